@@ -473,10 +473,12 @@ struct client {
 	unsigned int writable_input:1;
 	unsigned int async:1;
 	unsigned int flag_midi2:1;
+	unsigned int zero_denormals:1;
 
 	uint32_t max_frames;
 	uint32_t max_align;
 	mix_func mix_function;
+	struct spa_cpu *cpu_iface;
 
 	jack_position_t jack_position;
 	jack_transport_state_t jack_state;
@@ -4292,6 +4294,7 @@ jack_client_t * jack_client_open (const char *client_name,
 
 	client->allow_mlock = pw_properties_get_bool(props, "mem.allow-mlock", true);
 	client->warn_mlock = pw_properties_get_bool(props, "mem.warn-mlock", false);
+	client->zero_denormals = pw_properties_get_bool(props, SPA_KEY_CPU_ZERO_DENORMALS, false);
 
 	pw_context_conf_section_match_rules(client->context.context, "jack.rules",
 			&props->dict, execute_match, client);
@@ -4300,6 +4303,7 @@ jack_client_t * jack_client_open (const char *client_name,
 
 	client->mix_function = mix_c;
 	cpu_iface = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
+	client->cpu_iface = cpu_iface;
 	if (cpu_iface) {
 #if defined (__SSE__)
 		uint32_t flags = spa_cpu_get_flags(cpu_iface);
@@ -7520,6 +7524,23 @@ int jack_drop_real_time_scheduling (jack_native_thread_t thread)
 	return spa_thread_utils_drop_rt(globals.thread_utils, t);
 }
 
+struct thread_start {
+	void *(*start_routine)(void*);
+	void *arg;
+	struct spa_cpu *cpu_iface;
+};
+
+/* realtime client threads run DSP like the data loop and flush denormals
+ * in the same way */
+static void *thread_start(void *data)
+{
+	struct thread_start start = *(struct thread_start*)data;
+
+	free(data);
+	spa_cpu_zero_denormals(start.cpu_iface, true);
+	return start.start_routine(start.arg);
+}
+
 /**
  * Create a thread for JACK or one of its clients.  The thread is
  * created executing @a start_routine with @a arg as its sole
@@ -7547,6 +7568,7 @@ int jack_client_create_thread (jack_client_t* client,
 	struct client *c = (struct client *) client;
 	int res = 0;
 	struct spa_thread *thr;
+	struct thread_start *start = NULL;
 
 	return_val_if_fail(client != NULL, -EINVAL);
 	return_val_if_fail(thread != NULL, -EINVAL);
@@ -7554,9 +7576,21 @@ int jack_client_create_thread (jack_client_t* client,
 
 	pw_log_info("client %p: create thread rt:%d prio:%d", client, realtime, priority);
 
+	if (realtime && c->zero_denormals && c->cpu_iface != NULL) {
+		if ((start = malloc(sizeof(*start))) == NULL)
+			return -errno;
+		start->start_routine = start_routine;
+		start->arg = arg;
+		start->cpu_iface = c->cpu_iface;
+		start_routine = thread_start;
+		arg = start;
+	}
+
 	thr = spa_thread_utils_create(&c->context.thread_utils, NULL, start_routine, arg);
-	if (thr == NULL)
+	if (thr == NULL) {
 		res = -errno;
+		free(start);
+	}
 	*thread = (pthread_t)thr;
 
 	if (res != 0) {
@@ -64,7 +64,7 @@ struct spa_filter_graph_events {
 };
 
 struct spa_filter_graph_methods {
-#define SPA_VERSION_FILTER_GRAPH_METHODS	0
+#define SPA_VERSION_FILTER_GRAPH_METHODS	1
 	uint32_t version;
 
 	int (*add_listener) (void *object,
@@ -83,6 +83,19 @@ struct spa_filter_graph_methods {
 	int (*reset) (void *object);
 
 	int (*process) (void *object, const void *in[], void *out[], uint32_t n_samples);
+
+	/**
+	 * Queue control changes for the next process call. The sequence contains
+	 * SPA_CONTROL_Properties with the SPA_PROP_params of the controls, the
+	 * offset of a control is the sample in the next process call where
+	 * the new value starts.
+	 *
+	 * This can be called from one thread concurrently with process without
+	 * locking.
+	 *
+	 * Since version 1.
+	 */
+	int (*set_control) (void *object, const struct spa_pod_sequence *sequence);
 };
 
 SPA_API_FILTER_GRAPH int spa_filter_graph_add_listener(struct spa_filter_graph *object,
@@ -138,6 +151,13 @@ SPA_API_FILTER_GRAPH int spa_filter_graph_process(struct spa_filter_graph *objec
 			spa_filter_graph, &object->iface, process, 0, in, out, n_samples);
 }
 
+SPA_API_FILTER_GRAPH int spa_filter_graph_set_control(struct spa_filter_graph *object,
+			const struct spa_pod_sequence *sequence)
+{
+	return spa_api_method_r(int, -ENOTSUP,
+			spa_filter_graph, &object->iface, set_control, 1, sequence);
+}
+
 /**
  * \}
  */
@@ -43,7 +43,7 @@ extern "C" {
 #endif
 
 SPA_API_AUDIO_FORMAT_UTILS int
-spa_format_audio_parse(const struct spa_pod *format, struct spa_audio_info *info)
+spa_format_audio_ext_parse(const struct spa_pod *format, struct spa_audio_info *info, size_t size)
 {
 	int res;
 
@@ -55,7 +55,8 @@ spa_format_audio_parse(const struct spa_pod *format, struct spa_audio_info *info
 
 	switch (info->media_subtype) {
 	case SPA_MEDIA_SUBTYPE_raw:
-		return spa_format_audio_raw_parse(format, &info->info.raw);
+		return spa_format_audio_raw_ext_parse(format, &info->info.raw,
+				size - offsetof(struct spa_audio_info, info.raw));
 	case SPA_MEDIA_SUBTYPE_dsp:
 		return spa_format_audio_dsp_parse(format, &info->info.dsp);
 	case SPA_MEDIA_SUBTYPE_iec958:
@@ -84,13 +85,24 @@ spa_format_audio_parse(const struct spa_pod *format, struct spa_audio_info *info
 	return -ENOTSUP;
 }
 
+SPA_API_AUDIO_FORMAT_UTILS int
+spa_format_audio_parse(const struct spa_pod *format, struct spa_audio_info *info)
+{
+	int res = spa_format_audio_ext_parse(format, info, sizeof(*info));
+	/* raw formats with too many channels parse as unpositioned */
+	if (res == -ECHRNG)
+		res = spa_format_audio_raw_parse(format, &info->info.raw);
+	return res;
+}
+
 SPA_API_AUDIO_FORMAT_UTILS struct spa_pod *
-spa_format_audio_build(struct spa_pod_builder *builder, uint32_t id,
-		       const struct spa_audio_info *info)
+spa_format_audio_ext_build(struct spa_pod_builder *builder, uint32_t id,
+		       const struct spa_audio_info *info, size_t size)
 {
 	switch (info->media_subtype) {
 	case SPA_MEDIA_SUBTYPE_raw:
-		return spa_format_audio_raw_build(builder, id, &info->info.raw);
+		return spa_format_audio_raw_ext_build(builder, id, &info->info.raw,
+				size - offsetof(struct spa_audio_info, info.raw));
 	case SPA_MEDIA_SUBTYPE_dsp:
 		return spa_format_audio_dsp_build(builder, id, &info->info.dsp);
 	case SPA_MEDIA_SUBTYPE_iec958:
@@ -119,6 +131,13 @@ spa_format_audio_build(struct spa_pod_builder *builder, uint32_t id,
 	errno = ENOTSUP;
 	return NULL;
 }
+
+SPA_API_AUDIO_FORMAT_UTILS struct spa_pod *
+spa_format_audio_build(struct spa_pod_builder *builder, uint32_t id,
+		       const struct spa_audio_info *info)
+{
+	return spa_format_audio_ext_build(builder, id, info, sizeof(*info));
+}
 /**
  * \}
  */
@@ -28,10 +28,18 @@ extern "C" {
 #endif
 
 SPA_API_AUDIO_RAW_UTILS int
-spa_format_audio_raw_parse(const struct spa_pod *format, struct spa_audio_info_raw *info)
+spa_format_audio_raw_ext_parse(const struct spa_pod *format, struct spa_audio_info_raw *info,
+		size_t size)
 {
 	struct spa_pod *position = NULL;
+	uint32_t max_position;
 	int res;
+
+	if (!SPA_AUDIO_INFO_RAW_VALID_SIZE(size))
+		return -EINVAL;
+
+	max_position = SPA_AUDIO_INFO_RAW_MAX_POSITION(size);
+
 	info->flags = 0;
 	res = spa_pod_parse_object(format,
 			SPA_TYPE_OBJECT_Format, NULL,
@@ -39,7 +47,30 @@ spa_format_audio_raw_parse(const struct spa_pod *format, struct spa_audio_info_r
 			SPA_FORMAT_AUDIO_rate,		SPA_POD_OPT_Int(&info->rate),
 			SPA_FORMAT_AUDIO_channels,	SPA_POD_OPT_Int(&info->channels),
 			SPA_FORMAT_AUDIO_position,	SPA_POD_OPT_Pod(&position));
+	if (info->channels > max_position)
+		return -ECHRNG;
 	if (position == NULL ||
+	    !spa_pod_copy_array(position, SPA_TYPE_Id, info->position, max_position))
+		SPA_FLAG_SET(info->flags, SPA_AUDIO_FLAG_UNPOSITIONED);
+
+	return res;
+}
+
+SPA_API_AUDIO_RAW_UTILS int
+spa_format_audio_raw_parse(const struct spa_pod *format, struct spa_audio_info_raw *info)
+{
+	struct spa_pod *position = NULL;
+	int res;
+	info->flags = 0;
+	res = spa_pod_parse_object(format,
+			SPA_TYPE_OBJECT_Format, NULL,
+			SPA_FORMAT_AUDIO_format,	SPA_POD_OPT_Id(&info->format),
+			SPA_FORMAT_AUDIO_rate,		SPA_POD_OPT_Int(&info->rate),
+			SPA_FORMAT_AUDIO_channels,	SPA_POD_OPT_Int(&info->channels),
+			SPA_FORMAT_AUDIO_position,	SPA_POD_OPT_Pod(&position));
+	/* formats with more channels than positions parse as unpositioned,
+	 * use spa_format_audio_raw_ext_parse() to get their positions */
+	if (info->channels > SPA_AUDIO_MAX_CHANNELS || position == NULL ||
 	    !spa_pod_copy_array(position, SPA_TYPE_Id, info->position, SPA_AUDIO_MAX_CHANNELS))
 		SPA_FLAG_SET(info->flags, SPA_AUDIO_FLAG_UNPOSITIONED);
 
@@ -47,10 +78,18 @@ spa_format_audio_raw_parse(const struct spa_pod *format, struct spa_audio_info_r
 }
 
 SPA_API_AUDIO_RAW_UTILS struct spa_pod *
-spa_format_audio_raw_build(struct spa_pod_builder *builder, uint32_t id,
-			   const struct spa_audio_info_raw *info)
+spa_format_audio_raw_ext_build(struct spa_pod_builder *builder, uint32_t id,
+			   const struct spa_audio_info_raw *info, size_t size)
 {
 	struct spa_pod_frame f;
+	uint32_t max_position;
+
+	if (!SPA_AUDIO_INFO_RAW_VALID_SIZE(size)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	max_position = SPA_AUDIO_INFO_RAW_MAX_POSITION(size);
+
 	spa_pod_builder_push_object(builder, &f, SPA_TYPE_OBJECT_Format, id);
 	spa_pod_builder_add(builder,
 			SPA_FORMAT_mediaType,		SPA_POD_Id(SPA_MEDIA_TYPE_audio),
@@ -65,7 +104,8 @@ spa_format_audio_raw_build(struct spa_pod_builder *builder, uint32_t id,
 	if (info->channels != 0) {
 		spa_pod_builder_add(builder,
 			SPA_FORMAT_AUDIO_channels,	SPA_POD_Int(info->channels), 0);
-		if (!SPA_FLAG_IS_SET(info->flags, SPA_AUDIO_FLAG_UNPOSITIONED)) {
+		if (!SPA_FLAG_IS_SET(info->flags, SPA_AUDIO_FLAG_UNPOSITIONED) &&
+		    info->channels <= max_position) {
 			spa_pod_builder_add(builder, SPA_FORMAT_AUDIO_position,
 				SPA_POD_Array(sizeof(uint32_t), SPA_TYPE_Id,
 					info->channels, info->position), 0);
@@ -74,6 +114,13 @@ spa_format_audio_raw_build(struct spa_pod_builder *builder, uint32_t id,
 	return (struct spa_pod*)spa_pod_builder_pop(builder, &f);
 }
 
+SPA_API_AUDIO_RAW_UTILS struct spa_pod *
+spa_format_audio_raw_build(struct spa_pod_builder *builder, uint32_t id,
+			   const struct spa_audio_info_raw *info)
+{
+	return spa_format_audio_raw_ext_build(builder, id, info, sizeof(*info));
+}
+
 /**
  * \}
  */
@@ -248,6 +248,101 @@ spa_pod_filter_prop(struct spa_pod_builder *b,
 	return 0;
 }
 
+#ifndef SPA_POD_FILTER_MAX_PROPS
+#define SPA_POD_FILTER_MAX_PROPS	64u
+#endif
+
+/* filter all props of \a op with the props of \a of. When there are not too
+ * many props, the filter props are indexed by key first so that each lookup
+ * is a scan over a small array of keys and the props of the filter that
+ * are not in \a op don't need to be looked up again. */
+SPA_API_POD_FILTER int spa_pod_filter_object(struct spa_pod_builder *b,
+		const struct spa_pod_object *op, const struct spa_pod_object *of)
+{
+	const struct spa_pod_prop *p1, *p2;
+	const struct spa_pod_prop *props[SPA_POD_FILTER_MAX_PROPS];
+	uint32_t keys[SPA_POD_FILTER_MAX_PROPS];
+	bool used[SPA_POD_FILTER_MAX_PROPS];
+	uint32_t i, j, n_props = 0, hint = 0;
+	struct spa_pod_frame f;
+	int res = 0;
+
+	SPA_POD_OBJECT_FOREACH(of, p2) {
+		if (n_props == SPA_POD_FILTER_MAX_PROPS)
+			goto slow;
+		keys[n_props] = p2->key;
+		props[n_props] = p2;
+		used[n_props] = false;
+		n_props++;
+	}
+
+	spa_pod_builder_push_object(b, &f, op->body.type, op->body.id);
+	SPA_POD_OBJECT_FOREACH(op, p1) {
+		/* props are usually in the same order, start looking after
+		 * the last match */
+		for (i = 0, j = hint; i < n_props; i++, j++) {
+			if (j == n_props)
+				j = 0;
+			if (keys[j] == p1->key)
+				break;
+		}
+		if (i < n_props) {
+			used[j] = true;
+			hint = j + 1;
+			res = spa_pod_filter_prop(b, p1, props[j]);
+		}
+		else if ((p1->flags & SPA_POD_PROP_FLAG_MANDATORY) != 0)
+			res = -EINVAL;
+		else
+			spa_pod_builder_raw_padded(b, p1, SPA_POD_PROP_SIZE(p1));
+		if (res < 0)
+			break;
+	}
+	if (res >= 0) {
+		for (i = 0; i < n_props; i++) {
+			if (used[i])
+				continue;
+			if ((props[i]->flags & SPA_POD_PROP_FLAG_MANDATORY) != 0) {
+				res = -EINVAL;
+				break;
+			}
+			spa_pod_builder_raw_padded(b, props[i], SPA_POD_PROP_SIZE(props[i]));
+		}
+	}
+	spa_pod_builder_pop(b, &f);
+	return res;
+
+slow:
+	spa_pod_builder_push_object(b, &f, op->body.type, op->body.id);
+	p2 = NULL;
+	SPA_POD_OBJECT_FOREACH(op, p1) {
+		p2 = spa_pod_object_find_prop(of, p2, p1->key);
+		if (p2 != NULL)
+			res = spa_pod_filter_prop(b, p1, p2);
+		else if ((p1->flags & SPA_POD_PROP_FLAG_MANDATORY) != 0)
+			res = -EINVAL;
+		else
+			spa_pod_builder_raw_padded(b, p1, SPA_POD_PROP_SIZE(p1));
+		if (res < 0)
+			break;
+	}
+	if (res >= 0) {
+		p1 = NULL;
+		SPA_POD_OBJECT_FOREACH(of, p2) {
+			p1 = spa_pod_object_find_prop(op, p1, p2->key);
+			if (p1 != NULL)
+				continue;
+			if ((p2->flags & SPA_POD_PROP_FLAG_MANDATORY) != 0)
+				res = -EINVAL;
+			if (res < 0)
+				break;
+			spa_pod_builder_raw_padded(b, p2, SPA_POD_PROP_SIZE(p2));
+		}
+	}
+	spa_pod_builder_pop(b, &f);
+	return res;
+}
+
 SPA_API_POD_FILTER int spa_pod_filter_part(struct spa_pod_builder *b,
 	       const struct spa_pod *pod, uint32_t pod_size,
 	       const struct spa_pod *filter, uint32_t filter_size)
@@ -265,40 +360,12 @@ SPA_API_POD_FILTER int spa_pod_filter_part(struct spa_pod_builder *b,
 		switch (SPA_POD_TYPE(pp)) {
 		case SPA_TYPE_Object:
 			if (pf != NULL) {
-				struct spa_pod_object *op = (struct spa_pod_object *) pp;
-				struct spa_pod_object *of = (struct spa_pod_object *) pf;
-				const struct spa_pod_prop *p1, *p2;
-
 				if (SPA_POD_TYPE(pf) != SPA_POD_TYPE(pp))
 					return -EINVAL;
 
-				spa_pod_builder_push_object(b, &f, op->body.type, op->body.id);
-				p2 = NULL;
-				SPA_POD_OBJECT_FOREACH(op, p1) {
-					p2 = spa_pod_object_find_prop(of, p2, p1->key);
-					if (p2 != NULL)
-						res = spa_pod_filter_prop(b, p1, p2);
-					else if ((p1->flags & SPA_POD_PROP_FLAG_MANDATORY) != 0)
-						res = -EINVAL;
-					else
-						spa_pod_builder_raw_padded(b, p1, SPA_POD_PROP_SIZE(p1));
-					if (res < 0)
-						break;
-				}
-				if (res >= 0) {
-					p1 = NULL;
-					SPA_POD_OBJECT_FOREACH(of, p2) {
-						p1 = spa_pod_object_find_prop(op, p1, p2->key);
-						if (p1 != NULL)
-							continue;
-						if ((p2->flags & SPA_POD_PROP_FLAG_MANDATORY) != 0)
-							res = -EINVAL;
-						if (res < 0)
-							break;
-						spa_pod_builder_raw_padded(b, p2, SPA_POD_PROP_SIZE(p2));
-					}
-				}
-				spa_pod_builder_pop(b, &f);
+				res = spa_pod_filter_object(b,
+						(const struct spa_pod_object *) pp,
+						(const struct spa_pod_object *) pf);
 				do_advance = true;
 			}
 			else
@@ -363,6 +430,16 @@ spa_pod_filter(struct spa_pod_builder *b,
 	spa_pod_builder_get_state(b, &state);
 	if (filter == NULL) {
 		res = spa_pod_builder_raw_padded(b, pod, SPA_POD_SIZE(pod));
+	} else if (b->callbacks.funcs == NULL) {
+		/* a fixed size builder can't grow, filter directly into it
+		 * and roll back on filter errors instead of copying the result.
+		 * On overflow the offset stays advanced so that the caller can
+		 * find the required size, like when copying the result. */
+		res = spa_pod_filter_part(b, pod, SPA_POD_SIZE(pod), filter, SPA_POD_SIZE(filter));
+		if (res < 0)
+			spa_pod_builder_reset(b, &state);
+		else if (b->state.offset > b->size)
+			res = -ENOSPC;
 	} else {
 		struct spa_pod_dynamic_builder db;
 		spa_pod_dynamic_builder_continue(&db, b);
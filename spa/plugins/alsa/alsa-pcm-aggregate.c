@@ -0,0 +1,512 @@
+/* Spa ALSA aggregate PCM */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+
+#include <spa/utils/string.h>
+#include <spa/utils/json.h>
+
+#include "alsa-pcm.h"
+
+/*
+ * An aggregate node drives one or more secondary PCMs next to the main PCM
+ * of the node. The channels of the secondaries are appended to the channels
+ * of the main PCM so that the node has one wide port.
+ *
+ * Only the main PCM is used for timing, the secondaries are read and written
+ * from the same wakeup. The devices are expected to share a word clock. The
+ * phase difference between each secondary and the main PCM is measured every
+ * cycle and fed into a DLL. When the devices drift, the DLL output is used to
+ * slip single frames on the secondary and larger errors are resynced at once.
+ */
+
+#define CHECK(s,msg,...) if ((err = (s)) < 0) { spa_log_error(state->log, msg ": %s", ##__VA_ARGS__, snd_strerror(err)); return err; }
+
+int spa_alsa_aggregate_parse(struct state *state, const char *val, size_t len)
+{
+	struct spa_json it[2];
+	char key[256], device[128];
+	const char *v;
+	uint32_t extra = 0;
+	int l, n = 0, channels;
+
+	if (spa_json_begin_array_relax(&it[0], val, len) <= 0)
+		return -EINVAL;
+
+	while (spa_json_enter_object(&it[0], &it[1]) > 0) {
+		struct secondary *s;
+
+		device[0] = '\0';
+		channels = 0;
+
+		while ((l = spa_json_object_next(&it[1], key, sizeof(key), &v)) > 0) {
+			if (spa_streq(key, "device"))
+				spa_json_parse_stringn(v, l, device, sizeof(device));
+			else if (spa_streq(key, "channels"))
+				spa_json_parse_int(v, l, &channels);
+		}
+		if (device[0] == '\0' || channels <= 0) {
+			spa_log_warn(state->log, "%p: aggregate device needs a device and channels",
+					state);
+			continue;
+		}
+		if (n >= MAX_SECONDARIES) {
+			spa_log_warn(state->log, "%p: too many aggregate devices, ignoring '%s'",
+					state, device);
+			continue;
+		}
+		if (extra + (uint32_t)channels >= SPA_AUDIO_MAX_CHANNELS) {
+			spa_log_warn(state->log, "%p: too many aggregate channels, ignoring '%s'",
+					state, device);
+			continue;
+		}
+		s = &state->secondaries[n++];
+		spa_zero(*s);
+		spa_scnprintf(s->device, sizeof(s->device), "%s", device);
+		s->channels = channels;
+		extra += channels;
+	}
+	state->n_secondaries = n;
+	state->extra_channels = extra;
+
+	spa_log_info(state->log, "%p: aggregate of %d devices with %d extra channels",
+			state, n, extra);
+	return 0;
+}
+
+int spa_alsa_aggregate_open(struct state *state)
+{
+	uint32_t i;
+	int err;
+
+	for (i = 0; i < state->n_secondaries; i++) {
+		struct secondary *s = &state->secondaries[i];
+
+		spa_log_info(state->log, "%p: ALSA aggregate device open '%s'", state, s->device);
+		if ((err = snd_pcm_open(&s->hndl, s->device, state->stream,
+				SND_PCM_NONBLOCK |
+				SND_PCM_NO_AUTO_RESAMPLE |
+				SND_PCM_NO_AUTO_CHANNELS | SND_PCM_NO_AUTO_FORMAT)) < 0) {
+			spa_log_error(state->log, "'%s': aggregate open failed: %s",
+					s->device, snd_strerror(err));
+			spa_alsa_aggregate_close(state);
+			return err;
+		}
+	}
+	return 0;
+}
+
+void spa_alsa_aggregate_close(struct state *state)
+{
+	uint32_t i;
+	int err;
+
+	for (i = 0; i < state->n_secondaries; i++) {
+		struct secondary *s = &state->secondaries[i];
+
+		if (s->hndl == NULL)
+			continue;
+		if (s->linked)
+			snd_pcm_unlink(s->hndl);
+
+		spa_log_info(state->log, "%p: aggregate device '%s' closing, %u resyncs",
+				state, s->device, s->resyncs);
+		if ((err = snd_pcm_close(s->hndl)) < 0)
+			spa_log_warn(state->log, "%s: close failed: %s", s->device,
+					snd_strerror(err));
+		s->hndl = NULL;
+		s->linked = false;
+		s->started = false;
+	}
+	free(state->silence_data);
+	state->silence_data = NULL;
+	state->silence_frames = 0;
+}
+
+static int secondary_set_format(struct state *state, struct secondary *s)
+{
+	snd_pcm_t *hndl = s->hndl;
+	snd_pcm_hw_params_t *params;
+	snd_pcm_sw_params_t *swparams;
+	snd_pcm_uframes_t period_size = state->period_frames;
+	int err, dir = 0;
+
+	if (s->linked) {
+		snd_pcm_unlink(hndl);
+		s->linked = false;
+	}
+
+	snd_pcm_hw_params_alloca(&params);
+	CHECK(snd_pcm_hw_params_any(hndl, params), "'%s': no configurations available", s->device);
+	CHECK(snd_pcm_hw_params_set_rate_resample(hndl, params, 0), "'%s': set_rate_resample", s->device);
+
+	s->use_mmap = state->use_mmap;
+	if (s->use_mmap && snd_pcm_hw_params_set_access(hndl, params,
+				SND_PCM_ACCESS_MMAP_NONINTERLEAVED) < 0)
+		s->use_mmap = false;
+	if (!s->use_mmap)
+		CHECK(snd_pcm_hw_params_set_access(hndl, params, SND_PCM_ACCESS_RW_NONINTERLEAVED),
+				"'%s': set_access", s->device);
+
+	CHECK(snd_pcm_hw_params_set_format(hndl, params, state->format), "'%s': set_format", s->device);
+	CHECK(snd_pcm_hw_params_set_channels(hndl, params, s->channels), "'%s': set_channels %u",
+			s->device, s->channels);
+	CHECK(snd_pcm_hw_params_set_rate(hndl, params, state->rate, 0), "'%s': set_rate %d",
+			s->device, state->rate);
+
+	if (!state->is_batch && snd_pcm_hw_params_can_disable_period_wakeup(params))
+		CHECK(snd_pcm_hw_params_set_period_wakeup(hndl, params, 0), "'%s': set_period_wakeup",
+				s->device);
+
+	CHECK(snd_pcm_hw_params_set_period_size_near(hndl, params, &period_size, &dir),
+			"'%s': set_period_size_near", s->device);
+	s->buffer_frames = state->buffer_frames;
+	CHECK(snd_pcm_hw_params_set_buffer_size_near(hndl, params, &s->buffer_frames),
+			"'%s': set_buffer_size_near", s->device);
+	CHECK(snd_pcm_hw_params(hndl, params), "'%s': set_hw_params", s->device);
+
+	/* we start the secondaries ourselves */
+	snd_pcm_sw_params_alloca(&swparams);
+	CHECK(snd_pcm_sw_params_current(hndl, swparams), "'%s': sw_params_current", s->device);
+	CHECK(snd_pcm_sw_params_set_start_threshold(hndl, swparams, LONG_MAX),
+			"'%s': set_start_threshold", s->device);
+	CHECK(snd_pcm_sw_params(hndl, swparams), "'%s': sw_params", s->device);
+
+	/* with a link, the secondary starts and stops in the same
+	 * trigger as the main PCM */
+	err = snd_pcm_link(state->hndl, hndl);
+	s->linked = err >= 0;
+
+	spa_log_info(state->log, "%s: aggregate '%s' access:%s channels:%u first:%u "
+			"buffer frames %lu, period frames %lu linked:%u",
+			state->name, s->device, s->use_mmap ? "mmap" : "rw", s->channels,
+			s->first, s->buffer_frames, period_size, s->linked);
+	return 0;
+}
+
+int spa_alsa_aggregate_set_format(struct state *state)
+{
+	uint32_t i, first = state->channels;
+	snd_pcm_uframes_t frames = 0;
+	int res;
+
+	for (i = 0; i < state->n_secondaries; i++) {
+		struct secondary *s = &state->secondaries[i];
+
+		s->first = first;
+		first += s->channels;
+
+		if ((res = secondary_set_format(state, s)) < 0)
+			return res;
+		if (!s->use_mmap)
+			frames = SPA_MAX(frames, s->buffer_frames);
+	}
+
+	/* the rw secondaries write silence from this buffer, one buffer of
+	 * frames is the most that is ever written at once */
+	free(state->silence_data);
+	state->silence_data = NULL;
+	state->silence_frames = 0;
+	if (frames > 0) {
+		if ((state->silence_data = calloc(frames, state->frame_size)) == NULL)
+			return -errno;
+		state->silence_frames = frames;
+	}
+	return 0;
+}
+
+static int secondary_silence(struct state *state, struct secondary *s, snd_pcm_uframes_t silence)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames;
+	snd_pcm_sframes_t res;
+	uint32_t i;
+
+	if (s->use_mmap) {
+		while (silence > 0) {
+			frames = silence;
+			if ((res = snd_pcm_mmap_begin(s->hndl, &areas, &offset, &frames)) < 0)
+				return res;
+			if (frames == 0)
+				break;
+			snd_pcm_areas_silence(areas, offset, s->channels, frames, state->format);
+			if ((res = snd_pcm_mmap_commit(s->hndl, offset, frames)) < 0)
+				return res;
+			silence -= frames;
+		}
+	} else {
+		void *bufs[SPA_AUDIO_MAX_CHANNELS];
+
+		if (state->silence_data == NULL)
+			return -EIO;
+		for (i = 0; i < s->channels; i++)
+			bufs[i] = state->silence_data;
+		while (silence > 0) {
+			frames = SPA_MIN(silence, state->silence_frames);
+			if ((res = snd_pcm_writen(s->hndl, bufs, frames)) < 0)
+				return res;
+			if (res == 0)
+				break;
+			silence -= res;
+		}
+	}
+	return 0;
+}
+
+static void secondary_reset(struct state *state, struct secondary *s)
+{
+	spa_dll_init(&s->dll);
+	spa_dll_set_bw(&s->dll, SPA_DLL_BW_MIN, state->threshold, state->rate);
+	s->rate_diff = 1.0;
+	s->slip = 0.0;
+	s->pad = 0;
+}
+
+int spa_alsa_aggregate_prepare(struct state *state, snd_pcm_uframes_t silence)
+{
+	uint32_t i;
+	int err;
+
+	for (i = 0; i < state->n_secondaries; i++) {
+		struct secondary *s = &state->secondaries[i];
+
+		s->started = false;
+		secondary_reset(state, s);
+
+		/* linked secondaries are prepared with the main PCM */
+		if (!s->linked && (err = snd_pcm_prepare(s->hndl)) < 0 && err != -EBUSY) {
+			spa_log_error(state->log, "%s: snd_pcm_prepare error: %s",
+					s->device, snd_strerror(err));
+			return err;
+		}
+		if (state->stream == SND_PCM_STREAM_PLAYBACK)
+			secondary_silence(state, s, silence);
+	}
+	return 0;
+}
+
+int spa_alsa_aggregate_start(struct state *state)
+{
+	uint32_t i;
+	int err;
+
+	for (i = 0; i < state->n_secondaries; i++) {
+		struct secondary *s = &state->secondaries[i];
+
+		if (!s->linked && (err = snd_pcm_start(s->hndl)) < 0) {
+			spa_log_error(state->log, "%s: snd_pcm_start: %s",
+					s->device, snd_strerror(err));
+			return err;
+		}
+		s->started = true;
+	}
+	return 0;
+}
+
+void spa_alsa_aggregate_drop(struct state *state)
+{
+	uint32_t i;
+	int err;
+
+	for (i = 0; i < state->n_secondaries; i++) {
+		struct secondary *s = &state->secondaries[i];
+
+		if (!s->linked && (err = snd_pcm_drop(s->hndl)) < 0)
+			spa_log_warn(state->log, "%s: snd_pcm_drop: %s",
+					s->device, snd_strerror(err));
+		s->started = false;
+	}
+}
+
+/* A linked secondary shares the xrun with the main PCM, which recovers
+ * the whole group. Others are restarted and resynced on the next cycle. */
+static void secondary_recover(struct state *state, struct secondary *s, int res)
+{
+	spa_log_warn(state->log, "%s: aggregate xrun: %s", s->device, snd_strerror(res));
+
+	if (s->linked || (res != -EPIPE && res != -ESTRPIPE))
+		return;
+
+	if (snd_pcm_prepare(s->hndl) < 0)
+		return;
+	secondary_reset(state, s);
+	if (state->stream == SND_PCM_STREAM_PLAYBACK)
+		secondary_silence(state, s, state->threshold + state->headroom);
+	snd_pcm_start(s->hndl);
+	s->resyncs++;
+}
+
+/* positive frames removes frames from the secondary, negative adds silence */
+static void secondary_shift(struct state *state, struct secondary *s, snd_pcm_sframes_t frames)
+{
+	if (state->stream == SND_PCM_STREAM_PLAYBACK) {
+		if (frames > 0)
+			snd_pcm_rewind(s->hndl, frames);
+		else if (frames < 0)
+			secondary_silence(state, s, -frames);
+	} else {
+		if (frames > 0)
+			snd_pcm_forward(s->hndl, frames);
+		else if (frames < 0)
+			s->pad += -frames;
+	}
+}
+
+/* The delay is the number of queued frames for playback and the number of
+ * available frames for capture of the main PCM. The secondaries are expected
+ * to have the same amount of frames in their buffer. */
+void spa_alsa_aggregate_sync(struct state *state, snd_pcm_uframes_t delay)
+{
+	uint32_t i;
+
+	for (i = 0; i < state->n_secondaries; i++) {
+		struct secondary *s = &state->secondaries[i];
+		snd_pcm_sframes_t avail, sdelay, shift;
+		double err;
+
+		if (SPA_UNLIKELY(!s->started))
+			continue;
+
+		if (SPA_UNLIKELY((avail = snd_pcm_avail(s->hndl)) < 0)) {
+			secondary_recover(state, s, avail);
+			continue;
+		}
+		if (state->stream == SND_PCM_STREAM_PLAYBACK)
+			sdelay = s->buffer_frames - SPA_MIN((snd_pcm_uframes_t)avail, s->buffer_frames);
+		else
+			sdelay = avail + s->pad;
+
+		err = (double)sdelay - (double)delay;
+
+		if (SPA_UNLIKELY(fabs(err) > state->max_resync)) {
+			spa_log_info(state->log, "%s: aggregate delay:%ld main:%lu, resync",
+					s->device, sdelay, delay);
+			secondary_shift(state, s, (snd_pcm_sframes_t)err);
+			secondary_reset(state, s);
+			s->resyncs++;
+			continue;
+		}
+
+		s->rate_diff = spa_dll_update(&s->dll, err);
+
+		/* without a resampler, follow the drift by slipping a frame
+		 * when the accumulated correction reaches one frame */
+		s->slip += (1.0 - s->rate_diff) * state->threshold;
+		shift = (snd_pcm_sframes_t)s->slip;
+		if (SPA_UNLIKELY(shift != 0)) {
+			spa_log_trace(state->log, "%s: aggregate err:%f rate:%f slip:%ld",
+					s->device, err, s->rate_diff, shift);
+			secondary_shift(state, s, shift);
+			s->slip -= shift;
+		}
+	}
+}
+
+static snd_pcm_sframes_t secondary_transfer(struct state *state, struct secondary *s,
+		struct spa_data *d, uint32_t offs, snd_pcm_uframes_t frames)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t done = 0, offset, n;
+	snd_pcm_sframes_t res;
+	size_t frame_size = state->frame_size;
+	bool playback = state->stream == SND_PCM_STREAM_PLAYBACK;
+	uint32_t i;
+
+	if (!s->use_mmap) {
+		void *bufs[s->channels];
+
+		for (i = 0; i < s->channels; i++)
+			bufs[i] = SPA_PTROFF(d[s->first + i].data, offs, void);
+		if (playback)
+			return snd_pcm_writen(s->hndl, bufs, frames);
+		else
+			return snd_pcm_readn(s->hndl, bufs, frames);
+	}
+
+	if ((res = snd_pcm_avail_update(s->hndl)) < 0)
+		return res;
+
+	while (done < frames) {
+		n = frames - done;
+		if ((res = snd_pcm_mmap_begin(s->hndl, &areas, &offset, &n)) < 0)
+			return res;
+		if (n == 0)
+			break;
+
+		for (i = 0; i < s->channels; i++) {
+			void *dev = channel_area_addr(&areas[i], offset);
+			void *buf = SPA_PTROFF(d[s->first + i].data,
+					offs + done * frame_size, void);
+			if (playback)
+				spa_memcpy(dev, buf, n * frame_size);
+			else
+				spa_memcpy(buf, dev, n * frame_size);
+		}
+		if ((res = snd_pcm_mmap_commit(s->hndl, offset, n)) < 0)
+			return res;
+		done += n;
+	}
+	return done;
+}
+
+void spa_alsa_aggregate_write(struct state *state, struct spa_buffer *buf, uint32_t offs,
+		snd_pcm_uframes_t frames)
+{
+	uint32_t i;
+	snd_pcm_sframes_t res;
+
+	for (i = 0; i < state->n_secondaries; i++) {
+		struct secondary *s = &state->secondaries[i];
+
+		if (SPA_UNLIKELY(s->first + s->channels > buf->n_datas))
+			break;
+
+		if (SPA_UNLIKELY((res = secondary_transfer(state, s, buf->datas, offs, frames)) < 0))
+			secondary_recover(state, s, res);
+		else if (SPA_UNLIKELY((snd_pcm_uframes_t)res < frames))
+			spa_log_debug(state->log, "%s: aggregate wrote %ld of %lu frames",
+					s->device, res, frames);
+	}
+}
+
+void spa_alsa_aggregate_read(struct state *state, struct spa_buffer *buf,
+		snd_pcm_uframes_t frames)
+{
+	struct spa_data *d = buf->datas;
+	uint32_t i, j;
+	snd_pcm_sframes_t res;
+	snd_pcm_uframes_t pad;
+	size_t frame_size = state->frame_size;
+
+	for (i = 0; i < state->n_secondaries; i++) {
+		struct secondary *s = &state->secondaries[i];
+
+		if (SPA_UNLIKELY(s->first + s->channels > buf->n_datas))
+			break;
+
+		/* frames added by a resync go before the data of the device */
+		pad = SPA_MIN(s->pad, frames);
+		s->pad -= pad;
+
+		if (SPA_UNLIKELY((res = secondary_transfer(state, s, d,
+						pad * frame_size, frames - pad)) < 0)) {
+			secondary_recover(state, s, res);
+			res = 0;
+		}
+		for (j = 0; j < s->channels; j++) {
+			void *data = d[s->first + j].data;
+
+			if (SPA_UNLIKELY(pad > 0))
+				memset(data, 0, pad * frame_size);
+			if (SPA_UNLIKELY(pad + res < frames))
+				memset(SPA_PTROFF(data, (pad + res) * frame_size, void), 0,
+						(frames - pad - res) * frame_size);
+		}
+	}
+}
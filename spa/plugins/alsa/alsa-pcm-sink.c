@@ -337,6 +337,10 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
 		if ((res = spa_alsa_pause(this)) < 0)
 			return res;
 		break;
+	case SPA_NODE_COMMAND_Flush:
+		if ((res = spa_alsa_flush(this)) < 0)
+			return res;
+		break;
 	default:
 		return -ENOTSUP;
 	}
@@ -557,6 +561,7 @@ impl_node_port_enum_params(void *object, int seq,
 static int clear_buffers(struct state *this)
 {
 	if (this->n_buffers > 0) {
+		spa_alsa_clear_direct(this);
 		spa_list_init(&this->ready);
 		this->n_buffers = 0;
 	}
@@ -734,7 +739,7 @@ impl_node_port_use_buffers(void *object,
 	}
 	this->n_buffers = n_buffers;
 
-	return 0;
+	return spa_alsa_setup_direct(this);
 }
 
 static int
@@ -500,6 +500,7 @@ impl_node_port_enum_params(void *object, int seq,
 static int clear_buffers(struct state *this)
 {
 	if (this->n_buffers > 0) {
+		spa_alsa_clear_direct(this);
 		spa_list_init(&this->free);
 		spa_list_init(&this->ready);
 		this->n_buffers = 0;
@@ -664,7 +665,7 @@ impl_node_port_use_buffers(void *object,
 	}
 	this->n_buffers = n_buffers;
 
-	return 0;
+	return spa_alsa_setup_direct(this);
 }
 
 static int
@@ -194,6 +194,23 @@ static int alsa_set_param(struct state *state, const char *k, const char *s)
 		state->default_start_delay = atoi(s);
 	} else if (spa_streq(k, "api.alsa.disable-mmap")) {
 		state->disable_mmap = spa_atob(s);
+	} else if (spa_streq(k, "api.alsa.direct-mmap")) {
+		state->direct_mmap = spa_atob(s);
+		SPA_FLAG_UPDATE(state->port_info.flags, SPA_PORT_FLAG_DYNAMIC_DATA,
+				state->direct_mmap);
+		state->port_info.change_mask |= SPA_PORT_CHANGE_MASK_FLAGS;
+	} else if (spa_streq(k, "api.alsa.deep-buffer")) {
+		uint32_t deep_buffer;
+		if (!spa_atou32(s, &deep_buffer, 0)) {
+			spa_log_warn(state->log, "%p: %s: invalid value %s", state, k, s);
+		} else {
+			if (deep_buffer > MAX_DEEP_BUFFER) {
+				spa_log_warn(state->log, "%p: %s: %s > %u, clamping",
+						state, k, s, MAX_DEEP_BUFFER);
+				deep_buffer = MAX_DEEP_BUFFER;
+			}
+			state->deep_buffer = deep_buffer;
+		}
 	} else if (spa_streq(k, "api.alsa.disable-batch")) {
 		state->disable_batch = spa_atob(s);
 	} else if (spa_streq(k, "api.alsa.disable-tsched")) {
@@ -499,9 +516,25 @@ struct spa_pod *spa_alsa_enum_propinfo(struct state *state,
 			SPA_PROP_INFO_type, SPA_POD_CHOICE_RANGE_Int(state->htimestamp_max_errors, 0, INT32_MAX),
 			SPA_PROP_INFO_params, SPA_POD_Bool(true));
 		break;
+	case 19:
+		param = spa_pod_builder_add_object(b,
+			SPA_TYPE_OBJECT_PropInfo, SPA_PARAM_PropInfo,
+			SPA_PROP_INFO_name, SPA_POD_String("api.alsa.direct-mmap"),
+			SPA_PROP_INFO_description, SPA_POD_String("Render directly into the MMAP area"),
+			SPA_PROP_INFO_type, SPA_POD_CHOICE_Bool(state->direct_mmap),
+			SPA_PROP_INFO_params, SPA_POD_Bool(true));
+		break;
+	case 20:
+		param = spa_pod_builder_add_object(b,
+			SPA_TYPE_OBJECT_PropInfo, SPA_PARAM_PropInfo,
+			SPA_PROP_INFO_name, SPA_POD_String("api.alsa.deep-buffer"),
+			SPA_PROP_INFO_description, SPA_POD_String("Playback buffer to fill in milliseconds"),
+			SPA_PROP_INFO_type, SPA_POD_CHOICE_RANGE_Int(state->deep_buffer, 0, MAX_DEEP_BUFFER),
+			SPA_PROP_INFO_params, SPA_POD_Bool(true));
+		break;
 	// While adding params here, update the math in default too
 	default:
-		idx -= 18;
+		idx -= 20;
 		if (idx <= state->num_bind_ctls)
 			param = enum_bind_ctl_propinfo(state, idx - 1, b);
 		else
@@ -624,6 +657,12 @@ int spa_alsa_add_prop_params(struct state *state, struct spa_pod_builder *b)
 	spa_pod_builder_string(b, "api.alsa.disable-mmap");
 	spa_pod_builder_bool(b, state->disable_mmap);
 
+	spa_pod_builder_string(b, "api.alsa.direct-mmap");
+	spa_pod_builder_bool(b, state->direct_mmap);
+
+	spa_pod_builder_string(b, "api.alsa.deep-buffer");
+	spa_pod_builder_int(b, state->deep_buffer);
+
 	spa_pod_builder_string(b, "api.alsa.disable-batch");
 	spa_pod_builder_bool(b, state->disable_batch);
 
@@ -1005,6 +1044,8 @@ int spa_alsa_init(struct state *state, const struct spa_dict *info)
 			state->num_bind_ctls = i;
 
 			/* We'll do the actual binding after checking the card exists */
+		} else if (spa_streq(k, "api.alsa.aggregate")) {
+			spa_alsa_aggregate_parse(state, s, strlen(s));
 		} else {
 			alsa_set_param(state, k, s);
 		}
@@ -1082,6 +1123,9 @@ int spa_alsa_clear(struct state *state)
 		spa_log_warn(state->log, "output close failed: %s", snd_strerror(err));
 	fclose(state->log_file);
 
+	free(state->buffer_datas);
+	state->buffer_datas = NULL;
+
 	free(state->tag[0]);
 	free(state->tag[1]);
 
@@ -1208,10 +1252,15 @@ int spa_alsa_open(struct state *state, const char *params)
 			device_name,
 			state->stream == SND_PCM_STREAM_CAPTURE ? "capture" : "playback");
 
+	if ((err = spa_alsa_aggregate_open(state)) < 0)
+		goto error_exit_close;
+
 	if (!state->disable_tsched) {
 		if ((err = spa_system_timerfd_create(state->data_system,
-				CLOCK_MONOTONIC, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0)
+				CLOCK_MONOTONIC, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0) {
+			spa_alsa_aggregate_close(state);
 			goto error_exit_close;
+		}
 
 		state->timerfd = err;
 	} else {
@@ -1265,6 +1314,8 @@ int spa_alsa_close(struct state *state)
 
 	spa_alsa_pause(state);
 
+	spa_alsa_aggregate_close(state);
+
 	spa_log_info(state->log, "%p: Device '%s' closing", state, state->name);
 	if ((err = snd_pcm_close(state->hndl)) < 0)
 		spa_log_warn(state->log, "%s: close failed: %s", state->name,
@@ -1553,6 +1604,42 @@ static int add_rate(struct state *state, uint32_t scale, uint32_t interleave, bo
 	return 1;
 }
 
+/* aggregates have a fixed number of channels, the channels of the main
+ * PCM followed by the channels of the secondaries */
+static int add_aggregate_channels(struct state *state, uint32_t index, uint32_t channels,
+		struct spa_pod_builder *b)
+{
+	struct spa_pod_frame f[1];
+	const struct channel_map *map = NULL;
+	uint32_t i, total = channels + state->extra_channels;
+
+	if (index > 0)
+		return 0;
+
+	if (total > SPA_AUDIO_MAX_CHANNELS) {
+		spa_log_error(state->log, "%p: aggregate of %u channels exceeds the "
+				"maximum of %u channels", state, total, SPA_AUDIO_MAX_CHANNELS);
+		return -ENOTSUP;
+	}
+	spa_pod_builder_int(b, total);
+
+	if (state->default_pos.channels == total)
+		map = &state->default_pos;
+	else if (channels <= 8)
+		map = &default_map[channels];
+
+	spa_pod_builder_prop(b, SPA_FORMAT_AUDIO_position, 0);
+	spa_pod_builder_push_array(b, &f[0]);
+	for (i = 0; i < total; i++) {
+		if (map && i < map->channels)
+			spa_pod_builder_id(b, map->pos[i]);
+		else
+			spa_pod_builder_id(b, SPA_AUDIO_CHANNEL_AUX0 + i);
+	}
+	spa_pod_builder_pop(b, &f[0]);
+	return 1;
+}
+
 static int add_channels(struct state *state, bool all, uint32_t index, uint32_t *next,
 		snd_pcm_hw_params_t *params, struct spa_pod_builder *b)
 {
@@ -1582,6 +1669,9 @@ static int add_channels(struct state *state, bool all, uint32_t index, uint32_t
 
 	spa_pod_builder_prop(b, SPA_FORMAT_AUDIO_channels, 0);
 
+	if (state->n_secondaries > 0)
+		return add_aggregate_channels(state, index, max, b);
+
 	if (state->props.use_chmap && (maps = snd_pcm_query_chmaps(hndl)) != NULL) {
 		uint32_t channel;
 		snd_pcm_chmap_t* map;
@@ -1727,7 +1817,10 @@ static int enum_pcm_formats(struct state *state, uint32_t index, uint32_t *next,
 					spa_pod_builder_id(b, fi->spa_pformat);
 				spa_pod_builder_id(b, fi->spa_pformat);
 			}
-			if ((snd_pcm_access_mask_test(amask, SND_PCM_ACCESS_MMAP_INTERLEAVED) ||
+			/* the secondaries of an aggregate use their own
+			 * channel buffers so we need planar formats */
+			if (state->n_secondaries == 0 &&
+			    (snd_pcm_access_mask_test(amask, SND_PCM_ACCESS_MMAP_INTERLEAVED) ||
 			    snd_pcm_access_mask_test(amask, SND_PCM_ACCESS_RW_INTERLEAVED)) &&
 			    (state->default_format == 0 || state->default_format == fi->spa_format)) {
 				if (j++ == 0)
@@ -2078,6 +2171,11 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 		rrate = f->rate;
 		rchannels = f->channels;
 		rformat = spa_format_to_alsa(f->format, &planar);
+		if (state->n_secondaries > 0) {
+			if (!planar || rchannels <= state->extra_channels)
+				return -ENOTSUP;
+			rchannels -= state->extra_channels;
+		}
 		break;
 	}
 	case SPA_MEDIA_SUBTYPE_iec958:
@@ -2085,6 +2183,9 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 		struct spa_audio_info_iec958 *f = &fmt->info.iec958;
 		unsigned aes3;
 
+		if (state->n_secondaries > 0)
+			return -ENOTSUP;
+
 		spa_log_info(state->log, "using IEC958 Codec:%s rate:%d",
 				spa_type_audio_iec958_codec_to_short_name(f->codec),
 				f->rate);
@@ -2139,6 +2240,9 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 	{
 		struct spa_audio_info_dsd *f = &fmt->info.dsd;
 
+		if (state->n_secondaries > 0)
+			return -ENOTSUP;
+
 		rrate = f->rate;
 		rchannels = f->channels;
 
@@ -2239,7 +2343,7 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 		if (fmt->media_subtype != SPA_MEDIA_SUBTYPE_raw)
 			return -EINVAL;
 		rchannels = val;
-		fmt->info.raw.channels = rchannels;
+		fmt->info.raw.channels = rchannels + state->extra_channels;
 		match = false;
 	}
 
@@ -2280,7 +2384,7 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 	state->planar = planar;
 	state->blocks = 1;
 	if (planar)
-		state->blocks *= rchannels;
+		state->blocks *= rchannels + state->extra_channels;
 	else
 		state->frame_size *= rchannels;
 
@@ -2300,6 +2404,11 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 	default_period = SPA_SCALE32_UP(DEFAULT_PERIOD, state->rate, DEFAULT_RATE);
 	default_period = flp2(2 * default_period - 1);
 
+	state->deep_frames = 0;
+	if (state->deep_buffer > 0 && state->stream == SND_PCM_STREAM_PLAYBACK &&
+	    !state->disable_tsched && state->n_secondaries == 0)
+		state->deep_frames = SPA_SCALE32_UP(state->deep_buffer, state->rate, 1000);
+
 	/* no period size specified. If we are batch or not using timers,
 	 * use the graph duration as the period */
 	if (period_size == 0 && (state->is_batch || state->disable_tsched))
@@ -2335,9 +2444,13 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 		CHECK(snd_pcm_hw_params_set_periods_near(hndl, params, &periods, &dir), "set_periods");
 		state->buffer_frames = period_size * periods;
 	} else {
+		snd_pcm_uframes_t max_frames = state->quantum_limit * 4 * state->frame_scale;
+
 		CHECK(snd_pcm_hw_params_get_buffer_size_max(params, &state->buffer_frames), "get_buffer_size_max");
 
-		state->buffer_frames = SPA_MIN(state->buffer_frames, state->quantum_limit * 4 * state->frame_scale);
+		if (state->deep_frames > 0)
+			max_frames = SPA_MAX(max_frames, state->deep_frames + state->quantum_limit);
+		state->buffer_frames = SPA_MIN(state->buffer_frames, max_frames);
 
 		CHECK(snd_pcm_hw_params_set_buffer_size_min(hndl, params, &state->buffer_frames), "set_buffer_size_min");
 		CHECK(snd_pcm_hw_params_set_buffer_size_near(hndl, params, &state->buffer_frames), "set_buffer_size_near");
@@ -2363,17 +2476,20 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 
 	spa_log_info(state->log, "%s: format:%s access:%s-%s rate:%d channels:%d "
 			"buffer frames %lu, period frames %lu, periods %u, frame_size %zd "
-			"headroom %u start-delay:%u batch:%u tsched:%u",
+			"headroom %u start-delay:%u batch:%u tsched:%u deep:%u",
 			state->name, snd_pcm_format_name(state->format),
 			state->use_mmap ? "mmap" : "rw",
 			planar ? "planar" : "interleaved",
 			state->rate, state->channels, state->buffer_frames, state->period_frames,
 			periods, state->frame_size, state->headroom, state->start_delay,
-			state->is_batch, !state->disable_tsched);
+			state->is_batch, !state->disable_tsched, state->deep_frames);
 
 	/* write the parameters to device */
 	CHECK(snd_pcm_hw_params(hndl, params), "set_hw_params");
 
+	if ((err = spa_alsa_aggregate_set_format(state)) < 0)
+		return err;
+
 	return match ? 0 : 1;
 }
 
@@ -2478,6 +2594,160 @@ static int set_timeout(struct state *state, uint64_t time)
 	return 0;
 }
 
+/* With direct mmap, the data of the buffers points into the mmap area of the
+ * device so that the peer renders into or reads from the ring buffer without
+ * an extra copy. This needs buffers with dynamic data and mmap areas where
+ * each buffer data maps to one contiguous area. */
+int spa_alsa_setup_direct(struct state *state)
+{
+	uint32_t i, j, n_datas;
+	void **datas;
+
+	spa_alsa_clear_direct(state);
+
+	if (!state->direct_mmap || !state->use_mmap || state->n_buffers == 0 ||
+	    state->n_secondaries > 0)
+		return 0;
+
+	n_datas = state->buffers[0].buf->n_datas;
+	for (i = 0; i < state->n_buffers; i++) {
+		struct spa_buffer *buf = state->buffers[i].buf;
+		if (buf->n_datas != n_datas)
+			return 0;
+		for (j = 0; j < n_datas; j++) {
+			if (!SPA_FLAG_IS_SET(buf->datas[j].flags, SPA_DATA_FLAG_DYNAMIC))
+				return 0;
+		}
+	}
+	if ((datas = calloc(state->n_buffers * n_datas, sizeof(void *))) == NULL)
+		return -errno;
+
+	for (i = 0; i < state->n_buffers; i++) {
+		struct buffer *b = &state->buffers[i];
+
+		b->datas = &datas[i * n_datas];
+		for (j = 0; j < n_datas; j++)
+			b->datas[j] = b->buf->datas[j].data;
+		b->maxsize = b->buf->datas[0].maxsize;
+	}
+	state->buffer_datas = datas;
+	state->direct = true;
+
+	spa_log_info(state->log, "%s: using direct mmap", state->name);
+	return 0;
+}
+
+static void direct_restore(struct state *state, struct buffer *b)
+{
+	struct spa_data *d = b->buf->datas;
+	uint32_t i;
+
+	if (!SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_DIRECT))
+		return;
+
+	for (i = 0; i < b->buf->n_datas; i++) {
+		d[i].data = b->datas[i];
+		d[i].maxsize = b->maxsize;
+	}
+	SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_DIRECT);
+}
+
+void spa_alsa_clear_direct(struct state *state)
+{
+	uint32_t i;
+
+	for (i = 0; i < state->n_buffers; i++) {
+		struct buffer *b = &state->buffers[i];
+
+		direct_restore(state, b);
+		b->datas = NULL;
+	}
+	free(state->buffer_datas);
+	state->buffer_datas = NULL;
+	state->direct = false;
+}
+
+static bool direct_areas(struct state *state, const snd_pcm_channel_area_t *areas,
+		uint32_t n_datas)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_datas; i++) {
+		if (areas[i].first % 8 != 0 ||
+		    areas[i].step != state->frame_size * 8)
+			return false;
+	}
+	return true;
+}
+
+static void direct_set(struct state *state, struct buffer *b,
+		const snd_pcm_channel_area_t *areas, snd_pcm_uframes_t offset,
+		snd_pcm_uframes_t frames)
+{
+	struct spa_data *d = b->buf->datas;
+	uint32_t i, maxsize;
+
+	maxsize = SPA_MIN(b->maxsize, frames * state->frame_size);
+	for (i = 0; i < b->buf->n_datas; i++) {
+		d[i].data = channel_area_addr(&areas[i], offset);
+		d[i].maxsize = maxsize;
+	}
+	SPA_FLAG_SET(b->flags, BUFFER_FLAG_DIRECT);
+}
+
+/* Point the buffers of the producer to the next free space in the ring
+ * buffer. We only do this when there is enough contiguous space for a
+ * complete cycle, otherwise the buffers use their own memory. */
+static void playback_direct(struct state *state)
+{
+	const snd_pcm_channel_area_t *my_areas;
+	snd_pcm_uframes_t offset, frames = state->buffer_frames;
+	uint32_t i, need;
+	bool direct;
+
+	need = state->threshold + (state->resample ? DIRECT_SLACK : 0);
+
+	direct = spa_list_is_empty(&state->ready) &&
+		snd_pcm_mmap_begin(state->hndl, &my_areas, &offset, &frames) >= 0 &&
+		frames >= need &&
+		direct_areas(state, my_areas, state->buffers[0].buf->n_datas);
+
+	for (i = 0; i < state->n_buffers; i++) {
+		struct buffer *b = &state->buffers[i];
+
+		if (!SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT))
+			continue;
+		if (direct)
+			direct_set(state, b, my_areas, offset, frames);
+		else
+			direct_restore(state, b);
+	}
+}
+
+/* Move the queued data out of the ring buffer before the ring buffer is
+ * modified by something other than the producer */
+static void playback_direct_detach(struct state *state)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < state->n_buffers; i++) {
+		struct buffer *b = &state->buffers[i];
+		struct spa_data *d = b->buf->datas;
+
+		if (!SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_DIRECT))
+			continue;
+
+		if (!SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT)) {
+			for (j = 0; j < b->buf->n_datas; j++) {
+				uint32_t size = SPA_MIN(d[j].maxsize,
+						d[j].chunk->offset + d[j].chunk->size);
+				memcpy(b->datas[j], d[j].data, size);
+			}
+		}
+		direct_restore(state, b);
+	}
+}
+
 static int spa_alsa_silence(struct state *state, snd_pcm_uframes_t silence)
 {
 	snd_pcm_t *hndl = state->hndl;
@@ -2485,6 +2755,9 @@ static int spa_alsa_silence(struct state *state, snd_pcm_uframes_t silence)
 	snd_pcm_uframes_t frames, offset;
 	int i, res;
 
+	if (state->direct)
+		playback_direct_detach(state);
+
 	if (state->use_mmap) {
 		frames = state->buffer_frames;
 
@@ -2543,6 +2816,7 @@ static void reset_buffers(struct state *this)
 
 static int do_prepare(struct state *state)
 {
+	snd_pcm_uframes_t silence;
 	int err;
 
 	state->last_threshold = state->threshold;
@@ -2558,17 +2832,20 @@ static int do_prepare(struct state *state)
 				state->name, snd_strerror(err));
 		return err;
 	}
-	if (state->stream == SND_PCM_STREAM_PLAYBACK) {
-		snd_pcm_uframes_t silence = state->start_delay + state->threshold + state->headroom;
-		if (state->disable_tsched)
-			silence += state->threshold;
+	silence = state->start_delay + state->threshold + state->headroom;
+	if (state->disable_tsched)
+		silence += state->threshold;
+	if (state->stream == SND_PCM_STREAM_PLAYBACK)
 		spa_alsa_silence(state, silence);
-	}
+
+	CHECK(spa_alsa_aggregate_prepare(state, silence), "aggregate prepare");
 
 	reset_buffers(state);
 	state->alsa_sync = true;
 	state->alsa_sync_warning = false;
 	state->alsa_started = false;
+	state->deep_filling = false;
+	state->deep_rewind = false;
 
 	return 0;
 }
@@ -2582,6 +2859,7 @@ static inline int do_drop(struct state *state)
 				state->name, snd_strerror(res));
 		return res;
 	}
+	spa_alsa_aggregate_drop(state);
 	return 0;
 }
 
@@ -2595,6 +2873,8 @@ static inline int do_start(struct state *state)
 					state->name, snd_strerror(res));
 			return res;
 		}
+		if ((res = spa_alsa_aggregate_start(state)) < 0)
+			return res;
 		state->alsa_started = true;
 	}
 	return 0;
@@ -2965,10 +3245,134 @@ static inline int check_position_config(struct state *state, bool starting)
 		state->resample = !state->pitch_elem &&
 			(((uint32_t)state->rate != state->driver_rate.denom) || state->matching);
 		state->alsa_sync = true;
+		/* a new quantum usually means a new client, don't let it wait
+		 * for the deep buffer to drain */
+		state->deep_rewind = state->deep_frames > 0;
+	}
+	return 0;
+}
+
+static uint64_t get_time_ns(struct state *state);
+
+/* With a deep buffer, the driver fills a large part of the hardware buffer
+ * by running the graph in a burst of cycles and then sleeps until the buffer
+ * drained to the normal target. Interactive changes rewind the buffer. */
+static inline bool deep_buffer_active(struct state *state)
+{
+	return state->deep_frames > 0 && !state->following && !state->freewheel;
+}
+
+static void deep_buffer_rewind(struct state *state)
+{
+	snd_pcm_sframes_t avail, rewind;
+	snd_pcm_uframes_t queued, target = state->threshold + state->headroom;
+
+	state->deep_rewind = false;
+
+	if (!state->alsa_started)
+		return;
+
+	if (state->direct)
+		playback_direct_detach(state);
+
+	if ((avail = snd_pcm_avail(state->hndl)) < 0)
+		return;
+
+	queued = state->buffer_frames - SPA_MIN((snd_pcm_uframes_t)avail, state->buffer_frames);
+	if (queued <= target)
+		return;
+
+	rewind = SPA_MIN(snd_pcm_rewindable(state->hndl), (snd_pcm_sframes_t)(queued - target));
+	if (rewind > 0)
+		rewind = snd_pcm_rewind(state->hndl, rewind);
+
+	spa_log_debug(state->log, "%s: deep buffer queued:%lu rewind:%ld",
+			state->name, queued, rewind);
+
+	state->deep_filling = true;
+}
+
+static int deep_buffer_sync(struct state *state, uint64_t current_time,
+		snd_pcm_uframes_t delay, snd_pcm_uframes_t target)
+{
+	if (SPA_UNLIKELY(state->deep_rewind)) {
+		deep_buffer_rewind(state);
+		delay = SPA_MIN(delay, target);
+	}
+	if (!state->deep_filling) {
+		if (state->alsa_started && delay > target + state->threshold) {
+			spa_log_trace(state->log, "%p: deep buffer wakeup %lu %lu", state,
+					delay, target);
+			state->next_time = current_time + (delay - target) * SPA_NSEC_PER_SEC / state->rate;
+			return -EAGAIN;
+		}
+		state->deep_filling = true;
+	}
+
+	if (SPA_LIKELY(state->clock)) {
+		state->clock->nsec = current_time;
+		state->clock->rate = state->driver_rate;
+		state->clock->position += state->clock->duration;
+		state->clock->duration = state->driver_duration;
+		state->clock->delay = delay + state->delay;
+		state->clock->rate_diff = 1.0;
+		state->clock->next_nsec = current_time;
 	}
+	/* when the graph doesn't complete, try again after a cycle */
+	state->next_time = current_time + (uint64_t)(state->threshold * 1e9 / state->rate);
 	return 0;
 }
 
+/* called after writing, run the next cycle right away while there is room
+ * in the buffer or sleep until it drained */
+static void deep_buffer_next(struct state *state)
+{
+	snd_pcm_sframes_t avail;
+	snd_pcm_uframes_t queued, fill, target = state->threshold + state->headroom;
+	uint64_t now;
+
+	if ((avail = snd_pcm_avail(state->hndl)) < 0)
+		return;
+
+	queued = state->buffer_frames - SPA_MIN((snd_pcm_uframes_t)avail, state->buffer_frames);
+	fill = SPA_MIN(state->deep_frames, state->buffer_frames - state->threshold);
+	now = get_time_ns(state);
+
+	if (queued + state->threshold <= fill) {
+		state->next_time = now;
+	} else {
+		state->deep_filling = false;
+		state->next_time = now + (queued - SPA_MIN(queued, target)) *
+			SPA_NSEC_PER_SEC / state->rate;
+	}
+	set_timeout(state, state->next_time);
+}
+
+static int do_deep_rewind(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct state *state = user_data;
+
+	if (!state->started || !deep_buffer_active(state))
+		return 0;
+
+	deep_buffer_rewind(state);
+	if (state->deep_filling) {
+		state->next_time = get_time_ns(state);
+		set_timeout(state, state->next_time);
+	}
+	return 0;
+}
+
+int spa_alsa_flush(struct state *state)
+{
+	if (state->deep_frames == 0 || !state->started)
+		return 0;
+
+	spa_log_debug(state->log, "%p: flush", state);
+	return spa_loop_invoke(state->data_loop, do_deep_rewind, 0, NULL, 0, true, state);
+}
+
 static int alsa_write_sync(struct state *state, uint64_t current_time)
 {
 	int res, suppressed;
@@ -2984,6 +3388,9 @@ static int alsa_write_sync(struct state *state, uint64_t current_time)
 		return res;
 	}
 
+	if (deep_buffer_active(state))
+		return deep_buffer_sync(state, current_time, delay, target);
+
 	if (SPA_UNLIKELY(!following && state->alsa_started && delay > target + state->max_error)) {
 		spa_log_trace(state->log, "%p: early wakeup %ld %lu %lu", state,
 				avail, delay, target);
@@ -2995,6 +3402,9 @@ static int alsa_write_sync(struct state *state, uint64_t current_time)
 	if (SPA_UNLIKELY((res = update_time(state, current_time, delay, target, following)) < 0))
 		return res;
 
+	if (state->n_secondaries > 0 && state->alsa_started)
+		spa_alsa_aggregate_sync(state, delay);
+
 	if (following && state->alsa_started && !state->linked) {
 		if (SPA_UNLIKELY(state->alsa_sync)) {
 			enum spa_log_level lev;
@@ -3012,6 +3422,8 @@ static int alsa_write_sync(struct state *state, uint64_t current_time)
 					state->name, avail, delay,
 					target, state->threshold, suppressed);
 
+			if (state->direct)
+				playback_direct_detach(state);
 			if (avail > target)
 				snd_pcm_rewind(state->hndl, avail - target);
 			else if (avail < target)
@@ -3058,10 +3470,12 @@ again:
 		size_t n_bytes, n_frames;
 		struct buffer *b;
 		struct spa_data *d;
-		uint32_t i, offs, size, last_offset;
+		uint32_t i, n_datas, offs, size, last_offset;
 
 		b = spa_list_first(&state->ready, struct buffer, link);
 		d = b->buf->datas;
+		/* the extra datas of an aggregate go to the secondaries */
+		n_datas = SPA_MIN(b->buf->n_datas, (uint32_t)state->channels);
 
 		offs = d[0].chunk->offset + state->ready_offset;
 		last_offset = d[0].chunk->size;
@@ -3074,13 +3488,21 @@ again:
 		n_bytes = n_frames * frame_size;
 
 		if (SPA_LIKELY(state->use_mmap)) {
-			for (i = 0; i < b->buf->n_datas; i++) {
-				spa_memcpy(channel_area_addr(&my_areas[i], off),
-						SPA_PTROFF(d[i].data, offs, void), n_bytes);
+			for (i = 0; i < n_datas; i++) {
+				void *dst = channel_area_addr(&my_areas[i], off);
+				void *src = SPA_PTROFF(d[i].data, offs, void);
+
+				if (SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_DIRECT)) {
+					/* rendered in place unless the ring moved */
+					if (SPA_UNLIKELY(src != dst))
+						memmove(dst, src, n_bytes);
+				} else {
+					spa_memcpy(dst, src, n_bytes);
+				}
 			}
 		} else {
-			void *bufs[b->buf->n_datas];
-			for (i = 0; i < b->buf->n_datas; i++)
+			void *bufs[n_datas];
+			for (i = 0; i < n_datas; i++)
 				bufs[i] = SPA_PTROFF(d[i].data, offs, void);
 
 			if (state->planar)
@@ -3088,6 +3510,8 @@ again:
 			else
 				snd_pcm_writei(hndl, bufs[0], n_frames);
 		}
+		if (state->n_secondaries > 0)
+			spa_alsa_aggregate_write(state, b->buf, offs, n_frames);
 
 		state->ready_offset += n_bytes;
 
@@ -3135,6 +3559,12 @@ again:
 	if (SPA_UNLIKELY(!state->alsa_started && (total_written > 0 || frames == 0)))
 		do_start(state);
 
+	if (state->direct)
+		playback_direct(state);
+
+	if (state->deep_filling && deep_buffer_active(state))
+		deep_buffer_next(state);
+
 	update_sources(state, true);
 
 	return 0;
@@ -3164,7 +3594,8 @@ static snd_pcm_uframes_t
 push_frames(struct state *state,
 	    const snd_pcm_channel_area_t *my_areas,
 	    snd_pcm_uframes_t offset,
-	    snd_pcm_uframes_t frames)
+	    snd_pcm_uframes_t frames,
+	    bool direct)
 {
 	snd_pcm_uframes_t total_frames = 0;
 
@@ -3180,6 +3611,8 @@ push_frames(struct state *state,
 		b = spa_list_first(&state->free, struct buffer, link);
 		spa_list_remove(&b->link);
 
+		direct_restore(state, b);
+
 		if (b->h) {
 			b->h->seq = state->sample_count;
 			b->h->pts = state->next_time;
@@ -3197,14 +3630,21 @@ push_frames(struct state *state,
 			l0 = SPA_MIN(n_bytes, left * frame_size);
 			l1 = n_bytes - l0;
 
+			if (direct && l1 == 0 &&
+			    direct_areas(state, my_areas, b->buf->n_datas))
+				direct_set(state, b, my_areas, offset, total_frames);
+
 			for (i = 0; i < b->buf->n_datas; i++) {
-				spa_memcpy(d[i].data,
-						channel_area_addr(&my_areas[i], offset),
-						l0);
-				if (SPA_UNLIKELY(l1 > 0))
-					spa_memcpy(SPA_PTROFF(d[i].data, l0, void),
-							channel_area_addr(&my_areas[i], 0),
-							l1);
+				if (i < (uint32_t)state->channels &&
+				    !SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_DIRECT)) {
+					spa_memcpy(d[i].data,
+							channel_area_addr(&my_areas[i], offset),
+							l0);
+					if (SPA_UNLIKELY(l1 > 0))
+						spa_memcpy(SPA_PTROFF(d[i].data, l0, void),
+								channel_area_addr(&my_areas[i], 0),
+								l1);
+				}
 				d[i].chunk->offset = 0;
 				d[i].chunk->size = n_bytes;
 				d[i].chunk->stride = frame_size;
@@ -3223,6 +3663,9 @@ push_frames(struct state *state,
 				snd_pcm_readi(state->hndl, bufs[0], total_frames);
 			}
 		}
+		if (state->n_secondaries > 0)
+			spa_alsa_aggregate_read(state, b->buf, total_frames);
+
 		spa_log_trace_fp(state->log, "%p: wrote %ld frames into buffer %d",
 				state, total_frames, b->id);
 
@@ -3260,6 +3703,9 @@ static int alsa_read_sync(struct state *state, uint64_t current_time)
 	if (SPA_UNLIKELY((res = update_time(state, current_time, delay, target, following)) < 0))
 		return res;
 
+	if (state->n_secondaries > 0)
+		spa_alsa_aggregate_sync(state, delay);
+
 	max_read = state->buffer_frames;
 	if (following && !state->linked) {
 		if (state->alsa_sync) {
@@ -3322,7 +3768,17 @@ static int alsa_read_frames(struct state *state)
 	}
 
 	if (frames > 0) {
-		read = push_frames(state, my_areas, offset, frames);
+		bool direct = false;
+
+		/* the committed frames are only overwritten by the device after
+		 * it filled the rest of the ring buffer, make sure that this takes
+		 * at least a cycle so that the peer can read them in place */
+		if (state->direct) {
+			snd_pcm_sframes_t filled = snd_pcm_avail_update(hndl);
+			direct = filled >= 0 &&
+				state->buffer_frames >= (snd_pcm_uframes_t)filled + state->threshold;
+		}
+		read = push_frames(state, my_areas, offset, frames, direct);
 		total_read += read;
 	} else {
 		spa_alsa_skip(state);
@@ -3382,6 +3838,8 @@ int spa_alsa_skip(struct state *state)
 	b = spa_list_first(&state->free, struct buffer, link);
 	spa_list_remove(&b->link);
 
+	direct_restore(state, b);
+
 	d = b->buf->datas;
 
 	avail = d[0].maxsize / state->frame_size;
@@ -3539,7 +3997,7 @@ static void alsa_irq_wakeup_event(struct spa_source *source)
 static void alsa_timer_wakeup_event(struct spa_source *source)
 {
 	struct state *state = source->data;
-	uint64_t expire, current_time;
+	uint64_t expire, current_time, max_timeout;
 	int res, suppressed;
 
 	if (SPA_LIKELY(state->started)) {
@@ -3558,7 +4016,11 @@ static void alsa_timer_wakeup_event(struct spa_source *source)
 
 	alsa_do_wakeup_work(state, current_time);
 
-	if (state->next_time > current_time + SPA_NSEC_PER_SEC ||
+	max_timeout = SPA_NSEC_PER_SEC;
+	if (state->deep_frames > 0)
+		max_timeout += state->buffer_frames * SPA_NSEC_PER_SEC / state->rate;
+
+	if (state->next_time > current_time + max_timeout ||
 	    current_time > state->next_time + SPA_NSEC_PER_SEC) {
 		if ((suppressed = spa_ratelimit_test(&state->rate_limit, current_time)) >= 0) {
 			spa_log_error(state->log, "%s: impossible timeout %"
@@ -3658,7 +4120,9 @@ int spa_alsa_prepare(struct state *state)
 		if (follower != state && !follower->matching) {
 			if (spa_alsa_prepare(follower) < 0)
 				continue;
-			if (!follower->linked && state->auto_link)
+			/* aggregates are linked to their secondaries */
+			if (!follower->linked && state->auto_link &&
+			    state->n_secondaries == 0 && follower->n_secondaries == 0)
 				do_link(state, follower);
 		}
 	}
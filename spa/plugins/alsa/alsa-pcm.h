@@ -46,6 +46,14 @@ extern "C" {
 
 #define MAX_HTIMESTAMP_ERROR	64
 
+/* extra space for the rate matching resampler when rendering in place */
+#define DIRECT_SLACK		64u
+
+/* the largest api.alsa.deep-buffer in milliseconds */
+#define MAX_DEEP_BUFFER		10000u
+
+#define MAX_SECONDARIES		8
+
 struct props {
 	char device[64];
 	char device_name[128];
@@ -60,10 +68,13 @@ struct props {
 struct buffer {
 	uint32_t id;
 #define BUFFER_FLAG_OUT	(1<<0)
+#define BUFFER_FLAG_DIRECT	(1<<1)
 	uint32_t flags;
 	struct spa_buffer *buf;
 	struct spa_meta_header *h;
 	struct spa_list link;
+	void **datas;		/**< memory of the buffer when not direct */
+	uint32_t maxsize;
 };
 
 #define BW_MAX		0.128
@@ -76,6 +87,26 @@ struct channel_map {
 	uint32_t pos[SPA_AUDIO_MAX_CHANNELS];
 };
 
+/* an extra PCM of an aggregate node, its channels follow the channels of
+ * the main PCM and of the secondaries before it */
+struct secondary {
+	char device[128];
+	snd_pcm_t *hndl;
+	uint32_t channels;
+	uint32_t first;
+	snd_pcm_uframes_t buffer_frames;
+	snd_pcm_uframes_t pad;
+
+	struct spa_dll dll;
+	double rate_diff;
+	double slip;
+	uint32_t resyncs;
+
+	unsigned int use_mmap:1;
+	unsigned int linked:1;
+	unsigned int started:1;
+};
+
 struct card {
 	struct spa_list link;
 	int ref;
@@ -152,11 +183,13 @@ struct state {
 	uint32_t n_allowed_rates;
 	struct channel_map default_pos;
 	unsigned int disable_mmap:1;
+	unsigned int direct_mmap:1;
 	unsigned int disable_batch:1;
 	unsigned int disable_tsched:1;
 	unsigned int is_split_parent:1;
 	char clock_name[64];
 	uint32_t quantum_limit;
+	uint32_t deep_buffer;
 
 	snd_pcm_uframes_t buffer_frames;
 	snd_pcm_uframes_t period_frames;
@@ -167,6 +200,7 @@ struct state {
 	size_t frame_scale;
 	int blocks;
 	uint32_t delay;
+	uint32_t deep_frames;
 	uint32_t read_size;
 	uint32_t max_read;
 
@@ -189,6 +223,7 @@ struct state {
 
 	struct buffer buffers[MAX_BUFFERS];
 	unsigned int n_buffers;
+	void **buffer_datas;
 
 	struct spa_list free;
 	struct spa_list ready;
@@ -219,6 +254,9 @@ struct state {
 	unsigned int matching:1;
 	unsigned int resample:1;
 	unsigned int use_mmap:1;
+	unsigned int direct:1;
+	unsigned int deep_filling:1;
+	unsigned int deep_rewind:1;
 	unsigned int planar:1;
 	unsigned int freewheel:1;
 	unsigned int open_ucm:1;
@@ -267,6 +305,13 @@ struct state {
 	struct spa_source ctl_sources[MAX_POLL];
 	int ctl_n_fds;
 
+	/* PCMs aggregated into this node */
+	struct secondary secondaries[MAX_SECONDARIES];
+	uint32_t n_secondaries;
+	uint32_t extra_channels;
+	void *silence_data;		/* zeroes written to rw secondaries */
+	snd_pcm_uframes_t silence_frames;
+
 	struct spa_list link;
 
 	struct spa_list followers;
@@ -301,8 +346,24 @@ int spa_alsa_close(struct state *state);
 int spa_alsa_write(struct state *state);
 int spa_alsa_read(struct state *state);
 int spa_alsa_skip(struct state *state);
+int spa_alsa_flush(struct state *state);
 
 void spa_alsa_recycle_buffer(struct state *state, uint32_t buffer_id);
+int spa_alsa_setup_direct(struct state *state);
+void spa_alsa_clear_direct(struct state *state);
+
+int spa_alsa_aggregate_parse(struct state *state, const char *val, size_t len);
+int spa_alsa_aggregate_open(struct state *state);
+void spa_alsa_aggregate_close(struct state *state);
+int spa_alsa_aggregate_set_format(struct state *state);
+int spa_alsa_aggregate_prepare(struct state *state, snd_pcm_uframes_t silence);
+int spa_alsa_aggregate_start(struct state *state);
+void spa_alsa_aggregate_drop(struct state *state);
+void spa_alsa_aggregate_sync(struct state *state, snd_pcm_uframes_t delay);
+void spa_alsa_aggregate_write(struct state *state, struct spa_buffer *buf, uint32_t offs,
+		snd_pcm_uframes_t frames);
+void spa_alsa_aggregate_read(struct state *state, struct spa_buffer *buf,
+		snd_pcm_uframes_t frames);
 
 void spa_alsa_emit_node_info(struct state *state, bool full);
 void spa_alsa_emit_port_info(struct state *state, bool full);
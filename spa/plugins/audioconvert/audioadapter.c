@@ -33,11 +33,20 @@ SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.audioadapter");
 
 #define DEFAULT_ALIGN	16
 
-#define MAX_PORTS	(SPA_AUDIO_MAX_CHANNELS+1)
+#define MAX_CHANNELS	512u
+#define MAX_PORTS	(MAX_CHANNELS+1)
 #define MAX_RETRY	64
 
 /** \cond */
 
+/* struct spa_audio_info with room for MAX_CHANNELS positions, used with
+ * the _ext parse and build functions */
+union audio_format {
+	struct spa_audio_info info;
+	uint8_t data[offsetof(struct spa_audio_info, info.raw.position) +
+		MAX_CHANNELS * sizeof(uint32_t)];
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_node node;
@@ -54,8 +63,8 @@ struct impl {
 	struct spa_node *follower;
 	struct spa_hook follower_listener;
 	uint64_t follower_flags;
-	struct spa_audio_info follower_current_format;
-	struct spa_audio_info default_format;
+	union audio_format follower_current_format;
+	union audio_format default_format;
 	int in_set_param;
 
 	struct spa_handle *hnd_convert;
@@ -783,7 +792,7 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 {
 	int res = 0, res2 = 0;
 	struct impl *this = object;
-	struct spa_audio_info info = { 0 };
+	union audio_format info = { 0 };
 
 	spa_log_debug(this->log, "%p: set param %d", this, id);
 
@@ -794,9 +803,9 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 		if (param == NULL)
 			return -EINVAL;
 
-		if (spa_format_audio_parse(param, &info) < 0)
+		if (spa_format_audio_ext_parse(param, &info.info, sizeof(info)) < 0)
 			return -EINVAL;
-		if (info.media_subtype != SPA_MEDIA_SUBTYPE_raw)
+		if (info.info.media_subtype != SPA_MEDIA_SUBTYPE_raw)
 			return -EINVAL;
 
 		this->follower_current_format = info;
@@ -821,14 +830,14 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 			return -EINVAL;
 
 		if (format) {
-			struct spa_audio_info info;
+			union audio_format info;
 
 			spa_zero(info);
-			if ((res = spa_format_audio_parse(format, &info)) < 0)
+			if ((res = spa_format_audio_ext_parse(format, &info.info, sizeof(info))) < 0)
 				return res;
 
-			if (info.media_subtype == SPA_MEDIA_SUBTYPE_raw)
-				info.info.raw.rate = 0;
+			if (info.info.media_subtype == SPA_MEDIA_SUBTYPE_raw)
+				info.info.info.raw.rate = 0;
 			else
 				return -ENOTSUP;
 
@@ -1004,8 +1013,8 @@ static int negotiate_format(struct impl *this)
 		res = -ENOTSUP;
 		goto done;
 	}
-	def = spa_format_audio_build(&b,
-			SPA_PARAM_Format, &this->default_format);
+	def = spa_format_audio_ext_build(&b, SPA_PARAM_Format,
+			&this->default_format.info, sizeof(this->default_format));
 
 	format = merge_objects(this, &b, SPA_PARAM_Format,
 			(struct spa_pod_object*)format,
@@ -1945,7 +1954,7 @@ static int load_converter(struct impl *this, const struct spa_dict *info,
 static int do_auto_port_config(struct impl *this, const char *str)
 {
 	uint32_t state = 0, i;
-	uint8_t buffer[4096];
+	uint8_t buffer[8192];
 	struct spa_pod_builder b;
 #define POSITION_PRESERVE 0
 #define POSITION_AUX 1
@@ -1953,7 +1962,7 @@ static int do_auto_port_config(struct impl *this, const char *str)
 	int l, res, position = POSITION_PRESERVE;
 	struct spa_pod *param;
 	bool have_format = false, monitor = false, control = false;
-	struct spa_audio_info format = { 0, };
+	union audio_format format = { 0, };
 	enum spa_param_port_config_mode mode = SPA_PARAM_PORT_CONFIG_MODE_none;
 	struct spa_json it[1];
 	char key[1024], val[256];
@@ -1985,7 +1994,7 @@ static int do_auto_port_config(struct impl *this, const char *str)
         }
 
 	while (true) {
-		struct spa_audio_info info = { 0, };
+		union audio_format info = { 0, };
 
 		spa_pod_builder_init(&b, buffer, sizeof(buffer));
 		if ((res = node_port_enum_params_sync(this, this->follower,
@@ -1994,14 +2003,14 @@ static int do_auto_port_config(struct impl *this, const char *str)
 					NULL, &param, &b)) != 1)
 			break;
 
-		if ((res = spa_format_audio_parse(param, &info)) < 0)
+		if ((res = spa_format_audio_ext_parse(param, &info.info, sizeof(info))) < 0)
 			continue;
 
 		spa_pod_object_fixate((struct spa_pod_object*)param);
 
-		if (info.media_subtype == SPA_MEDIA_SUBTYPE_raw &&
-		    format.media_subtype == SPA_MEDIA_SUBTYPE_raw &&
-		    format.info.raw.channels >= info.info.raw.channels)
+		if (info.info.media_subtype == SPA_MEDIA_SUBTYPE_raw &&
+		    format.info.media_subtype == SPA_MEDIA_SUBTYPE_raw &&
+		    format.info.info.raw.channels >= info.info.info.raw.channels)
 			continue;
 
 		format = info;
@@ -2010,18 +2019,20 @@ static int do_auto_port_config(struct impl *this, const char *str)
 	if (!have_format)
 		return -ENOENT;
 
-	if (format.media_subtype == SPA_MEDIA_SUBTYPE_raw) {
+	if (format.info.media_subtype == SPA_MEDIA_SUBTYPE_raw) {
+		struct spa_audio_info_raw *raw = &format.info.info.raw;
+
 		if (position == POSITION_AUX) {
-			for (i = 0; i < format.info.raw.channels; i++)
-				format.info.raw.position[i] = SPA_AUDIO_CHANNEL_START_Aux + i;
+			for (i = 0; i < raw->channels; i++)
+				raw->position[i] = SPA_AUDIO_CHANNEL_START_Aux + i;
 		} else if (position == POSITION_UNKNOWN) {
-			for (i = 0; i < format.info.raw.channels; i++)
-				format.info.raw.position[i] = SPA_AUDIO_CHANNEL_UNKNOWN;
+			for (i = 0; i < raw->channels; i++)
+				raw->position[i] = SPA_AUDIO_CHANNEL_UNKNOWN;
 		}
 	}
 
 	spa_pod_builder_init(&b, buffer, sizeof(buffer));
-	param = spa_format_audio_build(&b, SPA_PARAM_Format, &format);
+	param = spa_format_audio_ext_build(&b, SPA_PARAM_Format, &format.info, sizeof(format));
 	param = spa_pod_builder_add_object(&b,
 		SPA_TYPE_OBJECT_ParamPortConfig, SPA_PARAM_PortConfig,
 		SPA_PARAM_PORT_CONFIG_direction, SPA_POD_Id(this->direction),
@@ -39,6 +39,7 @@
 #include "channelmix-ops.h"
 #include "resample.h"
 #include "wavfile.h"
+#include "thread-pool.h"
 
 #undef SPA_LOG_TOPIC_DEFAULT
 #define SPA_LOG_TOPIC_DEFAULT &log_topic
@@ -49,10 +50,12 @@ SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.audioconvert");
 
 #define MAX_ALIGN	FMT_OPS_MAX_ALIGN
 #define MAX_BUFFERS	32
-#define MAX_DATAS	SPA_AUDIO_MAX_CHANNELS
-#define MAX_PORTS	(SPA_AUDIO_MAX_CHANNELS+1)
+#define MAX_CHANNELS	512u
+#define MAX_PORTS	(MAX_CHANNELS+1)
 #define MAX_STAGES	64
 #define MAX_GRAPH	9	/* 8 active + 1 replacement slot */
+#define MAX_GROUPS	8u
+#define MIN_GROUP_CHANNELS	8u
 
 #define DEFAULT_MUTE		false
 #define DEFAULT_VOLUME		VOLUME_NORM
@@ -62,15 +65,15 @@ SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.audioconvert");
 struct volumes {
 	bool mute;
 	uint32_t n_volumes;
-	float volumes[SPA_AUDIO_MAX_CHANNELS];
+	float *volumes;
 };
 
-static void init_volumes(struct volumes *vol)
+static void init_volumes(struct volumes *vol, uint32_t max_channels)
 {
 	uint32_t i;
 	vol->mute = DEFAULT_MUTE;
 	vol->n_volumes = 0;
-	for (i = 0; i < SPA_AUDIO_MAX_CHANNELS; i++)
+	for (i = 0; i < max_channels; i++)
 		vol->volumes[i] = DEFAULT_VOLUME;
 }
 
@@ -88,10 +91,13 @@ struct props {
 	float max_volume;
 	float prev_volume;
 	uint32_t n_channels;
-	uint32_t channel_map[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t *channel_map;
 	struct volumes channel;
 	struct volumes soft;
 	struct volumes monitor;
+	float *mix_volumes;		/* clamped volumes for channelmix */
+	uint32_t max_channels;		/* room in the arrays above */
+	void *channel_data;
 	struct volume_ramp_params vrp;
 	unsigned int have_soft_volume:1;
 	unsigned int mix_disabled:1;
@@ -110,11 +116,11 @@ static void props_reset(struct props *props)
 	props->min_volume = DEFAULT_MIN_VOLUME;
 	props->max_volume = DEFAULT_MAX_VOLUME;
 	props->n_channels = 0;
-	for (i = 0; i < SPA_AUDIO_MAX_CHANNELS; i++)
+	for (i = 0; i < props->max_channels; i++)
 		props->channel_map[i] = SPA_AUDIO_CHANNEL_UNKNOWN;
-	init_volumes(&props->channel);
-	init_volumes(&props->soft);
-	init_volumes(&props->monitor);
+	init_volumes(&props->channel, props->max_channels);
+	init_volumes(&props->soft, props->max_channels);
+	init_volumes(&props->monitor, props->max_channels);
 	props->have_soft_volume = false;
 	props->mix_disabled = false;
 	props->resample_disabled = false;
@@ -125,6 +131,65 @@ static void props_reset(struct props *props)
 	props->filter_graph_disabled = false;
 }
 
+/* the channel map and volumes have room for SPA_AUDIO_MAX_CHANNELS and only
+ * grow when a format with more channels is negotiated. Returns 1 and the old
+ * memory in @old when new memory was allocated. */
+static int props_ensure_channels(struct props *props, uint32_t channels, void **old_data)
+{
+	uint32_t i, old = props->max_channels, max = SPA_MAX(channels, SPA_AUDIO_MAX_CHANNELS);
+	void *data;
+	uint32_t *channel_map;
+	float *volumes;
+
+	if (props->channel_data != NULL && max <= old)
+		return 0;
+
+	if ((data = calloc(max, sizeof(uint32_t) + 4 * sizeof(float))) == NULL)
+		return -errno;
+
+	channel_map = data;
+	volumes = SPA_PTROFF(data, max * sizeof(uint32_t), float);
+	for (i = 0; i < max; i++) {
+		channel_map[i] = i < old ? props->channel_map[i] : SPA_AUDIO_CHANNEL_UNKNOWN;
+		volumes[i] = i < old ? props->channel.volumes[i] : DEFAULT_VOLUME;
+		volumes[max + i] = i < old ? props->soft.volumes[i] : DEFAULT_VOLUME;
+		volumes[2 * max + i] = i < old ? props->monitor.volumes[i] : DEFAULT_VOLUME;
+	}
+	*old_data = props->channel_data;
+	props->channel_data = data;
+	props->channel_map = channel_map;
+	props->channel.volumes = volumes;
+	props->soft.volumes = volumes + max;
+	props->monitor.volumes = volumes + 2 * max;
+	props->mix_volumes = volumes + 3 * max;
+	props->max_channels = max;
+	return 1;
+}
+
+static void props_move_channels(struct props *props, const struct props *other)
+{
+	props->channel_data = other->channel_data;
+	props->channel_map = other->channel_map;
+	props->channel.volumes = other->channel.volumes;
+	props->soft.volumes = other->soft.volumes;
+	props->monitor.volumes = other->monitor.volumes;
+	props->mix_volumes = other->mix_volumes;
+	props->max_channels = other->max_channels;
+}
+
+/* struct spa_audio_info with room for MAX_CHANNELS positions, used with
+ * the _ext parse and build functions */
+struct audio_info {
+	uint32_t media_type;
+	uint32_t media_subtype;
+	union {
+		struct spa_audio_info_raw raw;
+		struct spa_audio_info_dsp dsp;
+		uint8_t data[offsetof(struct spa_audio_info_raw, position) +
+			MAX_CHANNELS * sizeof(uint32_t)];
+	} info;
+};
+
 struct buffer {
 	uint32_t id;
 #define BUFFER_FLAG_QUEUED	(1<<0)
@@ -132,7 +197,7 @@ struct buffer {
 	uint32_t flags;
 	struct spa_list link;
 	struct spa_buffer *buf;
-	void *datas[MAX_DATAS];
+	void **datas;
 };
 
 struct port {
@@ -156,11 +221,12 @@ struct port {
 
 	struct buffer buffers[MAX_BUFFERS];
 	uint32_t n_buffers;
+	void **buffer_datas;
 
 	struct spa_latency_info latency[2];
 	unsigned int have_latency:1;
 
-	struct spa_audio_info format;
+	struct audio_info format;
 	unsigned int valid:1;
 	unsigned int have_format:1;
 	unsigned int is_dsp:1;
@@ -184,7 +250,7 @@ struct dir {
 	enum spa_direction direction;
 	enum spa_param_port_config_mode mode;
 
-	struct spa_audio_info format;
+	struct audio_info format;
 	unsigned int have_format:1;
 	unsigned int have_profile:1;
 	struct spa_pod *tag;
@@ -195,6 +261,8 @@ struct dir {
 	unsigned int need_remap:1;
 	unsigned int is_passthrough:1;
 	unsigned int control:1;
+
+	uint32_t n_groups;
 };
 
 struct stage_context {
@@ -215,6 +283,14 @@ struct stage_context {
 	struct port *ctrlport;
 };
 
+/* the channels of wide streams are split in groups that are processed
+ * in parallel on the thread pool. */
+struct channel_group {
+	struct convert conv[2];
+	struct resample resample;	/* group 0 uses impl->resample */
+	struct channelmix mix;		/* rows of impl->mix */
+};
+
 struct stage {
 	struct impl *impl;
 	bool passthrough;
@@ -232,9 +308,9 @@ struct filter_graph {
 	struct spa_filter_graph *graph;
 	struct spa_hook listener;
 	uint32_t n_inputs;
-	uint32_t inputs_position[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t inputs_position[MAX_CHANNELS];
 	uint32_t n_outputs;
-	uint32_t outputs_position[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t outputs_position[MAX_CHANNELS];
 	bool removing;
 	bool setup;
 };
@@ -245,6 +321,7 @@ struct impl {
 
 	struct spa_log *log;
 	struct spa_cpu *cpu;
+	struct spa_thread_utils *thread_utils;
 	struct spa_loop *data_loop;
 	struct spa_plugin_loader *loader;
 
@@ -290,6 +367,12 @@ struct impl {
 	struct dir dir[2];
 	struct channelmix mix;
 	struct resample resample;
+	uint32_t resample_channels;
+	uint32_t n_resample_groups;
+
+	uint32_t n_threads;
+	struct thread_pool *pool;
+	struct channel_group *groups;
 	struct volume volume;
 	double rate_scale;
 	struct spa_pod_sequence *vol_ramp_sequence;
@@ -307,6 +390,8 @@ struct impl {
 	unsigned int port_ignore_latency:1;
 	unsigned int monitor_passthrough:1;
 	unsigned int resample_passthrough:1;
+	unsigned int detect_silence:1;
+	unsigned int silence_passthrough:1;
 
 	bool recalc;
 
@@ -542,8 +627,8 @@ static int impl_node_enum_params(void *object, int seq,
 
 		if (dir->have_format) {
 			spa_pod_builder_prop(&b, SPA_PARAM_PORT_CONFIG_format, 0);
-			spa_format_audio_raw_build(&b, SPA_PARAM_PORT_CONFIG_format,
-					&dir->format.info.raw);
+			spa_format_audio_raw_ext_build(&b, SPA_PARAM_PORT_CONFIG_format,
+					&dir->format.info.raw, sizeof(dir->format.info));
 		}
 		param = spa_pod_builder_pop(&b, &f[0]);
 		break;
@@ -988,11 +1073,11 @@ static void graph_info(void *object, const struct spa_filter_graph_info *info)
 		else if (spa_streq(k, "n_outputs"))
 			spa_atou32(s, &g->n_outputs, 0);
 		else if (spa_streq(k, "inputs.audio.position"))
-			spa_audio_parse_position(s, strlen(s),
-					g->inputs_position, &g->n_inputs);
+			spa_audio_parse_position_n(s, strlen(s),
+					g->inputs_position, MAX_CHANNELS, &g->n_inputs);
 		else if (spa_streq(k, "outputs.audio.position"))
-			spa_audio_parse_position(s, strlen(s),
-					g->outputs_position, &g->n_outputs);
+			spa_audio_parse_position_n(s, strlen(s),
+					g->outputs_position, MAX_CHANNELS, &g->n_outputs);
 	}
 }
 
@@ -1612,7 +1697,7 @@ static int apply_props(struct impl *this, const struct spa_pod *param)
 		case SPA_PROP_channelVolumes:
 			if (!p->lock_volumes &&
 			    (n = spa_pod_copy_array(&prop->value, SPA_TYPE_Float,
-					p->channel.volumes, SPA_AUDIO_MAX_CHANNELS)) > 0) {
+					p->channel.volumes, p->max_channels)) > 0) {
 				have_channel_volume = true;
 				p->channel.n_volumes = n;
 				changed++;
@@ -1620,7 +1705,7 @@ static int apply_props(struct impl *this, const struct spa_pod *param)
 			break;
 		case SPA_PROP_channelMap:
 			if ((n = spa_pod_copy_array(&prop->value, SPA_TYPE_Id,
-					p->channel_map, SPA_AUDIO_MAX_CHANNELS)) > 0) {
+					p->channel_map, p->max_channels)) > 0) {
 				p->n_channels = n;
 				changed++;
 			}
@@ -1635,7 +1720,7 @@ static int apply_props(struct impl *this, const struct spa_pod *param)
 		case SPA_PROP_softVolumes:
 			if (!p->lock_volumes &&
 			    (n = spa_pod_copy_array(&prop->value, SPA_TYPE_Float,
-					p->soft.volumes, SPA_AUDIO_MAX_CHANNELS)) > 0) {
+					p->soft.volumes, p->max_channels)) > 0) {
 				have_soft_volume = true;
 				p->soft.n_volumes = n;
 				changed++;
@@ -1647,7 +1732,7 @@ static int apply_props(struct impl *this, const struct spa_pod *param)
 			break;
 		case SPA_PROP_monitorVolumes:
 			if ((n = spa_pod_copy_array(&prop->value, SPA_TYPE_Float,
-					p->monitor.volumes, SPA_AUDIO_MAX_CHANNELS)) > 0) {
+					p->monitor.volumes, p->max_channels)) > 0) {
 				p->monitor.n_volumes = n;
 				changed++;
 			}
@@ -1716,11 +1801,42 @@ static int apply_midi(struct impl *this, const struct spa_pod *value)
 	return 1;
 }
 
+static int do_move_channels(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct impl *this = user_data;
+	const struct props *props = *(const struct props **)data;
+	props_move_channels(&this->props, props);
+	return 0;
+}
+
+/* the control port also updates the volumes from the data thread so new
+ * memory is swapped in there while running */
+static int ensure_channels(struct impl *this, uint32_t channels)
+{
+	struct props tmp = this->props, *p = &tmp;
+	void *old_data = NULL;
+	int res;
+
+	if ((res = props_ensure_channels(&tmp, channels, &old_data)) <= 0)
+		return res;
+
+	if (this->started && this->data_loop != NULL)
+		spa_loop_invoke(this->data_loop, do_move_channels, 0,
+				&p, sizeof(p), true, this);
+	else
+		props_move_channels(&this->props, &tmp);
+
+	free(old_data);
+	return 0;
+}
+
 static int reconfigure_mode(struct impl *this, enum spa_param_port_config_mode mode,
-		enum spa_direction direction, bool monitor, bool control, struct spa_audio_info *info)
+		enum spa_direction direction, bool monitor, bool control, struct audio_info *info)
 {
 	struct dir *dir;
 	uint32_t i;
+	int res;
 
 	dir = &this->dir[direction];
 
@@ -1749,6 +1865,9 @@ static int reconfigure_mode(struct impl *this, enum spa_param_port_config_mode m
 	case SPA_PARAM_PORT_CONFIG_MODE_dsp:
 	{
 		if (info) {
+			if ((res = ensure_channels(this,
+							info->info.raw.channels)) < 0)
+				return res;
 			dir->n_ports = info->info.raw.channels;
 			dir->format = *info;
 			dir->format.info.raw.format = SPA_AUDIO_FORMAT_DSP_F32;
@@ -1807,7 +1926,7 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 	switch (id) {
 	case SPA_PARAM_PortConfig:
 	{
-		struct spa_audio_info info = { 0, }, *infop = NULL;
+		struct audio_info info = { 0, }, *infop = NULL;
 		struct spa_pod *format = NULL;
 		enum spa_direction direction;
 		enum spa_param_port_config_mode mode;
@@ -1834,11 +1953,12 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 			    info.media_subtype != SPA_MEDIA_SUBTYPE_raw)
 				return -EINVAL;
 
-			if (spa_format_audio_raw_parse(format, &info.info.raw) < 0)
+			if (spa_format_audio_raw_ext_parse(format, &info.info.raw,
+						sizeof(info.info)) < 0)
 				return -EINVAL;
 
 			if (info.info.raw.channels == 0 ||
-			    info.info.raw.channels > SPA_AUDIO_MAX_CHANNELS)
+			    info.info.raw.channels > MAX_CHANNELS)
 				return -EINVAL;
 
 			infop = &info;
@@ -1890,11 +2010,89 @@ static int int32_cmp(const void *v1, const void *v2)
 	return a1 - a2;
 }
 
+static uint32_t n_channel_groups(struct impl *this, uint32_t channels)
+{
+	if (this->pool == NULL)
+		return 1;
+	return SPA_CLAMP(channels / MIN_GROUP_CHANNELS, 1u,
+			thread_pool_n_threads(this->pool));
+}
+
+static inline void group_channels(uint32_t channels, uint32_t n_groups, uint32_t group,
+		uint32_t *first, uint32_t *n_channels)
+{
+	*first = channels * group / n_groups;
+	*n_channels = channels * (group + 1) / n_groups - *first;
+}
+
+static void free_convert_groups(struct impl *this, enum spa_direction direction)
+{
+	struct dir *dir = &this->dir[direction];
+	uint32_t i;
+
+	for (i = 0; i < dir->n_groups; i++) {
+		struct convert *conv = &this->groups[i].conv[direction];
+		if (conv->free)
+			convert_free(conv);
+	}
+	dir->n_groups = 0;
+}
+
+static int setup_convert_groups(struct impl *this, enum spa_direction direction)
+{
+	struct dir *dir = &this->dir[direction];
+	uint32_t i, first, n_channels, n_groups;
+	int res;
+
+	free_convert_groups(this, direction);
+
+	/* only planar data can be split in channels */
+	if (dir->conv.is_passthrough ||
+	    !SPA_AUDIO_FORMAT_IS_PLANAR(dir->conv.src_fmt) ||
+	    !SPA_AUDIO_FORMAT_IS_PLANAR(dir->conv.dst_fmt))
+		return 0;
+
+	n_groups = n_channel_groups(this, dir->conv.n_channels);
+	if (n_groups < 2)
+		return 0;
+
+	for (i = 0; i < n_groups; i++) {
+		struct convert *conv = &this->groups[i].conv[direction];
+
+		group_channels(dir->conv.n_channels, n_groups, i, &first, &n_channels);
+		*conv = dir->conv;
+		conv->n_channels = n_channels;
+		conv->cpu_flags = this->cpu_flags;
+		conv->free = NULL;
+		conv->data = NULL;
+		if ((res = convert_init(conv)) < 0) {
+			free_convert_groups(this, direction);
+			return res;
+		}
+		dir->n_groups++;
+	}
+	spa_log_info(this->log, "%p: %s convert in %d groups", this,
+			direction == SPA_DIRECTION_INPUT ? "input" : "output", n_groups);
+	return 0;
+}
+
+static void free_resample_groups(struct impl *this)
+{
+	uint32_t i;
+
+	for (i = 1; i < this->n_resample_groups; i++) {
+		struct resample *r = &this->groups[i].resample;
+		if (r->free)
+			resample_free(r);
+	}
+	this->n_resample_groups = 0;
+}
+
 static int setup_in_convert(struct impl *this)
 {
 	uint32_t i, j;
 	struct dir *in = &this->dir[SPA_DIRECTION_INPUT];
-	struct spa_audio_info src_info, dst_info;
+	struct audio_info src_info, dst_info;
 	int res;
 	bool remap = false;
 
@@ -1931,6 +2129,7 @@ static int setup_in_convert(struct impl *this)
 			break;
 		}
 	}
+	free_convert_groups(this, SPA_DIRECTION_INPUT);
 	if (in->conv.free)
 		convert_free(&in->conv);
 
@@ -1942,6 +2141,8 @@ static int setup_in_convert(struct impl *this)
 
 	if ((res = convert_init(&in->conv)) < 0)
 		return res;
+	if ((res = setup_convert_groups(this, SPA_DIRECTION_INPUT)) < 0)
+		return res;
 
 	spa_log_debug(this->log, "%p: got converter features %08x:%08x passthrough:%d remap:%d %s", this,
 			this->cpu_flags, in->conv.cpu_flags, in->conv.is_passthrough,
@@ -1968,7 +2169,7 @@ static void fix_volumes(struct impl *this, struct volumes *vols, uint32_t channe
 		vols->volumes[i] = s;
 }
 
-static int remap_volumes(struct impl *this, const struct spa_audio_info *info)
+static int remap_volumes(struct impl *this, const struct audio_info *info)
 {
 	struct props *p = &this->props;
 	uint32_t i, j, target = info->info.raw.channels;
@@ -2004,11 +2205,11 @@ static int remap_volumes(struct impl *this, const struct spa_audio_info *info)
 	return 1;
 }
 
-static void set_volume(struct impl *this)
+static void set_mix_volume(struct impl *this, struct channelmix *mix)
 {
 	struct volumes *vol;
 	uint32_t i;
-	float volumes[SPA_AUDIO_MAX_CHANNELS];
+	float *volumes = this->props.mix_volumes;
 	struct dir *dir = &this->dir[this->direction];
 
 	spa_log_debug(this->log, "%p set volume %f have_format:%d", this, this->props.volume, dir->have_format);
@@ -2016,7 +2217,7 @@ static void set_volume(struct impl *this)
 	if (dir->have_format)
 		remap_volumes(this, &dir->format);
 
-	if (this->mix.set_volume == NULL)
+	if (mix->set_volume == NULL)
 		return;
 
 	if (this->props.have_soft_volume)
@@ -2028,7 +2229,7 @@ static void set_volume(struct impl *this)
 		volumes[i] = SPA_CLAMPF(vol->volumes[dir->remap[i]],
 				this->props.min_volume, this->props.max_volume);
 
-	channelmix_set_volume(&this->mix,
+	channelmix_set_volume(mix,
 			SPA_CLAMPF(this->props.volume, this->props.min_volume, this->props.max_volume),
 			vol->mute, vol->n_volumes, volumes);
 
@@ -2036,20 +2237,36 @@ static void set_volume(struct impl *this)
 	this->params[IDX_Props].user++;
 }
 
+static void set_volume(struct impl *this)
+{
+	set_mix_volume(this, &this->mix);
+}
+
 static char *format_position(char *str, size_t len, uint32_t channels, uint32_t *position)
 {
 	uint32_t i, idx = 0;
-	for (i = 0; i < channels; i++)
+	str[0] = '\0';
+	for (i = 0; i < channels && idx < len; i++)
 		idx += snprintf(str + idx, len - idx, "%s%s", i == 0 ? "" : " ",
 				spa_debug_type_find_short_name(spa_type_audio_channel,
 					position[i]));
 	return str;
 }
 
+static int do_swap_channelmix(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct impl *this = user_data;
+	struct channelmix *pending = *(struct channelmix **)data;
+	channelmix_swap(&this->mix, pending);
+	return 0;
+}
+
 static int setup_channelmix(struct impl *this, uint32_t channels, uint32_t *position)
 {
 	struct dir *in = &this->dir[SPA_DIRECTION_INPUT];
 	struct dir *out = &this->dir[SPA_DIRECTION_OUTPUT];
+	struct channelmix *mix = &this->mix, *pending = NULL;
 	uint32_t i, src_chan, dst_chan, p;
 	uint64_t src_mask, dst_mask;
 	char str[1024];
@@ -2085,23 +2302,45 @@ static int setup_channelmix(struct impl *this, uint32_t channels, uint32_t *posi
 	    (src_chan != dst_chan || src_mask != dst_mask))
 		return -EPERM;
 
-	this->mix.src_chan = src_chan;
-	this->mix.src_mask = src_mask;
-	this->mix.dst_chan = dst_chan;
-	this->mix.dst_mask = dst_mask;
-	this->mix.cpu_flags = this->cpu_flags;
-	this->mix.log = this->log;
-	this->mix.freq = in->format.info.raw.rate;
+	/* the data thread is mixing, set up the new channels in a copy and
+	 * swap it in */
+	if (this->started && this->data_loop != NULL && this->mix.data != NULL &&
+	    (this->mix.src_chan != src_chan || this->mix.dst_chan != dst_chan)) {
+		if ((pending = malloc(sizeof(*pending))) == NULL)
+			return -errno;
+		*pending = this->mix;
+		pending->data = NULL;
+		mix = pending;
+	}
 
-	if ((res = channelmix_init(&this->mix)) < 0)
-		return res;
+	mix->src_chan = src_chan;
+	mix->src_mask = src_mask;
+	mix->dst_chan = dst_chan;
+	mix->dst_mask = dst_mask;
+	mix->cpu_flags = this->cpu_flags;
+	mix->log = this->log;
+	mix->freq = in->format.info.raw.rate;
 
-	set_volume(this);
+	if ((res = channelmix_init(mix)) < 0)
+		goto done;
+
+	set_mix_volume(this, mix);
 
 	spa_log_debug(this->log, "%p: got channelmix features %08x:%08x flags:%08x %s",
-			this, this->cpu_flags, this->mix.cpu_flags,
-			this->mix.flags, this->mix.func_name);
-	return 0;
+			this, this->cpu_flags, mix->cpu_flags,
+			mix->flags, mix->func_name);
+
+	if (pending != NULL)
+		spa_loop_invoke(this->data_loop, do_swap_channelmix, 0,
+				&pending, sizeof(pending), true, this);
+	res = 0;
+done:
+	if (pending != NULL) {
+		/* the old channel memory after the swap */
+		free(pending->data);
+		free(pending);
+	}
+	return res;
 }
 
 static int setup_resample(struct impl *this)
@@ -2109,7 +2348,7 @@ static int setup_resample(struct impl *this)
 	struct dir *in = &this->dir[SPA_DIRECTION_INPUT];
 	struct dir *out = &this->dir[SPA_DIRECTION_OUTPUT];
 	int res;
-	uint32_t channels;
+	uint32_t i, channels, n_groups, first, n_channels;
 
 	if (this->direction == SPA_DIRECTION_INPUT)
 		channels = in->format.info.raw.channels;
@@ -2130,8 +2369,13 @@ static int setup_resample(struct impl *this)
 
 	if (this->resample.free)
 		resample_free(&this->resample);
+	free_resample_groups(this);
 
-	this->resample.channels = channels;
+	n_groups = this->resample_peaks ? 1 : n_channel_groups(this, channels);
+	group_channels(channels, n_groups, 0, &first, &n_channels);
+
+	this->resample_channels = channels;
+	this->resample.channels = n_channels;
 	this->resample.i_rate = in->format.info.raw.rate;
 	this->resample.o_rate = out->format.info.raw.rate;
 	this->resample.log = this->log;
@@ -2145,13 +2389,32 @@ static int setup_resample(struct impl *this)
 	else
 		res = resample_native_init(&this->resample);
 
-	spa_log_debug(this->log, "%p: got resample features %08x:%08x %s",
+	for (i = 1; res >= 0 && i < n_groups; i++) {
+		struct resample *r = &this->groups[i].resample;
+
+		group_channels(channels, n_groups, i, &first, &n_channels);
+		spa_zero(*r);
+		r->options = this->resample.options;
+		r->channels = n_channels;
+		r->i_rate = this->resample.i_rate;
+		r->o_rate = this->resample.o_rate;
+		r->log = this->log;
+		r->quality = this->resample.quality;
+		r->cpu_flags = this->cpu_flags;
+		if ((res = resample_native_init(r)) < 0)
+			break;
+		this->n_resample_groups = i + 1;
+	}
+	if (res < 0)
+		free_resample_groups(this);
+
+	spa_log_debug(this->log, "%p: got resample features %08x:%08x %s groups:%d",
 			this, this->cpu_flags, this->resample.cpu_flags,
-			this->resample.func_name);
+			this->resample.func_name, this->n_resample_groups);
 	return res;
 }
 
-static int calc_width(struct spa_audio_info *info)
+static int calc_width(struct audio_info *info)
 {
 	switch (info->info.raw.format) {
 	case SPA_AUDIO_FORMAT_U8:
@@ -2182,7 +2445,7 @@ static int setup_out_convert(struct impl *this)
 {
 	uint32_t i, j;
 	struct dir *out = &this->dir[SPA_DIRECTION_OUTPUT];
-	struct spa_audio_info src_info, dst_info;
+	struct audio_info src_info, dst_info;
 	int res;
 	bool remap = false;
 
@@ -2220,6 +2483,7 @@ static int setup_out_convert(struct impl *this)
 			break;
 		}
 	}
+	free_convert_groups(this, SPA_DIRECTION_OUTPUT);
 	if (out->conv.free)
 		convert_free(&out->conv);
 
@@ -2232,6 +2496,8 @@ static int setup_out_convert(struct impl *this)
 
 	if ((res = convert_init(&out->conv)) < 0)
 		return res;
+	if ((res = setup_convert_groups(this, SPA_DIRECTION_OUTPUT)) < 0)
+		return res;
 
 	spa_log_debug(this->log, "%p: got converter features %08x:%08x quant:%d:%d"
 			" passthrough:%d remap:%d %s", this,
@@ -2243,7 +2509,7 @@ static int setup_out_convert(struct impl *this)
 
 static uint32_t resample_update_rate_match(struct impl *this, bool passthrough, uint32_t size, uint32_t queued)
 {
-	uint32_t delay, match_size;
+	uint32_t i, delay, match_size;
 	int32_t delay_frac;
 
 	if (passthrough) {
@@ -2261,6 +2527,8 @@ static uint32_t resample_update_rate_match(struct impl *this, bool passthrough,
 		    SPA_FLAG_IS_SET(this->io_rate_match->flags, SPA_IO_RATE_MATCH_FLAG_ACTIVE))
 			rate *= this->io_rate_match->rate;
 		resample_update_rate(&this->resample, rate);
+		for (i = 1; i < this->n_resample_groups; i++)
+			resample_update_rate(&this->groups[i].resample, rate);
 		fdelay = resample_delay(&this->resample) + resample_phase(&this->resample);
 		if (this->direction == SPA_DIRECTION_INPUT) {
 			match_size = resample_in_len(&this->resample, size);
@@ -2384,6 +2652,7 @@ static int setup_convert(struct impl *this)
 static void reset_node(struct impl *this)
 {
 	struct filter_graph *g;
+	uint32_t i;
 
 	spa_list_for_each(g, &this->active_graphs, link) {
 		if (g->graph)
@@ -2392,6 +2661,8 @@ static void reset_node(struct impl *this)
 	}
 	if (this->resample.reset)
 		resample_reset(&this->resample);
+	for (i = 1; i < this->n_resample_groups; i++)
+		resample_reset(&this->groups[i].resample);
 	this->in_offset = 0;
 	this->out_offset = 0;
 }
@@ -2544,7 +2815,7 @@ static int port_enum_formats(void *object,
 			}
 			spa_pod_builder_add(builder,
 				SPA_FORMAT_AUDIO_channels, SPA_POD_CHOICE_RANGE_Int(
-					DEFAULT_CHANNELS, 1, SPA_AUDIO_MAX_CHANNELS),
+					DEFAULT_CHANNELS, 1, MAX_CHANNELS),
 				0);
 			*param = spa_pod_builder_pop(builder, &f[0]);
 		}
@@ -2608,7 +2879,8 @@ impl_node_port_enum_params(void *object, int seq,
 				SPA_FORMAT_CONTROL_types,  SPA_POD_Int(
 					(1u<<SPA_CONTROL_UMP) | (1u<<SPA_CONTROL_Properties)));
 		else
-			param = spa_format_audio_raw_build(&b, id, &port->format.info.raw);
+			param = spa_format_audio_raw_ext_build(&b, id, &port->format.info.raw,
+					sizeof(port->format.info));
 		break;
 	case SPA_PARAM_Buffers:
 	{
@@ -2744,6 +3016,8 @@ static int clear_buffers(struct impl *this, struct port *port)
 		}
 	}
 	port->n_buffers = 0;
+	free(port->buffer_datas);
+	port->buffer_datas = NULL;
 	spa_list_init(&port->queue);
 	return 0;
 }
@@ -2899,7 +3173,7 @@ static int port_set_format(void *object,
 		port->have_format = false;
 		clear_buffers(this, port);
 	} else {
-		struct spa_audio_info info = { 0 };
+		struct audio_info info = { 0 };
 
 		if ((res = spa_format_parse(format, &info.media_type, &info.media_subtype)) < 0) {
 			spa_log_error(this->log, "can't parse format %s", spa_strerror(res));
@@ -2941,14 +3215,15 @@ static int port_set_format(void *object,
 						info.media_type, info.media_subtype);
 				return -EINVAL;
 			}
-			if ((res = spa_format_audio_raw_parse(format, &info.info.raw)) < 0) {
+			if ((res = spa_format_audio_raw_ext_parse(format, &info.info.raw,
+							sizeof(info.info))) < 0) {
 				spa_log_error(this->log, "can't parse format %s", spa_strerror(res));
 				return res;
 			}
 			if (info.info.raw.format == 0 ||
 			    (!this->props.resample_disabled && info.info.raw.rate == 0) ||
 			    info.info.raw.channels == 0 ||
-			    info.info.raw.channels > SPA_AUDIO_MAX_CHANNELS) {
+			    info.info.raw.channels > MAX_CHANNELS) {
 				spa_log_error(this->log, "invalid format:%d rate:%d channels:%d",
 						info.info.raw.format, info.info.raw.rate,
 						info.info.raw.channels);
@@ -2961,6 +3236,9 @@ static int port_set_format(void *object,
 				port->stride *= info.info.raw.channels;
 				port->blocks = 1;
 			}
+			if ((res = ensure_channels(this,
+							info.info.raw.channels)) < 0)
+				return res;
 			this->dir[direction].format = info;
 			this->dir[direction].have_format = true;
 			this->setup = false;
@@ -3079,6 +3357,12 @@ impl_node_port_use_buffers(void *object,
 
 	maxsize = this->quantum_limit * sizeof(float);
 
+	if (n_buffers > 0) {
+		port->buffer_datas = calloc(n_buffers * port->blocks, sizeof(void*));
+		if (port->buffer_datas == NULL)
+			return -errno;
+	}
+
 	for (i = 0; i < n_buffers; i++) {
 		struct buffer *b;
 		uint32_t n_datas = buffers[i]->n_datas;
@@ -3088,6 +3372,7 @@ impl_node_port_use_buffers(void *object,
 		b->id = i;
 		b->flags = 0;
 		b->buf = buffers[i];
+		b->datas = &port->buffer_datas[i * port->blocks];
 
 		if (n_datas != port->blocks) {
 			spa_log_error(this->log, "%p: invalid blocks %d on buffer %d",
@@ -3296,9 +3581,13 @@ static void run_wav_stage(struct stage *stage, struct stage_context *c)
 
 	if (SPA_UNLIKELY(impl->props.wav_path[0])) {
 		if (impl->wav_file == NULL) {
+			struct audio_info *format = &impl->dir[impl->direction].format;
 			struct wav_file_info info;
 
-			info.info = impl->dir[impl->direction].format;
+			spa_zero(info);
+			info.info.media_type = format->media_type;
+			info.info.media_subtype = format->media_subtype;
+			info.info.info.raw = format->info.raw;
 
 			impl->wav_file = wav_file_open(impl->props.wav_path,
 					"w", &info);
@@ -3379,6 +3668,43 @@ static void add_src_remap_stage(struct impl *impl, struct stage_context *ctx)
 	ctx->src_idx = CTX_DATA_REMAP_SRC;
 }
 
+struct group_job {
+	struct impl *impl;
+	enum spa_direction direction;
+	uint32_t channels;
+	uint32_t n_groups;
+	void **dst;
+	const void **src;
+	uint32_t in_len;
+	uint32_t out_len;
+};
+
+static void run_convert_job(void *data, uint32_t group)
+{
+	struct group_job *j = data;
+	struct convert *conv = &j->impl->groups[group].conv[j->direction];
+	uint32_t first, n_channels;
+
+	group_channels(j->channels, j->n_groups, group, &first, &n_channels);
+	convert_process(conv, &j->dst[first], &j->src[first], j->in_len);
+}
+
+static void run_convert_groups(struct impl *impl, enum spa_direction direction,
+		void **dst, const void **src, uint32_t n_samples)
+{
+	struct dir *dir = &impl->dir[direction];
+	struct group_job j = {
+		.impl = impl,
+		.direction = direction,
+		.channels = dir->conv.n_channels,
+		.n_groups = dir->n_groups,
+		.dst = dst,
+		.src = src,
+		.in_len = n_samples,
+	};
+	thread_pool_run(impl->pool, run_convert_job, &j, j.n_groups);
+}
+
 static void run_src_convert_stage(struct stage *s, struct stage_context *c)
 {
 	struct impl *impl = s->impl;
@@ -3396,7 +3722,11 @@ static void run_src_convert_stage(struct stage *s, struct stage_context *c)
 	} else {
 		dst = c->datas[s->out_idx];
 	}
-	convert_process(&dir->conv, dst, (const void**)c->datas[s->in_idx], c->n_samples);
+	if (dir->n_groups > 1)
+		run_convert_groups(impl, SPA_DIRECTION_INPUT, dst,
+				(const void**)c->datas[s->in_idx], c->n_samples);
+	else
+		convert_process(&dir->conv, dst, (const void**)c->datas[s->in_idx], c->n_samples);
 }
 static void add_src_convert_stage(struct impl *impl, struct stage_context *ctx)
 {
@@ -3412,14 +3742,46 @@ static void add_src_convert_stage(struct impl *impl, struct stage_context *ctx)
 	ctx->src_idx = ctx->dst_idx;
 }
 
+/* all groups are fed the same number of samples and resample at the same
+ * rate so they consume and produce the same amount of samples. */
+static void run_resample_job(void *data, uint32_t group)
+{
+	struct group_job *j = data;
+	struct impl *impl = j->impl;
+	struct resample *r = group == 0 ? &impl->resample : &impl->groups[group].resample;
+	uint32_t first, n_channels, in_len = j->in_len, out_len = j->out_len;
+
+	group_channels(j->channels, j->n_groups, group, &first, &n_channels);
+	resample_process(r, &j->src[first], &in_len, &j->dst[first], &out_len);
+	if (group == 0) {
+		j->in_len = in_len;
+		j->out_len = out_len;
+	}
+}
+
 static void run_resample_stage(struct stage *s, struct stage_context *c)
 {
 	struct impl *impl = s->impl;
 	uint32_t in_len = c->n_samples;
 	uint32_t out_len = c->n_out;
 
-	resample_process(&impl->resample, (const void**)c->datas[s->in_idx], &in_len,
-			c->datas[s->out_idx], &out_len);
+	if (impl->n_resample_groups > 1) {
+		struct group_job j = {
+			.impl = impl,
+			.channels = impl->resample_channels,
+			.n_groups = impl->n_resample_groups,
+			.dst = c->datas[s->out_idx],
+			.src = (const void**)c->datas[s->in_idx],
+			.in_len = in_len,
+			.out_len = out_len,
+		};
+		thread_pool_run(impl->pool, run_resample_job, &j, j.n_groups);
+		in_len = j.in_len;
+		out_len = j.out_len;
+	} else {
+		resample_process(&impl->resample, (const void**)c->datas[s->in_idx], &in_len,
+				c->datas[s->out_idx], &out_len);
+	}
 
 	spa_log_trace_fp(impl->log, "%p: resample %d/%d -> %d/%d", impl,
 				c->n_samples, in_len, c->n_out, out_len);
@@ -3440,12 +3802,46 @@ static void add_resample_stage(struct impl *impl, struct stage_context *ctx)
 	ctx->src_idx = ctx->dst_idx;
 }
 
+static uint32_t n_mix_groups(struct impl *impl)
+{
+	struct channelmix *mix = &impl->mix;
+
+	/* only the generic mixer can work on a subset of the output channels,
+	 * the copy path needs matching input and output channels */
+	if (mix->process != channelmix_f32_n_m_c
+#if defined (HAVE_SSE)
+	    && mix->process != channelmix_f32_n_m_sse
+#endif
+	    )
+		return 1;
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_COPY))
+		return 1;
+	return n_channel_groups(impl, mix->dst_chan);
+}
+
+static void run_channelmix_job(void *data, uint32_t group)
+{
+	struct group_job *j = data;
+	struct channelmix *mix = &j->impl->mix, *view = &j->impl->groups[group].mix;
+	uint32_t first, n_channels;
+
+	group_channels(mix->dst_chan, j->n_groups, group, &first, &n_channels);
+
+	view->src_chan = mix->src_chan;
+	view->dst_chan = n_channels;
+	view->flags = mix->flags;
+	view->matrix = &mix->matrix[first];
+	view->lr4 = &mix->lr4[first];
+	mix->process(view, &j->dst[first], j->src, j->in_len);
+}
+
 static void run_channelmix_stage(struct stage *s, struct stage_context *c)
 {
 	struct impl *impl = s->impl;
 	void **out_datas = c->datas[s->out_idx];
 	const void **in_datas = (const void**)c->datas[s->in_idx];
 	struct port *ctrlport = c->ctrlport;
+	uint32_t n_groups;
 
 	spa_log_trace_fp(impl->log, "%p: channelmix %d", impl, c->n_samples);
 	if (ctrlport != NULL && ctrlport->ctrl != NULL) {
@@ -3460,11 +3856,28 @@ static void run_channelmix_stage(struct stage *s, struct stage_context *c)
 			free(impl->vol_ramp_sequence);
 			impl->vol_ramp_sequence = NULL;
 		}
+	} else if ((n_groups = n_mix_groups(impl)) > 1) {
+		struct group_job j = {
+			.impl = impl,
+			.n_groups = n_groups,
+			.dst = out_datas,
+			.src = in_datas,
+			.in_len = c->n_samples,
+		};
+		thread_pool_run(impl->pool, run_channelmix_job, &j, n_groups);
 	} else {
 		channelmix_process(&impl->mix, out_datas, in_datas, c->n_samples);
 	}
 }
 
+/* the filter graphs ramp the params of the sequence in their next cycle */
+static void queue_filter_control(struct impl *impl, const struct spa_pod_sequence *sequence)
+{
+	uint32_t i;
+	for (i = 0; i < impl->n_graph; i++)
+		spa_filter_graph_set_control(impl->filter_graph[i]->graph, sequence);
+}
+
 static void run_filter_stage(struct stage *s, struct stage_context *c)
 {
 	struct filter_graph *fg = s->data;
@@ -3518,7 +3931,11 @@ static void run_dst_convert_stage(struct stage *s, struct stage_context *c)
 	} else {
 		src = c->datas[s->in_idx];
 	}
-	convert_process(&dir->conv, c->datas[s->out_idx], (const void **)src, c->n_samples);
+	if (dir->n_groups > 1)
+		run_convert_groups(impl, SPA_DIRECTION_OUTPUT, c->datas[s->out_idx],
+				(const void **)src, c->n_samples);
+	else
+		convert_process(&dir->conv, c->datas[s->out_idx], (const void **)src, c->n_samples);
 }
 static void add_dst_convert_stage(struct impl *impl, struct stage_context *ctx)
 {
@@ -3534,6 +3951,60 @@ static void add_dst_convert_stage(struct impl *impl, struct stage_context *ctx)
 	ctx->src_idx = s->out_idx;
 }
 
+/* formats where all bits zero is silence */
+static bool format_is_zero_silence(uint32_t format)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_UNKNOWN:
+	case SPA_AUDIO_FORMAT_U8:
+	case SPA_AUDIO_FORMAT_U8P:
+	case SPA_AUDIO_FORMAT_U16_LE:
+	case SPA_AUDIO_FORMAT_U16_BE:
+	case SPA_AUDIO_FORMAT_U24_32_LE:
+	case SPA_AUDIO_FORMAT_U24_32_BE:
+	case SPA_AUDIO_FORMAT_U32_LE:
+	case SPA_AUDIO_FORMAT_U32_BE:
+	case SPA_AUDIO_FORMAT_U24_LE:
+	case SPA_AUDIO_FORMAT_U24_BE:
+	case SPA_AUDIO_FORMAT_U20_LE:
+	case SPA_AUDIO_FORMAT_U20_BE:
+	case SPA_AUDIO_FORMAT_U18_LE:
+	case SPA_AUDIO_FORMAT_U18_BE:
+	case SPA_AUDIO_FORMAT_ULAW:
+	case SPA_AUDIO_FORMAT_ALAW:
+		return false;
+	default:
+		return true;
+	}
+}
+
+static bool data_is_zero(const void *data, uint32_t size)
+{
+	const uint8_t *d = data;
+	uint64_t w[8];
+
+	/* or 64 bytes at a time so that the loop stops early on the first
+	 * block with signal */
+	for (; size >= sizeof(w); d += sizeof(w), size -= sizeof(w)) {
+		memcpy(w, d, sizeof(w));
+		if ((w[0] | w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7]) != 0)
+			return false;
+	}
+	for (; size > 0; d++, size--)
+		if (*d != 0)
+			return false;
+	return true;
+}
+
+/* the channelmix keeps no state from earlier samples, it has no delay, no
+ * hilbert transform and no lfe or fc filters */
+static bool channelmix_is_stateless(struct channelmix *mix)
+{
+	return SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_IDENTITY) ||
+		(mix->delay == 0 && mix->n_taps <= 1 &&
+		 mix->lfe_cutoff == 0.0f && mix->fc_cutoff == 0.0f);
+}
+
 static void recalc_stages(struct impl *this, struct stage_context *ctx)
 {
 	struct dir *dir;
@@ -3560,6 +4031,15 @@ static void recalc_stages(struct impl *this, struct stage_context *ctx)
 	mix_passthrough = SPA_FLAG_IS_SET(this->mix.flags, CHANNELMIX_FLAG_IDENTITY) &&
 		(ctrlport == NULL || ctrlport->ctrl == NULL) && (this->vol_ramp_sequence == NULL);
 
+	dir = &this->dir[SPA_DIRECTION_OUTPUT];
+	this->silence_passthrough = filter_passthrough && resample_passthrough &&
+		(ctrlport == NULL || ctrlport->ctrl == NULL) &&
+		this->vol_ramp_sequence == NULL &&
+		channelmix_is_stateless(&this->mix) &&
+		!this->props.wav_path[0] && this->wav_file == NULL &&
+		dir->conv.noise_bits == 0 && dir->conv.method == DITHER_METHOD_NONE &&
+		format_is_zero_silence(dir->format.info.raw.format);
+
 	if (in_passthrough && filter_passthrough && mix_passthrough && resample_passthrough)
 		out_passthrough = false;
 
@@ -3640,7 +4120,7 @@ static int impl_node_process(void *object)
 	const void *src_datas[MAX_PORTS];
 	void *dst_datas[MAX_PORTS], *remap_src_datas[MAX_PORTS], *remap_dst_datas[MAX_PORTS], *data;
 	uint32_t i, j, n_src_datas = 0, n_dst_datas = 0, n_mon_datas = 0, remap;
-	uint32_t n_samples, max_in, n_out, max_out, quant_samples;
+	uint32_t n_samples, max_in, n_out, max_out, quant_samples, dst_strides[MAX_PORTS];
 	struct port *port, *ctrlport = NULL;
 	struct buffer *buf, *out_bufs[MAX_PORTS];
 	struct spa_data *bd;
@@ -3744,7 +4224,12 @@ static int impl_node_process(void *object)
 
 				offs = SPA_MIN(bd->chunk->offset, bd->maxsize);
 				size = SPA_MIN(bd->maxsize - offs, bd->chunk->size);
-				if (!SPA_FLAG_IS_SET(bd->chunk->flags, SPA_CHUNK_FLAG_EMPTY))
+				/* inputs that are not marked empty but only contain
+				 * silence also count as empty */
+				if (in_empty && !SPA_FLAG_IS_SET(bd->chunk->flags, SPA_CHUNK_FLAG_EMPTY) &&
+				    (port->is_control || !this->detect_silence ||
+				     !format_is_zero_silence(port->format.info.raw.format) ||
+				     !data_is_zero(SPA_PTROFF(data, offs, void), size)))
 					in_empty = false;
 
 				if (SPA_UNLIKELY(port->is_control)) {
@@ -3759,6 +4244,8 @@ static int impl_node_process(void *object)
 						ctrlport->ctrl = ctrl;
 						ctrlport->ctrl_offset = 0;
 						this->recalc = true;
+						if (ctrl != NULL)
+							queue_filter_control(this, ctrl);
 					}
 				} else  {
 					max_in = SPA_MIN(max_in, size / port->stride);
@@ -3832,6 +4319,7 @@ static int impl_node_process(void *object)
 				} else {
 					remap = n_dst_datas++;
 					dst_datas[remap] = SPA_PTR_ALIGN(this->scratch, MAX_ALIGN, void);
+					dst_strides[remap] = port->stride;
 					spa_log_trace_fp(this->log, "%p: empty output %d->%d", this,
 						i * port->blocks + j, remap);
 					max_out = SPA_MIN(max_out, this->scratch_size / port->stride);
@@ -3879,6 +4367,7 @@ static int impl_node_process(void *object)
 					remap = n_dst_datas++;
 					dst_datas[remap] = SPA_PTROFF(data,
 							this->out_offset * port->stride, void);
+					dst_strides[remap] = port->stride;
 					max_out = SPA_MIN(max_out, bd->maxsize / port->stride);
 
 					spa_log_trace_fp(this->log, "%p: output %d offs:%d %d->%d", this,
@@ -3930,9 +4419,22 @@ static int impl_node_process(void *object)
 		recalc_stages(this, &ctx);
 	}
 
-	for (i = 0; i < this->n_stages; i++) {
-		struct stage *s = &this->stages[i];
-		s->run(s, &ctx);
+	if (in_empty && this->silence_passthrough) {
+		/* none of the stages keeps state or adds noise, silence on the
+		 * input is silence on the output */
+		for (i = 0; i < n_dst_datas; i++)
+			memset(dst_datas[i], 0, n_samples * dst_strides[i]);
+	} else {
+		for (i = 0; i < this->n_stages; i++) {
+			struct stage *s = &this->stages[i];
+			s->run(s, &ctx);
+		}
+		/* the stages can still produce a tail after the input became
+		 * silent, only mark the output empty when it is silent */
+		if (in_empty && format_is_zero_silence(this->dir[SPA_DIRECTION_OUTPUT].format.info.raw.format)) {
+			for (i = 0; in_empty && i < n_dst_datas; i++)
+				in_empty = data_is_zero(dst_datas[i], ctx.n_samples * dst_strides[i]);
+		}
 	}
 	this->in_offset += ctx.in_samples;
 	this->out_offset += ctx.n_samples;
@@ -4058,8 +4560,11 @@ static int impl_get_interface(struct spa_handle *handle, const char *type, void
 static void free_dir(struct dir *dir)
 {
 	uint32_t i;
-	for (i = 0; i < MAX_PORTS; i++)
+	for (i = 0; i < MAX_PORTS; i++) {
+		if (dir->ports[i])
+			free(dir->ports[i]->buffer_datas);
 		free(dir->ports[i]);
+	}
 	if (dir->conv.free)
 		convert_free(&dir->conv);
 	free(dir->tag);
@@ -4073,6 +4578,13 @@ static int impl_clear(struct spa_handle *handle)
 
 	this = (struct impl *) handle;
 
+	free_convert_groups(this, SPA_DIRECTION_INPUT);
+	free_convert_groups(this, SPA_DIRECTION_OUTPUT);
+	free_resample_groups(this);
+	if (this->pool)
+		thread_pool_free(this->pool);
+	free(this->groups);
+
 	free_dir(&this->dir[SPA_DIRECTION_INPUT]);
 	free_dir(&this->dir[SPA_DIRECTION_OUTPUT]);
 
@@ -4082,9 +4594,12 @@ static int impl_clear(struct spa_handle *handle)
 
 	if (this->resample.free)
 		resample_free(&this->resample);
+	if (this->mix.free)
+		channelmix_free(&this->mix);
 	if (this->wav_file != NULL)
 		wav_file_close(this->wav_file);
 	free (this->vol_ramp_sequence);
+	free(this->props.channel_data);
 	return 0;
 }
 
@@ -4106,6 +4621,7 @@ impl_init(const struct spa_handle_factory *factory,
 	uint32_t i;
 	const char *str;
 	bool filter_graph_disabled;
+	int res;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -4125,7 +4641,10 @@ impl_init(const struct spa_handle_factory *factory,
 		this->max_align = SPA_MIN(MAX_ALIGN, spa_cpu_get_max_align(this->cpu));
 	}
 	this->loader = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_PluginLoader);
+	this->thread_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_ThreadUtils);
 
+	if ((res = ensure_channels(this, 0)) < 0)
+		return res;
 	props_reset(&this->props);
 	filter_graph_disabled = this->props.filter_graph_disabled;
 	spa_list_init(&this->active_graphs);
@@ -4146,6 +4665,7 @@ impl_init(const struct spa_handle_factory *factory,
 	this->mix.fc_cutoff = 0.0f;
 	this->mix.rear_delay = 0.0f;
 	this->mix.widen = 0.0f;
+	this->detect_silence = false;
 
 	if (info && (str = spa_dict_lookup(info, "clock.quantum-limit")) != NULL)
 		spa_atou32(str, &this->quantum_limit, 0);
@@ -4165,9 +4685,15 @@ impl_init(const struct spa_handle_factory *factory,
 				this->direction = SPA_DIRECTION_INPUT;
 		}
 		else if (spa_streq(k, SPA_KEY_AUDIO_POSITION)) {
-			if (s != NULL)
-				spa_audio_parse_position(s, strlen(s), this->props.channel_map,
-						&this->props.n_channels);
+			uint32_t position[MAX_CHANNELS], n_position = 0;
+			if (s != NULL &&
+			    spa_audio_parse_position_n(s, strlen(s), position,
+					MAX_CHANNELS, &n_position) > 0 &&
+			    ensure_channels(this, n_position) == 0) {
+				memcpy(this->props.channel_map, position,
+						n_position * sizeof(uint32_t));
+				this->props.n_channels = n_position;
+			}
 		}
 		else if (spa_streq(k, SPA_KEY_PORT_IGNORE_LATENCY))
 			this->port_ignore_latency = spa_atob(s);
@@ -4177,10 +4703,29 @@ impl_init(const struct spa_handle_factory *factory,
 			this->monitor_passthrough = spa_atob(s);
 		else if (spa_streq(k, "audioconvert.filter-graph.disable"))
 			filter_graph_disabled = spa_atob(s);
+		else if (spa_streq(k, "convert.threads"))
+			spa_atou32(s, &this->n_threads, 0);
+		else if (spa_streq(k, "convert.detect-silence"))
+			this->detect_silence = spa_atob(s);
 		else
 			audioconvert_set_param(this, k, s);
 	}
 	this->props.filter_graph_disabled = filter_graph_disabled;
+
+	if (this->n_threads > 1) {
+		this->n_threads = SPA_MIN(this->n_threads, MAX_GROUPS);
+		this->groups = calloc(this->n_threads, sizeof(struct channel_group));
+		if (this->groups == NULL)
+			return -errno;
+		this->pool = thread_pool_new(this->log, this->thread_utils,
+				this->n_threads);
+		if (this->pool == NULL) {
+			spa_log_warn(this->log, "%p: can't create thread pool: %m", this);
+			free(this->groups);
+			this->groups = NULL;
+		}
+	}
+
 	this->props.channel.n_volumes = this->props.n_channels;
 	this->props.soft.n_volumes = this->props.n_channels;
 	this->props.monitor.n_volumes = this->props.n_channels;
@@ -0,0 +1,146 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "test-helper.h"
+#include "channelmix-ops.h"
+
+static uint32_t cpu_flags;
+
+struct stats {
+	uint32_t n_samples;
+	uint32_t src_chan;
+	uint32_t dst_chan;
+	uint64_t perf;
+	const char *name;
+	const char *impl;
+};
+
+#define MAX_SAMPLES	4096
+#define MAX_CHANNELS	512
+
+#define MAX_COUNT 100
+
+static float samp_in[MAX_SAMPLES * MAX_CHANNELS];
+static float samp_out[MAX_SAMPLES * MAX_CHANNELS];
+
+static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
+
+#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * 32
+
+static uint32_t n_results = 0;
+static struct stats results[MAX_RESULTS];
+
+static void run_test1(const char *name, uint32_t src_chan, uint64_t src_mask,
+		uint32_t dst_chan, uint64_t dst_mask, int n_samples)
+{
+	int i;
+	uint32_t j;
+	const void *ip[src_chan];
+	void *op[dst_chan];
+	struct timespec ts;
+	uint64_t count, t1, t2;
+	struct channelmix mix;
+
+	spa_zero(mix);
+	mix.src_chan = src_chan;
+	mix.src_mask = src_mask;
+	mix.dst_chan = dst_chan;
+	mix.dst_mask = dst_mask;
+	mix.cpu_flags = cpu_flags;
+	mix.freq = 48000;
+	mix.fc_cutoff = 120.0f;
+	mix.lfe_cutoff = 12000.0f;
+	spa_assert_se(channelmix_init(&mix) == 0);
+	channelmix_set_volume(&mix, 1.0f, false, 0, NULL);
+
+	for (j = 0; j < src_chan; j++)
+		ip[j] = &samp_in[j * n_samples];
+	for (j = 0; j < dst_chan; j++)
+		op[j] = &samp_out[j * n_samples];
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		channelmix_process(&mix, op, ip, n_samples);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.n_samples = n_samples,
+		.src_chan = src_chan,
+		.dst_chan = dst_chan,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / SPA_MAX(t2 - t1, 1u),
+		.name = name,
+		.impl = mix.func_name,
+	};
+	channelmix_free(&mix);
+}
+
+static void run_test(const char *name, uint32_t src_chan, uint64_t src_mask,
+		uint32_t dst_chan, uint64_t dst_mask)
+{
+	SPA_FOR_EACH_ELEMENT_VAR(sample_sizes, s)
+		run_test1(name, src_chan, src_mask, dst_chan, dst_mask, *s);
+}
+
+static void test_stereo(void)
+{
+	run_test("test_2_2", 2, MASK_STEREO, 2, MASK_STEREO);
+	run_test("test_1_2", 1, MASK_MONO, 2, MASK_STEREO);
+	run_test("test_2_1", 2, MASK_STEREO, 1, MASK_MONO);
+	run_test("test_2_5p1", 2, MASK_STEREO, 6, MASK_5_1);
+	run_test("test_5p1_2", 6, MASK_5_1, 2, MASK_STEREO);
+}
+
+static void test_wide(void)
+{
+	run_test("test_16_12", 16, 0, 12, 0);
+	run_test("test_128_128", 128, 0, 128, 0);
+	run_test("test_512_2", 512, 0, 2, 0);
+}
+
+static int compare_func(const void *_a, const void *_b)
+{
+	const struct stats *a = _a, *b = _b;
+	int diff;
+	if ((diff = strcmp(a->name, b->name)) != 0) return diff;
+	if ((diff = a->n_samples - b->n_samples) != 0) return diff;
+	if ((diff = b->perf - a->perf) != 0) return diff;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i;
+
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	test_stereo();
+	test_wide();
+
+	qsort(results, n_results, sizeof(struct stats), compare_func);
+
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		fprintf(stderr, "%-12."PRIu64" \t%-32.32s %s \t samples %d, channels %d->%d\n",
+				s->perf, s->name, s->impl, s->n_samples, s->src_chan, s->dst_chan);
+	}
+	return 0;
+}
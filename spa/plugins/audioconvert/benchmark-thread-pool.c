@@ -0,0 +1,173 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "test-helper.h"
+#include "resample.h"
+#include "channelmix-ops.h"
+#include "thread-pool.h"
+
+#define MAX_SAMPLES	1024
+#define MAX_CHANNELS	256
+#define MAX_THREADS	8
+
+#define MAX_COUNT 100
+
+static uint32_t cpu_flags;
+
+static float samp_in[MAX_CHANNELS][MAX_SAMPLES];
+static float samp_out[MAX_CHANNELS][MAX_SAMPLES * 2];
+
+static const int quality[] = { 4, 10 };
+
+struct job {
+	uint32_t n_groups;
+	const void *ip[MAX_CHANNELS];
+	void *op[MAX_CHANNELS];
+	struct resample r[MAX_THREADS];
+	struct channelmix *mix;
+	struct channelmix view[MAX_THREADS];
+};
+
+static void group_channels(uint32_t channels, uint32_t n_groups, uint32_t group,
+		uint32_t *first, uint32_t *n_channels)
+{
+	*first = channels * group / n_groups;
+	*n_channels = channels * (group + 1) / n_groups - *first;
+}
+
+static void run_resample(void *data, uint32_t group)
+{
+	struct job *j = data;
+	uint32_t first, n_channels, in_len = MAX_SAMPLES, out_len = MAX_SAMPLES * 2;
+
+	group_channels(MAX_CHANNELS, j->n_groups, group, &first, &n_channels);
+	resample_process(&j->r[group], &j->ip[first], &in_len, &j->op[first], &out_len);
+}
+
+static void run_channelmix(void *data, uint32_t group)
+{
+	struct job *j = data;
+	struct channelmix *view = &j->view[group];
+	uint32_t first, n_channels;
+
+	group_channels(j->mix->dst_chan, j->n_groups, group, &first, &n_channels);
+	view->src_chan = j->mix->src_chan;
+	view->dst_chan = n_channels;
+	view->flags = j->mix->flags;
+	view->matrix = &j->mix->matrix[first];
+	view->lr4 = &j->mix->lr4[first];
+	j->mix->process(view, &j->op[first], j->ip, MAX_SAMPLES);
+}
+
+static uint64_t run_pool(struct thread_pool *pool, thread_pool_func_t func, struct job *j)
+{
+	struct timespec ts;
+	uint64_t count, t1, t2;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	for (count = 0; count < MAX_COUNT; count++)
+		thread_pool_run(pool, func, j, j->n_groups);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	return count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1);
+}
+
+static void test_resample(struct job *j, uint32_t n_threads, int quality)
+{
+	struct thread_pool *pool;
+	uint32_t i, first, n_channels;
+
+	pool = thread_pool_new(NULL, NULL, n_threads);
+	spa_assert_se(pool != NULL);
+
+	j->n_groups = n_threads;
+	for (i = 0; i < n_threads; i++) {
+		group_channels(MAX_CHANNELS, n_threads, i, &first, &n_channels);
+		spa_zero(j->r[i]);
+		j->r[i].cpu_flags = cpu_flags;
+		j->r[i].channels = n_channels;
+		j->r[i].i_rate = 44100;
+		j->r[i].o_rate = 48000;
+		j->r[i].quality = quality;
+		spa_assert_se(resample_native_init(&j->r[i]) == 0);
+	}
+
+	fprintf(stderr, "%-12."PRIu64" \tresample %d channels q%d %s \t threads %d\n",
+			run_pool(pool, run_resample, j), MAX_CHANNELS, quality,
+			j->r[0].func_name, n_threads);
+
+	for (i = 0; i < n_threads; i++)
+		resample_free(&j->r[i]);
+	thread_pool_free(pool);
+}
+
+static void test_channelmix(struct job *j, struct channelmix *mix, uint32_t n_threads)
+{
+	struct thread_pool *pool;
+
+	pool = thread_pool_new(NULL, NULL, n_threads);
+	spa_assert_se(pool != NULL);
+
+	j->n_groups = n_threads;
+	j->mix = mix;
+
+	fprintf(stderr, "%-12."PRIu64" \tchannelmix %d->%d %s \t threads %d\n",
+			run_pool(pool, run_channelmix, j), mix->src_chan, mix->dst_chan,
+			mix->func_name, n_threads);
+
+	thread_pool_free(pool);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct job j;
+	static struct channelmix mix;
+	uint32_t i, k;
+
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	for (i = 0; i < MAX_CHANNELS; i++) {
+		j.ip[i] = samp_in[i];
+		j.op[i] = samp_out[i];
+		for (k = 0; k < MAX_SAMPLES; k++)
+			samp_in[i][k] = (float)(drand48() - 0.5f);
+	}
+
+	SPA_FOR_EACH_ELEMENT_VAR(quality, q) {
+		for (i = 1; i <= MAX_THREADS; i++)
+			test_resample(&j, i, *q);
+	}
+
+	mix.src_chan = MAX_CHANNELS;
+	/* with the same number of channels the mix is a copy */
+	mix.dst_chan = MAX_CHANNELS / 2;
+	mix.cpu_flags = cpu_flags;
+	mix.freq = 48000;
+	spa_assert_se(channelmix_init(&mix) == 0);
+	for (i = 0; i < mix.dst_chan; i++)
+		for (k = 0; k < mix.src_chan; k++)
+			mix.matrix_orig[i][k] = (float)(drand48() - 0.5f);
+	channelmix_set_volume(&mix, 1.0f, false, 0, NULL);
+
+	for (i = 1; i <= MAX_THREADS; i++)
+		test_channelmix(&j, &mix, i);
+
+	channelmix_free(&mix);
+
+	return 0;
+}
@@ -3,6 +3,8 @@
 /* SPDX-License-Identifier: MIT */
 
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
 #include <stdio.h>
 #include <math.h>
 
@@ -179,6 +181,30 @@ static bool match_mix(struct channelmix *mix,
 	return matched;
 }
 
+/* positions can only be represented in the masks for up to CHANNEL_BITS
+ * channels, wider layouts are mixed by channel index */
+static int make_matrix_wide(struct channelmix *mix)
+{
+	uint32_t i, j, src_chan = mix->src_chan, dst_chan = mix->dst_chan;
+	float v;
+
+	spa_log_info(mix->log, "mixing %d -> %d channels by index", src_chan, dst_chan);
+
+	for (i = 0; i < dst_chan; i++) {
+		for (j = 0; j < src_chan; j++) {
+			if (src_chan == 1)
+				v = 1.0f;
+			else if (dst_chan == 1)
+				v = 1.0f / src_chan;
+			else
+				v = i == j ? 1.0f : 0.0f;
+			mix->matrix_orig[i][j] = v;
+		}
+		lr4_set(&mix->lr4[i], BQ_NONE, mix->fc_cutoff / mix->freq);
+	}
+	return 0;
+}
+
 static int make_matrix(struct channelmix *mix)
 {
 	float matrix[SPA_AUDIO_MAX_CHANNELS][SPA_AUDIO_MAX_CHANNELS] = {{ 0.0f }};
@@ -195,6 +221,9 @@ static int make_matrix(struct channelmix *mix)
 	bool filter_fc = false, filter_lfe = false, matched = false, normalize;
 #define _MATRIX(s,d)	matrix[_CH(s)][_CH(d)]
 
+	if (src_chan > CHANNEL_BITS || dst_chan > CHANNEL_BITS)
+		return make_matrix_wide(mix);
+
 	normalize =  SPA_FLAG_IS_SET(mix->options, CHANNELMIX_OPTION_NORMALIZE);
 
 	spa_log_debug(mix->log, "src-mask:%08"PRIx64" dst-mask:%08"PRIx64
@@ -638,10 +667,12 @@ done:
 
 		if ((dst_paired & (1UL << i)) == 0)
 			continue;
+		if (ic >= dst_chan)
+			break;
 		for (jc = 0, j = 0; j < CHANNEL_BITS; j++) {
 			if ((src_paired & (1UL << j)) == 0)
 				continue;
-			if (ic >= dst_chan || jc >= src_chan)
+			if (jc >= src_chan)
 				continue;
 
 			if (ic == 0)
@@ -690,7 +721,6 @@ done:
 static void impl_channelmix_set_volume(struct channelmix *mix, float volume, bool mute,
 		uint32_t n_channel_volumes, float *channel_volumes)
 {
-	float volumes[SPA_AUDIO_MAX_CHANNELS];
 	float vol = mute ? 0.0f : volume, t;
 	uint32_t i, j;
 	uint32_t src_chan = mix->src_chan;
@@ -700,21 +730,23 @@ static void impl_channelmix_set_volume(struct channelmix *mix, float volume, boo
 
 	/** apply global volume to channels */
 	for (i = 0; i < n_channel_volumes; i++) {
-		volumes[i] = channel_volumes[i] * vol;
-		spa_log_debug(mix->log, "%d: %f * %f = %f", i, channel_volumes[i], vol, volumes[i]);
+		spa_log_debug(mix->log, "%d: %f * %f = %f", i, channel_volumes[i], vol,
+				channel_volumes[i] * vol);
 	}
 
 	/** apply volumes per channel */
 	if (n_channel_volumes == src_chan) {
 		for (i = 0; i < dst_chan; i++) {
 			for (j = 0; j < src_chan; j++) {
-				mix->matrix[i][j] = mix->matrix_orig[i][j] * volumes[j];
+				mix->matrix[i][j] = mix->matrix_orig[i][j] *
+					(channel_volumes[j] * vol);
 			}
 		}
 	} else if (n_channel_volumes == dst_chan) {
 		for (i = 0; i < dst_chan; i++) {
 			for (j = 0; j < src_chan; j++) {
-				mix->matrix[i][j] = mix->matrix_orig[i][j] * volumes[i];
+				mix->matrix[i][j] = mix->matrix_orig[i][j] *
+					(channel_volumes[i] * vol);
 			}
 		}
 	} else if (n_channel_volumes == 0) {
@@ -754,15 +786,83 @@ static void impl_channelmix_set_volume(struct channelmix *mix, float volume, boo
 static void impl_channelmix_free(struct channelmix *mix)
 {
 	mix->process = NULL;
+	free(mix->data);
+	mix->data = NULL;
+	mix->matrix_orig = NULL;
+	mix->matrix = NULL;
+	mix->lr4 = NULL;
+	mix->data_src_chan = mix->data_dst_chan = 0;
+}
+
+/* the matrices and filters are sized for the negotiated number of channels.
+ * When the channels don't change, the memory is kept because the data thread
+ * might be using it, only the original matrix is cleared for make_matrix. */
+static int alloc_matrix(struct channelmix *mix)
+{
+	uint32_t i, src_chan = mix->src_chan, dst_chan = mix->dst_chan;
+	size_t rows_size, matrix_size, lr4_size;
+	void *data;
+
+	if (mix->data != NULL &&
+	    mix->data_src_chan == src_chan && mix->data_dst_chan == dst_chan) {
+		for (i = 0; i < dst_chan; i++)
+			memset(mix->matrix_orig[i], 0, src_chan * sizeof(float));
+		return 0;
+	}
+
+	rows_size = SPA_ROUND_UP_N(dst_chan * sizeof(float*), 16);
+	matrix_size = SPA_ROUND_UP_N(dst_chan * src_chan * sizeof(float), 16);
+	lr4_size = dst_chan * sizeof(struct lr4);
+
+	if ((data = calloc(1, 2 * rows_size + 2 * matrix_size + lr4_size)) == NULL)
+		return -errno;
+	free(mix->data);
+	mix->data = data;
+	mix->data_src_chan = src_chan;
+	mix->data_dst_chan = dst_chan;
+
+	mix->matrix_orig = SPA_PTROFF(mix->data, 0, float*);
+	mix->matrix = SPA_PTROFF(mix->data, rows_size, float*);
+	for (i = 0; i < dst_chan; i++) {
+		mix->matrix_orig[i] = SPA_PTROFF(mix->data,
+				2 * rows_size + i * src_chan * sizeof(float), float);
+		mix->matrix[i] = SPA_PTROFF(mix->data,
+				2 * rows_size + matrix_size + i * src_chan * sizeof(float), float);
+	}
+	mix->lr4 = SPA_PTROFF(mix->data, 2 * rows_size + 2 * matrix_size, struct lr4);
+	return 0;
+}
+
+/* exchange the state that depends on the number of channels with other, a
+ * mixer that was set up for other channels. This does not allocate or free
+ * anything so that it can be done on the data thread. */
+void channelmix_swap(struct channelmix *mix, struct channelmix *other)
+{
+	SPA_SWAP(mix->src_chan, other->src_chan);
+	SPA_SWAP(mix->dst_chan, other->dst_chan);
+	SPA_SWAP(mix->src_mask, other->src_mask);
+	SPA_SWAP(mix->dst_mask, other->dst_mask);
+	SPA_SWAP(mix->cpu_flags, other->cpu_flags);
+	SPA_SWAP(mix->func_name, other->func_name);
+	SPA_SWAP(mix->flags, other->flags);
+	SPA_SWAP(mix->matrix_orig, other->matrix_orig);
+	SPA_SWAP(mix->matrix, other->matrix);
+	SPA_SWAP(mix->freq, other->freq);
+	SPA_SWAP(mix->lr4, other->lr4);
+	SPA_SWAP(mix->delay, other->delay);
+	SPA_SWAP(mix->process, other->process);
+	SPA_SWAP(mix->data, other->data);
+	SPA_SWAP(mix->data_src_chan, other->data_src_chan);
+	SPA_SWAP(mix->data_dst_chan, other->data_dst_chan);
 }
 
 int channelmix_init(struct channelmix *mix)
 {
 	const struct channelmix_info *info;
+	int res;
 
-	if (mix->src_chan > SPA_AUDIO_MAX_CHANNELS ||
-	    mix->dst_chan > SPA_AUDIO_MAX_CHANNELS)
-		return -EINVAL;
+	if ((res = alloc_matrix(mix)) < 0)
+		return res;
 
 	info = find_channelmix_info(mix->src_chan, mix->src_mask, mix->dst_chan, mix->dst_mask,
 			mix->cpu_flags);
@@ -50,8 +50,8 @@ struct channelmix {
 #define CHANNELMIX_FLAG_EQUAL		(1<<2)		/**< all values are equal */
 #define CHANNELMIX_FLAG_COPY		(1<<3)		/**< 1 on diagonal, can be nxm */
 	uint32_t flags;
-	float matrix_orig[SPA_AUDIO_MAX_CHANNELS][SPA_AUDIO_MAX_CHANNELS];
-	float matrix[SPA_AUDIO_MAX_CHANNELS][SPA_AUDIO_MAX_CHANNELS];
+	float **matrix_orig;				/* dst_chan rows of src_chan */
+	float **matrix;					/* dst_chan rows of src_chan */
 
 	float freq;					/* sample frequency */
 	float lfe_cutoff;				/* in Hz, 0 is disabled */
@@ -59,7 +59,7 @@ struct channelmix {
 	float rear_delay;				/* in ms, 0 is disabled */
 	float widen;					/* stereo widen. 0 is disabled */
 	uint32_t hilbert_taps;				/* to phase shift, 0 disabled */
-	struct lr4 lr4[SPA_AUDIO_MAX_CHANNELS];
+	struct lr4 *lr4;				/* dst_chan filters */
 
 	float buffer_mem[2 * BUFFER_SIZE*2 + CHANNELMIX_OPS_MAX_ALIGN/4];
 	float *buffer[2];
@@ -76,9 +76,12 @@ struct channelmix {
 	void (*free) (struct channelmix *mix);
 
 	void *data;
+	uint32_t data_src_chan;
+	uint32_t data_dst_chan;
 };
 
 int channelmix_init(struct channelmix *mix);
+void channelmix_swap(struct channelmix *mix, struct channelmix *other);
 
 static const struct channelmix_upmix_info {
 	const char *label;
@@ -25,7 +25,8 @@ SPA_LOG_IMPL(logger);
 
 extern const struct spa_handle_factory test_source_factory;
 
-#define MAX_PORTS (SPA_AUDIO_MAX_CHANNELS+1)
+#define MAX_CHANNELS	512u
+#define MAX_PORTS (MAX_CHANNELS+1)
 
 struct context {
 	struct spa_handle *convert_handle;
@@ -53,7 +54,7 @@ static int setup_context(struct context *ctx)
 	size_t size;
 	int res;
 	struct spa_support support[1];
-	struct spa_dict_item items[6];
+	struct spa_dict_item items[7];
 	const struct spa_handle_factory *factory;
 	void *iface;
 
@@ -75,10 +76,11 @@ static int setup_context(struct context *ctx)
 	items[3] = SPA_DICT_ITEM_INIT("channelmix.lfe-cutoff", "150");
 	items[4] = SPA_DICT_ITEM_INIT("channelmix.fc-cutoff", "12000");
 	items[5] = SPA_DICT_ITEM_INIT("channelmix.rear-delay", "12.0");
+	items[6] = SPA_DICT_ITEM_INIT("convert.detect-silence", "true");
 
 	res = spa_handle_factory_init(factory,
 			ctx->convert_handle,
-			&SPA_DICT_INIT(items, 6),
+			&SPA_DICT_INIT(items, 7),
 			support, 1);
 	spa_assert_se(res >= 0);
 
@@ -569,6 +571,7 @@ struct data {
 	uint32_t planes;
 	const void *data[MAX_PORTS];
 	uint32_t size;
+	uint32_t flags;
 };
 
 static int run_convert(struct context *ctx, struct data *in_data,
@@ -607,6 +610,7 @@ static int run_convert(struct context *ctx, struct data *in_data,
 			b->datas[j].chunk->offset = 0;
 			b->datas[j].chunk->size = in_data->size;
 			b->datas[j].chunk->stride = 0;
+			b->datas[j].chunk->flags = in_data->flags;
 		}
 		buffers[0] = &b->buffer;
 		res = spa_node_port_use_buffers(ctx->convert_node, SPA_DIRECTION_INPUT, i,
@@ -664,6 +668,8 @@ static int run_convert(struct context *ctx, struct data *in_data,
 		for (j = 0; j < out_data->planes; j++, k++) {
 			spa_assert_se(b->datas[j].chunk->offset == 0);
 			spa_assert_se(b->datas[j].chunk->size == out_data->size);
+			spa_assert_se((b->datas[j].chunk->flags & SPA_CHUNK_FLAG_EMPTY) ==
+					(out_data->flags & SPA_CHUNK_FLAG_EMPTY));
 
 			res = memcmp(b->datas[j].data, out_data->data[k], out_data->size);
 			if (res != 0) {
@@ -1116,6 +1122,68 @@ static int test_convert_remap_conv(struct context *ctx)
 	return 0;
 }
 
+static const int16_t data_s16_silence[] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+static const float data_f32p_silence[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+struct data conv_s16_48000_stereo_silence = {
+	.mode = SPA_PARAM_PORT_CONFIG_MODE_convert,
+	.info = SPA_AUDIO_INFO_RAW_INIT(
+		.format = SPA_AUDIO_FORMAT_S16,
+		.rate = 48000,
+		.channels = 2,
+		.position = {
+			SPA_AUDIO_CHANNEL_FL,
+			SPA_AUDIO_CHANNEL_FR,
+		}),
+	.ports = 1,
+	.planes = 1,
+	.data = { data_s16_silence },
+	.size = sizeof(int16_t) * 8
+};
+
+struct data conv_s16_48000_stereo_empty = {
+	.mode = SPA_PARAM_PORT_CONFIG_MODE_convert,
+	.info = SPA_AUDIO_INFO_RAW_INIT(
+		.format = SPA_AUDIO_FORMAT_S16,
+		.rate = 48000,
+		.channels = 2,
+		.position = {
+			SPA_AUDIO_CHANNEL_FL,
+			SPA_AUDIO_CHANNEL_FR,
+		}),
+	.ports = 1,
+	.planes = 1,
+	.data = { data_s16_silence },
+	.size = sizeof(int16_t) * 8,
+	.flags = SPA_CHUNK_FLAG_EMPTY
+};
+
+struct data dsp_stereo_empty = {
+	.mode = SPA_PARAM_PORT_CONFIG_MODE_dsp,
+	.info = SPA_AUDIO_INFO_RAW_INIT(
+		.format = SPA_AUDIO_FORMAT_F32,
+		.rate = 48000,
+		.channels = 2,
+		.position = {
+			SPA_AUDIO_CHANNEL_FL,
+			SPA_AUDIO_CHANNEL_FR,
+		}),
+	.ports = 2,
+	.planes = 1,
+	.data = { data_f32p_silence, data_f32p_silence },
+	.size = sizeof(float) * 4,
+	.flags = SPA_CHUNK_FLAG_EMPTY
+};
+
+/* silence on the input, flagged or not, is flagged on the output */
+static int test_convert_silence(struct context *ctx)
+{
+	run_convert(ctx, &conv_s16_48000_stereo_silence, &dsp_stereo_empty);
+	run_convert(ctx, &conv_s16_48000_stereo_empty, &dsp_stereo_empty);
+	run_convert(ctx, &dsp_stereo_empty, &conv_s16_48000_stereo_empty);
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	struct context ctx;
@@ -1139,6 +1207,7 @@ int main(int argc, char *argv[])
 
 	test_convert_remap_dsp(&ctx);
 	test_convert_remap_conv(&ctx);
+	test_convert_silence(&ctx);
 
 	clean_context(&ctx);
 
@@ -58,6 +58,7 @@ static void test_mix(uint32_t src_chan, uint32_t src_mask, uint32_t dst_chan, ui
 	spa_assert_se(channelmix_init(&mix) == 0);
 	channelmix_set_volume(&mix, 1.0f, false, 0, NULL);
 	dump_matrix(&mix, coeff);
+	channelmix_free(&mix);
 }
 
 static void test_1_N_MONO(void)
@@ -366,6 +367,95 @@ static void test_n_m_impl(void)
 	channelmix_set_volume(&mix, 1.0f, false, 0, NULL);
 
 	run_n_m_impl(&mix, (const void**)src, N_SAMPLES);
+	channelmix_free(&mix);
+}
+
+static void check_wide(uint32_t src_chan, uint32_t dst_chan)
+{
+	struct channelmix mix;
+	uint32_t i, j;
+	float v;
+
+	spa_log_debug(&logger.log, "start %d->%d", src_chan, dst_chan);
+
+	spa_zero(mix);
+	mix.src_chan = src_chan;
+	mix.dst_chan = dst_chan;
+	mix.log = &logger.log;
+	mix.cpu_flags = cpu_flags;
+	mix.fc_cutoff = 120.0f;
+	mix.lfe_cutoff = 12000.0f;
+	spa_assert_se(channelmix_init(&mix) == 0);
+	channelmix_set_volume(&mix, 0.5f, false, 0, NULL);
+
+	for (i = 0; i < dst_chan; i++) {
+		for (j = 0; j < src_chan; j++) {
+			if (src_chan == 1)
+				v = 1.0f;
+			else if (dst_chan == 1)
+				v = 1.0f / src_chan;
+			else
+				v = i == j ? 1.0f : 0.0f;
+			spa_assert_se(CLOSE_ENOUGH(mix.matrix_orig[i][j], v));
+			spa_assert_se(CLOSE_ENOUGH(mix.matrix[i][j], v * 0.5f));
+		}
+	}
+	channelmix_free(&mix);
+}
+
+static void test_wide(void)
+{
+	check_wide(96, 96);
+	check_wide(1, 80);
+	check_wide(80, 1);
+	check_wide(128, 72);
+	check_wide(72, 128);
+}
+
+static void test_reinit(void)
+{
+	struct channelmix mix, other;
+	float **matrix;
+	void *data;
+
+	spa_zero(mix);
+	mix.src_chan = 2;
+	mix.src_mask = _M(FL) | _M(FR);
+	mix.dst_chan = 1;
+	mix.dst_mask = _M(MONO);
+	mix.log = &logger.log;
+	mix.cpu_flags = cpu_flags;
+	spa_assert_se(channelmix_init(&mix) == 0);
+	channelmix_set_volume(&mix, 1.0f, false, 0, NULL);
+
+	/* the same channels keep the memory and the mixing matrix, only
+	 * set_volume updates it */
+	data = mix.data;
+	matrix = mix.matrix;
+	mix.options = CHANNELMIX_OPTION_NORMALIZE;
+	spa_assert_se(channelmix_init(&mix) == 0);
+	spa_assert_se(mix.data == data);
+	spa_assert_se(mix.matrix == matrix);
+	spa_assert_se(CLOSE_ENOUGH(mix.matrix[0][0], 0.5f));
+	spa_assert_se(CLOSE_ENOUGH(mix.matrix[0][1], 0.5f));
+
+	/* other channels are set up in a copy and swapped in */
+	other = mix;
+	other.data = NULL;
+	other.dst_chan = 2;
+	other.dst_mask = _M(FL) | _M(FR);
+	spa_assert_se(channelmix_init(&other) == 0);
+	channelmix_set_volume(&other, 1.0f, false, 0, NULL);
+	channelmix_swap(&mix, &other);
+
+	spa_assert_se(mix.dst_chan == 2);
+	spa_assert_se(SPA_FLAG_IS_SET(mix.flags, CHANNELMIX_FLAG_IDENTITY));
+	spa_assert_se(other.dst_chan == 1);
+	spa_assert_se(other.data == data);
+	spa_assert_se(other.matrix == matrix);
+
+	channelmix_free(&other);
+	channelmix_free(&mix);
 }
 
 int main(int argc, char *argv[])
@@ -392,5 +482,8 @@ int main(int argc, char *argv[])
 
 	test_n_m_impl();
 
+	test_wide();
+	test_reinit();
+
 	return 0;
 }
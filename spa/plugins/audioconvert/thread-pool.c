@@ -0,0 +1,263 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fenv.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/dict.h>
+#include <spa/utils/result.h>
+
+#include "thread-pool.h"
+
+#define MAX_THREADS	64u
+
+struct thread_pool {
+	struct spa_log *log;
+	struct spa_thread_utils *thread_utils;
+
+	uint32_t n_threads;
+	uint32_t n_helpers;
+	struct spa_thread **helpers;
+
+	sem_t start;
+	sem_t done;
+
+	thread_pool_func_t func;
+	void *data;
+	uint32_t n_jobs;
+	uint32_t next_job;
+
+	/* the floating point environment of the data thread, with the
+	 * denormals mode, applied by the helpers when env_serial changes */
+	fenv_t env;
+	uint32_t env_serial;
+
+	unsigned int running:1;
+	unsigned int sched_set:1;
+	unsigned int helpers_rt:1;
+	unsigned int serial:1;
+};
+
+static void run_jobs(struct thread_pool *pool)
+{
+	uint32_t job;
+
+	while ((job = __atomic_fetch_add(&pool->next_job, 1, __ATOMIC_RELAXED)) < pool->n_jobs)
+		pool->func(pool->data, job);
+}
+
+static void *helper_thread(void *data)
+{
+	struct thread_pool *pool = data;
+	uint32_t env_serial = 0;
+
+	while (true) {
+		while (sem_wait(&pool->start) < 0 && errno == EINTR);
+
+		if (!pool->running)
+			break;
+
+		if (SPA_UNLIKELY(env_serial != pool->env_serial)) {
+			fesetenv(&pool->env);
+			env_serial = pool->env_serial;
+		}
+
+		run_jobs(pool);
+
+		sem_post(&pool->done);
+	}
+	return NULL;
+}
+
+/* the helpers do the work of the data thread and should run with the
+ * same floating point environment, so that denormals are flushed on all
+ * threads when the data thread does it. The mode can change between runs,
+ * when a node switches it while it processes, so check it on each run. The
+ * exception flags are sticky, so the environment only changes a few times
+ * until they are all set. */
+static inline void check_env(struct thread_pool *pool)
+{
+	fenv_t env;
+
+	fegetenv(&env);
+	if (SPA_UNLIKELY(memcmp(&env, &pool->env, sizeof(env)) != 0)) {
+		/* the helpers pick this up before they run the jobs */
+		pool->env = env;
+		pool->env_serial++;
+	}
+}
+
+/* The data thread is only set up after the pool was created so we check
+ * its scheduling on the first run. When the data thread is realtime and
+ * the helpers are not, it would wait for lower priority threads, run the
+ * jobs serially then. */
+static void check_sched(struct thread_pool *pool)
+{
+	struct sched_param param;
+	uint32_t i;
+	int policy, res;
+
+	pool->sched_set = true;
+
+	if (pool->n_helpers == 0 || pool->helpers_rt)
+		return;
+	if (pthread_getschedparam(pthread_self(), &policy, &param) != 0 ||
+	    policy == SCHED_OTHER)
+		return;
+
+	/* without thread utils we can only try to copy the scheduling */
+	if (pool->thread_utils == NULL) {
+		for (i = 0; i < pool->n_helpers; i++) {
+			if ((res = pthread_setschedparam((pthread_t)pool->helpers[i],
+							policy, &param)) != 0)
+				break;
+		}
+		if (i == pool->n_helpers)
+			return;
+	}
+	spa_log_warn(pool->log, "%p: helpers are not realtime, running serially", pool);
+	pool->serial = true;
+}
+
+static void create_helpers(struct thread_pool *pool, uint32_t n_helpers)
+{
+	struct spa_thread *thr;
+	uint32_t i;
+	int res;
+
+	pool->helpers_rt = pool->thread_utils != NULL;
+
+	for (i = 0; i < n_helpers; i++) {
+		if (pool->thread_utils) {
+			thr = spa_thread_utils_create(pool->thread_utils,
+					&SPA_DICT_ITEMS(
+						SPA_DICT_ITEM(SPA_KEY_THREAD_NAME, "pw-pool-helper")),
+					helper_thread, pool);
+			res = thr == NULL ? errno : 0;
+		} else {
+			pthread_t pt;
+			res = pthread_create(&pt, NULL, helper_thread, pool);
+			thr = (struct spa_thread*)pt;
+		}
+		if (res != 0) {
+			spa_log_warn(pool->log, "%p: can't create helper thread: %s",
+					pool, strerror(res));
+			break;
+		}
+		pool->helpers[pool->n_helpers++] = thr;
+
+		if (pool->thread_utils &&
+		    (res = spa_thread_utils_acquire_rt(pool->thread_utils, thr, -1)) < 0) {
+			spa_log_info(pool->log, "%p: helper %d can't get realtime priority: %s",
+					pool, i, spa_strerror(res));
+			pool->helpers_rt = false;
+		}
+	}
+}
+
+struct thread_pool *thread_pool_new(struct spa_log *log,
+		struct spa_thread_utils *thread_utils, uint32_t n_threads)
+{
+	struct thread_pool *pool;
+	int res;
+
+	n_threads = SPA_CLAMP(n_threads, 1u, MAX_THREADS);
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return NULL;
+
+	pool->log = log;
+	pool->thread_utils = thread_utils;
+	pool->running = true;
+
+	pool->helpers = calloc(n_threads - 1, sizeof(struct spa_thread *));
+	if (pool->helpers == NULL && n_threads > 1)
+		goto error_free;
+
+	if (sem_init(&pool->start, 0, 0) < 0)
+		goto error_free_helpers;
+	if (sem_init(&pool->done, 0, 0) < 0)
+		goto error_destroy_start;
+
+	create_helpers(pool, n_threads - 1);
+	pool->n_threads = pool->n_helpers + 1;
+
+	spa_log_info(log, "%p: created pool with %d threads", pool, pool->n_threads);
+
+	return pool;
+
+error_destroy_start:
+	res = errno;
+	sem_destroy(&pool->start);
+	errno = res;
+error_free_helpers:
+	res = errno;
+	free(pool->helpers);
+	errno = res;
+error_free:
+	res = errno;
+	free(pool);
+	errno = res;
+	return NULL;
+}
+
+void thread_pool_free(struct thread_pool *pool)
+{
+	uint32_t i;
+
+	pool->running = false;
+	for (i = 0; i < pool->n_helpers; i++)
+		sem_post(&pool->start);
+	for (i = 0; i < pool->n_helpers; i++) {
+		if (pool->thread_utils)
+			spa_thread_utils_join(pool->thread_utils, pool->helpers[i], NULL);
+		else
+			pthread_join((pthread_t)pool->helpers[i], NULL);
+	}
+
+	sem_destroy(&pool->start);
+	sem_destroy(&pool->done);
+	free(pool->helpers);
+	free(pool);
+}
+
+uint32_t thread_pool_n_threads(struct thread_pool *pool)
+{
+	return pool->n_threads;
+}
+
+void thread_pool_run(struct thread_pool *pool, thread_pool_func_t func,
+		void *data, uint32_t n_jobs)
+{
+	uint32_t i, n_helpers;
+
+	if (SPA_UNLIKELY(!pool->sched_set))
+		check_sched(pool);
+
+	n_helpers = pool->serial ? 0 : SPA_MIN(pool->n_helpers, n_jobs - SPA_MIN(n_jobs, 1u));
+	if (n_helpers > 0)
+		check_env(pool);
+
+	pool->func = func;
+	pool->data = data;
+	pool->n_jobs = n_jobs;
+	pool->next_job = 0;
+
+	/* sem_post and sem_wait make the job visible to the helpers and
+	 * the results visible to us */
+	for (i = 0; i < n_helpers; i++)
+		sem_post(&pool->start);
+
+	run_jobs(pool);
+
+	for (i = 0; i < n_helpers; i++)
+		while (sem_wait(&pool->done) < 0 && errno == EINTR);
+}
@@ -0,0 +1,36 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdint.h>
+
+#include <spa/support/log.h>
+#include <spa/support/thread.h>
+
+/** A small pool of helper threads that run the jobs of one processing
+ * cycle together with the calling thread. */
+struct thread_pool;
+
+typedef void (*thread_pool_func_t) (void *data, uint32_t job);
+
+/** Make a pool with \a n_threads threads, including the calling thread.
+ * The helpers are created with \a thread_utils, when not NULL, and get
+ * realtime priority from it. When the calling thread runs with realtime
+ * priority and the helpers could not get it, the jobs run serially. */
+struct thread_pool *thread_pool_new(struct spa_log *log,
+		struct spa_thread_utils *thread_utils, uint32_t n_threads);
+
+void thread_pool_free(struct thread_pool *pool);
+
+/** The number of threads, including the calling thread */
+uint32_t thread_pool_n_threads(struct thread_pool *pool);
+
+/** Run \a n_jobs jobs on the pool and the calling thread. This returns
+ * when all jobs have completed. */
+void thread_pool_run(struct thread_pool *pool, thread_pool_func_t func,
+		void *data, uint32_t n_jobs);
+
+#endif /* THREAD_POOL_H */
@@ -0,0 +1,414 @@
+/* Spa Bluez5 codec benchmark */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <time.h>
+
+#include <spa/support/plugin-loader.h>
+#include <spa/param/audio/format.h>
+#include <spa/utils/dict.h>
+#include <spa/utils/names.h>
+
+#include "test-helper.h"
+#include "codec-loader.h"
+
+#define BENCH_MTU	1008
+#define BENCH_SECONDS	2
+#define PCM_BLOCKS	64
+#define MAX_PACKET	8192
+#define MAX_CONFIGS	16
+
+static const uint32_t rates[] = { 48000, 44100, 96000, 32000, 24000, 16000, 8000 };
+static const uint32_t channels[] = { 2, 1 };
+
+static const struct spa_dict empty_dict = SPA_DICT_INIT(NULL, 0);
+
+struct packets {
+	uint8_t *data;
+	size_t size;
+	size_t used;
+	uint32_t count;
+};
+
+struct result {
+	uint64_t nsec;
+	uint64_t frames;	/* codec frames, one encode() call each */
+	uint64_t samples;
+	uint64_t bytes;
+};
+
+static struct spa_handle *loader_load(void *object, const char *factory_name,
+		const struct spa_dict *info)
+{
+	const char *lib = info ? spa_dict_lookup(info, SPA_KEY_LIBRARY_NAME) : NULL;
+	char path[256];
+
+	if (lib == NULL)
+		return NULL;
+	snprintf(path, sizeof(path), "%s.so", lib);
+	return load_handle(NULL, 0, path, factory_name);
+}
+
+static int loader_unload(void *object, struct spa_handle *handle)
+{
+	spa_handle_clear(handle);
+	free(handle);
+	return 0;
+}
+
+static const struct spa_plugin_loader_methods loader_methods = {
+	SPA_VERSION_PLUGIN_LOADER_METHODS,
+	.load = loader_load,
+	.unload = loader_unload,
+};
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static uint32_t sample_size(uint32_t format)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_S16:
+		return 2;
+	case SPA_AUDIO_FORMAT_S24:
+		return 3;
+	case SPA_AUDIO_FORMAT_S24_32:
+	case SPA_AUDIO_FORMAT_S32:
+	case SPA_AUDIO_FORMAT_F32:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+/* a tone with some noise, so that the encoders have something to do */
+static void fill_pcm(uint8_t *dst, uint32_t n_samples, const struct spa_audio_info_raw *info)
+{
+	uint32_t i, size = sample_size(info->format);
+
+	for (i = 0; i < n_samples; i++) {
+		uint32_t frame = i / info->channels;
+		float v = 0.5f * sinf(2.0f * (float)M_PI * 440.0f * frame / info->rate)
+			+ 0.1f * (float)(drand48() - 0.5);
+		int32_t s = (int32_t)(v * 8388607.0f);
+
+		switch (info->format) {
+		case SPA_AUDIO_FORMAT_S16:
+			*(int16_t *)dst = (int16_t)(s >> 8);
+			break;
+		case SPA_AUDIO_FORMAT_S24:
+			dst[0] = s;
+			dst[1] = s >> 8;
+			dst[2] = s >> 16;
+			break;
+		case SPA_AUDIO_FORMAT_S24_32:
+			*(int32_t *)dst = s;
+			break;
+		case SPA_AUDIO_FORMAT_S32:
+			*(int32_t *)dst = s * 256;
+			break;
+		case SPA_AUDIO_FORMAT_F32:
+			*(float *)dst = v;
+			break;
+		default:
+			break;
+		}
+		dst += size;
+	}
+}
+
+static void packets_add(struct packets *p, const void *data, uint32_t size)
+{
+	if (p->used + sizeof(uint32_t) + size > p->size)
+		return;
+	memcpy(p->data + p->used, &size, sizeof(uint32_t));
+	memcpy(p->data + p->used + sizeof(uint32_t), data, size);
+	p->used += sizeof(uint32_t) + size;
+	p->count++;
+}
+
+static int run_encode(const struct media_codec *codec, void *data,
+		const uint8_t *pcm, uint32_t pcm_size, uint32_t block_size,
+		uint32_t frame_size, uint64_t n_samples, struct result *r, struct packets *out)
+{
+	uint8_t buf[MAX_PACKET];
+	uint32_t offs = 0;
+	uint16_t seq = 0;
+	uint64_t t1, t2;
+	int res;
+
+	spa_zero(*r);
+	out->used = out->count = 0;
+
+	t1 = get_time_ns();
+	while (r->samples < n_samples) {
+		int need_flush = NEED_FLUSH_NO;
+		size_t used, encoded;
+
+		if ((res = codec->start_encode(data, buf, sizeof(buf), seq++, r->samples)) < 0)
+			return res;
+		used = res;
+
+		while (need_flush == NEED_FLUSH_NO) {
+			res = codec->encode(data, pcm + offs, block_size,
+					buf + used, sizeof(buf) - used, &encoded, &need_flush);
+			if (res < 0)
+				return res;
+			if (res == 0 && encoded == 0 && need_flush == NEED_FLUSH_NO)
+				return -EINVAL;
+
+			offs = (offs + res) % pcm_size;
+			r->samples += res / frame_size;
+			r->frames += res > 0;
+			used += encoded;
+		}
+		r->bytes += used;
+		packets_add(out, buf, used);
+
+		while (need_flush == NEED_FLUSH_FRAGMENT) {
+			if ((res = codec->start_encode(data, buf, sizeof(buf), seq++, r->samples)) < 0)
+				return res;
+			used = res;
+			if ((res = codec->encode(data, NULL, 0, buf + used, sizeof(buf) - used,
+							&encoded, &need_flush)) < 0)
+				return res;
+			used += encoded;
+			r->bytes += used;
+			packets_add(out, buf, used);
+		}
+	}
+	t2 = get_time_ns();
+	r->nsec = t2 - t1;
+
+	return 0;
+}
+
+static int run_decode(const struct media_codec *codec, void *data,
+		const struct packets *in, uint32_t frame_size, struct result *r)
+{
+	static uint8_t dst[MAX_PACKET * 64];
+	size_t pos = 0, written;
+	uint64_t t1, t2;
+	int res;
+
+	spa_zero(*r);
+
+	t1 = get_time_ns();
+	while (pos < in->used) {
+		uint32_t size;
+		const uint8_t *src;
+
+		memcpy(&size, in->data + pos, sizeof(uint32_t));
+		src = in->data + pos + sizeof(uint32_t);
+		pos += sizeof(uint32_t) + size;
+
+		if ((res = codec->start_decode(data, src, size, NULL, NULL)) < 0)
+			return res;
+		src += res;
+		size -= res;
+
+		while (size > 0) {
+			if ((res = codec->decode(data, src, size, dst, sizeof(dst), &written)) <= 0)
+				return res < 0 ? res : -EINVAL;
+			src += res;
+			size -= res;
+			r->samples += written / frame_size;
+			r->bytes += written;
+			r->frames++;
+		}
+	}
+	t2 = get_time_ns();
+	r->nsec = t2 - t1;
+
+	return 0;
+}
+
+/* For encoding, bytes/s is the encoded bitrate. For decoding, it is the
+ * PCM throughput. */
+static void print_result(const char *what, const char *name, const struct spa_audio_info_raw *info,
+		const char *variant, const struct result *r, bool encoded_rate)
+{
+	double secs = (double)r->samples / info->rate;
+
+	if (r->frames == 0 || r->nsec == 0)
+		return;
+
+	fprintf(stderr, "%-10.3f us/frame  %10.0f bytes/s  %8.1fx realtime \t%s %s %dHz %dch %s\n",
+			(double)r->nsec / 1000.0 / r->frames,
+			encoded_rate ? r->bytes / secs : r->bytes * (double)SPA_NSEC_PER_SEC / r->nsec,
+			secs * SPA_NSEC_PER_SEC / r->nsec,
+			what, name, info->rate, info->channels, variant);
+}
+
+static void bench_config(const struct media_codec *codec, uint8_t *config, int config_size,
+		const struct spa_audio_info *info, const char *variant, bool min_bitpool)
+{
+	struct spa_audio_info_raw raw = info->info.raw;
+	void *props = NULL, *enc, *dec = NULL;
+	uint32_t frame_size, block_size, pcm_size, i;
+	uint8_t *pcm = NULL;
+	struct packets packets = { 0 };
+	struct result r;
+	int res;
+
+	frame_size = sample_size(raw.format) * raw.channels;
+	if (frame_size == 0) {
+		fprintf(stderr, "skip %s: format %d not supported\n", codec->name, raw.format);
+		return;
+	}
+
+	if (codec->init_props)
+		props = codec->init_props(codec, 0, &empty_dict);
+
+	enc = codec->init(codec, 0, config, config_size, info, props, BENCH_MTU);
+	if (enc == NULL) {
+		fprintf(stderr, "skip %s: init failed\n", codec->name);
+		goto done;
+	}
+
+	if (min_bitpool) {
+		int prev = INT_MIN;
+
+		for (i = 0; i < 256; i++) {
+			res = codec->reduce_bitpool(enc);
+			if (res < 0 || res == prev)
+				break;
+			prev = res;
+		}
+		/* no bitpool control, same as the default run */
+		if (i == 0)
+			goto done;
+	}
+
+	/* one extra block so that a full block can be read at any offset */
+	block_size = codec->get_block_size(enc);
+	pcm_size = block_size * PCM_BLOCKS;
+	pcm = malloc(pcm_size + block_size);
+	packets.size = (size_t)raw.rate * BENCH_SECONDS * frame_size * 2 + MAX_PACKET;
+	packets.data = malloc(packets.size);
+	if (pcm == NULL || packets.data == NULL)
+		goto done;
+
+	fill_pcm(pcm, (pcm_size + block_size) / sample_size(raw.format), &raw);
+
+	res = run_encode(codec, enc, pcm, pcm_size, block_size,
+			frame_size, (uint64_t)raw.rate * BENCH_SECONDS, &r, &packets);
+	if (res < 0) {
+		fprintf(stderr, "skip %s: encode failed: %s\n", codec->name, spa_strerror(res));
+		goto done;
+	}
+	print_result("encode", codec->name, &raw, variant, &r, true);
+
+	if (codec->start_decode == NULL || codec->decode == NULL)
+		goto done;
+
+	dec = codec->init(codec, MEDIA_CODEC_FLAG_SINK, config, config_size, info, props, BENCH_MTU);
+	if (dec == NULL)
+		goto done;
+
+	if ((res = run_decode(codec, dec, &packets, frame_size, &r)) < 0)
+		fprintf(stderr, "skip %s: decode failed: %s\n", codec->name, spa_strerror(res));
+	else
+		print_result("decode", codec->name, &raw, variant, &r, false);
+
+done:
+	if (dec)
+		codec->deinit(dec);
+	if (enc)
+		codec->deinit(enc);
+	if (props && codec->clear_props)
+		codec->clear_props(props);
+	free(packets.data);
+	free(pcm);
+}
+
+static void bench_codec(const struct media_codec *codec)
+{
+	uint8_t caps[A2DP_MAX_CAPS_SIZE];
+	uint8_t configs[MAX_CONFIGS][A2DP_MAX_CAPS_SIZE];
+	int config_sizes[MAX_CONFIGS];
+	uint32_t n_configs = 0, i, j, k;
+	int caps_size, res;
+
+	if (codec->fill_caps == NULL || codec->select_config == NULL ||
+	    codec->validate_config == NULL || codec->init == NULL ||
+	    codec->start_encode == NULL || codec->encode == NULL)
+		return;
+
+	caps_size = codec->fill_caps(codec, 0, &empty_dict, caps);
+	if (caps_size < 0) {
+		fprintf(stderr, "skip %s: no caps\n", codec->name);
+		return;
+	}
+
+	/* every distinct configuration the codec selects for the common
+	 * rates and channel counts */
+	for (i = 0; i < SPA_N_ELEMENTS(rates); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(channels); j++) {
+			struct media_codec_audio_info info = { rates[i], channels[j] };
+			uint8_t config[A2DP_MAX_CAPS_SIZE];
+
+			res = codec->select_config(codec, 0, caps, caps_size, &info,
+					&empty_dict, config);
+			if (res < 0)
+				continue;
+
+			for (k = 0; k < n_configs; k++)
+				if (config_sizes[k] == res && memcmp(configs[k], config, res) == 0)
+					break;
+			if (k < n_configs || n_configs >= MAX_CONFIGS)
+				continue;
+
+			memcpy(configs[n_configs], config, res);
+			config_sizes[n_configs++] = res;
+		}
+	}
+
+	for (k = 0; k < n_configs; k++) {
+		struct spa_audio_info info = { 0 };
+
+		if (codec->validate_config(codec, 0, configs[k], config_sizes[k], &info) < 0)
+			continue;
+
+		bench_config(codec, configs[k], config_sizes[k], &info, "", false);
+		if (codec->reduce_bitpool)
+			bench_config(codec, configs[k], config_sizes[k], &info, "min-bitpool", true);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_plugin_loader loader;
+	const struct media_codec * const *codecs;
+	uint32_t i;
+
+	loader.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_PluginLoader,
+			SPA_VERSION_PLUGIN_LOADER, &loader_methods, NULL);
+
+	codecs = load_media_codecs(&loader, NULL);
+	if (codecs == NULL) {
+		fprintf(stderr, "can't load codecs: %m\n");
+		return 77;
+	}
+
+	for (i = 0; codecs[i]; i++) {
+		if (argc > 1 && !spa_streq(argv[1], codecs[i]->name))
+			continue;
+		bench_codec(codecs[i]);
+	}
+
+	free_media_codecs(codecs);
+
+	return 0;
+}
@@ -0,0 +1,130 @@
+/* Spa Bluez5 ISO batched writes */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef SPA_BLUEZ5_ISO_BATCH_H
+#define SPA_BLUEZ5_ISO_BATCH_H
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <spa/utils/defs.h>
+
+#include "iso-io.h"
+
+#define SPA_BT_ISO_BATCH_MAX	32
+
+/**
+ * SDUs of the streams in an ISO group, submitted together.
+ *
+ * All packets are prepared first and then sent in one pass, so that the
+ * SDUs of the group reach the controller as close together as possible.
+ * Consecutive packets for the same socket go out with a single sendmmsg().
+ */
+struct spa_bt_iso_batch
+{
+	struct {
+		int fd;
+		const void *data;
+		size_t size;
+		int res;	/**< bytes sent, or negative errno */
+	} items[SPA_BT_ISO_BATCH_MAX];
+	uint32_t n_items;
+};
+
+static inline void spa_bt_iso_batch_init(struct spa_bt_iso_batch *b)
+{
+	b->n_items = 0;
+}
+
+/** Returns the index of the added packet, or -ENOSPC */
+static inline int spa_bt_iso_batch_add(struct spa_bt_iso_batch *b, int fd,
+		const void *data, size_t size)
+{
+	uint32_t i = b->n_items;
+
+	if (i >= SPA_BT_ISO_BATCH_MAX)
+		return -ENOSPC;
+
+	b->items[i].fd = fd;
+	b->items[i].data = data;
+	b->items[i].size = size;
+	b->items[i].res = 0;
+	b->n_items++;
+	return i;
+}
+
+/** Send all packets. Returns the number of failed packets. */
+static inline int spa_bt_iso_batch_submit(struct spa_bt_iso_batch *b)
+{
+	struct mmsghdr msgs[SPA_BT_ISO_BATCH_MAX];
+	struct iovec iov[SPA_BT_ISO_BATCH_MAX];
+	uint32_t i, j, n;
+	int res, failed = 0;
+
+	for (i = 0; i < b->n_items; i = j) {
+		for (j = i; j < b->n_items && b->items[j].fd == b->items[i].fd; j++) {
+			n = j - i;
+			iov[n].iov_base = (void *)b->items[j].data;
+			iov[n].iov_len = b->items[j].size;
+			spa_zero(msgs[n]);
+			msgs[n].msg_hdr.msg_iov = &iov[n];
+			msgs[n].msg_hdr.msg_iovlen = 1;
+		}
+		n = j - i;
+
+		if (n == 1) {
+			res = send(b->items[i].fd, b->items[i].data, b->items[i].size,
+					MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (res < 0) {
+				res = -errno;
+				failed++;
+			}
+			b->items[i].res = res;
+			continue;
+		}
+
+		res = sendmmsg(b->items[i].fd, msgs, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (res < 0) {
+			res = -errno;
+			for (; i < j; i++, failed++)
+				b->items[i].res = res;
+			continue;
+		}
+
+		/* the first message that could not be sent ends the batch */
+		for (n = 0; i < j; i++, n++) {
+			if (n < (uint32_t)res) {
+				b->items[i].res = msgs[n].msg_len;
+			} else {
+				b->items[i].res = -EAGAIN;
+				failed++;
+			}
+		}
+	}
+	return failed;
+}
+
+static inline void spa_bt_iso_jitter_reset(struct spa_bt_iso_jitter *j)
+{
+	spa_zero(*j);
+	j->min = INT64_MAX;
+	j->max = INT64_MIN;
+}
+
+/** Update statistics with a new deviation from the nominal value, in ns */
+static inline void spa_bt_iso_jitter_update(struct spa_bt_iso_jitter *j, int64_t value)
+{
+	j->min = SPA_MIN(j->min, value);
+	j->max = SPA_MAX(j->max, value);
+	j->last = value;
+
+	/* running average over ~64 samples */
+	if (j->count++ == 0)
+		j->avg = value;
+	else
+		j->avg += (value - j->avg) / 64;
+}
+
+#endif
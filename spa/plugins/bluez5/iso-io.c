@@ -26,12 +26,16 @@ SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.bluez5.iso");
 #define SPA_LOG_TOPIC_DEFAULT &log_topic
 
 #include "bt-latency.h"
+#include "iso-batch.h"
 
 #define IDLE_TIME	(500 * SPA_NSEC_PER_MSEC)
 #define EMPTY_BUF_SIZE	65536
 
 #define LATENCY_PERIOD		(200 * SPA_NSEC_PER_MSEC)
 #define MAX_PACKET_QUEUE	3
+#define STATS_PERIOD		(10 * SPA_NSEC_PER_SEC)
+
+struct stream;
 
 struct group {
 	struct spa_log *log;
@@ -44,6 +48,12 @@ struct group {
 	uint64_t next;
 	uint64_t duration;
 	bool started;
+
+	struct spa_bt_iso_batch batch;
+	struct stream *batch_streams[SPA_BT_ISO_BATCH_MAX];
+
+	struct spa_bt_iso_io_stats stats;
+	uint64_t stats_time;
 };
 
 struct stream {
@@ -144,11 +154,39 @@ static uint64_t get_time_ns(struct spa_system *system, clockid_t clockid)
 	return SPA_TIMESPEC_TO_NSEC(&now);
 }
 
+static void reset_stats(struct group *group, uint64_t now)
+{
+	spa_bt_iso_jitter_reset(&group->stats.wakeup);
+	spa_bt_iso_jitter_reset(&group->stats.spread);
+	group->stats.failed = 0;
+	group->stats_time = now;
+}
+
+static void update_stats(struct group *group, uint64_t now)
+{
+	struct spa_bt_iso_io_stats *s = &group->stats;
+
+	if (now < group->stats_time + STATS_PERIOD)
+		return;
+
+	spa_log_debug(group->log, "%p: ISO group:%u streams:%u wakeup:%+d/%+d/%+d us "
+			"spread:%d/%d/%d us failed:%"PRIu64,
+			group, group->id, s->n_streams,
+			(int)(s->wakeup.min / 1000), (int)(s->wakeup.avg / 1000),
+			(int)(s->wakeup.max / 1000),
+			(int)(s->spread.min / 1000), (int)(s->spread.avg / 1000),
+			(int)(s->spread.max / 1000), s->failed);
+
+	reset_stats(group, now);
+}
+
 static int set_timers(struct group *group)
 {
 	if (group->duration == 0)
 		return -EINVAL;
 
+	reset_stats(group, get_time_ns(group->data_system, CLOCK_MONOTONIC));
+
 	group->next = SPA_ROUND_UP(get_time_ns(group->data_system, CLOCK_MONOTONIC) + group->duration,
 			group->duration);
 
@@ -164,13 +202,58 @@ static void drop_rx(int fd)
 	} while (res >= 0);
 }
 
+static void log_sent(struct group *group, struct stream *stream, int res)
+{
+	spa_log_trace(group->log, "%p: ISO group:%u sent fd:%d size:%u ts:%u idle:%d res:%d latency:%d..%d us",
+			group, group->id, stream->fd, (unsigned)stream->this.size,
+			(unsigned)stream->this.timestamp, stream->idle, res,
+			stream->tx_latency.valid ? stream->tx_latency.ptp.min/1000 : -1,
+			stream->tx_latency.valid ? stream->tx_latency.ptp.max/1000 : -1);
+}
+
+/* Send the SDUs of all streams in one pass */
+static bool group_submit(struct group *group)
+{
+	struct spa_bt_iso_batch *batch = &group->batch;
+	uint64_t now, start;
+	uint32_t i;
+	int failed;
+
+	if (batch->n_items == 0)
+		return false;
+
+	start = get_time_ns(group->data_system, CLOCK_MONOTONIC);
+	now = get_time_ns(group->data_system, CLOCK_REALTIME);
+
+	failed = spa_bt_iso_batch_submit(batch);
+
+	spa_bt_iso_jitter_update(&group->stats.spread,
+			get_time_ns(group->data_system, CLOCK_MONOTONIC) - start);
+	group->stats.n_streams = batch->n_items;
+	group->stats.failed += failed;
+
+	for (i = 0; i < batch->n_items; i++) {
+		struct stream *stream = group->batch_streams[i];
+		int res = batch->items[i].res;
+
+		if (res >= 0)
+			spa_bt_latency_sent(&stream->tx_latency, now);
+
+		log_sent(group, stream, res);
+		stream->this.size = 0;
+	}
+
+	spa_bt_iso_batch_init(batch);
+	return failed > 0;
+}
+
 static void group_on_timeout(struct spa_source *source)
 {
 	struct group *group = source->data;
 	struct stream *stream;
 	bool resync = false;
 	bool fail = false;
-	uint64_t exp;
+	uint64_t exp, now;
 	int res;
 
 	if ((res = spa_system_timerfd_read(group->data_system, group->timerfd, &exp)) < 0) {
@@ -180,6 +263,10 @@ static void group_on_timeout(struct spa_source *source)
 		return;
 	}
 
+	now = get_time_ns(group->data_system, CLOCK_MONOTONIC);
+	spa_bt_iso_jitter_update(&group->stats.wakeup, (int64_t)(now - group->next));
+	update_stats(group, now);
+
 	spa_list_for_each(stream, &group->streams, link) {
 		if (!stream->sink) {
 			if (!stream->pull) {
@@ -201,9 +288,9 @@ static void group_on_timeout(struct spa_source *source)
 	}
 
 	/* Produce output */
+	spa_bt_iso_batch_init(&group->batch);
+
 	spa_list_for_each(stream, &group->streams, link) {
-		int res = 0;
-		uint64_t now;
 		int32_t min_latency = INT32_MAX, max_latency = INT32_MIN;
 		struct stream *other;
 
@@ -246,25 +333,23 @@ static void group_on_timeout(struct spa_source *source)
 			goto stream_done;
 		}
 
-		now = get_time_ns(group->data_system, CLOCK_REALTIME);
-		res = send(stream->fd, stream->this.buf, stream->this.size, MSG_DONTWAIT | MSG_NOSIGNAL);
-		if (res < 0) {
-			res = -errno;
-			fail = true;
-		} else {
-			spa_bt_latency_sent(&stream->tx_latency, now);
+		/* Sent below together with the other streams */
+		res = spa_bt_iso_batch_add(&group->batch, stream->fd,
+				stream->this.buf, stream->this.size);
+		if (res >= 0) {
+			group->batch_streams[res] = stream;
+			continue;
 		}
+		fail = true;
 
 	stream_done:
-		spa_log_trace(group->log, "%p: ISO group:%u sent fd:%d size:%u ts:%u idle:%d res:%d latency:%d..%d us",
-				group, group->id, stream->fd, (unsigned)stream->this.size,
-				(unsigned)stream->this.timestamp, stream->idle, res,
-				stream->tx_latency.valid ? stream->tx_latency.ptp.min/1000 : -1,
-				stream->tx_latency.valid ? stream->tx_latency.ptp.max/1000 : -1);
-
+		log_sent(group, stream, 0);
 		stream->this.size = 0;
 	}
 
+	if (group_submit(group))
+		fail = true;
+
 	if (fail)
 		spa_log_debug(group->log, "%p: ISO group:%d send failure", group, group->id);
 
@@ -548,6 +633,14 @@ void spa_bt_iso_io_set_cb(struct spa_bt_iso_io *this, spa_bt_iso_io_pull_t pull,
 	}
 }
 
+/** Must be called from data thread */
+void spa_bt_iso_io_get_stats(struct spa_bt_iso_io *this, struct spa_bt_iso_io_stats *stats)
+{
+	struct stream *stream = SPA_CONTAINER_OF(this, struct stream, this);
+
+	*stats = stream->group->stats;
+}
+
 /** Must be called from data thread */
 int spa_bt_iso_io_recv_errqueue(struct spa_bt_iso_io *this)
 {
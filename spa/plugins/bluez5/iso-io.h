@@ -37,6 +37,25 @@ struct spa_bt_iso_io
 	void *user_data;
 };
 
+/** Jitter statistics, in ns */
+struct spa_bt_iso_jitter
+{
+	int64_t min;
+	int64_t max;
+	int64_t avg;
+	int64_t last;
+	uint64_t count;
+};
+
+/** Per-group statistics */
+struct spa_bt_iso_io_stats
+{
+	struct spa_bt_iso_jitter wakeup;	/**< Timer wakeup relative to the interval start */
+	struct spa_bt_iso_jitter spread;	/**< Time to submit the SDUs of all streams */
+	uint32_t n_streams;			/**< Number of sink streams in the last batch */
+	uint64_t failed;			/**< Number of SDUs that failed to send */
+};
+
 typedef void (*spa_bt_iso_io_pull_t)(struct spa_bt_iso_io *io);
 
 struct spa_bt_iso_io *spa_bt_iso_io_create(struct spa_bt_transport *t,
@@ -45,5 +64,6 @@ struct spa_bt_iso_io *spa_bt_iso_io_attach(struct spa_bt_iso_io *io, struct spa_
 void spa_bt_iso_io_destroy(struct spa_bt_iso_io *io);
 void spa_bt_iso_io_set_cb(struct spa_bt_iso_io *io, spa_bt_iso_io_pull_t pull, void *user_data);
 int spa_bt_iso_io_recv_errqueue(struct spa_bt_iso_io *io);
+void spa_bt_iso_io_get_stats(struct spa_bt_iso_io *io, struct spa_bt_iso_io_stats *stats);
 
 #endif
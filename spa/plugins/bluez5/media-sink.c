@@ -5,6 +5,7 @@
 #include <unistd.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <semaphore.h>
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
 
@@ -12,10 +13,12 @@
 #include <spa/support/loop.h>
 #include <spa/support/log.h>
 #include <spa/support/system.h>
+#include <spa/support/thread.h>
 #include <spa/utils/list.h>
 #include <spa/utils/keys.h>
 #include <spa/utils/names.h>
 #include <spa/utils/result.h>
+#include <spa/utils/ringbuffer.h>
 #include <spa/utils/string.h>
 #include <spa/monitor/device.h>
 
@@ -61,6 +64,9 @@ struct props {
 #define RATE_CTL_DIFF_MAX 0.005
 #define LATENCY_PERIOD		(200 * SPA_NSEC_PER_MSEC)
 
+#define DEFAULT_ENCODE_LATENCY	20	/* ms */
+#define PACKET_RING_SIZE	(1u << 16)
+
 /* Wait for two cycles before trying to sync ISO. On start/driver reassign,
  * first cycle may have strange number of samples. */
 #define RESYNC_CYCLES 2
@@ -121,6 +127,38 @@ struct spa_bt_asha {
 	unsigned int set_timer:1;
 };
 
+/* Header of an encoded packet in the packet ring, followed by the
+ * packet data and padded to 8 bytes. */
+struct encoded_packet {
+	uint32_t size;
+	uint32_t frames;
+};
+
+/* PCM is copied into a ringbuffer by the data thread and encoded on a
+ * separate thread into the packet ring. The packets are sent from the
+ * data loop on the flush timer. */
+struct encode_thread {
+	struct spa_thread *thread;
+	sem_t wake;
+
+	struct spa_ringbuffer pcm;
+	uint8_t *pcm_data;
+	uint32_t pcm_size;
+	uint32_t max_bytes;
+
+	struct spa_ringbuffer packets;
+	uint8_t *packet_data;
+	uint8_t send_buffer[BUFFER_SIZE];
+
+	struct spa_source source;
+
+	int abr_unsent;
+	int bitpool;
+	uint32_t dropped;
+
+	unsigned int running:1;
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_node node;
@@ -129,6 +167,7 @@ struct impl {
 	struct spa_loop *data_loop;
 	struct spa_system *data_system;
 	struct spa_loop_utils *loop_utils;
+	struct spa_thread_utils *thread_utils;
 
 	struct spa_hook_list hooks;
 	struct spa_callbacks callbacks;
@@ -159,6 +198,10 @@ struct impl {
 
 	unsigned int is_duplex:1;
 	unsigned int is_internal:1;
+	unsigned int use_encode_thread:1;
+
+	uint32_t encode_latency;
+	struct encode_thread *enc;
 
 	struct spa_source source;
 	int timerfd;
@@ -481,6 +524,9 @@ static void set_latency(struct impl *this, bool emit_latency)
 	 * and doesn't depend on the quantum. Kernel knows the latency due to
 	 * socket/controller queue, but doesn't tell us, so not included but
 	 * hopefully in < 10 ms range.
+	 *
+	 * When encoding on a thread, the packet delay includes the time spent
+	 * in the encoder queue, which is bounded by the encode latency.
 	 */
 
 	delay = __atomic_load_n(&this->packet_delay_ns, __ATOMIC_RELAXED);
@@ -1132,6 +1178,362 @@ static void drop_frames(struct impl *this, uint32_t req)
 	}
 }
 
+static uint64_t encode_queue_delay(struct impl *this)
+{
+	struct encode_thread *enc = this->enc;
+	struct port *port = &this->port;
+	uint32_t index;
+	int32_t filled;
+
+	filled = spa_ringbuffer_get_write_index(&enc->pcm, &index);
+	filled = SPA_CLAMP(filled, 0, (int32_t)enc->pcm_size);
+
+	return (uint64_t)(filled / port->frame_size) * SPA_NSEC_PER_SEC
+		/ port->current_format.info.raw.rate;
+}
+
+static void encode_thread_push(struct impl *this, struct buffer *b)
+{
+	struct encode_thread *enc = this->enc;
+	struct port *port = &this->port;
+	struct spa_data *d = b->buf->datas;
+	uint32_t index, offs, size, l0, l1;
+	int32_t filled;
+
+	/* in data thread */
+
+	size = d[0].chunk->size - d[0].chunk->size % port->frame_size;
+	if (size == 0 || d[0].data == NULL)
+		return;
+
+	filled = spa_ringbuffer_get_write_index(&enc->pcm, &index);
+
+	/* the encoder is too far behind, drop the data instead of letting the
+	 * latency grow */
+	if (filled > 0 && (uint32_t)filled + size > enc->max_bytes) {
+		if (enc->dropped++ == 0)
+			spa_log_warn(this->log, "%p: encoder too slow, dropping %u frames",
+					this, size / port->frame_size);
+		return;
+	}
+	if ((uint32_t)SPA_MAX(filled, 0) + size > enc->pcm_size)
+		return;
+
+	offs = d[0].chunk->offset % d[0].maxsize;
+	l0 = SPA_MIN(size, d[0].maxsize - offs);
+	l1 = size - l0;
+
+	spa_ringbuffer_write_data(&enc->pcm, enc->pcm_data, enc->pcm_size,
+			index & (enc->pcm_size - 1), SPA_PTROFF(d[0].data, offs, void), l0);
+	if (l1 > 0)
+		spa_ringbuffer_write_data(&enc->pcm, enc->pcm_data, enc->pcm_size,
+				(index + l0) & (enc->pcm_size - 1), d[0].data, l1);
+	spa_ringbuffer_write_update(&enc->pcm, index + size);
+
+	sem_post(&enc->wake);
+}
+
+static void encode_thread_queue(struct impl *this)
+{
+	struct encode_thread *enc = this->enc;
+	struct port *port = &this->port;
+	struct encoded_packet pkt;
+	uint32_t index, needed;
+	int32_t filled;
+	uint64_t count = 1;
+	bool fragment;
+
+	/* in encoder thread */
+
+	while (this->need_flush) {
+		pkt.size = this->buffer_used;
+		pkt.frames = this->block_count * this->block_size / port->frame_size;
+		needed = SPA_ROUND_UP_N(sizeof(pkt) + pkt.size, 8);
+
+		filled = spa_ringbuffer_get_write_index(&enc->packets, &index);
+		if (filled < 0 || (uint32_t)filled + needed > PACKET_RING_SIZE) {
+			spa_log_debug(this->log, "%p: packet ring full, drop packet", this);
+		} else {
+			spa_ringbuffer_write_data(&enc->packets, enc->packet_data, PACKET_RING_SIZE,
+					index & (PACKET_RING_SIZE - 1), &pkt, sizeof(pkt));
+			spa_ringbuffer_write_data(&enc->packets, enc->packet_data, PACKET_RING_SIZE,
+					(index + sizeof(pkt)) & (PACKET_RING_SIZE - 1),
+					this->buffer, pkt.size);
+			spa_ringbuffer_write_update(&enc->packets, index + needed);
+			spa_system_eventfd_write(this->data_system, enc->source.fd, count);
+		}
+
+		fragment = this->need_flush == NEED_FLUSH_FRAGMENT;
+		reset_buffer(this);
+		if (!fragment)
+			break;
+		if (encode_fragment(this) < 0) {
+			reset_buffer(this);
+			break;
+		}
+	}
+}
+
+static void encode_thread_process(struct impl *this)
+{
+	struct encode_thread *enc = this->enc;
+	uint32_t index, offs, len;
+	int32_t avail;
+	int res;
+
+	/* in encoder thread, apply the feedback from the writer first */
+	if ((res = __atomic_exchange_n(&enc->abr_unsent, -1, __ATOMIC_ACQUIRE)) >= 0)
+		this->codec->abr_process(this->codec_data, res);
+
+	if ((res = __atomic_exchange_n(&enc->bitpool, 0, __ATOMIC_ACQUIRE)) < 0) {
+		res = this->codec->reduce_bitpool(this->codec_data);
+		spa_log_debug(this->log, "%p: reduce bitpool: %i", this, res);
+	} else if (res > 0) {
+		res = this->codec->increase_bitpool(this->codec_data);
+		spa_log_debug(this->log, "%p: increase bitpool: %i", this, res);
+	}
+
+	while (enc->running) {
+		avail = spa_ringbuffer_get_read_index(&enc->pcm, &index);
+		if (avail <= 0)
+			break;
+
+		offs = index & (enc->pcm_size - 1);
+		len = SPA_MIN((uint32_t)avail, enc->pcm_size - offs);
+
+		res = add_data(this, enc->pcm_data + offs, len);
+		if (res < 0) {
+			spa_log_warn(this->log, "%p: encode error %s, drop %u bytes",
+					this, spa_strerror(res), len);
+			reset_buffer(this);
+			res = len;
+		}
+		spa_ringbuffer_read_update(&enc->pcm, index + res);
+
+		if (this->need_flush)
+			encode_thread_queue(this);
+		else if (res == 0)
+			break;
+	}
+}
+
+static void *encode_thread_loop(void *data)
+{
+	struct impl *this = data;
+	struct encode_thread *enc = this->enc;
+
+	while (true) {
+		while (sem_wait(&enc->wake) < 0 && errno == EINTR);
+
+		if (!enc->running)
+			break;
+
+		encode_thread_process(this);
+	}
+	return NULL;
+}
+
+static void encode_thread_flush(struct impl *this, uint64_t now_time)
+{
+	struct encode_thread *enc = this->enc;
+	struct port *port = &this->port;
+	struct encoded_packet pkt;
+	uint32_t index, needed;
+	int32_t avail;
+	uint64_t packet_time;
+	int written, unused_buffer;
+
+	/* in data thread */
+
+	avail = spa_ringbuffer_get_read_index(&enc->packets, &index);
+	if (avail < (int32_t)sizeof(pkt)) {
+		this->flush_pending = false;
+		return;
+	}
+
+	spa_ringbuffer_read_data(&enc->packets, enc->packet_data, PACKET_RING_SIZE,
+			index & (PACKET_RING_SIZE - 1), &pkt, sizeof(pkt));
+	spa_ringbuffer_read_data(&enc->packets, enc->packet_data, PACKET_RING_SIZE,
+			(index + sizeof(pkt)) & (PACKET_RING_SIZE - 1),
+			enc->send_buffer, SPA_MIN(pkt.size, sizeof(enc->send_buffer)));
+	needed = SPA_ROUND_UP_N(sizeof(pkt) + pkt.size, 8);
+	spa_ringbuffer_read_update(&enc->packets, index + needed);
+
+	unused_buffer = get_transport_unused_size(this);
+	if (unused_buffer >= 0)
+		__atomic_store_n(&enc->abr_unsent, (int)this->fd_buffer_size - unused_buffer,
+				__ATOMIC_RELEASE);
+
+	written = send(this->flush_source.fd, enc->send_buffer, pkt.size,
+			MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (written < 0 && errno == EAGAIN) {
+		/* socket buffer is full, skip the packet */
+		spa_log_trace(this->log, "%p: fail flush", this);
+		if (now_time - this->last_error > SPA_NSEC_PER_SEC / 2) {
+			__atomic_store_n(&enc->bitpool, -1, __ATOMIC_RELEASE);
+			this->last_error = now_time;
+		}
+	} else if (written < 0) {
+		spa_log_debug(this->log, "%p: error flushing: %m", this);
+	} else if (now_time - this->last_error > SPA_NSEC_PER_SEC) {
+		if (unused_buffer == (int)this->fd_buffer_size)
+			__atomic_store_n(&enc->bitpool, 1, __ATOMIC_RELEASE);
+		this->last_error = now_time;
+	}
+
+	packet_time = (uint64_t)pkt.frames * SPA_NSEC_PER_SEC
+		/ port->current_format.info.raw.rate;
+
+	update_packet_delay(this, packet_time + encode_queue_delay(this));
+
+	/*
+	 * Send the packets on our own clock, spaced by their duration. When
+	 * packets pile up because the graph runs faster than we send, catch
+	 * up by sending the next one right away.
+	 */
+	if (this->next_flush_time + packet_time < now_time)
+		this->next_flush_time = now_time;
+	this->next_flush_time += packet_time;
+
+	avail -= needed;
+	if (avail < (int32_t)sizeof(pkt)) {
+		this->flush_pending = false;
+		return;
+	}
+	if ((uint32_t)avail > 2 * needed)
+		this->next_flush_time = now_time;
+
+	enable_flush_timer(this, true);
+}
+
+static void encode_thread_on_packet(struct spa_source *source)
+{
+	struct impl *this = source->data;
+	struct timespec ts;
+	uint64_t count, now;
+
+	if (spa_system_eventfd_read(this->data_system, source->fd, &count) < 0)
+		return;
+	if (this->flush_pending)
+		return;
+
+	spa_system_clock_gettime(this->data_system, CLOCK_MONOTONIC, &ts);
+	now = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	this->next_flush_time = SPA_MAX(this->next_flush_time, now);
+	enable_flush_timer(this, true);
+}
+
+/* the encoder does the work of the data thread and needs realtime priority,
+ * the data thread would otherwise wait for it. We encode on the data thread
+ * when the encoder thread can't get it. */
+static int encode_thread_start(struct impl *this)
+{
+	struct encode_thread *enc;
+	struct port *port = &this->port;
+	uint32_t rate = port->current_format.info.raw.rate;
+	int res;
+
+	if (this->thread_utils == NULL)
+		return -ENOTSUP;
+
+	enc = calloc(1, sizeof(*enc));
+	if (enc == NULL)
+		return -errno;
+
+	enc->max_bytes = (uint32_t)((uint64_t)this->encode_latency * rate / SPA_MSEC_PER_SEC)
+		* port->frame_size;
+	enc->max_bytes = SPA_MAX(enc->max_bytes, 2 * this->block_size);
+
+	/* room for the bound plus one quantum */
+	enc->pcm_size = 1;
+	while (enc->pcm_size < enc->max_bytes + this->quantum_limit * port->frame_size)
+		enc->pcm_size <<= 1;
+
+	enc->pcm_data = calloc(1, enc->pcm_size);
+	enc->packet_data = calloc(1, PACKET_RING_SIZE);
+	if (enc->pcm_data == NULL || enc->packet_data == NULL) {
+		res = -errno;
+		goto error;
+	}
+	spa_ringbuffer_init(&enc->pcm);
+	spa_ringbuffer_init(&enc->packets);
+	enc->abr_unsent = -1;
+
+	enc->source.data = this;
+	enc->source.fd = spa_system_eventfd_create(this->data_system,
+			SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
+	enc->source.func = encode_thread_on_packet;
+	enc->source.mask = SPA_IO_IN;
+	enc->source.rmask = 0;
+	if (enc->source.fd < 0) {
+		res = enc->source.fd;
+		goto error;
+	}
+
+	if (sem_init(&enc->wake, 0, 0) < 0) {
+		res = -errno;
+		goto error_close;
+	}
+	enc->running = true;
+	this->enc = enc;
+
+	enc->thread = spa_thread_utils_create(this->thread_utils,
+			&SPA_DICT_ITEMS(
+				SPA_DICT_ITEM(SPA_KEY_THREAD_NAME, "bluez5-encode")),
+			encode_thread_loop, this);
+	if (enc->thread == NULL) {
+		res = -errno;
+		goto error_sem;
+	}
+	if ((res = spa_thread_utils_acquire_rt(this->thread_utils, enc->thread, -1)) < 0) {
+		enc->running = false;
+		sem_post(&enc->wake);
+		spa_thread_utils_join(this->thread_utils, enc->thread, NULL);
+		goto error_sem;
+	}
+
+	spa_loop_add_source(this->data_loop, &enc->source);
+
+	spa_log_info(this->log, "%p: encoding on thread, max latency:%.2f ms", this,
+			(double)enc->max_bytes / port->frame_size * SPA_MSEC_PER_SEC / rate);
+	return 0;
+
+error_sem:
+	this->enc = NULL;
+	sem_destroy(&enc->wake);
+error_close:
+	spa_system_close(this->data_system, enc->source.fd);
+error:
+	free(enc->pcm_data);
+	free(enc->packet_data);
+	free(enc);
+	return res;
+}
+
+static void encode_thread_stop(struct impl *this)
+{
+	struct encode_thread *enc = this->enc;
+
+	/* the source was removed from the data loop already */
+	if (enc == NULL)
+		return;
+
+	enc->running = false;
+	sem_post(&enc->wake);
+	spa_thread_utils_join(this->thread_utils, enc->thread, NULL);
+
+	if (enc->dropped > 0)
+		spa_log_warn(this->log, "%p: encoder dropped %u buffers", this, enc->dropped);
+
+	sem_destroy(&enc->wake);
+	spa_system_close(this->data_system, enc->source.fd);
+	free(enc->pcm_data);
+	free(enc->packet_data);
+	free(enc);
+	this->enc = NULL;
+}
+
 static void media_iso_pull(struct spa_bt_iso_io *iso_io)
 {
 	struct impl *this = iso_io->user_data;
@@ -1250,6 +1652,14 @@ static void media_on_flush_timeout(struct spa_source *source)
 		return;
 	}
 
+	if (this->enc) {
+		struct timespec ts;
+
+		spa_system_clock_gettime(this->data_system, CLOCK_MONOTONIC, &ts);
+		encode_thread_flush(this, SPA_TIMESPEC_TO_NSEC(&ts));
+		return;
+	}
+
 	while (exp-- > 0) {
 		this->flush_pending = false;
 		flush_data(this, this->current_time);
@@ -1409,7 +1819,7 @@ static int do_start_iso_io(struct spa_loop *loop, bool async, uint32_t seq,
 
 static int transport_start(struct impl *this)
 {
-	int val, size;
+	int val, size, res;
 	struct port *port;
 	socklen_t len;
 	uint8_t *conf;
@@ -1548,6 +1958,14 @@ static int transport_start(struct impl *this)
 	this->flush_pending = false;
 	this->iso_pending = false;
 
+	if (this->use_encode_thread) {
+		if (this->transport->iso_io || is_asha)
+			spa_log_info(this->log, "%p: encode thread only supported for A2DP", this);
+		else if ((res = encode_thread_start(this)) < 0)
+			spa_log_warn(this->log, "%p: can't start encode thread, encoding in "
+					"data thread: %s", this, spa_strerror(res));
+	}
+
 	this->transport_started = true;
 
 	if (this->transport->iso_io)
@@ -1637,6 +2055,8 @@ static int do_remove_transport_source(struct spa_loop *loop,
 			spa_loop_remove_source(this->data_loop, &this->asha->flush_source);
 		spa_list_remove(&this->asha_link);
 	}
+	if (this->enc && this->enc->source.loop)
+		spa_loop_remove_source(this->data_loop, &this->enc->source);
 	enable_flush_timer(this, false);
 
 	if (this->transport->iso_io)
@@ -1657,6 +2077,8 @@ static void transport_stop(struct impl *this)
 
 	spa_loop_invoke(this->data_loop, do_remove_transport_source, 0, NULL, 0, true, this);
 
+	encode_thread_stop(this);
+
 	if (this->codec_data && this->own_codec_data)
 		this->codec->deinit(this->codec_data);
 	this->codec_data = NULL;
@@ -2190,10 +2612,17 @@ static int impl_node_process(void *object)
 		frames = d ? d[0].chunk->size / port->frame_size : 0;
 		spa_log_trace(this->log, "%p: queue buffer %u frames:%u", this, io->buffer_id, frames);
 
-		spa_list_append(&port->ready, &b->link);
-		SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_OUT);
-
-		io->buffer_id = SPA_ID_INVALID;
+		if (this->enc) {
+			/* copied to the encoder, the buffer can be reused right away */
+			if (d)
+				encode_thread_push(this, b);
+			spa_node_call_reuse_buffer(&this->callbacks, 0, b->id);
+			io->buffer_id = SPA_ID_INVALID;
+		} else {
+			spa_list_append(&port->ready, &b->link);
+			SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_OUT);
+			io->buffer_id = SPA_ID_INVALID;
+		}
 		io->status = SPA_STATUS_OK;
 	}
 
@@ -2237,6 +2666,13 @@ static int impl_node_process(void *object)
 	}
 
 	spa_log_trace(this->log, "%p: on process time:%"PRIu64, this, this->process_time);
+	if (this->enc) {
+		if (this->transport == NULL || !this->flush_source.loop) {
+			io->status = -EIO;
+			return SPA_STATUS_STOPPED;
+		}
+		return SPA_STATUS_HAVE_DATA;
+	}
 	if ((res = flush_data(this, this->current_time)) < 0) {
 		io->status = res;
 		return SPA_STATUS_STOPPED;
@@ -2404,6 +2840,7 @@ impl_init(const struct spa_handle_factory *factory,
 	this->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
 	this->data_system = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataSystem);
 	this->loop_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_LoopUtils);
+	this->thread_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_ThreadUtils);
 
 	spa_log_topic_init(this->log, &log_topic);
 
@@ -2469,6 +2906,12 @@ impl_init(const struct spa_handle_factory *factory,
 	if (info && (str = spa_dict_lookup(info, "api.bluez5.internal")) != NULL)
 		this->is_internal = spa_atob(str);
 
+	this->encode_latency = DEFAULT_ENCODE_LATENCY;
+	if (info && (str = spa_dict_lookup(info, "bluez5.encode-thread")) != NULL)
+		this->use_encode_thread = spa_atob(str);
+	if (info && (str = spa_dict_lookup(info, "bluez5.encode-latency")) != NULL)
+		spa_atou32(str, &this->encode_latency, 0);
+
 	if (info && (str = spa_dict_lookup(info, SPA_KEY_API_BLUEZ5_TRANSPORT)))
 		sscanf(str, "pointer:%p", &this->transport);
 
@@ -0,0 +1,201 @@
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include <spa/utils/defs.h>
+
+#include "iso-batch.h"
+
+#define N_STREAMS	4
+#define SDU_SIZE	120
+
+/* The peer end of a socket pair stands in for the controller */
+struct link {
+	int fd;
+	int peer;
+};
+
+static void link_open(struct link *l)
+{
+	int fds[2];
+
+	spa_assert_se(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, fds) == 0);
+	l->fd = fds[0];
+	l->peer = fds[1];
+}
+
+static void link_close(struct link *l)
+{
+	if (l->fd >= 0)
+		close(l->fd);
+	if (l->peer >= 0)
+		close(l->peer);
+	l->fd = l->peer = -1;
+}
+
+static void fill_sdu(uint8_t *buf, size_t size, uint8_t seed)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (uint8_t)(seed + i);
+}
+
+static void check_recv(struct link *l, size_t size, uint8_t seed)
+{
+	uint8_t buf[SDU_SIZE * 2], expected[SDU_SIZE * 2];
+	ssize_t res;
+
+	res = recv(l->peer, buf, sizeof(buf), MSG_DONTWAIT);
+	spa_assert_se(res == (ssize_t)size);
+
+	fill_sdu(expected, size, seed);
+	spa_assert_se(memcmp(buf, expected, size) == 0);
+}
+
+static void check_empty(struct link *l)
+{
+	uint8_t buf[16];
+
+	spa_assert_se(recv(l->peer, buf, sizeof(buf), MSG_DONTWAIT) < 0);
+	spa_assert_se(errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static void test_iso_batch_streams(void)
+{
+	struct spa_bt_iso_batch batch;
+	struct link links[N_STREAMS];
+	uint8_t sdus[N_STREAMS][SDU_SIZE];
+	int i;
+
+	spa_bt_iso_batch_init(&batch);
+
+	for (i = 0; i < N_STREAMS; i++) {
+		link_open(&links[i]);
+		fill_sdu(sdus[i], SDU_SIZE - i, i * 16);
+		spa_assert_se(spa_bt_iso_batch_add(&batch, links[i].fd, sdus[i], SDU_SIZE - i) == i);
+	}
+
+	spa_assert_se(spa_bt_iso_batch_submit(&batch) == 0);
+
+	for (i = 0; i < N_STREAMS; i++) {
+		spa_assert_se(batch.items[i].res == SDU_SIZE - i);
+		check_recv(&links[i], SDU_SIZE - i, i * 16);
+		check_empty(&links[i]);
+		link_close(&links[i]);
+	}
+}
+
+static void test_iso_batch_same_fd(void)
+{
+	struct spa_bt_iso_batch batch;
+	struct link l, other;
+	uint8_t sdus[3][SDU_SIZE];
+	int i;
+
+	link_open(&l);
+	link_open(&other);
+
+	spa_bt_iso_batch_init(&batch);
+
+	/* two SDUs for the same socket go out with one sendmmsg */
+	for (i = 0; i < 3; i++)
+		fill_sdu(sdus[i], SDU_SIZE, 100 + i);
+	spa_assert_se(spa_bt_iso_batch_add(&batch, l.fd, sdus[0], SDU_SIZE) == 0);
+	spa_assert_se(spa_bt_iso_batch_add(&batch, l.fd, sdus[1], SDU_SIZE) == 1);
+	spa_assert_se(spa_bt_iso_batch_add(&batch, other.fd, sdus[2], SDU_SIZE) == 2);
+
+	spa_assert_se(spa_bt_iso_batch_submit(&batch) == 0);
+	for (i = 0; i < 3; i++)
+		spa_assert_se(batch.items[i].res == SDU_SIZE);
+
+	check_recv(&l, SDU_SIZE, 100);
+	check_recv(&l, SDU_SIZE, 101);
+	check_empty(&l);
+	check_recv(&other, SDU_SIZE, 102);
+	check_empty(&other);
+
+	link_close(&l);
+	link_close(&other);
+}
+
+static void test_iso_batch_errors(void)
+{
+	struct spa_bt_iso_batch batch;
+	struct link ok, dead, full;
+	uint8_t sdu[SDU_SIZE];
+	int i, val = 1;
+
+	link_open(&ok);
+	link_open(&dead);
+	link_open(&full);
+
+	fill_sdu(sdu, sizeof(sdu), 7);
+
+	/* controller went away */
+	close(dead.peer);
+	dead.peer = -1;
+
+	/* controller does not consume: fill the socket */
+	spa_assert_se(setsockopt(full.fd, SOL_SOCKET, SO_SNDBUF, &val, sizeof(val)) == 0);
+	while (send(full.fd, sdu, sizeof(sdu), MSG_DONTWAIT | MSG_NOSIGNAL) >= 0);
+	spa_assert_se(errno == EAGAIN || errno == EWOULDBLOCK);
+
+	spa_bt_iso_batch_init(&batch);
+	spa_assert_se(spa_bt_iso_batch_add(&batch, dead.fd, sdu, sizeof(sdu)) == 0);
+	spa_assert_se(spa_bt_iso_batch_add(&batch, full.fd, sdu, sizeof(sdu)) == 1);
+	spa_assert_se(spa_bt_iso_batch_add(&batch, full.fd, sdu, sizeof(sdu)) == 2);
+	spa_assert_se(spa_bt_iso_batch_add(&batch, ok.fd, sdu, sizeof(sdu)) == 3);
+
+	/* a failing stream does not hold back the others */
+	spa_assert_se(spa_bt_iso_batch_submit(&batch) == 3);
+	spa_assert_se(batch.items[0].res == -EPIPE);
+	spa_assert_se(batch.items[1].res == -EAGAIN);
+	spa_assert_se(batch.items[2].res == -EAGAIN);
+	spa_assert_se(batch.items[3].res == SDU_SIZE);
+	check_recv(&ok, SDU_SIZE, 7);
+
+	/* batch is bounded */
+	spa_bt_iso_batch_init(&batch);
+	for (i = 0; i < SPA_BT_ISO_BATCH_MAX; i++)
+		spa_assert_se(spa_bt_iso_batch_add(&batch, ok.fd, sdu, sizeof(sdu)) == i);
+	spa_assert_se(spa_bt_iso_batch_add(&batch, ok.fd, sdu, sizeof(sdu)) == -ENOSPC);
+
+	link_close(&ok);
+	link_close(&dead);
+	link_close(&full);
+}
+
+static void test_iso_jitter(void)
+{
+	struct spa_bt_iso_jitter j;
+	int i;
+
+	spa_bt_iso_jitter_reset(&j);
+	spa_assert_se(j.count == 0);
+
+	spa_bt_iso_jitter_update(&j, 1000);
+	spa_assert_se(j.min == 1000 && j.max == 1000 && j.avg == 1000 && j.last == 1000);
+
+	spa_bt_iso_jitter_update(&j, -500);
+	spa_bt_iso_jitter_update(&j, 3000);
+	spa_assert_se(j.min == -500);
+	spa_assert_se(j.max == 3000);
+	spa_assert_se(j.last == 3000);
+	spa_assert_se(j.count == 3);
+
+	/* average converges to a steady value */
+	for (i = 0; i < 2000; i++)
+		spa_bt_iso_jitter_update(&j, 200);
+	spa_assert_se(j.avg >= 199 && j.avg <= 263);
+}
+
+int main(void)
+{
+	test_iso_batch_streams();
+	test_iso_batch_same_fd();
+	test_iso_batch_errors();
+	test_iso_jitter();
+	return 0;
+}
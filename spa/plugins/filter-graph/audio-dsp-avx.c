@@ -234,6 +234,171 @@ void dsp_sum_avx(void *obj, float *r, const float *a, const float *b, uint32_t n
 	}
 }
 
+/* 8x8 transpose, v[k] holds 8 samples of channel k before and sample k of
+ * the 8 channels after */
+static inline void transpose8_avx(__m256 v[8])
+{
+	__m256 t0, t1, t2, t3, t4, t5, t6, t7;
+	__m256 s0, s1, s2, s3, s4, s5, s6, s7;
+
+	t0 = _mm256_unpacklo_ps(v[0], v[1]);
+	t1 = _mm256_unpackhi_ps(v[0], v[1]);
+	t2 = _mm256_unpacklo_ps(v[2], v[3]);
+	t3 = _mm256_unpackhi_ps(v[2], v[3]);
+	t4 = _mm256_unpacklo_ps(v[4], v[5]);
+	t5 = _mm256_unpackhi_ps(v[4], v[5]);
+	t6 = _mm256_unpacklo_ps(v[6], v[7]);
+	t7 = _mm256_unpackhi_ps(v[6], v[7]);
+
+	s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0));
+	s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2));
+	s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0));
+	s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2));
+	s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1,0,1,0));
+	s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3,2,3,2));
+	s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1,0,1,0));
+	s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3,2,3,2));
+
+	v[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	v[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	v[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	v[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	v[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	v[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	v[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	v[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+#define BQ8(bq,s,f)	_mm256_setr_ps(bq[0].f, bq[s].f, bq[2*s].f, bq[3*s].f,	\
+				bq[4*s].f, bq[5*s].f, bq[6*s].f, bq[7*s].f)
+
+/* Run n_bq (1 or 2) biquads of 8 channels, one channel in each lane. Blocks
+ * of 8 samples are transposed so that the loads and stores stay vectors. */
+static inline void dsp_biquad_run8_avx(void *obj, struct biquad *bq, uint32_t bq_stride,
+		uint32_t n_bq, float **out, const float **in, uint32_t n_samples)
+{
+	__m256 v[8], y;
+	__m256 b0[2], b1[2], b2[2];
+	__m256 a1[2], a2[2];
+	__m256 x1[2], x2[2];
+	float t[8];
+	uint32_t i, j, k, unrolled = n_samples & ~7;
+
+	for (j = 0; j < n_bq; j++) {
+		b0[j] = BQ8((bq+j), bq_stride, b0);
+		b1[j] = BQ8((bq+j), bq_stride, b1);
+		b2[j] = BQ8((bq+j), bq_stride, b2);
+		a1[j] = BQ8((bq+j), bq_stride, a1);
+		a2[j] = BQ8((bq+j), bq_stride, a2);
+		x1[j] = BQ8((bq+j), bq_stride, x1);
+		x2[j] = BQ8((bq+j), bq_stride, x2);
+	}
+
+#define BQ8_STEP(x,j)										\
+	y = _mm256_fmadd_ps(x, b0[j], x1[j]);		/* y = x * b0 + x1 */			\
+	x1[j] = _mm256_fmadd_ps(x, b1[j], x2[j]);	/* x1 = x * b1 + x2 */			\
+	x1[j] = _mm256_fnmadd_ps(y, a1[j], x1[j]);	/* x1 = x * b1 + x2 - a1 * y */		\
+	x2[j] = _mm256_mul_ps(x, b2[j]);		/* x2 = x * b2 */			\
+	x2[j] = _mm256_fnmadd_ps(y, a2[j], x2[j]);	/* x2 = x * b2 - a2 * y */		\
+	x = y;
+
+	for (i = 0; i < unrolled; i += 8) {
+		for (k = 0; k < 8; k++)
+			v[k] = _mm256_loadu_ps(&in[k][i]);
+		transpose8_avx(v);
+		for (j = 0; j < n_bq; j++) {
+			for (k = 0; k < 8; k++) {
+				BQ8_STEP(v[k], j);
+			}
+		}
+		transpose8_avx(v);
+		for (k = 0; k < 8; k++)
+			_mm256_storeu_ps(&out[k][i], v[k]);
+	}
+	for (; i < n_samples; i++) {
+		v[0] = _mm256_setr_ps(in[0][i], in[1][i], in[2][i], in[3][i],
+				in[4][i], in[5][i], in[6][i], in[7][i]);
+		for (j = 0; j < n_bq; j++) {
+			BQ8_STEP(v[0], j);
+		}
+		_mm256_storeu_ps(t, v[0]);
+		for (k = 0; k < 8; k++)
+			out[k][i] = t[k];
+	}
+#undef BQ8_STEP
+
+#define F(x) (isnormal(x) ? (x) : 0.0f)
+	for (j = 0; j < n_bq; j++) {
+		float t1[8], t2[8];
+		_mm256_storeu_ps(t1, x1[j]);
+		_mm256_storeu_ps(t2, x2[j]);
+		for (k = 0; k < 8; k++) {
+			bq[k*bq_stride+j].x1 = F(t1[k]);
+			bq[k*bq_stride+j].x2 = F(t2[k]);
+		}
+	}
+#undef F
+}
+#undef BQ8
+
+static void dsp_biquad_run1_8_avx(void *obj, struct biquad *bq, uint32_t bq_stride,
+		float **out, const float **in, uint32_t n_samples)
+{
+	dsp_biquad_run8_avx(obj, bq, bq_stride, 1, out, in, n_samples);
+}
+
+static void dsp_biquad2_run8_avx(void *obj, struct biquad *bq, uint32_t bq_stride,
+		float **out, const float **in, uint32_t n_samples)
+{
+	dsp_biquad_run8_avx(obj, bq, bq_stride, 2, out, in, n_samples);
+}
+
+void dsp_biquad_run_avx(void *obj, struct biquad *bq, uint32_t n_bq, uint32_t bq_stride,
+		float * SPA_RESTRICT out[], const float * SPA_RESTRICT in[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	uint32_t i, j, k, bqs8 = bq_stride*8;
+	uint32_t iunrolled8 = n_src & ~7;
+	uint32_t junrolled2 = n_bq & ~1;
+
+	for (i = 0; i < iunrolled8; i+=8, bq+=bqs8) {
+		const float *s[8];
+		float *d[8];
+
+		for (k = 0; k < 8; k++) {
+			s[k] = in[i+k];
+			d[k] = out[i+k];
+			if (s[k] == NULL || d[k] == NULL)
+				break;
+		}
+		if (k < 8)
+			break;
+
+		j = 0;
+		if (j < junrolled2) {
+			dsp_biquad2_run8_avx(obj, &bq[j], bq_stride, d, s, n_samples);
+			for (k = 0; k < 8; k++)
+				s[k] = d[k];
+			j+=2;
+		}
+		for (; j < junrolled2; j+=2) {
+			dsp_biquad2_run8_avx(obj, &bq[j], bq_stride, d, s, n_samples);
+		}
+		if (j < n_bq) {
+			dsp_biquad_run1_8_avx(obj, &bq[j], bq_stride, d, s, n_samples);
+		}
+	}
+	/* the remaining channels */
+	if (i < n_src)
+#if defined (HAVE_SSE)
+		dsp_biquad_run_sse(obj, bq, n_bq, bq_stride, &out[i], &in[i],
+				n_src - i, n_samples);
+#else
+		dsp_biquad_run_c(obj, bq, n_bq, bq_stride, &out[i], &in[i],
+				n_src - i, n_samples);
+#endif
+}
+
 inline static __m256 _mm256_mul_pz(__m256 ab, __m256 cd)
 {
 	__m256 aa, bb, dc, x0, x1;
@@ -173,6 +173,62 @@ void dsp_biquad_run_c(void *obj, struct biquad *bq, uint32_t n_bq, uint32_t bq_s
 	}
 }
 
+static void biquad_ramp_c(void *obj, struct biquad *bq, const struct biquad *target,
+		float *out, const float *in, uint32_t n_samples)
+{
+	float x, y, x1, x2, scale = 1.0f / n_samples;
+	float b0, b1, b2, a1, a2;
+	float db0, db1, db2, da1, da2;
+	uint32_t i;
+
+	x1 = bq->x1;
+	x2 = bq->x2;
+	b0 = bq->b0;
+	b1 = bq->b1;
+	b2 = bq->b2;
+	a1 = bq->a1;
+	a2 = bq->a2;
+	db0 = (target->b0 - b0) * scale;
+	db1 = (target->b1 - b1) * scale;
+	db2 = (target->b2 - b2) * scale;
+	da1 = (target->a1 - a1) * scale;
+	da2 = (target->a2 - a2) * scale;
+	for (i = 0; i < n_samples; i++) {
+		b0 += db0;
+		b1 += db1;
+		b2 += db2;
+		a1 += da1;
+		a2 += da2;
+		x  = in[i];
+		y  = b0 * x          + x1;
+		x1 = b1 * x - a1 * y + x2;
+		x2 = b2 * x - a2 * y;
+		out[i] = y;
+	}
+#define F(x) (isnormal(x) ? (x) : 0.0f)
+	bq->x1 = F(x1);
+	bq->x2 = F(x2);
+#undef F
+}
+
+void dsp_biquad_ramp_c(void *obj, struct biquad *bq, const struct biquad *target,
+		float * SPA_RESTRICT out[], const float * SPA_RESTRICT in[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	uint32_t i;
+	for (i = 0; i < n_src; i++) {
+		if (in[i] == NULL || out[i] == NULL) {
+			biquad_set_target(&bq[i], &target[i]);
+		} else if (bq[i].type == BQ_NONE || target[i].type == BQ_NONE || n_samples == 0) {
+			biquad_set_target(&bq[i], &target[i]);
+			biquad_run_c(obj, &bq[i], out[i], in[i], n_samples);
+		} else {
+			biquad_ramp_c(obj, &bq[i], &target[i], out[i], in[i], n_samples);
+			biquad_set_target(&bq[i], &target[i]);
+		}
+	}
+}
+
 void dsp_sum_c(void *obj, float * dst,
 		const float * SPA_RESTRICT a, const float * SPA_RESTRICT b, uint32_t n_samples)
 {
@@ -10,6 +10,15 @@
 struct spa_fga_dsp * spa_fga_dsp_new(uint32_t cpu_flags);
 void spa_fga_dsp_free(struct spa_fga_dsp *dsp);
 
+/* take the coefficients of target and keep the state of bq */
+static inline void biquad_set_target(struct biquad *bq, const struct biquad *target)
+{
+	float x1 = bq->x1, x2 = bq->x2;
+	*bq = *target;
+	bq->x1 = x1;
+	bq->x2 = x2;
+}
+
 #define MAKE_CLEAR_FUNC(arch) \
 void dsp_clear_##arch(void *obj, float * SPA_RESTRICT dst, uint32_t n_samples)
 #define MAKE_COPY_FUNC(arch) \
@@ -30,6 +39,9 @@ void dsp_mult_##arch(void *obj, float * SPA_RESTRICT dst,	\
 #define MAKE_BIQUAD_RUN_FUNC(arch) \
 void dsp_biquad_run_##arch (void *obj, struct biquad *bq, uint32_t n_bq, uint32_t bq_stride, \
 	float * SPA_RESTRICT out[], const float * SPA_RESTRICT in[], uint32_t n_src, uint32_t n_samples)
+#define MAKE_BIQUAD_RAMP_FUNC(arch) \
+void dsp_biquad_ramp_##arch (void *obj, struct biquad *bq, const struct biquad *target, \
+	float * SPA_RESTRICT out[], const float * SPA_RESTRICT in[], uint32_t n_src, uint32_t n_samples)
 #define MAKE_DELAY_FUNC(arch) \
 void dsp_delay_##arch (void *obj, float *buffer, uint32_t *pos, uint32_t n_buffer, \
 		uint32_t delay, float *dst, const float *src, uint32_t n_samples)
@@ -65,6 +77,7 @@ MAKE_SUM_FUNC(c);
 MAKE_LINEAR_FUNC(c);
 MAKE_MULT_FUNC(c);
 MAKE_BIQUAD_RUN_FUNC(c);
+MAKE_BIQUAD_RAMP_FUNC(c);
 MAKE_DELAY_FUNC(c);
 
 MAKE_FFT_NEW_FUNC(c);
@@ -80,6 +93,7 @@ MAKE_FFT_CMULADD_FUNC(c);
 MAKE_MIX_GAIN_FUNC(sse);
 MAKE_SUM_FUNC(sse);
 MAKE_BIQUAD_RUN_FUNC(sse);
+MAKE_BIQUAD_RAMP_FUNC(sse);
 MAKE_DELAY_FUNC(sse);
 MAKE_FFT_CMUL_FUNC(sse);
 MAKE_FFT_CMULADD_FUNC(sse);
@@ -87,6 +101,7 @@ MAKE_FFT_CMULADD_FUNC(sse);
 #if defined (HAVE_AVX)
 MAKE_MIX_GAIN_FUNC(avx);
 MAKE_SUM_FUNC(avx);
+MAKE_BIQUAD_RUN_FUNC(avx);
 MAKE_FFT_CMUL_FUNC(avx);
 MAKE_FFT_CMULADD_FUNC(avx);
 #endif
@@ -612,6 +612,146 @@ void dsp_biquad_run_sse(void *obj, struct biquad *bq, uint32_t n_bq, uint32_t bq
 	}
 }
 
+/* like dsp_biquad_run1_sse, the coefficients are moved to the target with
+ * one vector add per sample. */
+static void dsp_biquad_ramp1_sse(void *obj, struct biquad *bq, const struct biquad *target,
+		float *out, const float *in, uint32_t n_samples)
+{
+	__m128 x, y, z;
+	__m128 b012, db012;
+	__m128 a12, da12;
+	__m128 x12, scale;
+	uint32_t i;
+
+	scale = _mm_set1_ps(1.0f / n_samples);
+	b012 = _mm_setr_ps(bq->b0, bq->b1, bq->b2, 0.0f);  /* b0  b1  b2  0 */
+	a12 = _mm_setr_ps(0.0f, bq->a1, bq->a2, 0.0f);	  /* 0   a1  a2  0 */
+	x12 = _mm_setr_ps(bq->x1, bq->x2, 0.0f, 0.0f);	  /* x1  x2  0   0 */
+	db012 = _mm_setr_ps(target->b0, target->b1, target->b2, 0.0f);
+	db012 = _mm_mul_ps(_mm_sub_ps(db012, b012), scale);
+	da12 = _mm_setr_ps(0.0f, target->a1, target->a2, 0.0f);
+	da12 = _mm_mul_ps(_mm_sub_ps(da12, a12), scale);
+
+	for (i = 0; i < n_samples; i++) {
+		b012 = _mm_add_ps(b012, db012);
+		a12 = _mm_add_ps(a12, da12);
+
+		x = _mm_load1_ps(&in[i]);		/*  x         x         x      x */
+		z = _mm_mul_ps(x, b012);		/*  b0*x      b1*x      b2*x   0 */
+		z = _mm_add_ps(z, x12); 		/*  b0*x+x1   b1*x+x2   b2*x   0 */
+		_mm_store_ss(&out[i], z);		/*  out[i] = b0*x+x1 */
+		y = _mm_shuffle_ps(z, z, _MM_SHUFFLE(0,0,0,0));	/*  b0*x+x1  b0*x+x1  b0*x+x1  b0*x+x1 = y*/
+		y = _mm_mul_ps(y, a12);		        /*  0        a1*y     a2*y     0 */
+		y = _mm_sub_ps(z, y);	 		/*  y        x1       x2       0 */
+		x12 = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3,3,2,1));    /*  x1  x2  0  0*/
+	}
+#define F(x) (isnormal(x) ? (x) : 0.0f)
+	bq->x1 = F(x12[0]);
+	bq->x2 = F(x12[1]);
+#undef F
+}
+
+/* 4 filters, one in each lane, each with their own coefficient ramp */
+static void dsp_biquad_ramp4_sse(void *obj, struct biquad *bq, const struct biquad *target,
+		float * SPA_RESTRICT out[], const float * SPA_RESTRICT in[], uint32_t n_samples)
+{
+	__m128 x, y, z;
+	__m128 b0, b1, b2, db0, db1, db2;
+	__m128 a1, a2, da1, da2;
+	__m128 x1, x2, scale;
+	uint32_t i;
+
+	scale = _mm_set1_ps(1.0f / n_samples);
+	b0 = _mm_setr_ps(bq[0].b0, bq[1].b0, bq[2].b0, bq[3].b0);
+	b1 = _mm_setr_ps(bq[0].b1, bq[1].b1, bq[2].b1, bq[3].b1);
+	b2 = _mm_setr_ps(bq[0].b2, bq[1].b2, bq[2].b2, bq[3].b2);
+	a1 = _mm_setr_ps(bq[0].a1, bq[1].a1, bq[2].a1, bq[3].a1);
+	a2 = _mm_setr_ps(bq[0].a2, bq[1].a2, bq[2].a2, bq[3].a2);
+	x1 = _mm_setr_ps(bq[0].x1, bq[1].x1, bq[2].x1, bq[3].x1);
+	x2 = _mm_setr_ps(bq[0].x2, bq[1].x2, bq[2].x2, bq[3].x2);
+
+	db0 = _mm_setr_ps(target[0].b0, target[1].b0, target[2].b0, target[3].b0);
+	db1 = _mm_setr_ps(target[0].b1, target[1].b1, target[2].b1, target[3].b1);
+	db2 = _mm_setr_ps(target[0].b2, target[1].b2, target[2].b2, target[3].b2);
+	da1 = _mm_setr_ps(target[0].a1, target[1].a1, target[2].a1, target[3].a1);
+	da2 = _mm_setr_ps(target[0].a2, target[1].a2, target[2].a2, target[3].a2);
+	db0 = _mm_mul_ps(_mm_sub_ps(db0, b0), scale);
+	db1 = _mm_mul_ps(_mm_sub_ps(db1, b1), scale);
+	db2 = _mm_mul_ps(_mm_sub_ps(db2, b2), scale);
+	da1 = _mm_mul_ps(_mm_sub_ps(da1, a1), scale);
+	da2 = _mm_mul_ps(_mm_sub_ps(da2, a2), scale);
+
+	for (i = 0; i < n_samples; i++) {
+		b0 = _mm_add_ps(b0, db0);
+		b1 = _mm_add_ps(b1, db1);
+		b2 = _mm_add_ps(b2, db2);
+		a1 = _mm_add_ps(a1, da1);
+		a2 = _mm_add_ps(a2, da2);
+
+		x = _mm_setr_ps(in[0][i], in[1][i], in[2][i], in[3][i]);
+
+		y = _mm_mul_ps(x, b0);		/* y = x * b0 */
+		y = _mm_add_ps(y, x1);		/* y = x * b0 + x1*/
+		z = _mm_mul_ps(y, a1);		/* z = a1 * y */
+		x1 = _mm_mul_ps(x, b1);		/* x1 = x * b1 */
+		x1 = _mm_add_ps(x1, x2);	/* x1 = x * b1 + x2*/
+		x1 = _mm_sub_ps(x1, z);		/* x1 = x * b1 + x2 - a1 * y*/
+		z = _mm_mul_ps(y, a2);		/* z = a2 * y */
+		x2 = _mm_mul_ps(x, b2);		/* x2 = x * b2 */
+		x2 = _mm_sub_ps(x2, z);		/* x2 = x * b2 - a2 * y*/
+
+		out[0][i] = y[0];
+		out[1][i] = y[1];
+		out[2][i] = y[2];
+		out[3][i] = y[3];
+	}
+#define F(x) (isnormal(x) ? (x) : 0.0f)
+	bq[0].x1 = F(x1[0]);
+	bq[0].x2 = F(x2[0]);
+	bq[1].x1 = F(x1[1]);
+	bq[1].x2 = F(x2[1]);
+	bq[2].x1 = F(x1[2]);
+	bq[2].x2 = F(x2[2]);
+	bq[3].x1 = F(x1[3]);
+	bq[3].x2 = F(x2[3]);
+#undef F
+}
+
+static inline bool biquad_can_ramp(const struct biquad *bq, const struct biquad *target,
+		float *out, const float *in)
+{
+	return in != NULL && out != NULL &&
+		bq->type != BQ_NONE && target->type != BQ_NONE;
+}
+
+void dsp_biquad_ramp_sse(void *obj, struct biquad *bq, const struct biquad *target,
+		float * SPA_RESTRICT out[], const float * SPA_RESTRICT in[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	uint32_t i = 0, j;
+
+	if (n_samples > 0) {
+		for (; i + 4 <= n_src; i += 4) {
+			for (j = 0; j < 4; j++)
+				if (!biquad_can_ramp(&bq[i+j], &target[i+j], out[i+j], in[i+j]))
+					break;
+			if (j < 4)
+				break;
+			dsp_biquad_ramp4_sse(obj, &bq[i], &target[i], &out[i], &in[i], n_samples);
+			for (j = 0; j < 4; j++)
+				biquad_set_target(&bq[i+j], &target[i+j]);
+		}
+		for (; i < n_src; i++) {
+			if (!biquad_can_ramp(&bq[i], &target[i], out[i], in[i]))
+				break;
+			dsp_biquad_ramp1_sse(obj, &bq[i], &target[i], out[i], in[i], n_samples);
+			biquad_set_target(&bq[i], &target[i]);
+		}
+	}
+	if (i < n_src)
+		dsp_biquad_ramp_c(obj, &bq[i], &target[i], &out[i], &in[i], n_src - i, n_samples);
+}
+
 void dsp_delay_sse(void *obj, float *buffer, uint32_t *pos, uint32_t n_buffer, uint32_t delay,
 		float *dst, const float *src, uint32_t n_samples)
 {
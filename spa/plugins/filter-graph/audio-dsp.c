@@ -24,11 +24,12 @@ struct dsp_info {
 static const struct dsp_info dsp_table[] =
 {
 #if defined (HAVE_AVX)
-	{ SPA_CPU_FLAG_AVX,
+	{ SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3,
 		.funcs.clear = dsp_clear_c,
 		.funcs.copy = dsp_copy_c,
 		.funcs.mix_gain = dsp_mix_gain_avx,
-		.funcs.biquad_run = dsp_biquad_run_sse,
+		.funcs.biquad_run = dsp_biquad_run_avx,
+		.funcs.biquad_ramp = dsp_biquad_ramp_sse,
 		.funcs.sum = dsp_sum_avx,
 		.funcs.linear = dsp_linear_c,
 		.funcs.mult = dsp_mult_c,
@@ -49,6 +50,7 @@ static const struct dsp_info dsp_table[] =
 		.funcs.copy = dsp_copy_c,
 		.funcs.mix_gain = dsp_mix_gain_sse,
 		.funcs.biquad_run = dsp_biquad_run_sse,
+		.funcs.biquad_ramp = dsp_biquad_ramp_sse,
 		.funcs.sum = dsp_sum_sse,
 		.funcs.linear = dsp_linear_c,
 		.funcs.mult = dsp_mult_c,
@@ -68,6 +70,7 @@ static const struct dsp_info dsp_table[] =
 		.funcs.copy = dsp_copy_c,
 		.funcs.mix_gain = dsp_mix_gain_c,
 		.funcs.biquad_run = dsp_biquad_run_c,
+		.funcs.biquad_ramp = dsp_biquad_ramp_c,
 		.funcs.sum = dsp_sum_c,
 		.funcs.linear = dsp_linear_c,
 		.funcs.mult = dsp_mult_c,
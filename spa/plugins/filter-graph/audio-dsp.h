@@ -59,6 +59,9 @@ struct spa_fga_dsp_methods {
 			uint32_t n_src, uint32_t n_samples);
 	void (*delay) (void *obj, float *buffer, uint32_t *pos, uint32_t n_buffer, uint32_t delay,
 			float *dst, const float *src, uint32_t n_samples);
+	void (*biquad_ramp) (void *obj, struct biquad *bq, const struct biquad *target,
+			float * SPA_RESTRICT out[], const float * SPA_RESTRICT in[],
+			uint32_t n_src, uint32_t n_samples);
 };
 
 static inline void spa_fga_dsp_clear(struct spa_fga_dsp *obj, float * SPA_RESTRICT dst, uint32_t n_samples)
@@ -165,4 +168,15 @@ static inline void spa_fga_dsp_delay(struct spa_fga_dsp *obj,
 			buffer, pos, n_buffer, delay, dst, src, n_samples);
 }
 
+/* run in[i] through bq[i] while the coefficients move linearly to those of
+ * target[i]. After n_samples the coefficients of bq are those of target. */
+static inline void spa_fga_dsp_biquad_ramp(struct spa_fga_dsp *obj,
+		struct biquad *bq, const struct biquad *target,
+		float * SPA_RESTRICT out[], const float * SPA_RESTRICT in[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	spa_api_method_v(spa_fga_dsp, &obj->iface, biquad_ramp, 0,
+			bq, target, out, in, n_src, n_samples);
+}
+
 #endif /* SPA_FGA_DSP_H */
@@ -71,6 +71,9 @@ struct spa_fga_descriptor {
 	void (*deactivate) (void *instance);
 
 	void (*run) (void *instance, unsigned long SampleCount);
+	/* optional, run instances of the descriptor together, each with its own
+	 * ports and state, as if run was called on each of them */
+	void (*run_multi) (void **instances, uint32_t n_instances, unsigned long SampleCount);
 };
 
 static inline void spa_fga_descriptor_free(const struct spa_fga_descriptor *desc)
@@ -0,0 +1,117 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/support/cpu.h>
+
+#include "test-helper.h"
+#include "audio-dsp-impl.h"
+#include "convolver.h"
+
+#define N_SAMPLES	1024
+#define BLOCK_SIZE	256
+#define TAIL_SIZE	4096
+#define MAX_COUNT	200
+
+static uint32_t cpu_flags;
+
+struct impl {
+	const char *name;
+	uint32_t flags;
+};
+
+static const struct impl impls[] = {
+	{ "c", 0 },
+#if defined (HAVE_SSE)
+	{ "sse", SPA_CPU_FLAG_SSE },
+#endif
+#if defined (HAVE_AVX)
+	{ "avx", SPA_CPU_FLAG_SSE | SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3 },
+#endif
+};
+
+static const int ir_lengths[] = { 1024, 8192, 65536, 262144, 1048576 };
+
+static float in[N_SAMPLES * MAX_COUNT];
+static float out[SPA_N_ELEMENTS(impls)][N_SAMPLES * MAX_COUNT];
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void run_test(const float *ir, int ir_len)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < SPA_N_ELEMENTS(impls); i++) {
+		const struct impl *im = &impls[i];
+		struct spa_fga_dsp *dsp;
+		struct convolver *conv;
+		uint64_t t1, t2;
+		float max_diff = 0.0f;
+
+		if (!SPA_FLAG_IS_SET(cpu_flags, im->flags))
+			continue;
+
+		dsp = spa_fga_dsp_new(im->flags);
+		spa_assert_se(dsp != NULL);
+		conv = convolver_new(dsp, BLOCK_SIZE, TAIL_SIZE, ir, ir_len);
+		spa_assert_se(conv != NULL);
+
+		t1 = get_time_ns();
+		for (j = 0; j < MAX_COUNT; j++)
+			convolver_run(conv, &in[j * N_SAMPLES], &out[i][j * N_SAMPLES], N_SAMPLES);
+		t2 = get_time_ns();
+
+		for (j = 0; j < N_SAMPLES * MAX_COUNT; j++)
+			max_diff = fmaxf(max_diff, fabsf(out[0][j] - out[i][j]));
+
+		/* one convolver is one channel */
+		fprintf(stderr, "%-12."PRIu64" \t%-8d taps %s \tblock %d tail %d diff %g\n",
+				(t2 - t1) / MAX_COUNT, ir_len, im->name,
+				BLOCK_SIZE, TAIL_SIZE, max_diff);
+
+		convolver_free(conv);
+		spa_fga_dsp_free(dsp);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i;
+	int j;
+
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	for (i = 0; i < SPA_N_ELEMENTS(in); i++)
+		in[i] = 0.5f * sinf(i * 0.05f) + 0.1f * (float)(drand48() - 0.5);
+
+	fprintf(stderr, "nsec/channel, %d samples\n", N_SAMPLES);
+
+	for (i = 0; i < SPA_N_ELEMENTS(ir_lengths); i++) {
+		int len = ir_lengths[i];
+		float *ir = calloc(len, sizeof(float));
+
+		spa_assert_se(ir != NULL);
+		/* a decaying noise tail, like a reverb */
+		for (j = 0; j < len; j++)
+			ir[j] = (float)(drand48() - 0.5) * expf(-4.0f * j / len) / sqrtf(len);
+
+		run_test(ir, len);
+		free(ir);
+	}
+	return 0;
+}
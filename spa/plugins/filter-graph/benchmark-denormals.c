@@ -0,0 +1,268 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <dlfcn.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/plugin-loader.h>
+#include <spa/support/log-impl.h>
+#include <spa/support/cpu.h>
+#include <spa/utils/dict.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+#include <spa/param/audio/raw.h>
+#include <spa/filter-graph/filter-graph.h>
+
+#define MAX_SAMPLES	8192
+#define N_SAMPLES	1024
+#define SIGNAL_COUNT	50
+#define SILENCE_COUNT	500
+
+/*
+ * Runs every builtin filter with an input on a signal and then on silence. Filters with
+ * feedback let their state decay into denormals during the silence, which
+ * can make a cycle many times slower. The silence is measured with and
+ * without denormals flushed to zero.
+ */
+static SPA_LOG_IMPL(logger);
+
+static struct spa_support support[4];
+static uint32_t n_support;
+static struct spa_cpu *cpu_iface;
+
+struct filter {
+	const char *label;
+	const char *input;
+	const char *output;
+	const char *args;
+};
+
+static const struct filter filters[] = {
+	{ "copy", "In", "Out", "" },
+	{ "mixer", "In 1", "Out", "" },
+	{ "bq_lowpass", "In", "Out", "control = { Freq = 100 Q = 0.7 }" },
+	{ "bq_highpass", "In", "Out", "control = { Freq = 100 Q = 0.7 }" },
+	{ "bq_bandpass", "In", "Out", "control = { Freq = 100 Q = 0.7 }" },
+	{ "bq_lowshelf", "In", "Out", "control = { Freq = 100 Q = 0.7 Gain = 6 }" },
+	{ "bq_highshelf", "In", "Out", "control = { Freq = 100 Q = 0.7 Gain = 6 }" },
+	{ "bq_peaking", "In", "Out", "control = { Freq = 100 Q = 0.7 Gain = 6 }" },
+	{ "bq_notch", "In", "Out", "control = { Freq = 100 Q = 0.7 }" },
+	{ "bq_allpass", "In", "Out", "control = { Freq = 100 Q = 0.7 }" },
+	{ "bq_raw", "In", "Out", "config = { coefficients = [ { rate = 48000 b0 = 0.001 a1 = -0.999 } ] }" },
+	{ "convolver", "In", "Out", "config = { filename = \"/hilbert\" length = 4096 }" },
+	{ "delay", "In", "Out", "config = { \"max-delay\" = 1.0 } control = { \"Delay (s)\" = 0.01 }" },
+	{ "invert", "In", "Out", "" },
+	{ "clamp", "In", "Out", "" },
+	{ "linear", "In", "Out", "control = { Mult = 0.8 }" },
+	{ "recip", "In", "Out", "" },
+	{ "exp", "In", "Out", "" },
+	{ "log", "In", "Out", "" },
+	{ "mult", "In 1", "Out", "" },
+	{ "param_eq", "In 1", "Out 1", "config = { filters = [ { type = bq_lowpass freq = 100 q = 0.7 } "
+		"{ type = bq_peaking freq = 1000 q = 1.0 gain = 3.0 } ] }" },
+	{ "max", "In 1", "Out", "" },
+	{ "dcblock", "In 1", "Out 1", "" },
+	{ "abs", "In", "Out", "" },
+	{ "sqrt", "In", "Out", "" },
+};
+
+static struct spa_handle *load_handle(const char *lib, const char *name,
+		const struct spa_dict *info)
+{
+	const char *dir;
+	char path[PATH_MAX];
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	uint32_t i = 0;
+	int res;
+
+	if ((dir = getenv("SPA_PLUGIN_DIR")) == NULL)
+		dir = PLUGINDIR;
+	snprintf(path, sizeof(path), "%s/%s.so", dir, lib);
+
+	if ((hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		fprintf(stderr, "can't load %s: %s\n", path, dlerror());
+		errno = ENOENT;
+		return NULL;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		errno = ENXIO;
+		return NULL;
+	}
+	while ((res = enum_func(&factory, &i)) > 0) {
+		if (spa_streq(factory->name, name))
+			break;
+	}
+	if (res <= 0) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	handle = calloc(1, spa_handle_factory_get_size(factory, info));
+	if ((res = spa_handle_factory_init(factory, handle, info, support, n_support)) < 0) {
+		fprintf(stderr, "can't make %s: %s\n", name, spa_strerror(res));
+		free(handle);
+		errno = -res;
+		return NULL;
+	}
+	return handle;
+}
+
+static struct spa_handle *loader_load(void *object, const char *factory_name,
+		const struct spa_dict *info)
+{
+	const char *lib = info ? spa_dict_lookup(info, SPA_KEY_LIBRARY_NAME) : NULL;
+	return lib ? load_handle(lib, factory_name, info) : NULL;
+}
+
+static int loader_unload(void *object, struct spa_handle *handle)
+{
+	spa_handle_clear(handle);
+	free(handle);
+	return 0;
+}
+
+static const struct spa_plugin_loader_methods loader_methods = {
+	SPA_VERSION_PLUGIN_LOADER_METHODS,
+	.load = loader_load,
+	.unload = loader_unload,
+};
+
+static struct spa_plugin_loader loader;
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static int run_filter(const struct filter *f, bool zero_denormals, float *in,
+		float *out, uint64_t nsec[2])
+{
+	struct spa_handle *handle;
+	struct spa_filter_graph *graph;
+	char json[2048];
+	const void *ins[1] = { in };
+	void *outs[1] = { out };
+	uint64_t t1, t2;
+	uint32_t i;
+	void *iface;
+	int res;
+
+	snprintf(json, sizeof(json),
+			"{ nodes = [ { type = builtin name = f label = %s %s } ] "
+			"inputs = [ \"f:%s\" ] outputs = [ \"f:%s\" ] }",
+			f->label, f->args, f->input, f->output);
+
+	handle = load_handle("filter-graph/libspa-filter-graph", "filter.graph",
+			&SPA_DICT_ITEMS(
+				SPA_DICT_ITEM("clock.quantum-limit", SPA_STRINGIFY(MAX_SAMPLES)),
+				SPA_DICT_ITEM("filter-graph.silence-timeout", "0"),
+				SPA_DICT_ITEM("filter.graph", json)));
+	if (handle == NULL)
+		return -errno;
+
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_FilterGraph, &iface)) < 0)
+		goto exit;
+	graph = iface;
+
+	if ((res = spa_filter_graph_activate(graph,
+			&SPA_DICT_ITEMS(SPA_DICT_ITEM(SPA_KEY_AUDIO_RATE, "48000")))) < 0)
+		goto exit;
+
+	spa_cpu_zero_denormals(cpu_iface, zero_denormals);
+
+	for (i = 0; i < N_SAMPLES; i++)
+		in[i] = 0.5f * sinf(i * 0.05f) + 0.1f * (float)(drand48() - 0.5);
+	t1 = get_time_ns();
+	for (i = 0; i < SIGNAL_COUNT; i++)
+		spa_filter_graph_process(graph, ins, outs, N_SAMPLES);
+	t2 = get_time_ns();
+	nsec[0] = (t2 - t1) / SIGNAL_COUNT;
+
+	memset(in, 0, N_SAMPLES * sizeof(float));
+	t1 = get_time_ns();
+	for (i = 0; i < SILENCE_COUNT; i++)
+		spa_filter_graph_process(graph, ins, outs, N_SAMPLES);
+	t2 = get_time_ns();
+	nsec[1] = (t2 - t1) / SILENCE_COUNT;
+
+	spa_cpu_zero_denormals(cpu_iface, false);
+
+	spa_filter_graph_deactivate(graph);
+exit:
+	spa_handle_clear(handle);
+	free(handle);
+	return res;
+}
+
+static void test_filter(const struct filter *f)
+{
+	float *in, *out;
+	uint64_t nsec[2][2];
+	int res;
+
+	in = calloc(N_SAMPLES, sizeof(float));
+	out = calloc(N_SAMPLES, sizeof(float));
+
+	if ((res = run_filter(f, false, in, out, nsec[0])) < 0 ||
+	    (res = run_filter(f, true, in, out, nsec[1])) < 0) {
+		fprintf(stderr, "%s: can't run filter: %s\n", f->label, spa_strerror(res));
+	} else {
+		fprintf(stderr, "%-12s %-10."PRIu64" %-10."PRIu64" %-10."PRIu64" %-10."PRIu64" silence %.2f\n",
+				f->label, nsec[0][0], nsec[0][1], nsec[1][0], nsec[1][1],
+				(double)nsec[0][1] / nsec[1][1]);
+	}
+	free(in);
+	free(out);
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_handle *cpu;
+	void *iface;
+	uint32_t i;
+
+	logger.log.level = SPA_LOG_LEVEL_WARN;
+	loader.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_PluginLoader,
+			SPA_VERSION_PLUGIN_LOADER, &loader_methods, NULL);
+
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Log, &logger);
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_PluginLoader, &loader);
+
+	if ((cpu = load_handle("support/libspa-support", SPA_NAME_SUPPORT_CPU, NULL)) == NULL ||
+	    spa_handle_get_interface(cpu, SPA_TYPE_INTERFACE_CPU, &iface) < 0) {
+		fprintf(stderr, "can't load the cpu interface\n");
+		return -1;
+	}
+	cpu_iface = iface;
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_CPU, iface);
+
+	if (spa_cpu_zero_denormals(cpu_iface, false) == -ENOTSUP)
+		fprintf(stderr, "zero denormals is not supported on this CPU\n");
+
+	fprintf(stderr, "nsec/cycle, %d samples, %d silent cycles\n", N_SAMPLES, SILENCE_COUNT);
+	fprintf(stderr, "%-12s %-10s %-10s %-10s %-10s\n", "filter",
+			"signal", "silence", "signal-ftz", "silence-ftz");
+
+	for (i = 0; i < SPA_N_ELEMENTS(filters); i++)
+		test_filter(&filters[i]);
+
+	spa_handle_clear(cpu);
+	free(cpu);
+	return 0;
+}
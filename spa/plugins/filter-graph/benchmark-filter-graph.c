@@ -0,0 +1,293 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <dlfcn.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/plugin-loader.h>
+#include <spa/support/log-impl.h>
+#include <spa/support/cpu.h>
+#include <spa/utils/dict.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+#include <spa/param/audio/raw.h>
+#include <spa/filter-graph/filter-graph.h>
+
+#define MAX_CHANNELS	16
+#define MAX_SAMPLES	8192
+#define N_SAMPLES	1024
+#define MAX_COUNT	2000
+#define MAX_NODES	64
+
+static SPA_LOG_IMPL(logger);
+
+static struct spa_support support[4];
+static uint32_t n_support;
+
+struct preset {
+	const char *name;
+	uint32_t n_channels;
+	uint32_t n_stages;
+	const char *labels[MAX_NODES];
+};
+
+#define EQ_10	10, {									\
+		"bq_peaking", "bq_peaking", "bq_peaking", "bq_peaking", "bq_peaking",	\
+		"bq_peaking", "bq_peaking", "bq_peaking", "bq_peaking", "bq_peaking" }
+
+static const struct preset presets[] = {
+	{ "eq-5", 2, 5, {
+		"bq_lowshelf", "bq_peaking", "bq_peaking", "bq_peaking", "bq_highshelf" } },
+	{ "eq-10", 2, EQ_10 },
+	{ "eq-10 7.1", 8, EQ_10 },
+	{ "eq-10 16ch", 16, EQ_10 },
+	{ "eq-20+gain", 2, 21, {
+		"bq_highpass", "bq_lowshelf", "bq_peaking", "bq_peaking", "bq_peaking",
+		"bq_peaking", "bq_peaking", "bq_peaking", "bq_peaking", "bq_peaking",
+		"bq_peaking", "bq_peaking", "bq_peaking", "bq_peaking", "bq_peaking",
+		"bq_peaking", "bq_peaking", "bq_peaking", "bq_highshelf", "bq_lowpass",
+		"linear" } },
+	{ "crossover+mix", 2, 6, {
+		"bq_highpass", "bq_highpass", "bq_lowpass", "bq_lowpass", "mixer", "copy" } },
+	{ "convolver 16ch", 16, 2, { "convolver", "bq_highshelf" } },
+};
+
+static struct spa_handle *load_handle(const char *lib, const char *name,
+		const struct spa_dict *info)
+{
+	const char *dir;
+	char path[PATH_MAX];
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	uint32_t i = 0;
+	int res;
+
+	if ((dir = getenv("SPA_PLUGIN_DIR")) == NULL)
+		dir = PLUGINDIR;
+	snprintf(path, sizeof(path), "%s/%s.so", dir, lib);
+
+	if ((hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		fprintf(stderr, "can't load %s: %s\n", path, dlerror());
+		errno = ENOENT;
+		return NULL;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		errno = ENXIO;
+		return NULL;
+	}
+	while ((res = enum_func(&factory, &i)) > 0) {
+		if (spa_streq(factory->name, name))
+			break;
+	}
+	if (res <= 0) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	handle = calloc(1, spa_handle_factory_get_size(factory, info));
+	if ((res = spa_handle_factory_init(factory, handle, info, support, n_support)) < 0) {
+		fprintf(stderr, "can't make %s: %s\n", name, spa_strerror(res));
+		free(handle);
+		errno = -res;
+		return NULL;
+	}
+	return handle;
+}
+
+static struct spa_handle *loader_load(void *object, const char *factory_name,
+		const struct spa_dict *info)
+{
+	const char *lib = info ? spa_dict_lookup(info, SPA_KEY_LIBRARY_NAME) : NULL;
+	return lib ? load_handle(lib, factory_name, info) : NULL;
+}
+
+static int loader_unload(void *object, struct spa_handle *handle)
+{
+	spa_handle_clear(handle);
+	free(handle);
+	return 0;
+}
+
+static const struct spa_plugin_loader_methods loader_methods = {
+	SPA_VERSION_PLUGIN_LOADER_METHODS,
+	.load = loader_load,
+	.unload = loader_unload,
+};
+
+static struct spa_plugin_loader loader;
+
+static void make_graph(char *json, size_t size, const struct preset *p)
+{
+	struct spa_strbuf b;
+	uint32_t i;
+
+	spa_strbuf_init(&b, json, size);
+	spa_strbuf_append(&b, "{ nodes = [ ");
+	for (i = 0; i < p->n_stages; i++) {
+		const char *l = p->labels[i];
+
+		spa_strbuf_append(&b, "{ type = builtin name = n%u label = %s ", i, l);
+		if (spa_strstartswith(l, "bq_"))
+			spa_strbuf_append(&b, "control = { \"Freq\" = %f \"Q\" = 0.7 \"Gain\" = %f } ",
+					40.0f * powf(1.4f, i), (i & 1) ? 3.0f : -2.0f);
+		else if (spa_streq(l, "linear"))
+			spa_strbuf_append(&b, "control = { \"Mult\" = 0.8 } ");
+		else if (spa_streq(l, "convolver"))
+			spa_strbuf_append(&b, "config = { filename = \"/hilbert\" length = 16384 } ");
+		spa_strbuf_append(&b, "} ");
+	}
+	spa_strbuf_append(&b, "] links = [ ");
+	for (i = 0; i + 1 < p->n_stages; i++)
+		spa_strbuf_append(&b, "{ output = \"n%u:Out\" input = \"n%u:%s\" } ", i, i + 1,
+				spa_streq(p->labels[i + 1], "mixer") ? "In 1" : "In");
+	spa_strbuf_append(&b, "] }");
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+struct mode {
+	const char *name;
+	bool fuse;
+	bool lanes;
+	uint32_t n_threads;
+};
+
+static const struct mode modes[] = {
+	{ "unfused", false, false, 1 },
+	{ "fused", true, false, 1 },
+	{ "lanes", true, true, 1 },
+	{ "threads", true, true, 4 },
+};
+
+static int run_graph(const struct preset *p, const struct mode *m, float *in[], float *out[],
+		uint64_t *nsec)
+{
+	struct spa_handle *handle;
+	struct spa_filter_graph *graph;
+	char json[16384], channels[16], threads[16];
+	uint64_t t1, t2;
+	uint32_t i;
+	void *iface;
+	int res;
+
+	make_graph(json, sizeof(json), p);
+	snprintf(channels, sizeof(channels), "%u", p->n_channels);
+	snprintf(threads, sizeof(threads), "%u", m->n_threads);
+
+	handle = load_handle("filter-graph/libspa-filter-graph", "filter.graph",
+			&SPA_DICT_ITEMS(
+				SPA_DICT_ITEM("clock.quantum-limit", SPA_STRINGIFY(MAX_SAMPLES)),
+				SPA_DICT_ITEM("filter-graph.n_inputs", channels),
+				SPA_DICT_ITEM("filter-graph.n_outputs", channels),
+				SPA_DICT_ITEM("filter-graph.fuse", m->fuse ? "true" : "false"),
+				SPA_DICT_ITEM("filter-graph.lanes", m->lanes ? "true" : "false"),
+				SPA_DICT_ITEM("filter-graph.threads", threads),
+				SPA_DICT_ITEM("filter.graph", json)));
+	if (handle == NULL)
+		return -errno;
+
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_FilterGraph, &iface)) < 0)
+		goto exit;
+	graph = iface;
+
+	if ((res = spa_filter_graph_activate(graph,
+			&SPA_DICT_ITEMS(SPA_DICT_ITEM(SPA_KEY_AUDIO_RATE, "48000")))) < 0)
+		goto exit;
+
+	t1 = get_time_ns();
+	for (i = 0; i < MAX_COUNT; i++)
+		spa_filter_graph_process(graph, (const void **)in, (void **)out, N_SAMPLES);
+	t2 = get_time_ns();
+	*nsec = t2 - t1;
+
+	spa_filter_graph_deactivate(graph);
+exit:
+	spa_handle_clear(handle);
+	free(handle);
+	return res;
+}
+
+static void test_preset(const struct preset *p)
+{
+	float *in[MAX_CHANNELS], *out[SPA_N_ELEMENTS(modes)][MAX_CHANNELS];
+	uint64_t nsec[SPA_N_ELEMENTS(modes)];
+	uint32_t i, j, m;
+	int res;
+
+	for (i = 0; i < p->n_channels; i++) {
+		in[i] = calloc(N_SAMPLES, sizeof(float));
+		for (m = 0; m < SPA_N_ELEMENTS(modes); m++)
+			out[m][i] = calloc(N_SAMPLES, sizeof(float));
+		for (j = 0; j < N_SAMPLES; j++)
+			in[i][j] = 0.5f * sinf(j * 0.05f * (i + 1)) + 0.1f * (float)(drand48() - 0.5);
+	}
+
+	for (m = 0; m < SPA_N_ELEMENTS(modes); m++) {
+		float max_diff = 0.0f;
+
+		if ((res = run_graph(p, &modes[m], in, out[m], &nsec[m])) < 0) {
+			fprintf(stderr, "%s: can't run graph: %s\n", p->name, spa_strerror(res));
+			break;
+		}
+		for (i = 0; i < p->n_channels; i++)
+			for (j = 0; j < N_SAMPLES; j++)
+				max_diff = fmaxf(max_diff, fabsf(out[0][i][j] - out[m][i][j]));
+
+		fprintf(stderr, "%-12."PRIu64" \t%-16s %-8s\t%u channels %u stages speedup %.2f diff %g\n",
+				nsec[m] / MAX_COUNT, p->name, modes[m].name, p->n_channels,
+				p->n_stages, (double)nsec[0] / nsec[m], max_diff);
+	}
+
+	for (i = 0; i < p->n_channels; i++) {
+		free(in[i]);
+		for (m = 0; m < SPA_N_ELEMENTS(modes); m++)
+			free(out[m][i]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_handle *cpu;
+	void *iface;
+	uint32_t i;
+
+	logger.log.level = SPA_LOG_LEVEL_WARN;
+	loader.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_PluginLoader,
+			SPA_VERSION_PLUGIN_LOADER, &loader_methods, NULL);
+
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Log, &logger);
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_PluginLoader, &loader);
+
+	if ((cpu = load_handle("support/libspa-support", SPA_NAME_SUPPORT_CPU, NULL)) != NULL &&
+	    spa_handle_get_interface(cpu, SPA_TYPE_INTERFACE_CPU, &iface) >= 0)
+		support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_CPU, iface);
+
+	fprintf(stderr, "nsec/cycle, %d samples\n", N_SAMPLES);
+
+	for (i = 0; i < SPA_N_ELEMENTS(presets); i++)
+		test_preset(&presets[i]);
+
+	if (cpu != NULL) {
+		spa_handle_clear(cpu);
+		free(cpu);
+	}
+	return 0;
+}
@@ -0,0 +1,249 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <dlfcn.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/plugin-loader.h>
+#include <spa/support/log-impl.h>
+#include <spa/support/cpu.h>
+#include <spa/utils/dict.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+#include <spa/param/audio/raw.h>
+#include <spa/filter-graph/filter-graph.h>
+
+#define MAX_SAMPLES	8192
+#define N_SAMPLES	1024
+#define N_GRAPHS	30
+#define SIGNAL_COUNT	50
+#define DECAY_COUNT	100
+#define SILENCE_COUNT	500
+
+/*
+ * Runs N_GRAPHS graphs, like the filters on the streams of a desktop, on a
+ * signal and then on silence. After the decay cycles, a graph with a
+ * silence-timeout no longer runs its nodes. The silence is measured with
+ * and without a silence-timeout.
+ */
+static SPA_LOG_IMPL(logger);
+
+static struct spa_support support[4];
+static uint32_t n_support;
+
+static const char graph_json[] =
+	"{ nodes = [ "
+	"  { type = builtin name = eq label = param_eq "
+	"    config = { filters = [ { type = bq_lowshelf freq = 100 q = 0.7 gain = 3.0 } "
+	"      { type = bq_peaking freq = 1000 q = 1.0 gain = -3.0 } "
+	"      { type = bq_highshelf freq = 8000 q = 0.7 gain = 2.0 } ] } } "
+	"  { type = builtin name = conv label = convolver "
+	"    config = { filename = \"/hilbert\" length = 512 } } "
+	"  { type = builtin name = delay label = delay "
+	"    config = { \"max-delay\" = 1.0 } control = { \"Delay (s)\" = 0.01 } } ] "
+	"  links = [ { output = \"eq:Out 1\" input = \"conv:In\" } "
+	"    { output = \"conv:Out\" input = \"delay:In\" } ] "
+	"  inputs = [ \"eq:In 1\" ] outputs = [ \"delay:Out\" ] }";
+
+static struct spa_handle *load_handle(const char *lib, const char *name,
+		const struct spa_dict *info)
+{
+	const char *dir;
+	char path[PATH_MAX];
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	uint32_t i = 0;
+	int res;
+
+	if ((dir = getenv("SPA_PLUGIN_DIR")) == NULL)
+		dir = PLUGINDIR;
+	snprintf(path, sizeof(path), "%s/%s.so", dir, lib);
+
+	if ((hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		fprintf(stderr, "can't load %s: %s\n", path, dlerror());
+		errno = ENOENT;
+		return NULL;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		errno = ENXIO;
+		return NULL;
+	}
+	while ((res = enum_func(&factory, &i)) > 0) {
+		if (spa_streq(factory->name, name))
+			break;
+	}
+	if (res <= 0) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	handle = calloc(1, spa_handle_factory_get_size(factory, info));
+	if ((res = spa_handle_factory_init(factory, handle, info, support, n_support)) < 0) {
+		fprintf(stderr, "can't make %s: %s\n", name, spa_strerror(res));
+		free(handle);
+		errno = -res;
+		return NULL;
+	}
+	return handle;
+}
+
+static struct spa_handle *loader_load(void *object, const char *factory_name,
+		const struct spa_dict *info)
+{
+	const char *lib = info ? spa_dict_lookup(info, SPA_KEY_LIBRARY_NAME) : NULL;
+	return lib ? load_handle(lib, factory_name, info) : NULL;
+}
+
+static int loader_unload(void *object, struct spa_handle *handle)
+{
+	spa_handle_clear(handle);
+	free(handle);
+	return 0;
+}
+
+static const struct spa_plugin_loader_methods loader_methods = {
+	SPA_VERSION_PLUGIN_LOADER_METHODS,
+	.load = loader_load,
+	.unload = loader_unload,
+};
+
+static struct spa_plugin_loader loader;
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void process(struct spa_filter_graph *graph[], float *in, float *out, uint32_t count)
+{
+	const void *ins[1] = { in };
+	void *outs[1] = { out };
+	uint32_t i, j;
+
+	for (i = 0; i < count; i++)
+		for (j = 0; j < N_GRAPHS; j++)
+			spa_filter_graph_process(graph[j], ins, outs, N_SAMPLES);
+}
+
+static int run_graphs(const char *timeout, float *in, float *out, uint64_t nsec[2])
+{
+	struct spa_handle *handle[N_GRAPHS];
+	struct spa_filter_graph *graph[N_GRAPHS];
+	uint64_t t1, t2;
+	uint32_t i, n_handle = 0;
+	void *iface;
+	int res = 0;
+
+	for (i = 0; i < N_GRAPHS; i++) {
+		handle[i] = load_handle("filter-graph/libspa-filter-graph", "filter.graph",
+				&SPA_DICT_ITEMS(
+					SPA_DICT_ITEM("clock.quantum-limit", SPA_STRINGIFY(MAX_SAMPLES)),
+					SPA_DICT_ITEM("filter-graph.silence-timeout", timeout),
+					SPA_DICT_ITEM("filter.graph", graph_json)));
+		if (handle[i] == NULL) {
+			res = -errno;
+			goto exit;
+		}
+		n_handle++;
+
+		if ((res = spa_handle_get_interface(handle[i], SPA_TYPE_INTERFACE_FilterGraph, &iface)) < 0)
+			goto exit;
+		graph[i] = iface;
+
+		if ((res = spa_filter_graph_activate(graph[i],
+				&SPA_DICT_ITEMS(SPA_DICT_ITEM(SPA_KEY_AUDIO_RATE, "48000")))) < 0)
+			goto exit;
+	}
+
+	for (i = 0; i < N_SAMPLES; i++)
+		in[i] = 0.5f * sinf(i * 0.05f) + 0.1f * (float)(drand48() - 0.5);
+	t1 = get_time_ns();
+	process(graph, in, out, SIGNAL_COUNT);
+	t2 = get_time_ns();
+	nsec[0] = (t2 - t1) / SIGNAL_COUNT;
+
+	memset(in, 0, N_SAMPLES * sizeof(float));
+	process(graph, in, out, DECAY_COUNT);
+
+	t1 = get_time_ns();
+	process(graph, in, out, SILENCE_COUNT);
+	t2 = get_time_ns();
+	nsec[1] = (t2 - t1) / SILENCE_COUNT;
+
+	for (i = 0; i < N_SAMPLES; i++) {
+		if (out[i] != 0.0f) {
+			fprintf(stderr, "output not silent: %g\n", out[i]);
+			res = -EIO;
+			break;
+		}
+	}
+
+	for (i = 0; i < N_GRAPHS; i++)
+		spa_filter_graph_deactivate(graph[i]);
+exit:
+	for (i = 0; i < n_handle; i++) {
+		spa_handle_clear(handle[i]);
+		free(handle[i]);
+	}
+	return res;
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_handle *cpu;
+	float *in, *out;
+	uint64_t nsec[2][2];
+	void *iface;
+	int res;
+
+	logger.log.level = SPA_LOG_LEVEL_WARN;
+	loader.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_PluginLoader,
+			SPA_VERSION_PLUGIN_LOADER, &loader_methods, NULL);
+
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Log, &logger);
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_PluginLoader, &loader);
+
+	if ((cpu = load_handle("support/libspa-support", SPA_NAME_SUPPORT_CPU, NULL)) == NULL ||
+	    spa_handle_get_interface(cpu, SPA_TYPE_INTERFACE_CPU, &iface) < 0) {
+		fprintf(stderr, "can't load the cpu interface\n");
+		return -1;
+	}
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_CPU, iface);
+	spa_cpu_zero_denormals(iface, true);
+
+	in = calloc(N_SAMPLES, sizeof(float));
+	out = calloc(N_SAMPLES, sizeof(float));
+
+	if ((res = run_graphs("0", in, out, nsec[0])) < 0 ||
+	    (res = run_graphs("1000", in, out, nsec[1])) < 0) {
+		fprintf(stderr, "can't run graphs: %s\n", spa_strerror(res));
+	} else {
+		fprintf(stderr, "nsec/cycle, %d graphs, %d samples\n", N_GRAPHS, N_SAMPLES);
+		fprintf(stderr, "%-10s %-10s %-10s\n", "timeout", "signal", "silence");
+		fprintf(stderr, "%-10s %-10"PRIu64" %-10"PRIu64"\n", "0", nsec[0][0], nsec[0][1]);
+		fprintf(stderr, "%-10s %-10"PRIu64" %-10"PRIu64"\n", "1000", nsec[1][0], nsec[1][1]);
+		fprintf(stderr, "silence %.2f\n", (double)nsec[0][1] / nsec[1][1]);
+	}
+	free(in);
+	free(out);
+
+	spa_cpu_zero_denormals(iface, false);
+	spa_handle_clear(cpu);
+	free(cpu);
+	return res < 0 ? -1 : 0;
+}
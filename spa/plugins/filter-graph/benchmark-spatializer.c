@@ -0,0 +1,220 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/support/cpu.h>
+
+#include "test-helper.h"
+#include "audio-dsp-impl.h"
+#include "convolver.h"
+#include "hrtf.h"
+
+#define N_SAMPLES	1024
+#define MAX_COUNT	100
+#define MAX_SOURCES	32
+#define N_DIRS		64
+#define IR_LEN		256
+#define BLOCK_SIZE	256
+#define TAIL_SIZE	4096
+#define MOVE_EVERY	4
+#define N_WEIGHTS	3
+
+/*
+ * Renders N mono sources to stereo, once with a pair of convolvers per
+ * source like the spatializer and once with the batched hrtf renderer.
+ * The sources are static or move every MOVE_EVERY cycles, in which case
+ * the convolvers are recreated and crossfaded.
+ */
+static float table_ir[N_DIRS * 2 * IR_LEN];
+static float in[MAX_SOURCES][N_SAMPLES * MAX_COUNT];
+static float out[2][2][N_SAMPLES * MAX_COUNT];
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void source_position(int source, int cycle, int dirs[N_WEIGHTS], float weights[N_WEIGHTS])
+{
+	int i, d = (source * 7 + cycle / MOVE_EVERY) % N_DIRS;
+	for (i = 0; i < N_WEIGHTS; i++) {
+		dirs[i] = (d + i) % N_DIRS;
+		weights[i] = 1.0f / (i + 1 + (cycle / MOVE_EVERY) % 3);
+	}
+}
+
+static void interpolate(int ear, const int dirs[N_WEIGHTS], const float weights[N_WEIGHTS], float *ir)
+{
+	int i, j;
+	memset(ir, 0, IR_LEN * sizeof(float));
+	for (i = 0; i < N_WEIGHTS; i++)
+		for (j = 0; j < IR_LEN; j++)
+			ir[j] += weights[i] * table_ir[(dirs[i] * 2 + ear) * IR_LEN + j];
+}
+
+static struct convolver *make_convolver(struct spa_fga_dsp *dsp, int source, int cycle, int ear)
+{
+	int dirs[N_WEIGHTS];
+	float weights[N_WEIGHTS], ir[IR_LEN];
+
+	source_position(source, cycle, dirs, weights);
+	interpolate(ear, dirs, weights, ir);
+	return convolver_new(dsp, BLOCK_SIZE, TAIL_SIZE, ir, IR_LEN);
+}
+
+static uint64_t run_convolvers(struct spa_fga_dsp *dsp, int n_sources, bool move, float *o[2])
+{
+	struct convolver *conv[MAX_SOURCES][2], *next[MAX_SOURCES][2];
+	float tmp[2][N_SAMPLES], prev[N_SAMPLES];
+	uint64_t t1, t2;
+	int i, j, e, k;
+
+	for (i = 0; i < n_sources; i++)
+		for (e = 0; e < 2; e++)
+			conv[i][e] = make_convolver(dsp, i, 0, e);
+
+	t1 = get_time_ns();
+	for (j = 0; j < MAX_COUNT; j++) {
+		bool switching = move && j > 0 && j % MOVE_EVERY == 0;
+
+		for (e = 0; e < 2; e++)
+			memset(&o[e][j * N_SAMPLES], 0, N_SAMPLES * sizeof(float));
+
+		for (i = 0; i < n_sources; i++) {
+			const float *src = &in[i][j * N_SAMPLES];
+
+			for (e = 0; e < 2; e++) {
+				float *dst = &o[e][j * N_SAMPLES];
+
+				convolver_run(conv[i][e], src, tmp[e], N_SAMPLES);
+				if (switching) {
+					next[i][e] = make_convolver(dsp, i, j, e);
+					convolver_run(next[i][e], src, prev, N_SAMPLES);
+					for (k = 0; k < N_SAMPLES; k++) {
+						float t = (float)k / N_SAMPLES;
+						tmp[e][k] = tmp[e][k] * (1.0f - t) + prev[k] * t;
+					}
+					convolver_free(conv[i][e]);
+					conv[i][e] = next[i][e];
+				}
+				for (k = 0; k < N_SAMPLES; k++)
+					dst[k] += tmp[e][k];
+			}
+		}
+	}
+	t2 = get_time_ns();
+
+	for (i = 0; i < n_sources; i++)
+		for (e = 0; e < 2; e++)
+			convolver_free(conv[i][e]);
+
+	return t2 - t1;
+}
+
+static uint64_t run_renderer(struct spa_fga_dsp *dsp, struct hrtf_table *table,
+		int n_sources, bool move, float *o[2])
+{
+	struct hrtf_renderer *r;
+	const float *src[MAX_SOURCES];
+	int dirs[N_WEIGHTS];
+	float weights[N_WEIGHTS], *dst[2];
+	uint64_t t1, t2;
+	int i, j;
+
+	r = hrtf_renderer_new(dsp, table, n_sources);
+	spa_assert_se(r != NULL);
+
+	for (i = 0; i < n_sources; i++) {
+		source_position(i, 0, dirs, weights);
+		hrtf_renderer_prepare(r, i, dirs, weights, N_WEIGHTS);
+		hrtf_renderer_commit(r, i);
+	}
+
+	t1 = get_time_ns();
+	for (j = 0; j < MAX_COUNT; j++) {
+		if (move && j > 0 && j % MOVE_EVERY == 0) {
+			for (i = 0; i < n_sources; i++) {
+				source_position(i, j, dirs, weights);
+				hrtf_renderer_prepare(r, i, dirs, weights, N_WEIGHTS);
+				hrtf_renderer_commit(r, i);
+			}
+		}
+		for (i = 0; i < n_sources; i++)
+			src[i] = &in[i][j * N_SAMPLES];
+		dst[0] = &o[0][j * N_SAMPLES];
+		dst[1] = &o[1][j * N_SAMPLES];
+		hrtf_renderer_run(r, src, dst, N_SAMPLES);
+	}
+	t2 = get_time_ns();
+
+	hrtf_renderer_free(r);
+	return t2 - t1;
+}
+
+static void run_test(struct spa_fga_dsp *dsp, struct hrtf_table *table, int n_sources, bool move)
+{
+	float *o[2][2] = { { out[0][0], out[0][1] }, { out[1][0], out[1][1] } };
+	uint64_t t_conv, t_hrtf;
+	float max_diff = 0.0f;
+	int i;
+
+	t_conv = run_convolvers(dsp, n_sources, move, o[0]);
+	t_hrtf = run_renderer(dsp, table, n_sources, move, o[1]);
+
+	/* the fades only match when the sources are static */
+	for (i = 0; i < N_SAMPLES * MAX_COUNT; i++)
+		max_diff = fmaxf(max_diff, fmaxf(fabsf(out[0][0][i] - out[1][0][i]),
+					fabsf(out[0][1][i] - out[1][1][i])));
+
+	fprintf(stderr, "%-12."PRIu64" \tconvolver %-6s\t%d sources\n",
+			t_conv / MAX_COUNT, move ? "moving" : "static", n_sources);
+	fprintf(stderr, "%-12."PRIu64" \thrtf      %-6s\t%d sources speedup %.2f diff %g\n",
+			t_hrtf / MAX_COUNT, move ? "moving" : "static", n_sources,
+			(double)t_conv / t_hrtf, max_diff);
+}
+
+int main(int argc, char *argv[])
+{
+	static const int n_sources[] = { 1, 2, 4, 8, 16, 32 };
+	struct spa_fga_dsp *dsp;
+	struct hrtf_table *table;
+	uint32_t cpu_flags;
+	int i, j;
+
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	for (i = 0; i < MAX_SOURCES; i++)
+		for (j = 0; j < N_SAMPLES * MAX_COUNT; j++)
+			in[i][j] = 0.5f * sinf(j * 0.01f * (i + 1)) + 0.1f * (float)(drand48() - 0.5);
+	for (i = 0; i < N_DIRS * 2; i++)
+		for (j = 0; j < IR_LEN; j++)
+			table_ir[i * IR_LEN + j] = (float)(drand48() - 0.5) * expf(-8.0f * j / IR_LEN);
+
+	dsp = spa_fga_dsp_new(cpu_flags);
+	spa_assert_se(dsp != NULL);
+	table = hrtf_table_new(dsp, BLOCK_SIZE, table_ir, N_DIRS, IR_LEN);
+	spa_assert_se(table != NULL);
+
+	fprintf(stderr, "nsec/cycle, %d samples, %d taps\n", N_SAMPLES, IR_LEN);
+
+	for (i = 0; i < (int)SPA_N_ELEMENTS(n_sources); i++) {
+		run_test(dsp, table, n_sources[i], false);
+		run_test(dsp, table, n_sources[i], true);
+	}
+
+	hrtf_table_free(table);
+	spa_fga_dsp_free(dsp);
+	return 0;
+}
@@ -11,8 +11,12 @@
 #endif
 #include <unistd.h>
 #include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include <spa/utils/json.h>
+#include <spa/utils/list.h>
+#include <spa/utils/string.h>
 #include <spa/utils/result.h>
 #include <spa/support/cpu.h>
 #include <spa/support/log.h>
@@ -51,6 +55,7 @@ struct builtin {
 	float gain;
 	float b0, b1, b2;
 	float a0, a1, a2;
+	bool reset;		/* controls were set with set_props */
 	float accum;
 };
 
@@ -290,10 +295,9 @@ static const char *bq_name_from_type(int type)
 	return "unknown";
 }
 
-static void bq_raw_update(struct builtin *impl, float b0, float b1, float b2,
-		float a0, float a1, float a2)
+static void bq_raw_update(struct builtin *impl, struct biquad *bq,
+		float b0, float b1, float b2, float a0, float a1, float a2)
 {
-	struct biquad *bq = &impl->bq;
 	impl->b0 = b0;
 	impl->b1 = b1;
 	impl->b2 = b2;
@@ -416,7 +420,7 @@ static void *bq_instantiate(const struct spa_fga_plugin *plugin, const struct sp
 				if (labs((long)rate - (long)SampleRate) <
 				    labs((long)best_rate - (long)SampleRate)) {
 					best_rate = rate;
-					bq_raw_update(impl, b0, b1, b2, a0, a1, a2);
+					bq_raw_update(impl, &impl->bq, b0, b1, b2, a0, a1, a2);
 				}
 			}
 		}
@@ -491,9 +495,9 @@ static struct spa_fga_port bq_ports[] = {
 
 };
 
-static void bq_freq_update(struct builtin *impl, int type, float freq, float Q, float gain)
+static void bq_freq_update(struct builtin *impl, struct biquad *bq,
+		int type, float freq, float Q, float gain)
 {
-	struct biquad *bq = &impl->bq;
 	impl->freq = freq;
 	impl->Q = Q;
 	impl->gain = gain;
@@ -520,17 +524,14 @@ static void bq_activate(void * Instance)
 		float freq = impl->port[2][0];
 		float Q = impl->port[3][0];
 		float gain = impl->port[4][0];
-		bq_freq_update(impl, impl->type, freq, Q, gain);
+		bq_freq_update(impl, &impl->bq, impl->type, freq, Q, gain);
 	}
 }
 
-static void bq_run(void *Instance, unsigned long samples)
+/* When the controls changed, the new coefficients are placed in bq and
+ * true is returned. */
+static bool bq_update(struct builtin *impl, struct biquad *bq)
 {
-	struct builtin *impl = Instance;
-	struct biquad *bq = &impl->bq;
-	float *out = impl->port[0];
-	float *in = impl->port[1];
-
 	if (impl->type == BQ_NONE) {
 		float b0, b1, b2, a0, a1, a2;
 		b0 = impl->port[5][0];
@@ -541,16 +542,96 @@ static void bq_run(void *Instance, unsigned long samples)
 		a2 = impl->port[10][0];
 		if (impl->b0 != b0 || impl->b1 != b1 || impl->b2 != b2 ||
 		    impl->a0 != a0 || impl->a1 != a1 || impl->a2 != a2) {
-			bq_raw_update(impl, b0, b1, b2, a0, a1, a2);
+			bq_raw_update(impl, bq, b0, b1, b2, a0, a1, a2);
+			return true;
 		}
 	} else {
 		float freq = impl->port[2][0];
 		float Q = impl->port[3][0];
 		float gain = impl->port[4][0];
-		if (impl->freq != freq || impl->Q != Q || impl->gain != gain)
-			bq_freq_update(impl, impl->type, freq, Q, gain);
+		if (impl->freq != freq || impl->Q != Q || impl->gain != gain) {
+			bq_freq_update(impl, bq, impl->type, freq, Q, gain);
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Controls from set_props, like a new preset, recompute the filter and
+ * reset its state as before. Only the controls that are queued with
+ * set_control, which don't call control_changed, are ramped. */
+static void bq_control_changed(void * Instance)
+{
+	struct builtin *impl = Instance;
+	impl->reset = true;
+}
+
+static void bq_reset(struct builtin *impl)
+{
+	if (impl->reset) {
+		impl->reset = false;
+		bq_update(impl, &impl->bq);
+	}
+}
+
+/* New coefficients are interpolated from the old ones over the samples of
+ * the run and the filter state is kept so that automation does not click.
+ * Both sets of coefficients are stable and so is every linear interpolation
+ * of them, the stable a1, a2 pairs form a triangle. */
+static void bq_run(void *Instance, unsigned long samples)
+{
+	struct builtin *impl = Instance;
+	float *out = impl->port[0];
+	float *in = impl->port[1];
+	struct biquad target;
+
+	bq_reset(impl);
+	if (bq_update(impl, &target))
+		spa_fga_dsp_biquad_ramp(impl->dsp, &impl->bq, &target,
+				&out, (const float **)&in, 1, samples);
+	else
+		spa_fga_dsp_biquad_run(impl->dsp, &impl->bq, 1, 0,
+				&out, (const float **)&in, 1, samples);
+}
+
+#define BQ_MAX_MULTI	16u
+
+/* The filters of the instances are copied next to each other so that the
+ * dsp functions can run them with one channel in each SIMD lane. */
+static void bq_run_multi(void **Instances, uint32_t n_instances, unsigned long samples)
+{
+	struct builtin *impl;
+	struct biquad bq[BQ_MAX_MULTI], target[BQ_MAX_MULTI];
+	float *out[BQ_MAX_MULTI];
+	const float *in[BQ_MAX_MULTI];
+	uint32_t i, j, n;
+	bool ramp;
+
+	for (i = 0; i < n_instances; i += n) {
+		n = SPA_MIN(n_instances - i, BQ_MAX_MULTI);
+		ramp = false;
+		for (j = 0; j < n; j++) {
+			impl = Instances[i + j];
+			bq_reset(impl);
+			bq[j] = impl->bq;
+			if (bq_update(impl, &target[j]))
+				ramp = true;
+			else
+				target[j] = bq[j];
+			out[j] = impl->port[0];
+			in[j] = impl->port[1];
+		}
+		impl = Instances[i];
+		if (ramp)
+			spa_fga_dsp_biquad_ramp(impl->dsp, bq, target, out, in, n, samples);
+		else
+			spa_fga_dsp_biquad_run(impl->dsp, bq, 1, 1, out, in, n, samples);
+
+		for (j = 0; j < n; j++) {
+			impl = Instances[i + j];
+			impl->bq = bq[j];
+		}
 	}
-	spa_fga_dsp_biquad_run(impl->dsp, bq, 1, 0, &out, (const float **)&in, 1, samples);
 }
 
 /** bq_lowpass */
@@ -563,7 +644,9 @@ static const struct spa_fga_descriptor bq_lowpass_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
+	.run_multi = bq_run_multi,
 	.cleanup = builtin_cleanup,
 };
 
@@ -577,7 +660,9 @@ static const struct spa_fga_descriptor bq_highpass_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
+	.run_multi = bq_run_multi,
 	.cleanup = builtin_cleanup,
 };
 
@@ -591,7 +676,9 @@ static const struct spa_fga_descriptor bq_bandpass_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
+	.run_multi = bq_run_multi,
 	.cleanup = builtin_cleanup,
 };
 
@@ -605,7 +692,9 @@ static const struct spa_fga_descriptor bq_lowshelf_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
+	.run_multi = bq_run_multi,
 	.cleanup = builtin_cleanup,
 };
 
@@ -619,7 +708,9 @@ static const struct spa_fga_descriptor bq_highshelf_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
+	.run_multi = bq_run_multi,
 	.cleanup = builtin_cleanup,
 };
 
@@ -633,7 +724,9 @@ static const struct spa_fga_descriptor bq_peaking_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
+	.run_multi = bq_run_multi,
 	.cleanup = builtin_cleanup,
 };
 
@@ -647,7 +740,9 @@ static const struct spa_fga_descriptor bq_notch_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
+	.run_multi = bq_run_multi,
 	.cleanup = builtin_cleanup,
 };
 
@@ -662,7 +757,9 @@ static const struct spa_fga_descriptor bq_allpass_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
+	.run_multi = bq_run_multi,
 	.cleanup = builtin_cleanup,
 };
 
@@ -676,7 +773,9 @@ static const struct spa_fga_descriptor bq_raw_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
+	.run_multi = bq_run_multi,
 	.cleanup = builtin_cleanup,
 };
 
@@ -691,8 +790,89 @@ struct convolver_impl {
 	float latency;
 
 	struct convolver *conv;
+	struct ir_entry *ir;
+};
+
+/* The transformed impulse responses, shared by all convolvers in the process
+ * that load the same file with the same config and fft implementation. */
+struct ir_entry {
+	struct spa_list link;
+	int ref;
+	char *key;
+	uint32_t cpu_flags;
+	int n_samples;
+	struct convolver_ir *ir;
 };
 
+static struct spa_list ir_entries = SPA_LIST_INIT(&ir_entries);
+static pthread_mutex_t ir_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char *make_ir_key(char **filenames, int channel, float gain, float delay, int offset,
+		int length, unsigned long rate, int quality, int blocksize, int tailsize)
+{
+	struct spa_strbuf b;
+	struct stat st;
+	size_t size = 256;
+	uint32_t i;
+	char *key;
+
+	for (i = 0; i < MAX_RATES && filenames[i]; i++)
+		size += strlen(filenames[i]) + 64;
+	if ((key = malloc(size)) == NULL)
+		return NULL;
+
+	spa_strbuf_init(&b, key, size);
+	for (i = 0; i < MAX_RATES && filenames[i]; i++) {
+		/* a changed file is a different impulse response */
+		if (stat(filenames[i], &st) < 0)
+			spa_zero(st);
+		spa_strbuf_append(&b, "%s:%"PRIi64":%"PRIi64":%ld|", filenames[i],
+				(int64_t)st.st_size, (int64_t)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+	}
+	spa_strbuf_append(&b, "%d:%.9g:%.9g:%d:%d:%lu:%d:%d:%d", channel, gain, delay,
+			offset, length, rate, quality, blocksize, tailsize);
+	return key;
+}
+
+static struct ir_entry *find_ir_entry(const char *key, uint32_t cpu_flags)
+{
+	struct ir_entry *e, *res = NULL;
+
+	pthread_mutex_lock(&ir_lock);
+	spa_list_for_each(e, &ir_entries, link) {
+		if (e->cpu_flags == cpu_flags && spa_streq(e->key, key)) {
+			e->ref++;
+			res = e;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&ir_lock);
+	return res;
+}
+
+static void add_ir_entry(struct ir_entry *e)
+{
+	pthread_mutex_lock(&ir_lock);
+	spa_list_append(&ir_entries, &e->link);
+	pthread_mutex_unlock(&ir_lock);
+}
+
+static void unref_ir_entry(struct ir_entry *e)
+{
+	bool free_entry;
+
+	pthread_mutex_lock(&ir_lock);
+	if ((free_entry = --e->ref == 0))
+		spa_list_remove(&e->link);
+	pthread_mutex_unlock(&ir_lock);
+
+	if (!free_entry)
+		return;
+	convolver_ir_free(e->ir);
+	free(e->key);
+	free(e);
+}
+
 #ifdef HAVE_SNDFILE
 static float *read_samples_from_sf(SNDFILE *f, const SF_INFO *info, float gain, int delay,
 		int offset, int length, int channel, long unsigned *rate, int *n_samples) {
@@ -918,7 +1098,9 @@ static void * convolver_instantiate(const struct spa_fga_plugin *plugin, const s
 {
 	struct plugin *pl = SPA_CONTAINER_OF(plugin, struct plugin, plugin);
 	struct convolver_impl *impl;
-	float *samples;
+	struct ir_entry *ir = NULL;
+	float *samples = NULL;
+	char *ir_key;
 	int offset = 0, length = 0, channel = index, n_samples = 0, len;
 	uint32_t i = 0;
 	struct spa_json it[2];
@@ -1029,7 +1211,16 @@ static void * convolver_instantiate(const struct spa_fga_plugin *plugin, const s
 	if (offset < 0)
 		offset = 0;
 
-	if (spa_streq(filenames[0], "/hilbert")) {
+	/* the generated responses are the same for all channels */
+	if (spa_streq(filenames[0], "/hilbert") || spa_streq(filenames[0], "/dirac"))
+		channel = 0;
+
+	ir_key = make_ir_key(filenames, channel, gain, delay, offset, length, SampleRate,
+			resample_quality, blocksize, tailsize);
+	if (ir_key != NULL && (ir = find_ir_entry(ir_key, pl->dsp->cpu_flags)) != NULL) {
+		spa_log_info(pl->log, "using shared impulse response %s", ir_key);
+		n_samples = ir->n_samples;
+	} else if (spa_streq(filenames[0], "/hilbert")) {
 		samples = create_hilbert(pl, filenames[0], gain, SampleRate, delay, offset,
 				length, &n_samples);
 	} else if (spa_streq(filenames[0], "/dirac")) {
@@ -1049,7 +1240,8 @@ static void * convolver_instantiate(const struct spa_fga_plugin *plugin, const s
 		if (filenames[i])
 			free(filenames[i]);
 
-	if (samples == NULL) {
+	if (samples == NULL && ir == NULL) {
+		free(ir_key);
 		errno = ENOENT;
 		return NULL;
 	}
@@ -1071,7 +1263,28 @@ static void * convolver_instantiate(const struct spa_fga_plugin *plugin, const s
 	impl->dsp = pl->dsp;
 	impl->rate = SampleRate;
 
-	impl->conv = convolver_new(impl->dsp, blocksize, tailsize, samples, n_samples);
+	if (ir == NULL) {
+		if ((ir = calloc(1, sizeof(*ir))) == NULL)
+			goto error;
+		ir->ir = convolver_ir_new(impl->dsp, blocksize, tailsize, samples, n_samples);
+		if (ir->ir == NULL) {
+			free(ir);
+			ir = NULL;
+			goto error;
+		}
+		ir->ref = 1;
+		ir->n_samples = n_samples;
+		ir->cpu_flags = pl->dsp->cpu_flags;
+		/* without a key, the impulse response is not shared */
+		ir->key = ir_key;
+		ir_key = NULL;
+		spa_list_init(&ir->link);
+		if (ir->key != NULL)
+			add_ir_entry(ir);
+	}
+	impl->ir = ir;
+
+	impl->conv = convolver_new_ir(impl->dsp, ir->ir);
 	if (impl->conv == NULL)
 		goto error;
 
@@ -1081,10 +1294,14 @@ static void * convolver_instantiate(const struct spa_fga_plugin *plugin, const s
 		impl->latency = latency * impl->rate;
 
 	free(samples);
+	free(ir_key);
 
 	return impl;
 error:
+	if (ir)
+		unref_ir_entry(ir);
 	free(samples);
+	free(ir_key);
 	free(impl);
 	return NULL;
 }
@@ -1101,6 +1318,8 @@ static void convolver_cleanup(void * Instance)
 	struct convolver_impl *impl = Instance;
 	if (impl->conv)
 		convolver_free(impl->conv);
+	if (impl->ir)
+		unref_ir_entry(impl->ir);
 	free(impl);
 }
 
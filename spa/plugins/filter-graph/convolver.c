@@ -8,8 +8,30 @@
 
 #include <spa/utils/defs.h>
 
+#include <stdlib.h>
+#include <errno.h>
 #include <math.h>
 
+#define SEGMENT_ALIGN	64
+
+/* the frequency domain segments of a part of the impulse response */
+struct partition {
+	int blockSize;
+	int segCount;
+	int fftComplexSize;
+	float **segmentsIr;
+	void *data;
+};
+
+struct convolver_ir {
+	int irlen;
+	int headBlockSize;
+	int tailBlockSize;
+	struct partition head;
+	struct partition tail0;
+	struct partition tail;
+};
+
 struct convolver1 {
 	int blockSize;
 	int segSize;
@@ -17,7 +39,7 @@ struct convolver1 {
 	int fftComplexSize;
 
 	float **segments;
-	float **segmentsIr;
+	float * const *segmentsIr;
 
 	float *fft_buffer;
 
@@ -43,6 +65,69 @@ static int next_power_of_two(int val)
 	return r;
 }
 
+static void partition_clear(struct partition *p)
+{
+	free(p->segmentsIr);
+	free(p->data);
+	spa_zero(*p);
+}
+
+static int partition_init(struct spa_fga_dsp *dsp, struct partition *p, int block,
+		const float *ir, int irlen)
+{
+	void *fft = NULL;
+	float *fft_buffer = NULL;
+	size_t stride;
+	int i, segSize, res = -ENOMEM;
+
+	spa_zero(*p);
+
+	while (irlen > 0 && fabs(ir[irlen-1]) < 0.000001f)
+		irlen--;
+
+	if (irlen == 0)
+		return 0;
+
+	p->blockSize = next_power_of_two(block);
+	p->segCount = (irlen + p->blockSize-1) / p->blockSize;
+	p->fftComplexSize = p->blockSize + 1;
+	segSize = 2 * p->blockSize;
+
+	/* the segments are not owned by a dsp so that they can be shared
+	 * between convolvers. Align them for all fft implementations. */
+	stride = SPA_ROUND_UP_N(p->fftComplexSize * 2 * sizeof(float), SEGMENT_ALIGN);
+	p->segmentsIr = calloc(p->segCount, sizeof(float*));
+	if (p->segmentsIr == NULL ||
+	    posix_memalign(&p->data, SEGMENT_ALIGN, stride * p->segCount) != 0)
+		goto error;
+
+	fft = spa_fga_dsp_fft_new(dsp, segSize, true);
+	fft_buffer = spa_fga_dsp_fft_memalloc(dsp, segSize, true);
+	if (fft == NULL || fft_buffer == NULL)
+		goto error;
+
+	for (i = 0; i < p->segCount; i++) {
+		int left = irlen - (i * p->blockSize);
+		int copy = SPA_MIN(p->blockSize, left);
+
+		p->segmentsIr[i] = SPA_PTROFF(p->data, i * stride, float);
+
+		spa_fga_dsp_copy(dsp, fft_buffer, &ir[i * p->blockSize], copy);
+		if (copy < segSize)
+			spa_fga_dsp_fft_memclear(dsp, fft_buffer + copy, segSize - copy, true);
+
+	        spa_fga_dsp_fft_run(dsp, fft, 1, fft_buffer, p->segmentsIr[i]);
+	}
+	res = 0;
+error:
+	if (fft)
+		spa_fga_dsp_fft_free(dsp, fft);
+	spa_fga_dsp_fft_memfree(dsp, fft_buffer);
+	if (res < 0)
+		partition_clear(p);
+	return res;
+}
+
 static void convolver1_reset(struct spa_fga_dsp *dsp, struct convolver1 *conv)
 {
 	int i;
@@ -62,8 +147,6 @@ static void convolver1_free(struct spa_fga_dsp *dsp, struct convolver1 *conv)
 	for (i = 0; i < conv->segCount; i++) {
 		if (conv->segments)
 			spa_fga_dsp_fft_memfree(dsp, conv->segments[i]);
-		if (conv->segmentsIr)
-			spa_fga_dsp_fft_memfree(dsp, conv->segmentsIr[i]);
 	}
 	if (conv->fft)
 		spa_fga_dsp_fft_free(dsp, conv->fft);
@@ -72,7 +155,6 @@ static void convolver1_free(struct spa_fga_dsp *dsp, struct convolver1 *conv)
 	if (conv->fft_buffer)
 		spa_fga_dsp_fft_memfree(dsp, conv->fft_buffer);
 	free(conv->segments);
-	free(conv->segmentsIr);
 	spa_fga_dsp_fft_memfree(dsp, conv->pre_mult);
 	spa_fga_dsp_fft_memfree(dsp, conv->conv);
 	spa_fga_dsp_fft_memfree(dsp, conv->overlap);
@@ -80,28 +162,23 @@ static void convolver1_free(struct spa_fga_dsp *dsp, struct convolver1 *conv)
 	free(conv);
 }
 
-static struct convolver1 *convolver1_new(struct spa_fga_dsp *dsp, int block, const float *ir, int irlen)
+static struct convolver1 *convolver1_new(struct spa_fga_dsp *dsp, const struct partition *p)
 {
 	struct convolver1 *conv;
 	int i;
 
-	if (block == 0)
-		return NULL;
-
-	while (irlen > 0 && fabs(ir[irlen-1]) < 0.000001f)
-		irlen--;
-
 	conv = calloc(1, sizeof(*conv));
 	if (conv == NULL)
 		return NULL;
 
-	if (irlen == 0)
+	if (p->segCount == 0)
 		return conv;
 
-	conv->blockSize = next_power_of_two(block);
+	conv->blockSize = p->blockSize;
 	conv->segSize = 2 * conv->blockSize;
-	conv->segCount = (irlen + conv->blockSize-1) / conv->blockSize;
-	conv->fftComplexSize = (conv->segSize / 2) + 1;
+	conv->segCount = p->segCount;
+	conv->fftComplexSize = p->fftComplexSize;
+	conv->segmentsIr = p->segmentsIr;
 
 	conv->fft = spa_fga_dsp_fft_new(dsp, conv->segSize, true);
 	if (conv->fft == NULL)
@@ -115,24 +192,13 @@ static struct convolver1 *convolver1_new(struct spa_fga_dsp *dsp, int block, con
 		goto error;
 
 	conv->segments = calloc(conv->segCount, sizeof(float*));
-	conv->segmentsIr = calloc(conv->segCount, sizeof(float*));
-	if (conv->segments == NULL || conv->segmentsIr == NULL)
+	if (conv->segments == NULL)
 		goto error;
 
 	for (i = 0; i < conv->segCount; i++) {
-		int left = irlen - (i * conv->blockSize);
-		int copy = SPA_MIN(conv->blockSize, left);
-
 		conv->segments[i] = spa_fga_dsp_fft_memalloc(dsp, conv->fftComplexSize, false);
-		conv->segmentsIr[i] = spa_fga_dsp_fft_memalloc(dsp, conv->fftComplexSize, false);
-		if (conv->segments[i] == NULL || conv->segmentsIr[i] == NULL)
+		if (conv->segments[i] == NULL)
 			goto error;
-
-		spa_fga_dsp_copy(dsp, conv->fft_buffer, &ir[i * conv->blockSize], copy);
-		if (copy < conv->segSize)
-			spa_fga_dsp_fft_memclear(dsp, conv->fft_buffer + copy, conv->segSize - copy, true);
-
-	        spa_fga_dsp_fft_run(dsp, conv->fft, 1, conv->fft_buffer, conv->segmentsIr[i]);
 	}
 	conv->pre_mult = spa_fga_dsp_fft_memalloc(dsp, conv->fftComplexSize, false);
 	conv->conv = spa_fga_dsp_fft_memalloc(dsp, conv->fftComplexSize, false);
@@ -225,6 +291,7 @@ static int convolver1_run(struct spa_fga_dsp *dsp, struct convolver1 *conv, cons
 struct convolver
 {
 	struct spa_fga_dsp *dsp;
+	struct convolver_ir *ir;
 	int headBlockSize;
 	int tailBlockSize;
 	struct convolver1 *headConvolver;
@@ -259,10 +326,10 @@ void convolver_reset(struct convolver *conv)
 	conv->precalculatedPos = 0;
 }
 
-struct convolver *convolver_new(struct spa_fga_dsp *dsp, int head_block, int tail_block, const float *ir, int irlen)
+struct convolver_ir *convolver_ir_new(struct spa_fga_dsp *dsp, int head_block, int tail_block,
+		const float *ir, int irlen)
 {
-	struct convolver *conv;
-	int head_ir_len;
+	struct convolver_ir *cir;
 
 	if (head_block == 0 || tail_block == 0)
 		return NULL;
@@ -274,26 +341,67 @@ struct convolver *convolver_new(struct spa_fga_dsp *dsp, int head_block, int tai
 	while (irlen > 0 && fabs(ir[irlen-1]) < 0.000001f)
 		irlen--;
 
+	cir = calloc(1, sizeof(*cir));
+	if (cir == NULL)
+		return NULL;
+
+	cir->irlen = irlen;
+	if (irlen == 0)
+		return cir;
+
+	cir->headBlockSize = next_power_of_two(head_block);
+	cir->tailBlockSize = next_power_of_two(tail_block);
+
+	if (partition_init(dsp, &cir->head, cir->headBlockSize, ir,
+				SPA_MIN(irlen, cir->tailBlockSize)) < 0)
+		goto error;
+
+	if (irlen > cir->tailBlockSize &&
+	    partition_init(dsp, &cir->tail0, cir->headBlockSize, ir + cir->tailBlockSize,
+				SPA_MIN(irlen - cir->tailBlockSize, cir->tailBlockSize)) < 0)
+		goto error;
+
+	if (irlen > 2 * cir->tailBlockSize &&
+	    partition_init(dsp, &cir->tail, cir->tailBlockSize, ir + (2 * cir->tailBlockSize),
+				irlen - (2 * cir->tailBlockSize)) < 0)
+		goto error;
+
+	return cir;
+error:
+	convolver_ir_free(cir);
+	return NULL;
+}
+
+void convolver_ir_free(struct convolver_ir *ir)
+{
+	partition_clear(&ir->head);
+	partition_clear(&ir->tail0);
+	partition_clear(&ir->tail);
+	free(ir);
+}
+
+struct convolver *convolver_new_ir(struct spa_fga_dsp *dsp, const struct convolver_ir *ir)
+{
+	struct convolver *conv;
+
 	conv = calloc(1, sizeof(*conv));
 	if (conv == NULL)
 		return NULL;
 
 	conv->dsp = dsp;
 
-	if (irlen == 0)
+	if (ir->irlen == 0)
 		return conv;
 
-	conv->headBlockSize = next_power_of_two(head_block);
-	conv->tailBlockSize = next_power_of_two(tail_block);
+	conv->headBlockSize = ir->headBlockSize;
+	conv->tailBlockSize = ir->tailBlockSize;
 
-	head_ir_len = SPA_MIN(irlen, conv->tailBlockSize);
-	conv->headConvolver = convolver1_new(dsp, conv->headBlockSize, ir, head_ir_len);
+	conv->headConvolver = convolver1_new(dsp, &ir->head);
 	if (conv->headConvolver == NULL)
 		goto error;
 
-	if (irlen > conv->tailBlockSize) {
-		int conv1IrLen = SPA_MIN(irlen - conv->tailBlockSize, conv->tailBlockSize);
-		conv->tailConvolver0 = convolver1_new(dsp, conv->headBlockSize, ir + conv->tailBlockSize, conv1IrLen);
+	if (ir->irlen > conv->tailBlockSize) {
+		conv->tailConvolver0 = convolver1_new(dsp, &ir->tail0);
 		conv->tailOutput0 = spa_fga_dsp_fft_memalloc(dsp, conv->tailBlockSize, true);
 		conv->tailPrecalculated0 = spa_fga_dsp_fft_memalloc(dsp, conv->tailBlockSize, true);
 		if (conv->tailConvolver0 == NULL || conv->tailOutput0 == NULL ||
@@ -301,9 +409,8 @@ struct convolver *convolver_new(struct spa_fga_dsp *dsp, int head_block, int tai
 			goto error;
 	}
 
-	if (irlen > 2 * conv->tailBlockSize) {
-		int tailIrLen = irlen - (2 * conv->tailBlockSize);
-		conv->tailConvolver = convolver1_new(dsp, conv->tailBlockSize, ir + (2 * conv->tailBlockSize), tailIrLen);
+	if (ir->irlen > 2 * conv->tailBlockSize) {
+		conv->tailConvolver = convolver1_new(dsp, &ir->tail);
 		conv->tailOutput = spa_fga_dsp_fft_memalloc(dsp, conv->tailBlockSize, true);
 		conv->tailPrecalculated = spa_fga_dsp_fft_memalloc(dsp, conv->tailBlockSize, true);
 		if (conv->tailConvolver == NULL || conv->tailOutput == NULL ||
@@ -325,6 +432,21 @@ error:
 	return NULL;
 }
 
+struct convolver *convolver_new(struct spa_fga_dsp *dsp, int head_block, int tail_block, const float *ir, int irlen)
+{
+	struct convolver_ir *cir;
+	struct convolver *conv;
+
+	if ((cir = convolver_ir_new(dsp, head_block, tail_block, ir, irlen)) == NULL)
+		return NULL;
+	if ((conv = convolver_new_ir(dsp, cir)) == NULL) {
+		convolver_ir_free(cir);
+		return NULL;
+	}
+	conv->ir = cir;
+	return conv;
+}
+
 void convolver_free(struct convolver *conv)
 {
 	struct spa_fga_dsp *dsp = conv->dsp;
@@ -340,6 +462,8 @@ void convolver_free(struct convolver *conv)
 	spa_fga_dsp_fft_memfree(dsp, conv->tailOutput);
 	spa_fga_dsp_fft_memfree(dsp, conv->tailPrecalculated);
 	spa_fga_dsp_fft_memfree(dsp, conv->tailInput);
+	if (conv->ir)
+		convolver_ir_free(conv->ir);
 	free(conv);
 }
 
@@ -10,5 +10,12 @@
 struct convolver *convolver_new(struct spa_fga_dsp *dsp, int block, int tail, const float *ir, int irlen);
 void convolver_free(struct convolver *conv);
 
+/* the transformed impulse response, it can be shared read-only between
+ * convolvers that use a dsp with the same fft implementation and must
+ * outlive them */
+struct convolver_ir *convolver_ir_new(struct spa_fga_dsp *dsp, int block, int tail, const float *ir, int irlen);
+void convolver_ir_free(struct convolver_ir *ir);
+struct convolver *convolver_new_ir(struct spa_fga_dsp *dsp, const struct convolver_ir *ir);
+
 void convolver_reset(struct convolver *conv);
 int convolver_run(struct convolver *conv, const float *input, float *output, int length);
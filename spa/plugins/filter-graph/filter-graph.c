@@ -12,13 +12,16 @@
 #include <unistd.h>
 #include <limits.h>
 #include <math.h>
+#include <time.h>
 
 #include "config.h"
 
 #include <spa/utils/result.h>
 #include <spa/utils/string.h>
 #include <spa/utils/json.h>
+#include <spa/utils/ringbuffer.h>
 #include <spa/support/cpu.h>
+#include <spa/support/loop.h>
 #include <spa/support/plugin-loader.h>
 #include <spa/param/latency-utils.h>
 #include <spa/param/tag-utils.h>
@@ -27,9 +30,11 @@
 #include <spa/param/audio/format-utils.h>
 #include <spa/pod/dynamic.h>
 #include <spa/pod/builder.h>
+#include <spa/control/control.h>
 #include <spa/debug/types.h>
 #include <spa/debug/log.h>
 #include <spa/filter-graph/filter-graph.h>
+#include <spa/plugins/audioconvert/thread-pool.h>
 
 #include "audio-plugin.h"
 #include "audio-dsp-impl.h"
@@ -39,6 +44,28 @@
 SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.filter-graph");
 
 #define MAX_HNDL 64
+#define MAX_CHANNELS 512u
+#define MAX_CHAIN 32u
+#define CHAIN_TILE 256u
+#define MAX_LANES 16u
+/* graphs with less handles run serially */
+#define MIN_PARALLEL 4u
+#define MAX_EVENTS 1024u
+
+/* queued controls move to the new value in DEFAULT_RAMP milliseconds, in
+ * steps of DEFAULT_RAMP_BLOCK samples */
+#define DEFAULT_RAMP		5.0f
+#define DEFAULT_RAMP_BLOCK	32u
+
+/* the weight of a cycle in the average load of an instance */
+#define PROFILE_AVG	0.05f
+/* the interval of the load updates in the graph info */
+#define PROFILE_INTERVAL_SEC	1
+
+/* the graph can stop running after its inputs and outputs were below
+ * SILENCE_LEVEL for filter-graph.silence-timeout milliseconds, 0 disables */
+#define DEFAULT_SILENCE_TIMEOUT	0.0f
+#define SILENCE_LEVEL		1e-8f
 
 #define DEFAULT_RATE	48000
 
@@ -88,6 +115,7 @@ struct port {
 
 	uint32_t idx;
 	unsigned long p;
+	uint32_t control_id;
 
 	struct spa_list link_list;
 	uint32_t n_links;
@@ -126,6 +154,18 @@ struct node {
 
 	unsigned int n_sort_deps;
 	unsigned int sorted:1;
+
+	struct node *fuse_next;
+	unsigned int fuse_prev:1;
+	uint32_t chain;
+	uint32_t chain_pos;
+	uint32_t level;
+
+	/* with profiling, the time spent in run by each instance in the
+	 * current cycle and its average and maximum fraction of the cycle time */
+	uint64_t time[MAX_HNDL];
+	float load[MAX_HNDL];
+	float load_max[MAX_HNDL];
 };
 
 struct link {
@@ -138,31 +178,85 @@ struct link {
 	struct port *input;
 };
 
+/* a linear chain of builtin nodes that is run in small tiles so that the
+ * samples stay in the cache from the first to the last node. With lanes, the
+ * chain runs the same nodes of n_lanes instances together, the chains of the
+ * other instances are then unused and have 0 lanes. */
+struct graph_chain {
+	uint32_t n_stages;
+	struct graph_stage {
+		const struct spa_fga_descriptor *desc;
+		void **hndl;
+		struct node *node;
+		struct port *in_port;
+		struct port *out_port;
+	} stages[MAX_CHAIN];
+
+	uint32_t n_lanes;
+	float *in[MAX_LANES];
+	float *out[MAX_LANES];
+	float *tile[2];
+};
+
 struct graph_port {
 	const struct spa_fga_descriptor *desc;
 	void **hndl;
 	uint32_t port;
 	struct node *node;
+	struct graph_chain *chain;
+	uint32_t lane;
 	unsigned next:1;
 };
 
 struct graph_hndl {
 	const struct spa_fga_descriptor *desc;
 	void **hndl;
+	struct node *node;
+	uint32_t n_hndl;
+	struct graph_chain *chain;
+	uint32_t level;
+};
+
+/* handles that don't depend on each other and can run in parallel */
+struct graph_wave {
+	uint32_t first;
+	uint32_t n_hndl;
+};
+
+/* a queued control change, the offset is relative to the next cycle */
+struct control_event {
+	uint32_t offset;
+	uint32_t id;
+	float value;
+	uint32_t padding;
+};
+
+struct control_ramp {
+	float start;
+	float target;
+	uint32_t pos;
+	uint32_t len;
+	unsigned active:1;
+};
+
+struct volume_port {
+	struct port *port;
+	float min;
+	float max;
+#define SCALE_LINEAR	0
+#define SCALE_CUBIC	1
+	int scale;
 };
 
 struct volume {
 	bool mute;
 	uint32_t n_volumes;
-	float volumes[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t max_volumes;
+	float *volumes;
+	float *tmp;			/* max_volumes scratch for set_props */
 
 	uint32_t n_ports;
-	struct port *ports[SPA_AUDIO_MAX_CHANNELS];
-	float min[SPA_AUDIO_MAX_CHANNELS];
-	float max[SPA_AUDIO_MAX_CHANNELS];
-#define SCALE_LINEAR	0
-#define SCALE_CUBIC	1
-	int scale[SPA_AUDIO_MAX_CHANNELS];
+	struct volume_port *ports;
 };
 
 struct graph {
@@ -181,8 +275,18 @@ struct graph {
 	uint32_t n_hndl;
 	struct graph_hndl *hndl;
 
+	uint32_t n_chain;
+	struct graph_chain *chain;
+	float *chain_mem;
+
+	uint32_t n_wave;
+	struct graph_wave *wave;
+
 	uint32_t n_control;
 	struct port **control_port;
+	struct control_ramp *ramp;
+	uint32_t n_ramping;
+	uint32_t *ramping;
 
 	uint32_t n_input_names;
 	char **input_names;
@@ -194,9 +298,11 @@ struct graph {
 
 	uint32_t n_inputs;
 	uint32_t n_outputs;
-	uint32_t inputs_position[SPA_AUDIO_MAX_CHANNELS];
+	const void **block_in;		/* n_inputs buffers for running in blocks */
+	void **block_out;		/* n_outputs buffers for running in blocks */
+	uint32_t inputs_position[MAX_CHANNELS];
 	uint32_t n_inputs_position;
-	uint32_t outputs_position[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t outputs_position[MAX_CHANNELS];
 	uint32_t n_outputs_position;
 
 	float min_latency;
@@ -213,6 +319,8 @@ struct impl {
 
 	struct spa_log *log;
 	struct spa_cpu *cpu;
+	struct spa_thread_utils *thread_utils;
+	struct spa_loop_utils *loop_utils;
 	struct spa_fga_dsp *dsp;
 	struct spa_plugin_loader *loader;
 
@@ -224,6 +332,23 @@ struct impl {
 	uint32_t quantum_limit;
 	uint32_t max_align;
 	long unsigned rate;
+	bool fuse;
+	bool lanes;
+	uint32_t n_threads;
+	struct thread_pool *pool;
+	bool profile;
+	struct spa_source *profile_timer;
+
+	float silence_timeout;
+	uint32_t silence_samples;
+	uint32_t silent;
+
+	float ramp_time;
+	uint32_t ramp_samples;
+	uint32_t ramp_block;
+	struct spa_ringbuffer control_ring;
+	struct control_event control_events[MAX_EVENTS];
+	uint32_t control_dropped;
 
 	struct spa_list plugin_list;
 
@@ -245,6 +370,43 @@ static inline void print_channels(char *buffer, size_t max_size, uint32_t n_chan
 	spa_strbuf_append(&buf, "]");
 }
 
+/* the average and maximum load of the instances of each node, as a
+ * JSON object with an array of [ load, max ] per instance for each node */
+static char *profile_load(struct impl *impl)
+{
+	struct graph *graph = &impl->graph;
+	struct node *node;
+	struct spa_strbuf buf;
+	char *str, load[64], max[64];
+	size_t size = 8;
+	uint32_t i;
+	bool first = true;
+
+	spa_list_for_each(node, &graph->node_list, link)
+		size += strlen(node->name) + strlen(node->desc->desc->name) + 8 +
+			node->n_hndl * (sizeof(load) + sizeof(max) + 8);
+
+	if ((str = malloc(size)) == NULL)
+		return NULL;
+
+	spa_strbuf_init(&buf, str, size);
+	spa_strbuf_append(&buf, "{");
+	spa_list_for_each(node, &graph->node_list, link) {
+		if (node->disabled)
+			continue;
+		spa_strbuf_append(&buf, "%s \"%s\": [", first ? "" : ",",
+				node->name[0] != '\0' ? node->name : node->desc->desc->name);
+		for (i = 0; i < node->n_hndl; i++)
+			spa_strbuf_append(&buf, "%s [ %s, %s ]", i ? "," : "",
+					spa_dtoa(load, sizeof(load), node->load[i]),
+					spa_dtoa(max, sizeof(max), node->load_max[i]));
+		spa_strbuf_append(&buf, " ]");
+		first = false;
+	}
+	spa_strbuf_append(&buf, " }");
+	return str;
+}
+
 static void emit_filter_graph_info(struct impl *impl, bool full)
 {
 	uint64_t old = full ? impl->info.change_mask : 0;
@@ -253,11 +415,11 @@ static void emit_filter_graph_info(struct impl *impl, bool full)
 	if (full)
 		impl->info.change_mask = impl->info_all;
 	if (impl->info.change_mask || full) {
-		char n_inputs[64], n_outputs[64], latency[64];
-		struct spa_dict_item items[6];
+		char n_inputs[64], n_outputs[64], latency[64], *load = NULL;
+		struct spa_dict_item items[7];
 		struct spa_dict dict = SPA_DICT(items, 0);
-		char in_pos[SPA_AUDIO_MAX_CHANNELS * 8];
-		char out_pos[SPA_AUDIO_MAX_CHANNELS * 8];
+		char in_pos[MAX_CHANNELS * 8];
+		char out_pos[MAX_CHANNELS * 8];
 
 		snprintf(n_inputs, sizeof(n_inputs), "%d", impl->graph.n_inputs);
 		snprintf(n_outputs, sizeof(n_outputs), "%d", impl->graph.n_outputs);
@@ -277,10 +439,14 @@ static void emit_filter_graph_info(struct impl *impl, bool full)
 		items[dict.n_items++] = SPA_DICT_ITEM("latency",
 				spa_dtoa(latency, sizeof(latency),
 					(graph->min_latency + graph->max_latency) / 2.0f));
+		if (impl->profile && graph->activated &&
+		    (load = profile_load(impl)) != NULL)
+			items[dict.n_items++] = SPA_DICT_ITEM("cpu.load", load);
 		impl->info.props = &dict;
 		spa_filter_graph_emit_info(&impl->hooks, &impl->info);
 		impl->info.props = NULL;
 		impl->info.change_mask = old;
+		free(load);
 	}
 }
 static int
@@ -302,10 +468,98 @@ impl_add_listener(void *object,
 	return 0;
 }
 
-static int impl_process(void *object,
+static inline void hndl_run(const struct spa_fga_descriptor *desc, void **hndl,
+		uint32_t n_hndl, uint32_t n_samples)
+{
+	uint32_t i;
+
+	if (n_hndl > 1 && desc->run_multi != NULL) {
+		desc->run_multi(hndl, n_hndl, n_samples);
+	} else {
+		for (i = 0; i < n_hndl; i++)
+			desc->run(hndl[i], n_samples);
+	}
+}
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+/* with profiling, the handles that run together in one call, such as the
+ * lanes of the bq filters, share the time of the call */
+static inline void node_run(struct node *node, const struct spa_fga_descriptor *desc,
+		void **hndl, uint32_t n_hndl, uint32_t n_samples)
+{
+	uint64_t t;
+	uint32_t i, first;
+
+	if (!node->graph->impl->profile) {
+		hndl_run(desc, hndl, n_hndl, n_samples);
+		return;
+	}
+	t = get_time_ns();
+	hndl_run(desc, hndl, n_hndl, n_samples);
+	t = (get_time_ns() - t) / SPA_MAX(n_hndl, 1u);
+	first = hndl - node->hndl;
+	for (i = 0; i < n_hndl; i++)
+		node->time[first + i] += t;
+}
+
+/* Run all nodes of the chain on a tile before going to the next tile. The
+ * nodes in the chain pass the samples in two small buffers per lane. */
+static void chain_run(struct graph_chain *chain, uint32_t n_samples)
+{
+	uint32_t i, l, offset, n, last = chain->n_stages - 1, n_lanes = chain->n_lanes;
+	float *in[MAX_LANES], *out;
+
+	for (offset = 0; offset < n_samples; offset += n) {
+		n = SPA_MIN(n_samples - offset, CHAIN_TILE);
+		for (l = 0; l < n_lanes; l++)
+			in[l] = chain->in[l] ? chain->in[l] + offset : NULL;
+
+		for (i = 0; i <= last; i++) {
+			struct graph_stage *s = &chain->stages[i];
+
+			for (l = 0; l < n_lanes; l++) {
+				if (i < last)
+					out = chain->tile[i & 1] + l * 2 * CHAIN_TILE;
+				else
+					out = chain->out[l] ? chain->out[l] + offset : NULL;
+
+				s->desc->connect_port(s->hndl[l], s->in_port->p, in[l]);
+				s->desc->connect_port(s->hndl[l], s->out_port->p, out);
+				in[l] = out;
+			}
+			node_run(s->node, s->desc, s->hndl, n_lanes, n);
+		}
+	}
+}
+
+static inline void graph_hndl_run(struct graph_hndl *hndl, uint32_t n_samples)
+{
+	if (hndl->chain)
+		chain_run(hndl->chain, n_samples);
+	else
+		node_run(hndl->node, hndl->desc, hndl->hndl, hndl->n_hndl, n_samples);
+}
+
+struct wave_job {
+	struct graph_hndl *hndl;
+	uint32_t n_samples;
+};
+
+static void run_wave_job(void *data, uint32_t job)
+{
+	struct wave_job *j = data;
+	graph_hndl_run(&j->hndl[job], j->n_samples);
+}
+
+static void graph_run(struct impl *impl,
 		const void *in[], void *out[], uint32_t n_samples)
 {
-	struct impl *impl = object;
 	struct graph *graph = &impl->graph;
 	uint32_t i, j, n_hndl = graph->n_hndl;
 	struct graph_port *port;
@@ -313,8 +567,11 @@ static int impl_process(void *object,
 	for (i = 0, j = 0; i < graph->n_inputs; i++) {
 		while (j < graph->n_input) {
 			port = &graph->input[j++];
-			if (port->desc && in[i])
+			if (port->desc && in[i]) {
 				port->desc->connect_port(*port->hndl, port->port, (float*)in[i]);
+				if (port->chain)
+					port->chain->in[port->lane] = (float*)in[i];
+			}
 			if (!port->next)
 				break;
 		}
@@ -324,15 +581,261 @@ static int impl_process(void *object,
 			continue;
 
 		port = &graph->output[i];
-		if (port->desc)
+		if (port->desc) {
 			port->desc->connect_port(*port->hndl, port->port, out[i]);
-		else
+			if (port->chain)
+				port->chain->out[port->lane] = out[i];
+		} else
 			memset(out[i], 0, n_samples * sizeof(float));
 	}
-	for (i = 0; i < n_hndl; i++) {
-		struct graph_hndl *hndl = &graph->hndl[i];
-		hndl->desc->run(*hndl->hndl, n_samples);
+	if (graph->n_wave > 0) {
+		/* the pool returns when all handles of the wave are done */
+		for (i = 0; i < graph->n_wave; i++) {
+			struct graph_wave *w = &graph->wave[i];
+			struct wave_job j = {
+				.hndl = &graph->hndl[w->first],
+				.n_samples = n_samples,
+			};
+			if (w->n_hndl == 1)
+				graph_hndl_run(j.hndl, n_samples);
+			else
+				thread_pool_run(impl->pool, run_wave_job, &j, w->n_hndl);
+		}
+	} else {
+		for (i = 0; i < n_hndl; i++)
+			graph_hndl_run(&graph->hndl[i], n_samples);
 	}
+}
+
+static void port_set_control_data(struct port *port, float value)
+{
+	uint32_t i, n_hndl = SPA_MAX(1u, port->node->n_hndl);
+	for (i = 0; i < n_hndl; i++)
+		port->control_data[i] = value;
+}
+
+static void control_ramp_start(struct impl *impl, uint32_t id, float value)
+{
+	struct graph *graph = &impl->graph;
+	struct control_ramp *r;
+	struct port *port;
+
+	if (id >= graph->n_control)
+		return;
+
+	port = graph->control_port[id];
+	r = &graph->ramp[id];
+	if (impl->ramp_samples == 0) {
+		port_set_control_data(port, value);
+		r->start = r->target = value;
+		r->pos = r->len;
+		return;
+	}
+	r->start = port->control_data[0];
+	r->target = value;
+	r->pos = 0;
+	r->len = impl->ramp_samples;
+	if (!r->active) {
+		r->active = true;
+		graph->ramping[graph->n_ramping++] = id;
+	}
+}
+
+/* move the ramping controls to their value at the end of the next n_samples */
+static void control_ramp_advance(struct graph *graph, uint32_t n_samples)
+{
+	uint32_t i = 0;
+
+	while (i < graph->n_ramping) {
+		uint32_t id = graph->ramping[i];
+		struct control_ramp *r = &graph->ramp[id];
+
+		r->pos = SPA_MIN(r->pos + n_samples, r->len);
+		port_set_control_data(graph->control_port[id],
+				r->start + (r->target - r->start) * r->pos / r->len);
+
+		if (r->pos == r->len) {
+			r->active = false;
+			graph->ramping[i] = graph->ramping[--graph->n_ramping];
+		} else {
+			i++;
+		}
+	}
+}
+
+/* drop the queued controls, their ids are only valid for the current graph,
+ * and move the ramping controls to their target */
+static void control_reset(struct impl *impl)
+{
+	struct graph *graph = &impl->graph;
+	uint32_t i, dropped;
+
+	spa_ringbuffer_init(&impl->control_ring);
+
+	for (i = 0; i < graph->n_ramping; i++) {
+		uint32_t id = graph->ramping[i];
+		struct control_ramp *r = &graph->ramp[id];
+
+		port_set_control_data(graph->control_port[id], r->target);
+		r->pos = r->len;
+		r->active = false;
+	}
+	graph->n_ramping = 0;
+
+	if ((dropped = impl->control_dropped) > 0) {
+		spa_log_warn(impl->log, "%p: control queue full, dropped %u controls",
+				impl, dropped);
+		impl->control_dropped = 0;
+	}
+}
+
+/* The queued controls split the cycle at their offsets. While controls
+ * are ramping, the graph runs in blocks of ramp_block samples with the
+ * controls updated between the blocks. */
+static void graph_process(struct impl *impl,
+		const void *in[], void *out[], uint32_t n_samples)
+{
+	struct graph *graph = &impl->graph;
+	const uint32_t size = sizeof(impl->control_events);
+	const void **bin = graph->block_in;
+	void **bout = graph->block_out;
+	struct control_event ev;
+	uint32_t i, index, offset, n, ev_offset = 0;
+	int32_t avail;
+	bool have_ev = false;
+
+	avail = spa_ringbuffer_get_read_index(&impl->control_ring, &index);
+	if (avail <= 0 && graph->n_ramping == 0) {
+		graph_run(impl, in, out, n_samples);
+		return;
+	}
+
+	for (offset = 0; offset < n_samples; offset += n) {
+		while (true) {
+			if (!have_ev) {
+				if (avail < (int32_t)sizeof(ev))
+					break;
+				spa_ringbuffer_read_data(&impl->control_ring, impl->control_events,
+						size, index & (size - 1), &ev, sizeof(ev));
+				index += sizeof(ev);
+				avail -= sizeof(ev);
+				/* events are applied in queue order, events past the
+				 * cycle are applied on the last sample */
+				ev_offset = SPA_CLAMP(ev.offset, offset, n_samples - 1);
+				have_ev = true;
+			}
+			if (ev_offset > offset)
+				break;
+			control_ramp_start(impl, ev.id, ev.value);
+			have_ev = false;
+		}
+		n = n_samples - offset;
+		if (have_ev)
+			n = SPA_MIN(n, ev_offset - offset);
+		if (graph->n_ramping > 0) {
+			n = SPA_MIN(n, impl->ramp_block);
+			control_ramp_advance(graph, n);
+		}
+		if (offset == 0 && n == n_samples) {
+			graph_run(impl, in, out, n_samples);
+			break;
+		}
+		for (i = 0; i < graph->n_inputs; i++)
+			bin[i] = in[i] ? SPA_PTROFF(in[i], offset * sizeof(float), void) : NULL;
+		for (i = 0; i < graph->n_outputs; i++)
+			bout[i] = out[i] ? SPA_PTROFF(out[i], offset * sizeof(float), void) : NULL;
+		graph_run(impl, bin, bout, n);
+	}
+	spa_ringbuffer_read_update(&impl->control_ring, index);
+}
+
+/* update the load of the instances with the time of this cycle */
+static void profile_update(struct impl *impl, uint32_t n_samples)
+{
+	struct node *node;
+	float cycle_ns = n_samples * (float)SPA_NSEC_PER_SEC / impl->rate;
+	uint32_t i;
+
+	spa_list_for_each(node, &impl->graph.node_list, link) {
+		for (i = 0; i < node->n_hndl; i++) {
+			float load = node->time[i] / cycle_ns;
+			node->time[i] = 0;
+			node->load[i] += (load - node->load[i]) * PROFILE_AVG;
+			node->load_max[i] = SPA_MAX(node->load_max[i], load);
+		}
+	}
+}
+
+static bool is_silent(const float *data, uint32_t n_samples)
+{
+	uint32_t i, j, n;
+
+	if (data == NULL)
+		return true;
+	/* scan in blocks so that the loop vectorizes and stops early on
+	 * the first block with signal */
+	for (i = 0; i < n_samples; i += n) {
+		float peak = 0.0f;
+		n = SPA_MIN(n_samples - i, 64u);
+		for (j = 0; j < n; j++)
+			peak = SPA_MAX(peak, fabsf(data[i + j]));
+		if (peak > SILENCE_LEVEL)
+			return false;
+	}
+	return true;
+}
+
+static bool ports_silent(void * const data[], uint32_t n_ports, uint32_t n_samples)
+{
+	uint32_t i;
+	for (i = 0; i < n_ports; i++)
+		if (!is_silent(data[i], n_samples))
+			return false;
+	return true;
+}
+
+/* When the inputs are silent, the graph keeps running until its outputs
+ * were silent for silence_samples, which lets the tails of stateful nodes
+ * such as reverbs and delays decay. After that, the graph is skipped and
+ * silence is written to the outputs until there is signal on the inputs
+ * or a control changes. */
+static bool inputs_silent(struct impl *impl, const void *in[], uint32_t n_samples)
+{
+	struct graph *graph = &impl->graph;
+	uint32_t index;
+
+	if (impl->silence_samples == 0 || graph->n_ramping > 0 ||
+	    spa_ringbuffer_get_read_index(&impl->control_ring, &index) > 0 ||
+	    !ports_silent((void * const *)in, graph->n_inputs, n_samples)) {
+		impl->silent = 0;
+		return false;
+	}
+	return true;
+}
+
+static int impl_process(void *object,
+		const void *in[], void *out[], uint32_t n_samples)
+{
+	struct impl *impl = object;
+	struct graph *graph = &impl->graph;
+	uint32_t i;
+
+	if (!inputs_silent(impl, in, n_samples)) {
+		graph_process(impl, in, out, n_samples);
+	} else if (impl->silent < impl->silence_samples) {
+		graph_process(impl, in, out, n_samples);
+		if (ports_silent(out, graph->n_outputs, n_samples))
+			impl->silent = SPA_MIN(impl->silent + n_samples, impl->silence_samples);
+		else
+			impl->silent = 0;
+	} else {
+		for (i = 0; i < graph->n_outputs; i++) {
+			if (out[i] != NULL)
+				memset(out[i], 0, n_samples * sizeof(float));
+		}
+	}
+	if (impl->profile && n_samples > 0)
+		profile_update(impl, n_samples);
 	return 0;
 }
 
@@ -568,6 +1071,8 @@ static int port_set_control_value(struct port *port, float *value, uint32_t id)
 			desc->desc->ports[port->p].name, old, port->control_data[id]);
 	changed = old != port->control_data[id];
 	node->control_changed |= changed;
+	if (changed)
+		impl->silent = 0;
 	return changed ? 1 : 0;
 }
 
@@ -590,7 +1095,14 @@ static int set_control_value(struct node *node, const char *name, float *value)
 	return count;
 }
 
-static int parse_params(struct graph *graph, const struct spa_pod *pod)
+static int set_param(void *data, struct node *node, const char *name, float *value)
+{
+	return set_control_value(node, name, value);
+}
+
+static int parse_params(struct graph *graph, const struct spa_pod *pod,
+		int (*set) (void *data, struct node *node, const char *name, float *value),
+		void *data)
 {
 	struct spa_pod_parser prs;
 	struct spa_pod_frame f;
@@ -627,7 +1139,7 @@ static int parse_params(struct graph *graph, const struct spa_pod *pod)
 			struct spa_pod *pod;
 			spa_pod_parser_get_pod(&prs, &pod);
 		}
-		if ((res = set_control_value(def_node, name, val)) > 0)
+		if ((res = set(data, def_node, name, val)) > 0)
 			changed += res;
 	}
 	return changed;
@@ -637,17 +1149,23 @@ static int impl_reset(void *object)
 {
 	struct impl *impl = object;
 	struct graph *graph = &impl->graph;
+	struct node *node;
 	uint32_t i;
-	for (i = 0; i < graph->n_hndl; i++) {
-		struct graph_hndl *hndl = &graph->hndl[i];
-		const struct spa_fga_descriptor *d = hndl->desc;
-		if (hndl->hndl == NULL || *hndl->hndl == NULL)
+
+	spa_list_for_each(node, &graph->node_list, link) {
+		const struct spa_fga_descriptor *d = node->desc->desc;
+		if (node->disabled)
 			continue;
-		if (d->deactivate)
-			d->deactivate(*hndl->hndl);
-		if (d->activate)
-			d->activate(*hndl->hndl);
+		for (i = 0; i < node->n_hndl; i++) {
+			if (node->hndl[i] == NULL)
+				continue;
+			if (d->deactivate)
+				d->deactivate(node->hndl[i]);
+			if (d->activate)
+				d->activate(node->hndl[i]);
+		}
 	}
+	control_reset(impl);
 	return 0;
 }
 
@@ -668,6 +1186,33 @@ static void node_control_changed(struct node *node)
 	node->control_changed = false;
 }
 
+/* make room for n_volumes, this only grows the memory */
+static int volume_ensure(struct volume *vol, uint32_t n_volumes)
+{
+	float *data;
+
+	n_volumes = SPA_MAX(n_volumes, SPA_AUDIO_MAX_CHANNELS);
+	if (vol->volumes != NULL && n_volumes <= vol->max_volumes)
+		return 0;
+
+	if ((data = calloc(n_volumes, 2 * sizeof(float))) == NULL)
+		return -errno;
+	if (vol->volumes != NULL)
+		memcpy(data, vol->volumes, vol->n_volumes * sizeof(float));
+	free(vol->volumes);
+	vol->volumes = data;
+	vol->tmp = data + n_volumes;
+	vol->max_volumes = n_volumes;
+	return 0;
+}
+
+static void volume_free(struct volume *vol)
+{
+	free(vol->volumes);
+	free(vol->ports);
+	spa_zero(*vol);
+}
+
 static int sync_volume(struct graph *graph, struct volume *vol)
 {
 	uint32_t i;
@@ -676,15 +1221,17 @@ static int sync_volume(struct graph *graph, struct volume *vol)
 	if (vol->n_ports == 0)
 		return 0;
 	for (i = 0; i < vol->n_volumes; i++) {
-		uint32_t n_port = i % vol->n_ports, n_hndl;
-		struct port *p = vol->ports[n_port];
+		struct volume_port *vp = &vol->ports[i % vol->n_ports];
+		struct port *p = vp->port;
 		float v = vol->mute ? 0.0f : vol->volumes[i];
-		switch (vol->scale[n_port]) {
+		uint32_t n_hndl;
+
+		switch (vp->scale) {
 		case SCALE_CUBIC:
 			v = cbrtf(v);
 			break;
 		}
-		v = v * (vol->max[n_port] - vol->min[n_port]) + vol->min[n_port];
+		v = v * (vp->max - vp->min) + vp->min;
 
 		n_hndl = SPA_MAX(1u, p->node->n_hndl);
 		res += port_set_control_value(p, &v, i % n_hndl);
@@ -692,6 +1239,71 @@ static int sync_volume(struct graph *graph, struct volume *vol)
 	return res;
 }
 
+struct control_queue {
+	struct impl *impl;
+	uint32_t offset;
+	uint32_t index;
+	int32_t filled;
+};
+
+static int queue_param(void *data, struct node *node, const char *name, float *value)
+{
+	struct control_queue *q = data;
+	struct impl *impl = q->impl;
+	const uint32_t size = sizeof(impl->control_events);
+	struct control_event ev;
+	struct port *port;
+
+	port = find_port(node, name, SPA_FGA_PORT_INPUT | SPA_FGA_PORT_CONTROL);
+	if (port == NULL)
+		return -ENOENT;
+
+	/* called from the data thread, the drops are reported on reset */
+	if (q->filled + (int32_t)sizeof(ev) > (int32_t)size) {
+		spa_log_trace_fp(impl->log, "%p: control queue full, dropping '%s'", impl, name);
+		impl->control_dropped++;
+		return -ENOSPC;
+	}
+	ev.offset = q->offset;
+	ev.id = port->control_id;
+	ev.value = value ? *value : port->node->desc->default_control[port->idx];
+	ev.padding = 0;
+	spa_ringbuffer_write_data(&impl->control_ring, impl->control_events, size,
+			q->index & (size - 1), &ev, sizeof(ev));
+	q->index += sizeof(ev);
+	q->filled += sizeof(ev);
+	return 1;
+}
+
+static int impl_set_control(void *object, const struct spa_pod_sequence *sequence)
+{
+	struct impl *impl = object;
+	struct graph *graph = &impl->graph;
+	struct control_queue q = { .impl = impl };
+	struct spa_pod_control *c;
+	int count = 0;
+
+	if (graph->n_control == 0)
+		return 0;
+
+	q.filled = spa_ringbuffer_get_write_index(&impl->control_ring, &q.index);
+	SPA_POD_SEQUENCE_FOREACH(sequence, c) {
+		struct spa_pod_object *obj = (struct spa_pod_object *)&c->value;
+		struct spa_pod_prop *prop;
+
+		if (c->type != SPA_CONTROL_Properties || !spa_pod_is_object(&c->value))
+			continue;
+
+		q.offset = c->offset;
+		SPA_POD_OBJECT_FOREACH(obj, prop) {
+			if (prop->key == SPA_PROP_params)
+				count += parse_params(graph, &prop->value, queue_param, &q);
+		}
+	}
+	spa_ringbuffer_write_update(&impl->control_ring, q.index);
+	return count;
+}
+
 static int impl_set_props(void *object, enum spa_direction direction, const struct spa_pod *props)
 {
 	struct impl *impl = object;
@@ -711,7 +1323,7 @@ static int impl_set_props(void *object, enum spa_direction direction, const stru
 	SPA_POD_OBJECT_FOREACH(obj, prop) {
 		switch (prop->key) {
 		case SPA_PROP_params:
-			changed += parse_params(graph, &prop->value);
+			changed += parse_params(graph, &prop->value, set_param, NULL);
 			spa_pod_builder_raw_padded(&b.b, prop, SPA_POD_PROP_SIZE(prop));
 			break;
 		case SPA_PROP_mute:
@@ -729,10 +1341,10 @@ static int impl_set_props(void *object, enum spa_direction direction, const stru
 		case SPA_PROP_channelVolumes:
 		{
 			uint32_t i, n_vols;
-			float vols[SPA_AUDIO_MAX_CHANNELS];
+			float *vols = vol->tmp;
 
 			if ((n_vols = spa_pod_copy_array(&prop->value, SPA_TYPE_Float, vols,
-					SPA_AUDIO_MAX_CHANNELS)) > 0) {
+					vol->max_volumes)) > 0) {
 				if (vol->n_volumes != n_vols)
 					do_volume = true;
 				vol->n_volumes = n_vols;
@@ -756,7 +1368,7 @@ static int impl_set_props(void *object, enum spa_direction direction, const stru
 		}
 	}
 	if (do_volume && vol->n_ports != 0) {
-		float soft_vols[SPA_AUDIO_MAX_CHANNELS];
+		float *soft_vols = vol->tmp;
 		uint32_t i;
 
 		for (i = 0; i < vol->n_volumes; i++)
@@ -1204,7 +1816,8 @@ static int parse_volume(struct graph *graph, struct spa_json *json, enum spa_dir
 	struct node *def_control;
 	struct port *port;
 	struct volume *vol = &graph->volume[direction];
-	int len;
+	struct volume_port *ports;
+	int len, scale_type;
 
 	if (spa_list_is_empty(&graph->node_list)) {
 		spa_log_error(impl->log, "can't set volume in graph without nodes");
@@ -1249,25 +1862,31 @@ static int parse_volume(struct graph *graph, struct spa_json *json, enum spa_dir
 		spa_log_error(impl->log, "unknown control port %s", control);
 		return -ENOENT;
 	}
-	if (vol->n_ports >= SPA_AUDIO_MAX_CHANNELS) {
+	if (vol->n_ports >= MAX_CHANNELS) {
 		spa_log_error(impl->log, "too many volume controls");
 		return -ENOSPC;
 	}
 	if (spa_streq(scale, "linear")) {
-		vol->scale[vol->n_ports] = SCALE_LINEAR;
+		scale_type = SCALE_LINEAR;
 	} else if (spa_streq(scale, "cubic")) {
-		vol->scale[vol->n_ports] = SCALE_CUBIC;
+		scale_type = SCALE_CUBIC;
 	} else {
 		spa_log_error(impl->log, "Invalid scale value '%s', use one of linear or cubic", scale);
 		return -EINVAL;
 	}
+	if ((ports = realloc(vol->ports, (vol->n_ports + 1) * sizeof(*ports))) == NULL)
+		return -errno;
+	vol->ports = ports;
+
 	spa_log_info(impl->log, "volume %d: \"%s:%s\" min:%f max:%f scale:%s", vol->n_ports, port->node->name,
 			port->node->desc->desc->ports[port->p].name, min, max, scale);
 
-	vol->ports[vol->n_ports] = port;
-	vol->min[vol->n_ports] = min;
-	vol->max[vol->n_ports] = max;
-	vol->n_ports++;
+	ports[vol->n_ports++] = (struct volume_port) {
+		.port = port,
+		.min = min,
+		.max = max,
+		.scale = scale_type,
+	};
 
 	return 0;
 }
@@ -1479,6 +2098,49 @@ static void node_free(struct node *node)
 	free(node);
 }
 
+/* skipping the graph on silence also stops its control outputs, such as
+ * the loudness of an analysis filter, and without audio outputs there is
+ * no silence to wait for. Only the latency of a node does not change. */
+static bool graph_can_skip(struct graph *graph)
+{
+	struct node *node;
+
+	if (graph->n_outputs == 0)
+		return false;
+
+	spa_list_for_each(node, &graph->node_list, link) {
+		uint32_t n_notify = node->desc->n_notify;
+		if (node->disabled)
+			continue;
+		if (node->latency_index != SPA_IDX_INVALID)
+			n_notify--;
+		if (n_notify > 0)
+			return false;
+	}
+	return true;
+}
+
+static void on_profile_timeout(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	impl->info.change_mask |= SPA_FILTER_GRAPH_CHANGE_MASK_PROPS;
+	emit_filter_graph_info(impl, false);
+}
+
+/* the load is emitted in the graph info while the graph is active */
+static void profile_timer_update(struct impl *impl, bool enable)
+{
+	struct timespec value, interval;
+
+	if (impl->profile_timer == NULL)
+		return;
+
+	value.tv_sec = interval.tv_sec = enable ? PROFILE_INTERVAL_SEC : 0;
+	value.tv_nsec = interval.tv_nsec = 0;
+	spa_loop_utils_update_timer(impl->loop_utils, impl->profile_timer,
+			&value, &interval, false);
+}
+
 static int impl_deactivate(void *object)
 {
 	struct impl *impl = object;
@@ -1491,6 +2153,8 @@ static int impl_deactivate(void *object)
 	graph->activated = false;
 	spa_list_for_each(node, &graph->node_list, link)
 		node_cleanup(node);
+	control_reset(impl);
+	profile_timer_update(impl, false);
 	return 0;
 }
 
@@ -1548,6 +2212,8 @@ static int impl_activate(void *object, const struct spa_dict *props)
 
 	rate = spa_dict_lookup(props, SPA_KEY_AUDIO_RATE);
 	impl->rate = rate ? atoi(rate) : DEFAULT_RATE;
+	impl->ramp_samples = (uint32_t)(impl->ramp_time * impl->rate / 1000.0f);
+	impl->silent = 0;
 
 	if ((str = spa_dict_lookup(props, "filter-graph.n_inputs")) != NULL) {
 		if (spa_atou32(str, &n_ports, 0) &&
@@ -1572,6 +2238,14 @@ static int impl_activate(void *object, const struct spa_dict *props)
 			return res;
 		graph->setup = true;
 	}
+	impl->silence_samples = graph_can_skip(graph) ?
+		(uint32_t)(impl->silence_timeout * impl->rate / 1000.0f) : 0;
+
+	spa_list_for_each(node, &graph->node_list, link) {
+		spa_zero(node->time);
+		spa_zero(node->load);
+		spa_zero(node->load_max);
+	}
 
 	/* first make instances */
 	spa_list_for_each(node, &graph->node_list, link) {
@@ -1608,9 +2282,14 @@ static int impl_activate(void *object, const struct spa_dict *props)
 				port = &node->input_port[j];
 				if (!spa_list_is_empty(&port->link_list)) {
 					link = spa_list_first(&port->link_list, struct link, input_link);
-					if ((res = port_ensure_data(link->output, i, max_samples)) < 0)
-						goto error;
-					data = link->output->audio_data[i];
+					if (link->output->node->fuse_next == node) {
+						/* fused, the chain connects the port */
+						data = NULL;
+					} else {
+						if ((res = port_ensure_data(link->output, i, max_samples)) < 0)
+							goto error;
+						data = link->output->audio_data[i];
+					}
 				} else {
 					data = sd;
 				}
@@ -1649,6 +2328,37 @@ static int impl_activate(void *object, const struct spa_dict *props)
 		}
 	}
 
+	/* the chains connect the ports for each tile, remember what is connected
+	 * to the ports at the ends of the chains */
+	for (i = 0; i < graph->n_chain; i++) {
+		struct graph_chain *chain = &graph->chain[i];
+		struct graph_stage *s;
+		uint32_t l;
+
+		for (l = 0; l < chain->n_lanes; l++) {
+			s = &chain->stages[0];
+			port = s->in_port;
+			j = s->hndl - port->node->hndl + l;
+			if (!spa_list_is_empty(&port->link_list)) {
+				link = spa_list_first(&port->link_list, struct link, input_link);
+				chain->in[l] = link->output->audio_data[j];
+			} else if (s->desc->flags & SPA_FGA_DESCRIPTOR_SUPPORTS_NULL_DATA) {
+				chain->in[l] = NULL;
+			} else {
+				chain->in[l] = impl->silence_data;
+			}
+
+			s = &chain->stages[chain->n_stages - 1];
+			port = s->out_port;
+			if (port->audio_data[j] != NULL)
+				chain->out[l] = port->audio_data[j];
+			else if (s->desc->flags & SPA_FGA_DESCRIPTOR_SUPPORTS_NULL_DATA)
+				chain->out[l] = NULL;
+			else
+				chain->out[l] = impl->discard_data;
+		}
+	}
+
 	/* now activate */
 	spa_list_for_each(node, &graph->node_list, link) {
 		desc = node->desc;
@@ -1716,6 +2426,7 @@ static int impl_activate(void *object, const struct spa_dict *props)
 	}
 	emit_filter_graph_info(impl, false);
 	spa_filter_graph_emit_props_changed(&impl->hooks, SPA_DIRECTION_INPUT);
+	profile_timer_update(impl, true);
 	return 0;
 error:
 	impl_deactivate(impl);
@@ -1730,8 +2441,235 @@ static void unsetup_graph(struct graph *graph)
 	graph->output = NULL;
 	free(graph->hndl);
 	graph->hndl = NULL;
+	free(graph->wave);
+	graph->wave = NULL;
+	graph->n_wave = 0;
+	free(graph->chain);
+	graph->chain = NULL;
+	graph->n_chain = 0;
+	free(graph->chain_mem);
+	graph->chain_mem = NULL;
+	free(graph->block_in);
+	graph->block_in = NULL;
+	free(graph->block_out);
+	graph->block_out = NULL;
+}
+/* builtin nodes that can run on a part of the samples at a time */
+static bool node_can_fuse(struct node *node)
+{
+	static const char * const labels[] = {
+		"copy", "mixer", "linear", "mult", "delay",
+	};
+	struct descriptor *desc = node->desc;
+	uint32_t i;
+	bool found = spa_strstartswith(desc->label, "bq_");
+
+	if (!node->graph->impl->fuse || node->disabled ||
+	    !spa_streq(desc->plugin->type, "builtin") || desc->n_output != 1)
+		return false;
+
+	for (i = 0; !found && i < SPA_N_ELEMENTS(labels); i++)
+		found = spa_streq(desc->label, labels[i]);
+	if (!found)
+		return false;
+
+	/* control links make the order of the nodes matter */
+	for (i = 0; i < desc->n_control; i++)
+		if (node->control_port[i].n_links > 0)
+			return false;
+	for (i = 0; i < desc->n_notify; i++)
+		if (node->notify_port[i].n_links > 0)
+			return false;
+	return true;
+}
+
+/* the only audio input with data */
+static struct port *node_fuse_input(struct node *node)
+{
+	struct graph *graph = node->graph;
+	struct node *first = spa_list_first(&graph->node_list, struct node, link);
+	struct port *port, *res = NULL;
+	uint32_t i;
 
+	for (i = 0; i < node->desc->n_input; i++) {
+		port = &node->input_port[i];
+		if (port->n_links == 0 && port->external == SPA_ID_INVALID &&
+		    (graph->n_input_names != 0 || node != first))
+			continue;
+		if (res != NULL)
+			return NULL;
+		res = port;
+	}
+	return res;
 }
+
+/* the node that gets all the output of the node and nothing else */
+static struct node *node_fuse_next(struct node *node)
+{
+	struct graph *graph = node->graph;
+	struct node *last = spa_list_last(&graph->node_list, struct node, link);
+	struct port *port = &node->output_port[0];
+	struct link *link;
+	struct node *next;
+
+	if (port->n_links != 1 || port->external != SPA_ID_INVALID ||
+	    (graph->n_output_names == 0 && node == last))
+		return NULL;
+
+	link = spa_list_first(&port->link_list, struct link, output_link);
+	next = link->input->node;
+	if (next->n_deps != 1 || !node_can_fuse(next) ||
+	    node_fuse_input(next) != link->input)
+		return NULL;
+	return next;
+}
+
+/* the number of instances, starting from instance i, that run together */
+static uint32_t hndl_lanes(struct impl *impl, uint32_t i, uint32_t n_hndl)
+{
+	return impl->lanes ? SPA_MIN(n_hndl - i, MAX_LANES) : 1;
+}
+
+static bool chain_can_multi(struct graph_chain *chain)
+{
+	uint32_t i;
+	for (i = 0; i < chain->n_stages; i++) {
+		if (chain->stages[i].desc->run_multi != NULL)
+			return true;
+	}
+	return false;
+}
+
+/* a node runs in the wave after the nodes it depends on. The nodes of a chain
+ * run with the first node of the chain. */
+static uint32_t node_level(struct node *node)
+{
+	struct link *link;
+	struct node *peer;
+	uint32_t i, level = 0;
+
+	for (i = 0; i < node->desc->n_input; i++) {
+		spa_list_for_each(link, &node->input_port[i].link_list, input_link) {
+			peer = link->output->node;
+			level = SPA_MAX(level, peer->level + (peer->fuse_next == node ? 0 : 1));
+		}
+	}
+	for (i = 0; i < node->desc->n_control; i++) {
+		spa_list_for_each(link, &node->control_port[i].link_list, input_link)
+			level = SPA_MAX(level, link->output->node->level + 1);
+	}
+	return level;
+}
+
+static void free_pool(struct impl *impl)
+{
+	if (impl->pool) {
+		thread_pool_free(impl->pool);
+		impl->pool = NULL;
+	}
+}
+
+/* order the handles by wave, the handles in a wave run in parallel on the
+ * thread pool. The pool is only made for graphs that have parallel waves. */
+static int setup_waves(struct graph *graph)
+{
+	struct impl *impl = graph->impl;
+	struct graph_wave *wave;
+	struct graph_hndl *hndl;
+	uint32_t i, n_wave = 0, max_hndl = 0, first = 0;
+
+	if (impl->n_threads < 2 || graph->n_hndl < MIN_PARALLEL)
+		goto serial;
+
+	for (i = 0; i < graph->n_hndl; i++)
+		n_wave = SPA_MAX(n_wave, graph->hndl[i].level + 1);
+
+	wave = calloc(n_wave, sizeof(struct graph_wave));
+	hndl = calloc(graph->n_hndl, sizeof(struct graph_hndl));
+	if (wave == NULL || hndl == NULL) {
+		free(wave);
+		free(hndl);
+		return -errno;
+	}
+	for (i = 0; i < graph->n_hndl; i++)
+		wave[graph->hndl[i].level].n_hndl++;
+	for (i = 0; i < n_wave; i++) {
+		max_hndl = SPA_MAX(max_hndl, wave[i].n_hndl);
+		wave[i].first = first;
+		first += wave[i].n_hndl;
+		wave[i].n_hndl = 0;
+	}
+	if (max_hndl < 2) {
+		/* nothing can run in parallel */
+		free(wave);
+		free(hndl);
+		goto serial;
+	}
+	if (impl->pool == NULL &&
+	    (impl->pool = thread_pool_new(impl->log, impl->thread_utils,
+					  impl->n_threads)) == NULL) {
+		spa_log_warn(impl->log, "%p: can't create thread pool, running serially: %m",
+				impl);
+		free(wave);
+		free(hndl);
+		return 0;
+	}
+	for (i = 0; i < graph->n_hndl; i++) {
+		struct graph_wave *w = &wave[graph->hndl[i].level];
+		hndl[w->first + w->n_hndl++] = graph->hndl[i];
+	}
+	spa_log_info(impl->log, "%p: %d handles in %d waves, max %d in parallel",
+			impl, graph->n_hndl, n_wave, max_hndl);
+
+	free(graph->hndl);
+	graph->hndl = hndl;
+	graph->wave = wave;
+	graph->n_wave = n_wave;
+	return 0;
+
+serial:
+	free_pool(impl);
+	return 0;
+}
+
+/* find the linear chains of nodes and give each node its place in a chain */
+static uint32_t setup_chains(struct graph *graph)
+{
+	struct impl *impl = graph->impl;
+	struct node *node, *n, *prev;
+	uint32_t n_chain = 0, len;
+
+	spa_list_for_each(node, &graph->node_list, link) {
+		node->fuse_next = NULL;
+		node->fuse_prev = false;
+		node->chain = SPA_ID_INVALID;
+		node->chain_pos = 0;
+	}
+	spa_list_for_each(node, &graph->node_list, link) {
+		if (!node_can_fuse(node) || node_fuse_input(node) == NULL)
+			continue;
+		if ((node->fuse_next = node_fuse_next(node)) != NULL)
+			node->fuse_next->fuse_prev = true;
+	}
+	spa_list_for_each(node, &graph->node_list, link) {
+		if (node->fuse_prev)
+			continue;
+		/* long chains are split */
+		for (n = node; n != NULL && n->fuse_next != NULL; n_chain++) {
+			for (len = 0, prev = NULL; n != NULL && len < MAX_CHAIN; len++) {
+				spa_log_info(impl->log, "fuse %s in chain %d:%d",
+						n->name, n_chain, len);
+				n->chain = n_chain;
+				n->chain_pos = len;
+				prev = n;
+				n = n->fuse_next;
+			}
+			prev->fuse_next = NULL;
+		}
+	}
+	return n_chain;
+}
+
 static int setup_graph(struct graph *graph)
 {
 	struct impl *impl = graph->impl;
@@ -1826,6 +2764,18 @@ static int setup_graph(struct graph *graph)
 	}
 	spa_log_info(impl->log, "using %d instances %d %d", n_hndl, n_input, n_output);
 
+	graph->block_in = calloc(graph->n_inputs, sizeof(void *));
+	graph->block_out = calloc(graph->n_outputs, sizeof(void *));
+	if (graph->block_in == NULL || graph->block_out == NULL) {
+		res = -errno;
+		goto error;
+	}
+	for (i = 0; i < 2; i++) {
+		if ((res = volume_ensure(&graph->volume[i],
+				SPA_MAX(graph->n_inputs, graph->n_outputs))) < 0)
+			goto error;
+	}
+
 	graph->n_input = 0;
 	graph->input = calloc(n_input * 16 * n_hndl, sizeof(struct graph_port));
 	graph->n_output = 0;
@@ -1967,20 +2917,88 @@ static int setup_graph(struct graph *graph)
 		}
 	}
 
+	/* fuse the linear chains, each instance has its own chains */
+	graph->n_chain = setup_chains(graph) * n_hndl;
+	if (graph->n_chain > 0) {
+		graph->chain = calloc(graph->n_chain, sizeof(struct graph_chain));
+		graph->chain_mem = calloc(graph->n_chain * 2 * CHAIN_TILE * sizeof(float)
+				+ impl->max_align, 1);
+		if (graph->chain == NULL || graph->chain_mem == NULL) {
+			res = -errno;
+			goto error;
+		}
+		for (i = 0; i < graph->n_chain; i++) {
+			struct graph_chain *chain = &graph->chain[i];
+			float *mem = SPA_PTR_ALIGN(graph->chain_mem, impl->max_align, float);
+
+			chain->tile[0] = mem + i * 2 * CHAIN_TILE;
+			chain->tile[1] = chain->tile[0] + CHAIN_TILE;
+		}
+		spa_list_for_each(node, &graph->node_list, link) {
+			if (node->chain == SPA_ID_INVALID)
+				continue;
+			for (i = 0; i < n_hndl; i++) {
+				struct graph_chain *chain = &graph->chain[node->chain * n_hndl + i];
+				struct graph_stage *s = &chain->stages[node->chain_pos];
+
+				s->desc = node->desc->desc;
+				s->hndl = &node->hndl[i];
+				s->node = node;
+				s->in_port = node_fuse_input(node);
+				s->out_port = &node->output_port[0];
+				chain->n_stages = SPA_MAX(chain->n_stages, node->chain_pos + 1);
+			}
+		}
+		/* with lanes, the first chain of a group of instances runs the chains
+		 * of the whole group */
+		for (i = 0; i < graph->n_chain; i += n) {
+			struct graph_chain *chain = &graph->chain[i];
+
+			n = chain_can_multi(chain) ? hndl_lanes(impl, i % n_hndl, n_hndl) : 1;
+			chain->n_lanes = n;
+		}
+		for (i = 0; i < graph->n_input + graph->n_output; i++) {
+			struct graph_chain *chain;
+
+			gp = i < graph->n_input ? &graph->input[i] : &graph->output[i - graph->n_input];
+			if (gp->desc == NULL || gp->node->chain == SPA_ID_INVALID)
+				continue;
+			chain = &graph->chain[gp->node->chain * n_hndl + (gp->hndl - gp->node->hndl)];
+			if (i < graph->n_input ?
+			    gp->node->chain_pos == 0 :
+			    gp->node->chain_pos == chain->n_stages - 1) {
+				for (gp->lane = 0; chain->n_lanes == 0; gp->lane++)
+					chain--;
+				gp->chain = chain;
+			}
+		}
+	}
+
 	graph->n_hndl = 0;
 	graph->hndl = calloc(graph->n_nodes * n_hndl, sizeof(struct graph_hndl));
 	/* order all nodes based on dependencies, first reset fields */
 	sort_reset(graph);
 	while ((node = sort_next_node(graph)) != NULL) {
 		node->n_hndl = n_hndl;
+		node->level = node_level(node);
 		desc = node->desc;
 		d = desc->desc;
 
-		if (!node->disabled) {
-			for (i = 0; i < n_hndl; i++) {
+		/* a chain runs all its nodes in the place of the first one */
+		if (!node->disabled && node->chain_pos == 0) {
+			for (i = 0; i < n_hndl; i += n) {
 				gh = &graph->hndl[graph->n_hndl++];
 				gh->hndl = &node->hndl[i];
 				gh->desc = d;
+				gh->node = node;
+				gh->level = node->level;
+				if (node->chain != SPA_ID_INVALID) {
+					gh->chain = &graph->chain[node->chain * n_hndl + i];
+					n = gh->chain->n_lanes;
+				} else {
+					n = d->run_multi != NULL ? hndl_lanes(impl, i, n_hndl) : 1;
+				}
+				gh->n_hndl = n;
 			}
 		}
 		for (i = 0; i < desc->n_control; i++) {
@@ -1991,7 +3009,7 @@ static int setup_graph(struct graph *graph)
 				port->control_data[j] = port->control_data[0];
 		}
 	}
-	res = 0;
+	res = setup_waves(graph);
 error:
 	return res;
 }
@@ -2002,13 +3020,17 @@ static int setup_graph_controls(struct graph *graph)
 	uint32_t i, n_control = 0;
 
 	graph->control_port = calloc(graph->n_control, sizeof(struct port *));
-	if (graph->control_port == NULL)
+	graph->ramp = calloc(graph->n_control, sizeof(struct control_ramp));
+	graph->ramping = calloc(graph->n_control, sizeof(uint32_t));
+	if (graph->control_port == NULL || graph->ramp == NULL || graph->ramping == NULL)
 		return -errno;
 
 	spa_list_for_each(node, &graph->node_list, link) {
 		/* collect all control ports on the graph */
-		for (i = 0; i < node->desc->n_control; i++)
+		for (i = 0; i < node->desc->n_control; i++) {
+			node->control_port[i].control_id = n_control;
 			graph->control_port[n_control++] = &node->control_port[i];
+		}
 	}
 	return 0;
 }
@@ -2045,6 +3067,10 @@ static int load_graph(struct graph *graph, const struct spa_dict *props)
 	spa_list_init(&graph->node_list);
 	spa_list_init(&graph->link_list);
 
+	if ((res = volume_ensure(&graph->volume[0], 0)) < 0 ||
+	    (res = volume_ensure(&graph->volume[1], 0)) < 0)
+		return res;
+
 	if ((json = spa_dict_lookup(props, "filter.graph")) == NULL) {
 		spa_log_error(impl->log, "missing filter.graph property");
 		return -EINVAL;
@@ -2076,8 +3102,8 @@ static int load_graph(struct graph *graph, const struct spa_dict *props)
 				spa_log_error(impl->log, "%s expects an array", key);
 				return -EINVAL;
 			}
-			spa_audio_parse_position(val, len, graph->inputs_position,
-						&graph->n_inputs_position);
+			spa_audio_parse_position_n(val, len, graph->inputs_position,
+						MAX_CHANNELS, &graph->n_inputs_position);
 			impl->info.n_inputs = graph->n_inputs_position;
 		}
 		else if (spa_streq("outputs.audio.position", key)) {
@@ -2086,8 +3112,8 @@ static int load_graph(struct graph *graph, const struct spa_dict *props)
 				spa_log_error(impl->log, "%s expects an array", key);
 				return -EINVAL;
 			}
-			spa_audio_parse_position(val, len, graph->outputs_position,
-						&graph->n_outputs_position);
+			spa_audio_parse_position_n(val, len, graph->outputs_position,
+						MAX_CHANNELS, &graph->n_outputs_position);
 			impl->info.n_outputs = graph->n_outputs_position;
 		}
 		else if (spa_streq("nodes", key)) {
@@ -2194,6 +3220,7 @@ static void graph_free(struct graph *graph)
 	struct node *node;
 	uint32_t i;
 
+	control_reset(graph->impl);
 	unsetup_graph(graph);
 
 	spa_list_consume(link, &graph->link_list, link)
@@ -2208,6 +3235,13 @@ static void graph_free(struct graph *graph)
 	free(graph->output_names);
 	free(graph->control_port);
 	graph->control_port = NULL;
+	free(graph->ramp);
+	graph->ramp = NULL;
+	free(graph->ramping);
+	graph->ramping = NULL;
+	graph->n_ramping = 0;
+	volume_free(&graph->volume[0]);
+	volume_free(&graph->volume[1]);
 }
 
 static const struct spa_filter_graph_methods impl_filter_graph = {
@@ -2220,6 +3254,7 @@ static const struct spa_filter_graph_methods impl_filter_graph = {
 	.deactivate = impl_deactivate,
 	.reset = impl_reset,
 	.process = impl_process,
+	.set_control = impl_set_control,
 };
 
 static int impl_get_interface(struct spa_handle *handle, const char *type, void **interface)
@@ -2245,6 +3280,10 @@ static int impl_clear(struct spa_handle *handle)
 
 	graph_free(&impl->graph);
 
+	if (impl->profile_timer)
+		spa_loop_utils_destroy_source(impl->loop_utils, impl->profile_timer);
+	if (impl->pool)
+		thread_pool_free(impl->pool);
 	if (impl->dsp)
 		spa_fga_dsp_free(impl->dsp);
 
@@ -2286,6 +3325,14 @@ impl_init(const struct spa_handle_factory *factory,
 	impl->dsp = spa_fga_dsp_new(impl->cpu ? spa_cpu_get_flags(impl->cpu) : 0);
 
 	impl->loader = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_PluginLoader);
+	impl->thread_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_ThreadUtils);
+	impl->loop_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_LoopUtils);
+	impl->fuse = true;
+	impl->lanes = false;
+	impl->ramp_time = DEFAULT_RAMP;
+	impl->ramp_block = DEFAULT_RAMP_BLOCK;
+	impl->silence_timeout = DEFAULT_SILENCE_TIMEOUT;
+	spa_ringbuffer_init(&impl->control_ring);
 
 	spa_list_init(&impl->plugin_list);
 
@@ -2298,7 +3345,22 @@ impl_init(const struct spa_handle_factory *factory,
 			spa_atou32(s, &impl->info.n_inputs, 0);
 		if (spa_streq(k, "filter-graph.n_outputs"))
 			spa_atou32(s, &impl->info.n_outputs, 0);
-	}
+		if (spa_streq(k, "filter-graph.fuse"))
+			impl->fuse = spa_atob(s);
+		if (spa_streq(k, "filter-graph.lanes"))
+			impl->lanes = spa_atob(s);
+		if (spa_streq(k, "filter-graph.threads"))
+			spa_atou32(s, &impl->n_threads, 0);
+		if (spa_streq(k, "filter-graph.ramp"))
+			spa_atof(s, &impl->ramp_time);
+		if (spa_streq(k, "filter-graph.ramp-block"))
+			spa_atou32(s, &impl->ramp_block, 0);
+		if (spa_streq(k, "filter-graph.profile"))
+			impl->profile = spa_atob(s);
+		if (spa_streq(k, "filter-graph.silence-timeout"))
+			spa_atof(s, &impl->silence_timeout);
+	}
+	impl->ramp_block = SPA_MAX(impl->ramp_block, 1u);
 	if (impl->quantum_limit == 0)
 		return -EINVAL;
 
@@ -2319,6 +3381,15 @@ impl_init(const struct spa_handle_factory *factory,
 		goto error;
 	}
 
+	if (impl->profile) {
+		if (impl->loop_utils != NULL)
+			impl->profile_timer = spa_loop_utils_add_timer(impl->loop_utils,
+					on_profile_timeout, impl);
+		if (impl->profile_timer == NULL)
+			spa_log_warn(impl->log, "%p: no main loop timer, the load is "
+					"only emitted on activate", impl);
+	}
+
 	impl->filter_graph.iface = SPA_INTERFACE_INIT(
 			SPA_TYPE_INTERFACE_FilterGraph,
 			SPA_VERSION_FILTER_GRAPH,
@@ -2327,6 +3398,8 @@ impl_init(const struct spa_handle_factory *factory,
 
 	return 0;
 error:
+	if (impl->pool)
+		thread_pool_free(impl->pool);
 	free(impl->silence_data);
 	free(impl->discard_data);
 	return res;
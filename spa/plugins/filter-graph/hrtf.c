@@ -0,0 +1,453 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "hrtf.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <spa/utils/defs.h>
+
+#define MAX_WEIGHTS	16
+#define N_SLOTS		4
+
+/* the contributions that are faded out and in during a block */
+#define STEADY		0
+#define FADE_OUT	1
+#define FADE_IN		2
+#define N_CLASSES	3
+
+struct hrtf_table {
+	struct spa_fga_dsp *dsp;
+	int blockSize;
+	int segCount;
+	int fftComplexSize;
+	int cstride;
+	int n_dirs;
+	float *data;
+};
+
+struct source {
+	float *window;
+	float **segments;
+	/* the responses, for each ear segCount segments */
+	float *slot[N_SLOTS];
+	int cur;
+	int prev;
+	int next;
+	int spare;
+};
+
+struct hrtf_renderer {
+	struct spa_fga_dsp *dsp;
+	const struct hrtf_table *table;
+
+	int blockSize;
+	int segSize;
+	int segCount;
+	int fftComplexSize;
+	int cstride;
+	float scale;
+
+	void *fft;
+	void *ifft;
+	float *fft_buffer;
+
+	float *pre[N_CLASSES][2];
+	float *acc[N_CLASSES][2];
+	uint32_t active;
+
+	int fill;
+	int current;
+
+	int n_sources;
+	struct source sources[];
+};
+
+static int next_power_of_two(int val)
+{
+	int r = 1;
+	while (r < val)
+		r *= 2;
+	return r;
+}
+
+static inline float *table_segment(const struct hrtf_table *t, int dir, int ear, int seg)
+{
+	return t->data + (size_t)((dir * 2 + ear) * t->segCount + seg) * t->cstride * 2;
+}
+
+static inline float *slot_segment(const struct hrtf_renderer *r, float *slot, int ear, int seg)
+{
+	return slot + (size_t)(ear * r->segCount + seg) * r->cstride * 2;
+}
+
+struct hrtf_table *hrtf_table_new(struct spa_fga_dsp *dsp, int block, const float *ir,
+		int n_dirs, int ir_len)
+{
+	struct hrtf_table *t;
+	void *fft = NULL;
+	float *fft_buffer = NULL;
+	int i, j, k, segSize;
+
+	if (block <= 0 || n_dirs <= 0 || ir_len <= 0)
+		return NULL;
+
+	t = calloc(1, sizeof(*t));
+	if (t == NULL)
+		return NULL;
+
+	t->dsp = dsp;
+	t->n_dirs = n_dirs;
+	t->blockSize = next_power_of_two(block);
+	t->segCount = (ir_len + t->blockSize - 1) / t->blockSize;
+	t->fftComplexSize = t->blockSize + 1;
+	t->cstride = SPA_ROUND_UP_N(t->fftComplexSize, 8);
+	segSize = 2 * t->blockSize;
+
+	t->data = spa_fga_dsp_fft_memalloc(dsp, n_dirs * 2 * t->segCount * t->cstride, false);
+	fft = spa_fga_dsp_fft_new(dsp, segSize, true);
+	fft_buffer = spa_fga_dsp_fft_memalloc(dsp, segSize, true);
+	if (t->data == NULL || fft == NULL || fft_buffer == NULL)
+		goto error;
+
+	for (i = 0; i < n_dirs; i++) {
+		for (j = 0; j < 2; j++) {
+			const float *r = &ir[(i * 2 + j) * ir_len];
+
+			for (k = 0; k < t->segCount; k++) {
+				int copy = SPA_MIN(t->blockSize, ir_len - k * t->blockSize);
+
+				spa_fga_dsp_copy(dsp, fft_buffer, &r[k * t->blockSize], copy);
+				spa_fga_dsp_fft_memclear(dsp, fft_buffer + copy, segSize - copy, true);
+				spa_fga_dsp_fft_run(dsp, fft, 1, fft_buffer, table_segment(t, i, j, k));
+			}
+		}
+	}
+	spa_fga_dsp_fft_free(dsp, fft);
+	spa_fga_dsp_fft_memfree(dsp, fft_buffer);
+	return t;
+error:
+	if (fft)
+		spa_fga_dsp_fft_free(dsp, fft);
+	spa_fga_dsp_fft_memfree(dsp, fft_buffer);
+	hrtf_table_free(t);
+	return NULL;
+}
+
+void hrtf_table_free(struct hrtf_table *t)
+{
+	spa_fga_dsp_fft_memfree(t->dsp, t->data);
+	free(t);
+}
+
+void hrtf_renderer_free(struct hrtf_renderer *r)
+{
+	struct spa_fga_dsp *dsp = r->dsp;
+	int i, j;
+
+	for (i = 0; i < r->n_sources; i++) {
+		struct source *s = &r->sources[i];
+
+		for (j = 0; s->segments && j < r->segCount; j++)
+			spa_fga_dsp_fft_memfree(dsp, s->segments[j]);
+		free(s->segments);
+		for (j = 0; j < N_SLOTS; j++)
+			spa_fga_dsp_fft_memfree(dsp, s->slot[j]);
+		spa_fga_dsp_fft_memfree(dsp, s->window);
+	}
+	for (i = 0; i < N_CLASSES; i++) {
+		for (j = 0; j < 2; j++) {
+			spa_fga_dsp_fft_memfree(dsp, r->pre[i][j]);
+			spa_fga_dsp_fft_memfree(dsp, r->acc[i][j]);
+		}
+	}
+	if (r->fft)
+		spa_fga_dsp_fft_free(dsp, r->fft);
+	if (r->ifft)
+		spa_fga_dsp_fft_free(dsp, r->ifft);
+	spa_fga_dsp_fft_memfree(dsp, r->fft_buffer);
+	free(r);
+}
+
+static void source_clear(struct hrtf_renderer *r, struct source *s)
+{
+	int i;
+	spa_fga_dsp_fft_memclear(r->dsp, s->window, r->segSize, true);
+	for (i = 0; i < r->segCount; i++)
+		spa_fga_dsp_fft_memclear(r->dsp, s->segments[i], r->fftComplexSize, false);
+}
+
+void hrtf_renderer_reset(struct hrtf_renderer *r)
+{
+	int i;
+	for (i = 0; i < r->n_sources; i++)
+		source_clear(r, &r->sources[i]);
+	r->fill = 0;
+	r->current = 0;
+}
+
+struct hrtf_renderer *hrtf_renderer_new(struct spa_fga_dsp *dsp,
+		const struct hrtf_table *table, int n_sources)
+{
+	struct hrtf_renderer *r;
+	int i, j;
+
+	if (n_sources <= 0)
+		return NULL;
+
+	r = calloc(1, sizeof(*r) + n_sources * sizeof(struct source));
+	if (r == NULL)
+		return NULL;
+
+	r->dsp = dsp;
+	r->table = table;
+	r->n_sources = n_sources;
+	r->blockSize = table->blockSize;
+	r->segSize = 2 * r->blockSize;
+	r->segCount = table->segCount;
+	r->fftComplexSize = table->fftComplexSize;
+	r->cstride = table->cstride;
+	r->scale = 1.0f / r->segSize;
+
+	r->fft = spa_fga_dsp_fft_new(dsp, r->segSize, true);
+	r->ifft = spa_fga_dsp_fft_new(dsp, r->segSize, true);
+	r->fft_buffer = spa_fga_dsp_fft_memalloc(dsp, r->segSize, true);
+	if (r->fft == NULL || r->ifft == NULL || r->fft_buffer == NULL)
+		goto error;
+
+	for (i = 0; i < N_CLASSES; i++) {
+		for (j = 0; j < 2; j++) {
+			r->pre[i][j] = spa_fga_dsp_fft_memalloc(dsp, r->fftComplexSize, false);
+			r->acc[i][j] = spa_fga_dsp_fft_memalloc(dsp, r->fftComplexSize, false);
+			if (r->pre[i][j] == NULL || r->acc[i][j] == NULL)
+				goto error;
+		}
+	}
+	for (i = 0; i < n_sources; i++) {
+		struct source *s = &r->sources[i];
+
+		s->cur = s->prev = s->next = -1;
+		s->spare = 0;
+		s->window = spa_fga_dsp_fft_memalloc(dsp, r->segSize, true);
+		s->segments = calloc(r->segCount, sizeof(float*));
+		if (s->window == NULL || s->segments == NULL)
+			goto error;
+		for (j = 0; j < r->segCount; j++) {
+			s->segments[j] = spa_fga_dsp_fft_memalloc(dsp, r->fftComplexSize, false);
+			if (s->segments[j] == NULL)
+				goto error;
+		}
+		for (j = 0; j < N_SLOTS; j++) {
+			s->slot[j] = spa_fga_dsp_fft_memalloc(dsp, 2 * r->segCount * r->cstride, false);
+			if (s->slot[j] == NULL)
+				goto error;
+		}
+	}
+	hrtf_renderer_reset(r);
+	return r;
+error:
+	hrtf_renderer_free(r);
+	return NULL;
+}
+
+int hrtf_renderer_prepare(struct hrtf_renderer *r, int source,
+		const int *dirs, const float *weights, int n)
+{
+	const struct hrtf_table *t = r->table;
+	const float *src[MAX_WEIGHTS];
+	float gain[MAX_WEIGHTS];
+	struct source *s;
+	int i, j, k, n_src = 0;
+
+	if (source < 0 || source >= r->n_sources)
+		return -EINVAL;
+
+	s = &r->sources[source];
+
+	for (j = 0; j < 2; j++) {
+		for (k = 0; k < r->segCount; k++) {
+			for (i = 0, n_src = 0; i < n && n_src < MAX_WEIGHTS; i++) {
+				if (dirs[i] < 0 || dirs[i] >= t->n_dirs || weights[i] == 0.0f)
+					continue;
+				src[n_src] = table_segment(t, dirs[i], j, k);
+				gain[n_src++] = weights[i];
+			}
+			/* the spectra are linear in the response, whatever their layout */
+			spa_fga_dsp_mix_gain(r->dsp, slot_segment(r, s->slot[s->spare], j, k),
+					src, n_src, gain, n_src, r->fftComplexSize * 2);
+		}
+	}
+	return n_src > 0 ? 0 : -EINVAL;
+}
+
+void hrtf_renderer_commit(struct hrtf_renderer *r, int source)
+{
+	struct source *s = &r->sources[source];
+	int i;
+
+	if (s->next >= 0) {
+		SPA_SWAP(s->next, s->spare);
+		return;
+	}
+	s->next = s->spare;
+	for (i = 0; i < N_SLOTS; i++) {
+		if (i != s->cur && i != s->prev && i != s->next) {
+			s->spare = i;
+			break;
+		}
+	}
+}
+
+static inline bool source_active(const struct source *s, const float *in)
+{
+	return in != NULL && s->cur >= 0;
+}
+
+static void accumulate(struct hrtf_renderer *r, float *acc[2], float *segment,
+		float *slot, int seg)
+{
+	int j;
+	for (j = 0; j < 2; j++)
+		spa_fga_dsp_fft_cmuladd(r->dsp, r->fft, acc[j], acc[j], segment,
+				slot_segment(r, slot, j, seg), r->fftComplexSize, r->scale);
+}
+
+static void start_block(struct hrtf_renderer *r, const float *in[])
+{
+	int i, j, k;
+
+	r->active = 0;
+	for (i = 0; i < r->n_sources; i++) {
+		struct source *s = &r->sources[i];
+
+		if (in[i] == NULL)
+			continue;
+
+		s->prev = -1;
+		if (s->next >= 0) {
+			if (s->cur < 0)
+				source_clear(r, s);
+			else
+				s->prev = s->cur;
+			s->cur = s->next;
+			s->next = -1;
+		}
+		if (s->cur >= 0)
+			r->active |= 1 << (s->prev >= 0 ? FADE_IN : STEADY);
+		if (s->prev >= 0)
+			r->active |= 1 << FADE_OUT;
+	}
+
+	for (i = 0; i < N_CLASSES; i++) {
+		if (r->active & (1 << i))
+			for (j = 0; j < 2; j++)
+				spa_fga_dsp_fft_memclear(r->dsp, r->pre[i][j], r->fftComplexSize, false);
+	}
+	if (r->segCount == 1)
+		return;
+
+	/* the older input blocks don't change during the block */
+	for (i = 0; i < r->n_sources; i++) {
+		struct source *s = &r->sources[i];
+
+		if (!source_active(s, in[i]))
+			continue;
+
+		for (k = 1; k < r->segCount; k++) {
+			float *segment = s->segments[(r->current + k) % r->segCount];
+
+			if (s->prev >= 0) {
+				accumulate(r, r->pre[FADE_OUT], segment, s->slot[s->prev], k);
+				accumulate(r, r->pre[FADE_IN], segment, s->slot[s->cur], k);
+			} else {
+				accumulate(r, r->pre[STEADY], segment, s->slot[s->cur], k);
+			}
+		}
+	}
+}
+
+void hrtf_renderer_run(struct hrtf_renderer *r, const float *in[], float *out[2], int length)
+{
+	int processed = 0, i, j, k, n;
+
+	while (processed < length) {
+		const int processing = SPA_MIN(length - processed, r->blockSize - r->fill);
+		const int pos = r->blockSize + r->fill;
+
+		if (r->fill == 0)
+			start_block(r, in);
+
+		for (i = 0; i < N_CLASSES; i++) {
+			if (r->active & (1 << i))
+				for (j = 0; j < 2; j++)
+					spa_fga_dsp_copy(r->dsp, r->acc[i][j], r->pre[i][j],
+							r->fftComplexSize * 2);
+		}
+
+		/* overlap-save: each window is the previous and the current block,
+		 * the response only depends on the input, not on previous output */
+		for (i = 0; i < r->n_sources; i++) {
+			struct source *s = &r->sources[i];
+			float *segment = s->segments[r->current];
+
+			if (!source_active(s, in[i]))
+				continue;
+
+			if (r->fill == 0)
+				spa_fga_dsp_fft_memclear(r->dsp, s->window + r->blockSize,
+						r->blockSize, true);
+			spa_fga_dsp_copy(r->dsp, s->window + pos, in[i] + processed, processing);
+			spa_fga_dsp_fft_run(r->dsp, r->fft, 1, s->window, segment);
+
+			if (s->prev >= 0) {
+				accumulate(r, r->acc[FADE_OUT], segment, s->slot[s->prev], 0);
+				accumulate(r, r->acc[FADE_IN], segment, s->slot[s->cur], 0);
+			} else {
+				accumulate(r, r->acc[STEADY], segment, s->slot[s->cur], 0);
+			}
+		}
+
+		for (j = 0; j < 2; j++) {
+			float *o = out[j] ? out[j] + processed : NULL;
+
+			if (o == NULL)
+				continue;
+
+			if (r->active & (1 << STEADY)) {
+				spa_fga_dsp_fft_run(r->dsp, r->ifft, -1, r->acc[STEADY][j], r->fft_buffer);
+				spa_fga_dsp_copy(r->dsp, o, r->fft_buffer + pos, processing);
+			} else {
+				spa_fga_dsp_fft_memclear(r->dsp, o, processing, true);
+			}
+			if (r->active & (1 << FADE_OUT)) {
+				float t = (float)r->fill / r->blockSize, dt = 1.0f / r->blockSize;
+
+				spa_fga_dsp_fft_run(r->dsp, r->ifft, -1, r->acc[FADE_OUT][j], r->fft_buffer);
+				for (k = 0, n = pos; k < processing; k++, n++, t += dt)
+					o[k] += r->fft_buffer[n] * (1.0f - t);
+
+				t = (float)r->fill / r->blockSize;
+				spa_fga_dsp_fft_run(r->dsp, r->ifft, -1, r->acc[FADE_IN][j], r->fft_buffer);
+				for (k = 0, n = pos; k < processing; k++, n++, t += dt)
+					o[k] += r->fft_buffer[n] * t;
+			}
+		}
+
+		r->fill += processing;
+		if (r->fill == r->blockSize) {
+			r->fill = 0;
+			for (i = 0; i < r->n_sources; i++) {
+				struct source *s = &r->sources[i];
+
+				if (!source_active(s, in[i]))
+					continue;
+				spa_fga_dsp_copy(r->dsp, s->window, s->window + r->blockSize,
+						r->blockSize);
+			}
+			r->current = (r->current > 0) ? (r->current - 1) : (r->segCount - 1);
+		}
+		processed += processing;
+	}
+}
@@ -0,0 +1,34 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "audio-dsp.h"
+
+/* The left and right impulse responses of a set of directions, transformed
+ * to the frequency domain. ir has n_dirs * 2 * ir_len samples, for each
+ * direction the left and then the right response. */
+struct hrtf_table *hrtf_table_new(struct spa_fga_dsp *dsp, int block,
+		const float *ir, int n_dirs, int ir_len);
+void hrtf_table_free(struct hrtf_table *table);
+
+/* Renders n_sources mono sources to stereo with the responses of a table.
+ * All sources are summed in the frequency domain and share the inverse
+ * transforms. */
+struct hrtf_renderer *hrtf_renderer_new(struct spa_fga_dsp *dsp,
+		const struct hrtf_table *table, int n_sources);
+void hrtf_renderer_free(struct hrtf_renderer *r);
+void hrtf_renderer_reset(struct hrtf_renderer *r);
+
+/* Prepare the response of a source as the weighted sum of the responses of
+ * n directions of the table. The new response is used after a commit and
+ * faded in over one block. Prepare and commit should not run concurrently
+ * with each other, commit should not run concurrently with process. */
+int hrtf_renderer_prepare(struct hrtf_renderer *r, int source,
+		const int *dirs, const float *weights, int n);
+void hrtf_renderer_commit(struct hrtf_renderer *r, int source);
+
+/* in has n_sources inputs, inputs can be NULL */
+void hrtf_renderer_run(struct hrtf_renderer *r, const float *in[], float *out[2], int length);
@@ -3,14 +3,17 @@
 /* SPDX-License-Identifier: MIT */
 
 #include <dlfcn.h>
+#include <errno.h>
 #include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include <lilv/lilv.h>
 
 #include <spa/utils/defs.h>
 #include <spa/utils/list.h>
+#include <spa/utils/ringbuffer.h>
 #include <spa/utils/string.h>
-#include <spa/support/loop.h>
 #include <spa/support/log.h>
 
 #if defined __has_include
@@ -212,8 +215,6 @@ struct plugin {
 	struct spa_fga_plugin plugin;
 
 	struct spa_log *log;
-	struct spa_loop *data_loop;
-	struct spa_loop *main_loop;
 
 	struct context *c;
 	const LilvPlugin *p;
@@ -224,6 +225,34 @@ struct descriptor {
 	struct plugin *p;
 };
 
+#define WORKER_RING_SIZE	(16u * 1024u)
+#define WORKER_RING_MASK	(WORKER_RING_SIZE - 1)
+
+/* A message in the worker rings, followed by size bytes of data */
+struct worker_msg {
+	uint32_t size;
+};
+
+/* The worker of an instance runs the non-RT work of the plugin on its own
+ * thread. The requests from run() and the responses of the work go through
+ * lock-free rings so that the data thread never blocks. */
+struct worker {
+	pthread_t thread;
+	sem_t sem;
+
+	struct spa_ringbuffer requests;
+	struct spa_ringbuffer responses;
+	uint8_t request_data[WORKER_RING_SIZE];
+	uint8_t response_data[WORKER_RING_SIZE];
+
+	/* the messages are copied out of the rings before they are
+	 * handed to the plugin */
+	uint8_t work_data[WORKER_RING_SIZE];
+	uint8_t response_msg[WORKER_RING_SIZE];
+
+	unsigned int running:1;
+};
+
 struct instance {
 	struct descriptor *desc;
 	struct plugin *p;
@@ -237,47 +266,157 @@ struct instance {
 	const LV2_Feature *features[7];
 
 	const LV2_Worker_Interface *work_iface;
+	struct worker *worker;
 
 	int32_t block_length;
 	LV2_Atom empty_atom;
 };
 
-static int
-do_respond(struct spa_loop *loop, bool async, uint32_t seq, const void *data,
-		size_t size, void *user_data)
+static int ring_write(struct spa_ringbuffer *ring, uint8_t *buffer,
+		uint32_t size, const void *data)
 {
-	struct instance *i = (struct instance*)user_data;
-	i->work_iface->work_response(i->instance->lv2_handle, size, data);
+	struct worker_msg msg = { .size = size };
+	uint32_t index;
+	int32_t filled;
+
+	filled = spa_ringbuffer_get_write_index(ring, &index);
+	if (filled < 0 || (uint32_t)filled + sizeof(msg) + size > WORKER_RING_SIZE)
+		return -ENOSPC;
+
+	spa_ringbuffer_write_data(ring, buffer, WORKER_RING_SIZE,
+			index & WORKER_RING_MASK, &msg, sizeof(msg));
+	index += sizeof(msg);
+	spa_ringbuffer_write_data(ring, buffer, WORKER_RING_SIZE,
+			index & WORKER_RING_MASK, data, size);
+	spa_ringbuffer_write_update(ring, index + size);
 	return 0;
 }
 
-/** Called by the plugin to respond to non-RT work. */
+/* read the next message into data, returns the size of the message or
+ * -ENOENT when the ring is empty */
+static int32_t ring_read(struct spa_ringbuffer *ring, uint8_t *buffer, void *data)
+{
+	struct worker_msg msg;
+	uint32_t index;
+	int32_t avail;
+
+	avail = spa_ringbuffer_get_read_index(ring, &index);
+	if (avail < (int32_t)sizeof(msg))
+		return -ENOENT;
+
+	spa_ringbuffer_read_data(ring, buffer, WORKER_RING_SIZE,
+			index & WORKER_RING_MASK, &msg, sizeof(msg));
+	index += sizeof(msg);
+	spa_ringbuffer_read_data(ring, buffer, WORKER_RING_SIZE,
+			index & WORKER_RING_MASK, data, msg.size);
+	spa_ringbuffer_read_update(ring, index + msg.size);
+	return msg.size;
+}
+
+/** Called by the plugin on the worker thread to respond to non-RT work. */
 static LV2_Worker_Status
 work_respond(LV2_Worker_Respond_Handle handle, uint32_t size, const void *data)
 {
 	struct instance *i = (struct instance*)handle;
-	spa_loop_invoke(i->p->data_loop, do_respond, 1, data, size, false, i);
+	struct worker *w = i->worker;
+
+	if (ring_write(&w->responses, w->response_data, size, data) < 0) {
+		spa_log_warn(i->p->log, "%p: worker response of %u bytes dropped", i, size);
+		return LV2_WORKER_ERR_NO_SPACE;
+	}
 	return LV2_WORKER_SUCCESS;
 }
 
-static int
-do_schedule(struct spa_loop *loop, bool async, uint32_t seq, const void *data,
-		size_t size, void *user_data)
+static void *worker_thread(void *data)
 {
-	struct instance *i = (struct instance*)user_data;
-	i->work_iface->work(i->instance->lv2_handle, work_respond, i, size, data);
-	return 0;
+	struct instance *i = data;
+	struct worker *w = i->worker;
+	int32_t size;
+
+	while (true) {
+		while (sem_wait(&w->sem) < 0 && errno == EINTR);
+
+		if (!w->running)
+			break;
+
+		while ((size = ring_read(&w->requests, w->request_data, w->work_data)) >= 0)
+			i->work_iface->work(i->instance->lv2_handle, work_respond, i,
+					size, w->work_data);
+	}
+	return NULL;
 }
 
-/** Called by the plugin to schedule non-RT work. */
+/** Called by the plugin in run() to schedule non-RT work. */
 static LV2_Worker_Status
 work_schedule(LV2_Worker_Schedule_Handle handle, uint32_t size, const void *data)
 {
 	struct instance *i = (struct instance*)handle;
-	spa_loop_invoke(i->p->main_loop, do_schedule, 1, data, size, false, i);
+	struct worker *w = i->worker;
+
+	if (w == NULL)
+		return LV2_WORKER_ERR_UNKNOWN;
+	if (ring_write(&w->requests, w->request_data, size, data) < 0)
+		return LV2_WORKER_ERR_NO_SPACE;
+
+	sem_post(&w->sem);
 	return LV2_WORKER_SUCCESS;
 }
 
+/* deliver the responses of the work, called in the context of run() */
+static void worker_deliver(struct instance *i)
+{
+	struct worker *w = i->worker;
+	int32_t size;
+
+	while ((size = ring_read(&w->responses, w->response_data, w->response_msg)) >= 0)
+		i->work_iface->work_response(i->instance->lv2_handle, size, w->response_msg);
+}
+
+static int worker_start(struct instance *i)
+{
+	struct worker *w;
+	int res;
+
+	w = calloc(1, sizeof(*w));
+	if (w == NULL)
+		return -errno;
+
+	spa_ringbuffer_init(&w->requests);
+	spa_ringbuffer_init(&w->responses);
+	if (sem_init(&w->sem, 0, 0) < 0) {
+		res = -errno;
+		free(w);
+		return res;
+	}
+	w->running = true;
+	i->worker = w;
+
+	if ((res = pthread_create(&w->thread, NULL, worker_thread, i)) != 0) {
+		spa_log_error(i->p->log, "%p: can't create worker thread: %s",
+				i, strerror(res));
+		sem_destroy(&w->sem);
+		free(w);
+		i->worker = NULL;
+		return -res;
+	}
+	return 0;
+}
+
+static void worker_stop(struct instance *i)
+{
+	struct worker *w = i->worker;
+
+	if (w == NULL)
+		return;
+
+	w->running = false;
+	sem_post(&w->sem);
+	pthread_join(w->thread, NULL);
+	sem_destroy(&w->sem);
+	free(w);
+	i->worker = NULL;
+}
+
 static void *lv2_instantiate(const struct spa_fga_plugin *plugin, const struct spa_fga_descriptor *desc,
                         unsigned long SampleRate, int index, const char *config)
 {
@@ -341,6 +480,11 @@ static void *lv2_instantiate(const struct spa_fga_plugin *plugin, const struct s
                 i->work_iface = (const LV2_Worker_Interface*)
 			lilv_instance_get_extension_data(i->instance, LV2_WORKER__interface);
         }
+	if (i->work_iface != NULL && worker_start(i) < 0) {
+		lilv_instance_free(i->instance);
+		free(i);
+		return NULL;
+	}
 	for (n = 0; n < desc->n_ports; n++) {
 		const LilvPort *port = lilv_plugin_get_port_by_index(p->p, n);
 		if (lilv_port_is_a(p->p, port, c->atom_AtomPort)) {
@@ -354,6 +498,7 @@ static void *lv2_instantiate(const struct spa_fga_plugin *plugin, const struct s
 static void lv2_cleanup(void *instance)
 {
 	struct instance *i = instance;
+	worker_stop(i);
 	lilv_instance_free(i->instance);
 	free(i);
 }
@@ -380,8 +525,10 @@ static void lv2_run(void *instance, unsigned long SampleCount)
 {
 	struct instance *i = instance;
 	lilv_instance_run(i->instance, SampleCount);
+	if (i->worker != NULL)
+		worker_deliver(i);
 	if (i->work_iface != NULL && i->work_iface->end_run != NULL)
-		i->work_iface->end_run(i->instance);
+		i->work_iface->end_run(i->instance->lv2_handle);
 }
 
 static void lv2_free(const struct spa_fga_descriptor *desc)
@@ -515,8 +662,6 @@ impl_init(const struct spa_handle_factory *factory,
 
 	impl = (struct plugin *) handle;
 	impl->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
-	impl->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
-	impl->main_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Loop);
 
 	for (i = 0; info && i < info->n_items; i++) {
 		const char *k = info->items[i].key;
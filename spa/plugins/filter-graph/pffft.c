@@ -147,7 +147,11 @@ typedef __m128 v4sf;
 #define VZERO() _mm_setzero_ps()
 #define VMUL(a,b) _mm_mul_ps(a,b)
 #define VADD(a,b) _mm_add_ps(a,b)
+#if defined(HAVE_AVX)
+#define VMADD(a,b,c) _mm_fmadd_ps(a,b,c)
+#else
 #define VMADD(a,b,c) _mm_add_ps(_mm_mul_ps(a,b), c)
+#endif
 #define VSUB(a,b) _mm_sub_ps(a,b)
 #define LD_PS1(p) _mm_set1_ps(p)
 #define INTERLEAVE2(in1, in2, out1, out2) { v4sf tmp__ = _mm_unpacklo_ps(in1, in2); out2 = _mm_unpackhi_ps(in1, in2); out1 = tmp__; }
@@ -155,12 +159,30 @@ typedef __m128 v4sf;
 #define VTRANSPOSE4(x0,x1,x2,x3) _MM_TRANSPOSE4_PS(x0,x1,x2,x3)
 #define VSWAPHL(a,b) _mm_shuffle_ps(b, a, _MM_SHUFFLE(3,2,1,0))
 #define VALIGNED(ptr) ((((uintptr_t)(ptr)) & 0xF) == 0)
+#if defined(HAVE_AVX)
+/*
+  AVX + FMA: the transforms keep the 4 float layout of SSE, the spectrum
+  products handle 2 blocks of 4 complex values at once.
+*/
+#include <immintrin.h>
+typedef __m256 v8sf;
+#define LD_CPLX8(p,re,im) { v8sf l__ = _mm256_loadu_ps(p), h__ = _mm256_loadu_ps((p) + 8); re = _mm256_permute2f128_ps(l__, h__, 0x20); im = _mm256_permute2f128_ps(l__, h__, 0x31); }
+#define ST_CPLX8(p,re,im) { _mm256_storeu_ps(p, _mm256_permute2f128_ps(re, im, 0x20)); _mm256_storeu_ps((p) + 8, _mm256_permute2f128_ps(re, im, 0x31)); }
+#define V8CPLXMUL(ar,ai,br,bi) { v8sf tr__ = _mm256_mul_ps(ai,bi), ti__ = _mm256_mul_ps(ai,br); ai = _mm256_fmadd_ps(ar,bi,ti__); ar = _mm256_fmsub_ps(ar,br,tr__); }
+#define pffft_funcs pffft_funcs_avx
+#define new_setup_simd new_setup_avx
+#define zreorder_simd zreorder_avx
+#define zconvolve_accumulate_simd zconvolve_accumulate_avx
+#define zconvolve_simd zconvolve_avx
+#define transform_simd transform_avx
+#else
 #define pffft_funcs pffft_funcs_sse
 #define new_setup_simd new_setup_sse
 #define zreorder_simd zreorder_sse
 #define zconvolve_accumulate_simd zconvolve_accumulate_sse
 #define zconvolve_simd zconvolve_sse
 #define transform_simd transform_sse
+#endif
 
 /*
   ARM NEON support macros
@@ -2040,6 +2062,21 @@ static void zconvolve_accumulate_simd(PFFFT_Setup * s, const float *a, const flo
 	cr = ((v4sf_union *) vc)[0].f[0];
 	ci = ((v4sf_union *) vc)[1].f[0];
 
+#if defined(V8CPLXMUL)
+	{
+		v8sf vscal8 = _mm256_set_m128(vscal, vscal);
+		for (i = 0; i < Ncvec2; i += 4) {
+			v8sf ar, ai, br, bi, cr, ci;
+			LD_CPLX8(a + i * SIMD_SZ, ar, ai);
+			LD_CPLX8(b + i * SIMD_SZ, br, bi);
+			LD_CPLX8(c + i * SIMD_SZ, cr, ci);
+			V8CPLXMUL(ar, ai, br, bi);
+			cr = _mm256_fmadd_ps(ar, vscal8, cr);
+			ci = _mm256_fmadd_ps(ai, vscal8, ci);
+			ST_CPLX8(ab + i * SIMD_SZ, cr, ci);
+		}
+	}
+#else
 	for (i = 0; i < Ncvec2; i += 4) {
 		v4sf ar, ai, br, bi;
 		ar = va[i + 0];
@@ -2057,6 +2094,7 @@ static void zconvolve_accumulate_simd(PFFFT_Setup * s, const float *a, const flo
 		vab[i + 2] = VMADD(ar, vscal, vc[i + 2]);
 		vab[i + 3] = VMADD(ai, vscal, vc[i + 3]);
 	}
+#endif
 	if (s->transform == PFFFT_REAL) {
 		((v4sf_union *) vab)[0].f[0] = cr + ar * br * scaling;
 		((v4sf_union *) vab)[1].f[0] = ci + ai * bi * scaling;
@@ -2095,6 +2133,20 @@ static void zconvolve_simd(PFFFT_Setup * s, const float *a, const float *b,
 	sbr = ((v4sf_union*)vb)[0].f[0];
 	sbi = ((v4sf_union*)vb)[1].f[0];
 
+#if defined(V8CPLXMUL)
+	{
+		v8sf vscal8 = _mm256_set_m128(vscal, vscal);
+		for (i = 0; i < Ncvec2; i += 4) {
+			v8sf var, vai, vbr, vbi;
+			LD_CPLX8(a + i * SIMD_SZ, var, vai);
+			LD_CPLX8(b + i * SIMD_SZ, vbr, vbi);
+			V8CPLXMUL(var, vai, vbr, vbi);
+			var = _mm256_mul_ps(var, vscal8);
+			vai = _mm256_mul_ps(vai, vscal8);
+			ST_CPLX8(ab + i * SIMD_SZ, var, vai);
+		}
+	}
+#else
 	/* default routine, works fine for non-arm cpus with current compilers */
 	for (i = 0; i < Ncvec2; i += 4) {
 		v4sf var, vai, vbr, vbi;
@@ -2113,6 +2165,7 @@ static void zconvolve_simd(PFFFT_Setup * s, const float *a, const float *b,
 		vab[i + 2] = VMUL(var, vscal);
 		vab[i + 3] = VMUL(vai, vscal);
 	}
+#endif
 
 	if (s->transform == PFFFT_REAL) {
 		((v4sf_union*)vab)[0].f[0] = sar * sbr * scaling;
@@ -2292,6 +2345,9 @@ extern struct funcs pffft_funcs_c;
 #if (defined(HAVE_SSE))
 extern struct funcs pffft_funcs_sse;
 #endif
+#if (defined(HAVE_AVX))
+extern struct funcs pffft_funcs_avx;
+#endif
 #if (defined(HAVE_ALTIVEC))
 extern struct funcs pffft_funcs_altivec;
 #endif
@@ -2368,6 +2424,10 @@ void pffft_select_cpu(int flags)
 	if (flags & SPA_CPU_FLAG_SSE)
 		funcs = &pffft_funcs_sse;
 #endif
+#if defined(HAVE_AVX)
+	if ((flags & SPA_CPU_FLAG_AVX) && (flags & SPA_CPU_FLAG_FMA3))
+		funcs = &pffft_funcs_avx;
+#endif
 #if defined(HAVE_NEON)
 	if (flags & SPA_CPU_FLAG_NEON)
 		funcs = &pffft_funcs_neon;
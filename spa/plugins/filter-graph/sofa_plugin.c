@@ -1,6 +1,7 @@
 #include "config.h"
 
 #include <limits.h>
+#include <math.h>
 
 #include <spa/utils/json.h>
 #include <spa/support/loop.h>
@@ -8,6 +9,7 @@
 
 #include "audio-plugin.h"
 #include "convolver.h"
+#include "hrtf.h"
 #include "audio-dsp.h"
 
 #include <mysofa.h>
@@ -40,70 +42,13 @@ struct spatializer_impl {
 	struct convolver *r_conv[3];
 };
 
-static void * spatializer_instantiate(const struct spa_fga_plugin *plugin, const struct spa_fga_descriptor * Descriptor,
-		unsigned long SampleRate, int index, const char *config)
+static struct MYSOFA_EASY *open_sofa(struct plugin *pl, const char *filename,
+		unsigned long rate, int *n_samples)
 {
-	struct plugin *pl = SPA_CONTAINER_OF(plugin, struct plugin, plugin);
-	struct spatializer_impl *impl;
-	struct spa_json it[1];
-	const char *val;
-	char key[256];
-	char filename[PATH_MAX] = "";
-	int len;
-
-	errno = EINVAL;
-	if (config == NULL) {
-		spa_log_error(pl->log, "spatializer: no config was given");
-		return NULL;
-	}
-
-	if (spa_json_begin_object(&it[0], config, strlen(config)) <= 0) {
-		spa_log_error(pl->log, "spatializer: expected object in config");
-		return NULL;
-	}
-
-	impl = calloc(1, sizeof(*impl));
-	if (impl == NULL) {
-		errno = ENOMEM;
-		return NULL;
-	}
-
-	impl->plugin = pl;
-	impl->dsp = pl->dsp;
-	impl->log = pl->log;
-
-	while ((len = spa_json_object_next(&it[0], key, sizeof(key), &val)) > 0) {
-		if (spa_streq(key, "blocksize")) {
-			if (spa_json_parse_int(val, len, &impl->blocksize) <= 0) {
-				spa_log_error(impl->log, "spatializer:blocksize requires a number");
-				errno = EINVAL;
-				goto error;
-			}
-		}
-		else if (spa_streq(key, "tailsize")) {
-			if (spa_json_parse_int(val, len, &impl->tailsize) <= 0) {
-				spa_log_error(impl->log, "spatializer:tailsize requires a number");
-				errno = EINVAL;
-				goto error;
-			}
-		}
-		else if (spa_streq(key, "filename")) {
-			if (spa_json_parse_stringn(val, len, filename, sizeof(filename)) <= 0) {
-				spa_log_error(impl->log, "spatializer:filename requires a string");
-				errno = EINVAL;
-				goto error;
-			}
-		}
-	}
-	if (!filename[0]) {
-		spa_log_error(impl->log, "spatializer:filename was not given");
-		errno = EINVAL;
-		goto error;
-	}
-
+	struct MYSOFA_EASY *sofa;
 	int ret = MYSOFA_OK;
 
-	impl->sofa = mysofa_open_cached(filename, SampleRate, &impl->n_samples, &ret);
+	sofa = mysofa_open_cached(filename, rate, n_samples, &ret);
 
 	if (ret != MYSOFA_OK) {
 		const char *reason;
@@ -174,10 +119,77 @@ static void * spatializer_instantiate(const struct spa_fga_plugin *plugin, const
 			reason = "Internal error";
 			break;
 		}
-		spa_log_error(impl->log, "Unable to load HRTF from %s: %s (%d)", filename, reason, ret);
+		spa_log_error(pl->log, "Unable to load HRTF from %s: %s (%d)", filename, reason, ret);
+		return NULL;
+	}
+	return sofa;
+}
+
+static void * spatializer_instantiate(const struct spa_fga_plugin *plugin, const struct spa_fga_descriptor * Descriptor,
+		unsigned long SampleRate, int index, const char *config)
+{
+	struct plugin *pl = SPA_CONTAINER_OF(plugin, struct plugin, plugin);
+	struct spatializer_impl *impl;
+	struct spa_json it[1];
+	const char *val;
+	char key[256];
+	char filename[PATH_MAX] = "";
+	int len;
+
+	errno = EINVAL;
+	if (config == NULL) {
+		spa_log_error(pl->log, "spatializer: no config was given");
+		return NULL;
+	}
+
+	if (spa_json_begin_object(&it[0], config, strlen(config)) <= 0) {
+		spa_log_error(pl->log, "spatializer: expected object in config");
+		return NULL;
+	}
+
+	impl = calloc(1, sizeof(*impl));
+	if (impl == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	impl->plugin = pl;
+	impl->dsp = pl->dsp;
+	impl->log = pl->log;
+
+	while ((len = spa_json_object_next(&it[0], key, sizeof(key), &val)) > 0) {
+		if (spa_streq(key, "blocksize")) {
+			if (spa_json_parse_int(val, len, &impl->blocksize) <= 0) {
+				spa_log_error(impl->log, "spatializer:blocksize requires a number");
+				errno = EINVAL;
+				goto error;
+			}
+		}
+		else if (spa_streq(key, "tailsize")) {
+			if (spa_json_parse_int(val, len, &impl->tailsize) <= 0) {
+				spa_log_error(impl->log, "spatializer:tailsize requires a number");
+				errno = EINVAL;
+				goto error;
+			}
+		}
+		else if (spa_streq(key, "filename")) {
+			if (spa_json_parse_stringn(val, len, filename, sizeof(filename)) <= 0) {
+				spa_log_error(impl->log, "spatializer:filename requires a string");
+				errno = EINVAL;
+				goto error;
+			}
+		}
+	}
+	if (!filename[0]) {
+		spa_log_error(impl->log, "spatializer:filename was not given");
+		errno = EINVAL;
 		goto error;
 	}
 
+	impl->sofa = open_sofa(pl, filename, SampleRate, &impl->n_samples);
+	if (impl->sofa == NULL)
+		goto error;
+
 	if (impl->blocksize <= 0)
 		impl->blocksize = SPA_CLAMP(impl->n_samples, 64, 256);
 	if (impl->tailsize <= 0)
@@ -414,6 +426,335 @@ static const struct spa_fga_descriptor spatializer_desc = {
 	.cleanup = spatializer_cleanup,
 };
 
+/** spatializer for many sources */
+#define MULTI_SOURCES	32
+#define MULTI_WEIGHTS	7
+
+#define MULTI_PORT_IN(i)	(2 + (i))
+#define MULTI_PORT_AZIMUTH(i)	(2 + MULTI_SOURCES + (i))
+#define MULTI_PORT_ELEVATION(i)	(2 + 2 * MULTI_SOURCES + (i))
+#define MULTI_PORT_RADIUS(i)	(2 + 3 * MULTI_SOURCES + (i))
+#define MULTI_PORT_LATENCY	(2 + 4 * MULTI_SOURCES)
+#define MULTI_N_PORTS		(MULTI_PORT_LATENCY + 1)
+
+struct multi_descriptor {
+	struct spa_fga_descriptor desc;
+	struct spa_fga_port ports[MULTI_N_PORTS];
+	char names[MULTI_N_PORTS][32];
+};
+
+struct multi_impl {
+	struct plugin *plugin;
+
+	struct spa_fga_dsp *dsp;
+	struct spa_log *log;
+
+	unsigned long rate;
+	float *port[MULTI_N_PORTS];
+	int n_samples, blocksize;
+
+	struct MYSOFA_EASY *sofa;
+	struct hrtf_table *table;
+	struct hrtf_renderer *renderer;
+
+	float coords[MULTI_SOURCES][3];
+	uint32_t changed;
+};
+
+static void * multi_instantiate(const struct spa_fga_plugin *plugin, const struct spa_fga_descriptor * Descriptor,
+		unsigned long SampleRate, int index, const char *config)
+{
+	struct plugin *pl = SPA_CONTAINER_OF(plugin, struct plugin, plugin);
+	struct multi_impl *impl;
+	struct MYSOFA_HRTF *hrtf;
+	struct spa_json it[1];
+	const char *val;
+	char key[256];
+	char filename[PATH_MAX] = "";
+	int i, len;
+
+	errno = EINVAL;
+	if (config == NULL) {
+		spa_log_error(pl->log, "spatializer_multi: no config was given");
+		return NULL;
+	}
+
+	if (spa_json_begin_object(&it[0], config, strlen(config)) <= 0) {
+		spa_log_error(pl->log, "spatializer_multi: expected object in config");
+		return NULL;
+	}
+
+	impl = calloc(1, sizeof(*impl));
+	if (impl == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	impl->plugin = pl;
+	impl->dsp = pl->dsp;
+	impl->log = pl->log;
+
+	while ((len = spa_json_object_next(&it[0], key, sizeof(key), &val)) > 0) {
+		if (spa_streq(key, "blocksize")) {
+			if (spa_json_parse_int(val, len, &impl->blocksize) <= 0) {
+				spa_log_error(impl->log, "spatializer_multi:blocksize requires a number");
+				errno = EINVAL;
+				goto error;
+			}
+		}
+		else if (spa_streq(key, "filename")) {
+			if (spa_json_parse_stringn(val, len, filename, sizeof(filename)) <= 0) {
+				spa_log_error(impl->log, "spatializer_multi:filename requires a string");
+				errno = EINVAL;
+				goto error;
+			}
+		}
+	}
+	if (!filename[0]) {
+		spa_log_error(impl->log, "spatializer_multi:filename was not given");
+		errno = EINVAL;
+		goto error;
+	}
+
+	impl->sofa = open_sofa(pl, filename, SampleRate, &impl->n_samples);
+	if (impl->sofa == NULL)
+		goto error;
+
+	hrtf = impl->sofa->hrtf;
+	if (hrtf->R != 2 || impl->sofa->lookup == NULL) {
+		spa_log_error(impl->log, "spatializer_multi: %s needs 2 receivers", filename);
+		errno = ENOTSUP;
+		goto error;
+	}
+
+	if (impl->blocksize <= 0)
+		impl->blocksize = SPA_CLAMP(impl->n_samples, 64, 256);
+
+	spa_log_info(impl->log, "using n_samples:%u %d blocksize %u directions sofa:%s",
+			impl->n_samples, impl->blocksize, hrtf->M, filename);
+
+	/* transform the responses of all measured directions once */
+	impl->table = hrtf_table_new(impl->dsp, impl->blocksize, hrtf->DataIR.values,
+			hrtf->M, hrtf->N);
+	if (impl->table == NULL)
+		goto error;
+	impl->renderer = hrtf_renderer_new(impl->dsp, impl->table, MULTI_SOURCES);
+	if (impl->renderer == NULL)
+		goto error;
+
+	for (i = 0; i < MULTI_SOURCES; i++)
+		impl->coords[i][0] = NAN;
+
+	impl->rate = SampleRate;
+	return impl;
+error:
+	if (impl->renderer)
+		hrtf_renderer_free(impl->renderer);
+	if (impl->table)
+		hrtf_table_free(impl->table);
+	if (impl->sofa)
+		mysofa_close_cached(impl->sofa);
+	free(impl);
+	return NULL;
+}
+
+/* interpolate between the closest measured direction and its neighbours,
+ * weighted with the inverse of their distance */
+static int multi_weights(struct multi_impl *impl, const float coords[3],
+		int dirs[MULTI_WEIGHTS], float weights[MULTI_WEIGHTS])
+{
+	const float *pos = impl->sofa->hrtf->SourcePosition.values;
+	const int *nb = NULL;
+	float c[3], sum = 0.0f;
+	int i, n = 0, nearest;
+
+	memcpy(c, coords, sizeof(c));
+	mysofa_s2c(c);
+
+	if ((nearest = mysofa_lookup(impl->sofa->lookup, c)) < 0)
+		return -ENOENT;
+
+	dirs[n++] = nearest;
+	if (impl->sofa->neighborhood)
+		nb = mysofa_neighborhood(impl->sofa->neighborhood, nearest);
+	for (i = 0; nb && i < 6; i++)
+		if (nb[i] >= 0)
+			dirs[n++] = nb[i];
+
+	for (i = 0; i < n; i++) {
+		const float *p = &pos[dirs[i] * 3];
+		float d = sqrtf((c[0] - p[0]) * (c[0] - p[0]) +
+				(c[1] - p[1]) * (c[1] - p[1]) +
+				(c[2] - p[2]) * (c[2] - p[2]));
+		if (d < 1e-6f) {
+			dirs[0] = dirs[i];
+			weights[0] = 1.0f;
+			return 1;
+		}
+		weights[i] = 1.0f / d;
+		sum += weights[i];
+	}
+	for (i = 0; i < n; i++)
+		weights[i] /= sum;
+	return n;
+}
+
+static int
+do_commit(struct spa_loop *loop, bool async, uint32_t seq, const void *data,
+		size_t size, void *user_data)
+{
+	struct multi_impl *impl = user_data;
+	int i;
+
+	for (i = 0; i < MULTI_SOURCES; i++)
+		if (impl->changed & (1u << i))
+			hrtf_renderer_commit(impl->renderer, i);
+	impl->changed = 0;
+	return 0;
+}
+
+static void multi_control_changed(void * Instance)
+{
+	struct multi_impl *impl = Instance;
+	int i, j, n, dirs[MULTI_WEIGHTS];
+	float weights[MULTI_WEIGHTS];
+
+	for (i = 0; i < MULTI_SOURCES; i++) {
+		float coords[3];
+
+		if (impl->port[MULTI_PORT_IN(i)] == NULL)
+			continue;
+
+		coords[0] = impl->port[MULTI_PORT_AZIMUTH(i)][0];
+		coords[1] = impl->port[MULTI_PORT_ELEVATION(i)][0];
+		coords[2] = impl->port[MULTI_PORT_RADIUS(i)][0];
+		if (memcmp(coords, impl->coords[i], sizeof(coords)) == 0)
+			continue;
+
+		if ((n = multi_weights(impl, coords, dirs, weights)) < 0 ||
+		    hrtf_renderer_prepare(impl->renderer, i, dirs, weights, n) < 0) {
+			spa_log_warn(impl->log, "no response for source %d at %f %f %f",
+					i, coords[0], coords[1], coords[2]);
+			continue;
+		}
+		for (j = 0; j < 3; j++)
+			impl->coords[i][j] = coords[j];
+		impl->changed |= 1u << i;
+	}
+	if (impl->changed)
+		spa_loop_invoke(impl->plugin->data_loop, do_commit, 1, NULL, 0, true, impl);
+}
+
+static void multi_run(void * Instance, unsigned long SampleCount)
+{
+	struct multi_impl *impl = Instance;
+	const float *in[MULTI_SOURCES];
+	float *out[2] = { impl->port[0], impl->port[1] };
+	int i;
+
+	for (i = 0; i < MULTI_SOURCES; i++)
+		in[i] = impl->port[MULTI_PORT_IN(i)];
+
+	hrtf_renderer_run(impl->renderer, in, out, SampleCount);
+
+	if (impl->port[MULTI_PORT_LATENCY] != NULL)
+		impl->port[MULTI_PORT_LATENCY][0] = impl->n_samples;
+}
+
+static void multi_connect_port(void * Instance, unsigned long Port,
+                        float * DataLocation)
+{
+	struct multi_impl *impl = Instance;
+	impl->port[Port] = DataLocation;
+}
+
+static void multi_activate(void * Instance)
+{
+	struct multi_impl *impl = Instance;
+	if (impl->port[MULTI_PORT_LATENCY] != NULL)
+		impl->port[MULTI_PORT_LATENCY][0] = impl->n_samples;
+}
+
+static void multi_deactivate(void * Instance)
+{
+	struct multi_impl *impl = Instance;
+	hrtf_renderer_reset(impl->renderer);
+}
+
+static void multi_cleanup(void * Instance)
+{
+	struct multi_impl *impl = Instance;
+
+	hrtf_renderer_free(impl->renderer);
+	hrtf_table_free(impl->table);
+	mysofa_close_cached(impl->sofa);
+	free(impl);
+}
+
+static void multi_free(const struct spa_fga_descriptor *desc)
+{
+	free((struct multi_descriptor *)desc);
+}
+
+static const struct spa_fga_descriptor *multi_make_desc(void)
+{
+	struct multi_descriptor *d;
+	struct spa_fga_port *p;
+	uint32_t i;
+
+	d = calloc(1, sizeof(*d));
+	if (d == NULL)
+		return NULL;
+
+	d->desc.name = "spatializer_multi";
+	d->desc.flags = SPA_FGA_DESCRIPTOR_SUPPORTS_NULL_DATA;
+	d->desc.free = multi_free;
+	d->desc.n_ports = MULTI_N_PORTS;
+	d->desc.ports = d->ports;
+	d->desc.instantiate = multi_instantiate;
+	d->desc.connect_port = multi_connect_port;
+	d->desc.control_changed = multi_control_changed;
+	d->desc.activate = multi_activate;
+	d->desc.deactivate = multi_deactivate;
+	d->desc.run = multi_run;
+	d->desc.cleanup = multi_cleanup;
+
+	for (i = 0; i < MULTI_N_PORTS; i++) {
+		d->ports[i].index = i;
+		d->ports[i].name = d->names[i];
+	}
+	snprintf(d->names[0], sizeof(d->names[0]), "Out L");
+	snprintf(d->names[1], sizeof(d->names[1]), "Out R");
+	d->ports[0].flags = d->ports[1].flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_AUDIO;
+
+	for (i = 0; i < MULTI_SOURCES; i++) {
+		p = &d->ports[MULTI_PORT_IN(i)];
+		snprintf(d->names[p->index], sizeof(d->names[0]), "In %u", i + 1);
+		p->flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_AUDIO;
+
+		p = &d->ports[MULTI_PORT_AZIMUTH(i)];
+		snprintf(d->names[p->index], sizeof(d->names[0]), "Azimuth %u", i + 1);
+		p->flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_CONTROL;
+		p->def = 0.0f; p->min = 0.0f; p->max = 360.0f;
+
+		p = &d->ports[MULTI_PORT_ELEVATION(i)];
+		snprintf(d->names[p->index], sizeof(d->names[0]), "Elevation %u", i + 1);
+		p->flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_CONTROL;
+		p->def = 0.0f; p->min = -90.0f; p->max = 90.0f;
+
+		p = &d->ports[MULTI_PORT_RADIUS(i)];
+		snprintf(d->names[p->index], sizeof(d->names[0]), "Radius %u", i + 1);
+		p->flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_CONTROL;
+		p->def = 1.0f; p->min = 0.0f; p->max = 100.0f;
+	}
+	p = &d->ports[MULTI_PORT_LATENCY];
+	snprintf(d->names[p->index], sizeof(d->names[0]), "latency");
+	p->hint = SPA_FGA_HINT_LATENCY;
+	p->flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL;
+
+	return &d->desc;
+}
+
 static const struct spa_fga_descriptor * sofa_descriptor(unsigned long Index)
 {
 	switch(Index) {
@@ -434,6 +775,8 @@ static const struct spa_fga_descriptor *sofa_plugin_make_desc(void *plugin, cons
 		if (spa_streq(d->name, name))
 			return d;
 	}
+	if (spa_streq(name, "spatializer_multi"))
+		return multi_make_desc();
 	return NULL;
 }
 
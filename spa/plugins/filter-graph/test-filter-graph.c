@@ -0,0 +1,428 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/plugin-loader.h>
+#include <spa/support/log-impl.h>
+#include <spa/support/cpu.h>
+#include <spa/utils/dict.h>
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+#include <spa/pod/builder.h>
+#include <spa/control/control.h>
+#include <spa/param/props.h>
+#include <spa/param/audio/raw.h>
+#include <spa/filter-graph/filter-graph.h>
+
+#include "test-helper.h"
+#include "audio-dsp-impl.h"
+
+#define N_SAMPLES	1024
+#define N_FILTERS	5
+#define RAMP_DIFF	6e-6f
+
+SPA_LOG_IMPL(logger);
+
+static uint32_t cpu_flags;
+
+static struct spa_support support[4];
+static uint32_t n_support;
+
+static void fill_input(float *data, uint32_t n_samples)
+{
+	uint32_t i;
+	for (i = 0; i < n_samples; i++)
+		data[i] = 0.5f * sinf(i * 0.05f) + 0.25f * sinf(i * 0.31f);
+}
+
+/* the SIMD biquad ramps must match the C version, both the 4 lane and the
+ * single filter path */
+static void test_biquad_ramp(void)
+{
+	struct spa_fga_dsp *dsp[2];
+	struct biquad bq[2][N_FILTERS], target[N_FILTERS];
+	float in_data[N_FILTERS][N_SAMPLES], out_data[2][N_FILTERS][N_SAMPLES];
+	const float *in[N_FILTERS];
+	float *out[2][N_FILTERS];
+	float max_diff = 0.0f;
+	uint32_t i, j, k;
+
+	dsp[0] = spa_fga_dsp_new(0);
+	dsp[1] = spa_fga_dsp_new(cpu_flags);
+	spa_assert_se(dsp[0] != NULL && dsp[1] != NULL);
+
+	for (i = 0; i < N_FILTERS; i++) {
+		fill_input(in_data[i], N_SAMPLES);
+		in[i] = in_data[i];
+		biquad_set(&target[i], BQ_PEAKING, 0.02 * (i + 1), 0.7, 6.0);
+		for (k = 0; k < 2; k++) {
+			biquad_set(&bq[k][i], BQ_PEAKING, 0.01 * (i + 1), 0.7, -3.0);
+			out[k][i] = out_data[k][i];
+		}
+	}
+	for (k = 0; k < 2; k++) {
+		/* run some samples first so that the ramp starts with state */
+		spa_fga_dsp_biquad_run(dsp[k], bq[k], 1, 1, out[k], in, N_FILTERS, N_SAMPLES / 2);
+		spa_fga_dsp_biquad_ramp(dsp[k], bq[k], target, out[k], in, N_FILTERS, N_SAMPLES);
+	}
+	for (i = 0; i < N_FILTERS; i++) {
+		for (j = 0; j < N_SAMPLES; j++)
+			max_diff = fmaxf(max_diff, fabsf(out[0][i][j] - out[1][i][j]));
+		spa_assert_se(bq[0][i].b0 == target[i].b0 && bq[1][i].b0 == target[i].b0);
+	}
+	fprintf(stderr, "biquad ramp C/SIMD max diff %g\n", max_diff);
+	spa_assert_se(max_diff <= RAMP_DIFF);
+
+	spa_fga_dsp_free(dsp[0]);
+	spa_fga_dsp_free(dsp[1]);
+}
+
+static struct spa_handle *load_handle_info(const char *lib, const char *name,
+		const struct spa_dict *info)
+{
+	const char *dir;
+	char path[PATH_MAX];
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	int res;
+
+	if ((dir = getenv("SPA_PLUGIN_DIR")) == NULL)
+		dir = PLUGINDIR;
+	snprintf(path, sizeof(path), "%s/%s.so", dir, lib);
+
+	if ((hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		fprintf(stderr, "can't load %s: %s\n", path, dlerror());
+		errno = ENOENT;
+		return NULL;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL ||
+	    (factory = get_factory(enum_func, name, SPA_VERSION_HANDLE_FACTORY)) == NULL) {
+		errno = ENOENT;
+		return NULL;
+	}
+	handle = calloc(1, spa_handle_factory_get_size(factory, info));
+	if ((res = spa_handle_factory_init(factory, handle, info, support, n_support)) < 0) {
+		free(handle);
+		errno = -res;
+		return NULL;
+	}
+	return handle;
+}
+
+static struct spa_handle *loader_load(void *object, const char *factory_name,
+		const struct spa_dict *info)
+{
+	const char *lib = info ? spa_dict_lookup(info, SPA_KEY_LIBRARY_NAME) : NULL;
+	return lib ? load_handle_info(lib, factory_name, info) : NULL;
+}
+
+static int loader_unload(void *object, struct spa_handle *handle)
+{
+	spa_handle_clear(handle);
+	free(handle);
+	return 0;
+}
+
+static const struct spa_plugin_loader_methods loader_methods = {
+	SPA_VERSION_PLUGIN_LOADER_METHODS,
+	.load = loader_load,
+	.unload = loader_unload,
+};
+
+static struct spa_plugin_loader loader;
+
+struct graph {
+	struct spa_handle *handle;
+	struct spa_filter_graph *graph;
+};
+
+static void graph_make(struct graph *g, const char *json, const char *key, const char *value)
+{
+	struct spa_dict_item items[3];
+	uint32_t n_items = 0;
+	void *iface;
+
+	items[n_items++] = SPA_DICT_ITEM("clock.quantum-limit", "8192");
+	items[n_items++] = SPA_DICT_ITEM("filter.graph", json);
+	if (key != NULL)
+		items[n_items++] = SPA_DICT_ITEM(key, value);
+
+	g->handle = load_handle_info("filter-graph/libspa-filter-graph", "filter.graph",
+			&SPA_DICT(items, n_items));
+	spa_assert_se(g->handle != NULL);
+	spa_assert_se(spa_handle_get_interface(g->handle,
+				SPA_TYPE_INTERFACE_FilterGraph, &iface) >= 0);
+	g->graph = iface;
+	spa_assert_se(spa_filter_graph_activate(g->graph,
+			&SPA_DICT_ITEMS(SPA_DICT_ITEM(SPA_KEY_AUDIO_RATE, "48000"))) >= 0);
+}
+
+static void graph_free(struct graph *g)
+{
+	spa_filter_graph_deactivate(g->graph);
+	spa_handle_clear(g->handle);
+	free(g->handle);
+}
+
+static void graph_process(struct graph *g, const float *in, float *out, uint32_t n_samples)
+{
+	const void *ins[1] = { in };
+	void *outs[1] = { out };
+	spa_assert_se(spa_filter_graph_process(g->graph, ins, outs, n_samples) >= 0);
+}
+
+static void graph_set_control(struct graph *g, uint32_t offset, const char *name, float value)
+{
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod_frame f[3];
+	struct spa_pod_sequence *seq;
+
+	spa_pod_builder_push_sequence(&b, &f[0], 0);
+	spa_pod_builder_control(&b, offset, SPA_CONTROL_Properties);
+	spa_pod_builder_push_object(&b, &f[1], SPA_TYPE_OBJECT_Props, SPA_PARAM_Props);
+	spa_pod_builder_prop(&b, SPA_PROP_params, 0);
+	spa_pod_builder_push_struct(&b, &f[2]);
+	spa_pod_builder_string(&b, name);
+	spa_pod_builder_float(&b, value);
+	spa_pod_builder_pop(&b, &f[2]);
+	spa_pod_builder_pop(&b, &f[1]);
+	seq = spa_pod_builder_pop(&b, &f[0]);
+
+	spa_assert_se(spa_filter_graph_set_control(g->graph, seq) == 1);
+}
+
+static void graph_set_props(struct graph *g, const char *name, float value)
+{
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod_frame f[2];
+	struct spa_pod *props;
+
+	spa_pod_builder_push_object(&b, &f[0], SPA_TYPE_OBJECT_Props, SPA_PARAM_Props);
+	spa_pod_builder_prop(&b, SPA_PROP_params, 0);
+	spa_pod_builder_push_struct(&b, &f[1]);
+	spa_pod_builder_string(&b, name);
+	spa_pod_builder_float(&b, value);
+	spa_pod_builder_pop(&b, &f[1]);
+	props = spa_pod_builder_pop(&b, &f[0]);
+
+	spa_assert_se(spa_filter_graph_set_props(g->graph, SPA_DIRECTION_INPUT, props) >= 0);
+}
+
+#define LOWPASS_GRAPH	"{ nodes = [ { type = builtin name = lp label = bq_lowpass "	\
+			"control = { \"Freq\" = 1000.0 \"Q\" = 0.7 } } ] }"
+#define LOWPASS_8K_GRAPH "{ nodes = [ { type = builtin name = lp label = bq_lowpass "	\
+			"control = { \"Freq\" = 8000.0 \"Q\" = 0.7 } } ] }"
+
+/* a change queued at an offset does not touch the samples before it */
+static void test_control_offset(const char *ramp)
+{
+	struct graph g[2];
+	float in[N_SAMPLES], out[2][N_SAMPLES];
+	uint32_t i, j, offset = 300;
+
+	fill_input(in, N_SAMPLES);
+
+	for (i = 0; i < 2; i++)
+		graph_make(&g[i], LOWPASS_GRAPH, "filter-graph.ramp", ramp);
+
+	for (i = 0; i < 3; i++) {
+		graph_process(&g[0], in, out[0], N_SAMPLES);
+		graph_process(&g[1], in, out[1], N_SAMPLES);
+		spa_assert_se(memcmp(out[0], out[1], sizeof(out[0])) == 0);
+	}
+
+	graph_set_control(&g[1], offset, "lp:Freq", 8000.0f);
+	graph_process(&g[0], in, out[0], N_SAMPLES);
+	graph_process(&g[1], in, out[1], N_SAMPLES);
+
+	spa_assert_se(memcmp(out[0], out[1], offset * sizeof(float)) == 0);
+	for (j = offset; j < N_SAMPLES; j++)
+		if (out[0][j] != out[1][j])
+			break;
+	spa_assert_se(j < N_SAMPLES);
+	fprintf(stderr, "ramp %s ms: first changed sample %u, offset %u\n", ramp, j, offset);
+
+	for (i = 0; i < 2; i++)
+		graph_free(&g[i]);
+}
+
+/* a change with set_props is not ramped, the filter restarts from a clean
+ * state with the new coefficients */
+static void test_props_reset(void)
+{
+	struct graph g[2];
+	float in[N_SAMPLES], out[2][N_SAMPLES];
+	uint32_t i;
+
+	fill_input(in, N_SAMPLES);
+
+	graph_make(&g[0], LOWPASS_GRAPH, NULL, NULL);
+	for (i = 0; i < 3; i++)
+		graph_process(&g[0], in, out[0], N_SAMPLES);
+	graph_set_props(&g[0], "lp:Freq", 8000.0f);
+
+	graph_make(&g[1], LOWPASS_8K_GRAPH, NULL, NULL);
+
+	graph_process(&g[0], in, out[0], N_SAMPLES);
+	graph_process(&g[1], in, out[1], N_SAMPLES);
+	spa_assert_se(memcmp(out[0], out[1], sizeof(out[0])) == 0);
+
+	for (i = 0; i < 2; i++)
+		graph_free(&g[i]);
+}
+
+/* a reset drops the queued changes */
+static void test_control_reset(void)
+{
+	struct graph g[2];
+	float in[N_SAMPLES], out[2][N_SAMPLES];
+	uint32_t i;
+
+	fill_input(in, N_SAMPLES);
+
+	for (i = 0; i < 2; i++)
+		graph_make(&g[i], LOWPASS_GRAPH, NULL, NULL);
+
+	graph_set_control(&g[1], 100, "lp:Freq", 8000.0f);
+	for (i = 0; i < 2; i++)
+		spa_filter_graph_reset(g[i].graph);
+
+	graph_process(&g[0], in, out[0], N_SAMPLES);
+	graph_process(&g[1], in, out[1], N_SAMPLES);
+	spa_assert_se(memcmp(out[0], out[1], sizeof(out[0])) == 0);
+
+	for (i = 0; i < 2; i++)
+		graph_free(&g[i]);
+}
+
+/* a convolver with a dirac that is delayed by 1.2s */
+#define DELAY_NODE	"{ type = builtin name = delay label = convolver "		\
+			"config = { filename = \"/dirac\" delay = 57600 } } "
+
+#define DELAY_GRAPH	"{ nodes = [ " DELAY_NODE " ] }"
+
+#define DELAY_CLAMP_GRAPH "{ nodes = [ " DELAY_NODE					\
+			"{ type = builtin name = clamp label = clamp } ] "			\
+			"links = [ { output = \"delay:Out\" input = \"clamp:In\" } ] }"
+
+/* run one cycle of signal and then silence, the graph can be skipped
+ * before the delayed signal comes out */
+static bool delayed_signal(const char *json, const char *timeout)
+{
+	struct graph g;
+	float in[N_SAMPLES], out[N_SAMPLES];
+	uint32_t i, j;
+	bool found = false;
+
+	graph_make(&g, json, timeout ? "filter-graph.silence-timeout" : NULL, timeout);
+
+	fill_input(in, N_SAMPLES);
+	graph_process(&g, in, out, N_SAMPLES);
+
+	memset(in, 0, sizeof(in));
+	for (i = 0; i < 60; i++) {
+		graph_process(&g, in, out, N_SAMPLES);
+		for (j = 0; j < N_SAMPLES; j++)
+			found |= fabsf(out[j]) > 0.1f;
+	}
+	graph_free(&g);
+	return found;
+}
+
+static void test_silence_skip(void)
+{
+	/* skipping is disabled by default */
+	spa_assert_se(delayed_signal(DELAY_GRAPH, NULL));
+	spa_assert_se(delayed_signal(DELAY_GRAPH, "0"));
+	/* the graph is skipped after 10ms of silence, before the delay */
+	spa_assert_se(!delayed_signal(DELAY_GRAPH, "10"));
+	/* graphs with control outputs always run */
+	spa_assert_se(delayed_signal(DELAY_CLAMP_GRAPH, "10"));
+}
+
+/* a skipped graph runs again on signal */
+static void test_silence_resume(void)
+{
+	struct graph g[2];
+	float in[N_SAMPLES], out[2][N_SAMPLES], max_diff = 0.0f;
+	uint32_t i, j;
+	bool signal = false;
+
+	graph_make(&g[0], LOWPASS_GRAPH, NULL, NULL);
+	graph_make(&g[1], LOWPASS_GRAPH, "filter-graph.silence-timeout", "10");
+
+	fill_input(in, N_SAMPLES);
+	for (i = 0; i < 3; i++) {
+		graph_process(&g[0], in, out[0], N_SAMPLES);
+		graph_process(&g[1], in, out[1], N_SAMPLES);
+	}
+	memset(in, 0, sizeof(in));
+	for (i = 0; i < 20; i++) {
+		graph_process(&g[0], in, out[0], N_SAMPLES);
+		graph_process(&g[1], in, out[1], N_SAMPLES);
+	}
+	for (j = 0; j < N_SAMPLES; j++)
+		spa_assert_se(out[1][j] == 0.0f);
+
+	fill_input(in, N_SAMPLES);
+	for (i = 0; i < 3; i++) {
+		graph_process(&g[0], in, out[0], N_SAMPLES);
+		graph_process(&g[1], in, out[1], N_SAMPLES);
+		for (j = 0; j < N_SAMPLES; j++) {
+			max_diff = fmaxf(max_diff, fabsf(out[0][j] - out[1][j]));
+			signal |= out[1][j] != 0.0f;
+		}
+	}
+	fprintf(stderr, "silence resume max diff %g\n", max_diff);
+	spa_assert_se(signal);
+	spa_assert_se(max_diff <= 1e-6f);
+
+	for (i = 0; i < 2; i++)
+		graph_free(&g[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_handle *cpu;
+	void *iface;
+
+	logger.log.level = SPA_LOG_LEVEL_WARN;
+	loader.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_PluginLoader,
+			SPA_VERSION_PLUGIN_LOADER, &loader_methods, NULL);
+
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Log, &logger);
+	support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_PluginLoader, &loader);
+
+	cpu_flags = get_cpu_flags();
+	if ((cpu = load_handle_info("support/libspa-support", SPA_NAME_SUPPORT_CPU, NULL)) != NULL &&
+	    spa_handle_get_interface(cpu, SPA_TYPE_INTERFACE_CPU, &iface) >= 0)
+		support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_CPU, iface);
+
+	test_biquad_ramp();
+	test_control_offset("5.0");
+	test_control_offset("0.0");
+	test_control_reset();
+	test_props_reset();
+	test_silence_skip();
+	test_silence_resume();
+
+	if (cpu != NULL) {
+		spa_handle_clear(cpu);
+		free(cpu);
+	}
+	return 0;
+}
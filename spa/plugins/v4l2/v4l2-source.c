@@ -48,6 +48,7 @@ static void reset_props(struct props *props)
 }
 
 #define MAX_BUFFERS     32
+#define MAX_PLANES	4
 
 #define BUFFER_FLAG_OUTSTANDING	(1<<0)
 #define BUFFER_FLAG_ALLOCATED	(1<<1)
@@ -96,6 +97,12 @@ struct port {
 
 	bool have_query_ext_ctrl;
 	struct v4l2_format fmt;
+	uint32_t n_planes;
+	struct {
+		uint32_t offset;
+		uint32_t stride;
+		uint32_t size;
+	} planes[MAX_PLANES];		/* planes of the format in one buffer */
 	enum v4l2_buf_type type;
 	enum v4l2_memory memtype;
 
@@ -588,21 +595,39 @@ static int impl_node_port_enum_params(void *object, int seq,
 			return res;
 		break;
 	case SPA_PARAM_Buffers:
+	{
+		uint32_t blocks, types;
+
 		if (!port->have_format)
 			return -EIO;
-		if (result.index > 0)
-			return 0;
 		if (port->max_buffers == 0)
 			return -EIO;
 
+		/* prefer exported DMA-BUFs with a data for each plane, then
+		 * memory that can be mapped with all planes in one data */
+		switch (result.index + (port->have_expbuf ? 0 : 1)) {
+		case 0:
+			blocks = port->n_planes;
+			types = 1u << SPA_DATA_DmaBuf;
+			break;
+		case 1:
+			blocks = 1;
+			types = (1u << SPA_DATA_MemFd) | (1u << SPA_DATA_MemPtr);
+			break;
+		default:
+			return 0;
+		}
+
 		param = spa_pod_builder_add_object(&b.b,
 			SPA_TYPE_OBJECT_ParamBuffers, id,
 			SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(SPA_MIN(4u, port->max_buffers),
 				1, port->max_buffers),
-			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(blocks),
 			SPA_PARAM_BUFFERS_size,    SPA_POD_Int(port->fmt.fmt.pix.sizeimage),
-			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(port->fmt.fmt.pix.bytesperline));
+			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(port->fmt.fmt.pix.bytesperline),
+			SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(types));
 		break;
+	}
 
 	case SPA_PARAM_Meta:
 		switch (result.index) {
@@ -127,7 +127,7 @@ static int spa_v4l2_clear_buffers(struct impl *this)
 {
 	struct port *port = &this->out_ports[0];
 	struct v4l2_requestbuffers reqbuf;
-	uint32_t i;
+	uint32_t i, j;
 
 	if (port->n_buffers == 0)
 		return 0;
@@ -152,7 +152,8 @@ static int spa_v4l2_clear_buffers(struct impl *this)
 			spa_log_debug(this->log, "close %d", (int) d[0].fd);
 			close(d[0].fd);
 		}
-		d[0].type = SPA_ID_INVALID;
+		for (j = 0; j < b->outbuf->n_datas; j++)
+			d[j].type = SPA_ID_INVALID;
 	}
 
 	spa_zero(reqbuf);
@@ -909,6 +910,76 @@ do_frminterval_filter:
 	return res;
 }
 
+/* Get the layout of the planes of a format that has all planes in one
+ * buffer. The chroma planes follow the luma plane with a stride derived
+ * from the bytesperline of the luma plane. */
+static void update_planes(struct port *port, uint32_t media_subtype)
+{
+	const struct v4l2_pix_format *pix = &port->fmt.fmt.pix;
+	uint32_t i, n_planes, offset, chroma_stride, chroma_height;
+
+	switch (pix->pixelformat) {
+	case V4L2_PIX_FMT_NV12:
+	case V4L2_PIX_FMT_NV21:
+		n_planes = 2;
+		chroma_stride = pix->bytesperline;
+		chroma_height = (pix->height + 1) / 2;
+		break;
+	case V4L2_PIX_FMT_NV16:
+	case V4L2_PIX_FMT_NV61:
+		n_planes = 2;
+		chroma_stride = pix->bytesperline;
+		chroma_height = pix->height;
+		break;
+	case V4L2_PIX_FMT_NV24:
+		n_planes = 2;
+		chroma_stride = pix->bytesperline * 2;
+		chroma_height = pix->height;
+		break;
+	case V4L2_PIX_FMT_YUV420:
+	case V4L2_PIX_FMT_YVU420:
+		n_planes = 3;
+		chroma_stride = pix->bytesperline / 2;
+		chroma_height = (pix->height + 1) / 2;
+		break;
+	case V4L2_PIX_FMT_YUV422P:
+		n_planes = 3;
+		chroma_stride = pix->bytesperline / 2;
+		chroma_height = pix->height;
+		break;
+	case V4L2_PIX_FMT_YUV411P:
+		n_planes = 3;
+		chroma_stride = pix->bytesperline / 4;
+		chroma_height = pix->height;
+		break;
+	default:
+		n_planes = 1;
+		chroma_stride = chroma_height = 0;
+		break;
+	}
+	if (media_subtype != SPA_MEDIA_SUBTYPE_raw)
+		n_planes = 1;
+
+	port->planes[0].offset = 0;
+	port->planes[0].stride = pix->bytesperline;
+	port->planes[0].size = n_planes == 1 ? pix->sizeimage : pix->bytesperline * pix->height;
+	offset = port->planes[0].size;
+
+	for (i = 1; i < n_planes; i++) {
+		port->planes[i].offset = offset;
+		port->planes[i].stride = chroma_stride;
+		port->planes[i].size = chroma_stride * chroma_height;
+		offset += port->planes[i].size;
+	}
+	/* the driver pads the image in ways we don't know about, use one
+	 * plane then */
+	if (offset > pix->sizeimage) {
+		n_planes = 1;
+		port->planes[0].size = pix->sizeimage;
+	}
+	port->n_planes = n_planes;
+}
+
 static int probe_expbuf(struct impl *this)
 {
 	struct port *port = &this->out_ports[0];
@@ -1064,6 +1135,9 @@ static int spa_v4l2_set_format(struct impl *this, struct spa_video_info *format,
 	probe_expbuf(this);
 
 	port->fmt = fmt;
+	update_planes(port, format->media_subtype);
+	spa_log_debug(this->log, "%s: %u planes", this->props.device, port->n_planes);
+
 	port->info.change_mask |= SPA_PORT_CHANGE_MASK_FLAGS | SPA_PORT_CHANGE_MASK_RATE;
 	port->info.flags = (port->alloc_buffers ? SPA_PORT_FLAG_CAN_ALLOC_BUFFERS : 0) |
 		SPA_PORT_FLAG_LIVE |
@@ -1418,6 +1492,7 @@ static int mmap_read(struct impl *this)
 	struct v4l2_buffer buf;
 	struct buffer *b;
 	struct spa_data *d;
+	uint32_t i;
 	int64_t pts;
 
 	spa_zero(buf);
@@ -1484,12 +1559,30 @@ static int mmap_read(struct impl *this)
 	}
 
 	d = b->outbuf->datas;
-	d[0].chunk->offset = 0;
-	d[0].chunk->size = SPA_MIN(buf.bytesused, d[0].maxsize);
-	d[0].chunk->stride = port->fmt.fmt.pix.bytesperline;
-	d[0].chunk->flags = 0;
-	if (buf.flags & V4L2_BUF_FLAG_ERROR)
-		d[0].chunk->flags |= SPA_CHUNK_FLAG_CORRUPTED;
+	if (b->outbuf->n_datas > 1 && b->outbuf->n_datas == port->n_planes) {
+		/* the planes are at fixed offsets in the buffer, bytesused
+		 * covers all of them */
+		uint32_t used = SPA_MIN(buf.bytesused, d[0].maxsize);
+
+		for (i = 0; i < port->n_planes; i++) {
+			uint32_t offset = port->planes[i].offset;
+
+			d[i].chunk->offset = offset;
+			d[i].chunk->size = used > offset ?
+				SPA_MIN(port->planes[i].size, used - offset) : 0;
+			d[i].chunk->stride = port->planes[i].stride;
+			d[i].chunk->flags = 0;
+			if (buf.flags & V4L2_BUF_FLAG_ERROR)
+				d[i].chunk->flags |= SPA_CHUNK_FLAG_CORRUPTED;
+		}
+	} else {
+		d[0].chunk->offset = 0;
+		d[0].chunk->size = SPA_MIN(buf.bytesused, d[0].maxsize);
+		d[0].chunk->stride = port->fmt.fmt.pix.bytesperline;
+		d[0].chunk->flags = 0;
+		if (buf.flags & V4L2_BUF_FLAG_ERROR)
+			d[0].chunk->flags |= SPA_CHUNK_FLAG_CORRUPTED;
+	}
 
 	if (b->mmap_ptr && b->ptr)
 		memcpy(b->ptr, b->mmap_ptr, d[0].chunk->size);
@@ -1687,7 +1780,7 @@ mmap_init(struct impl *this,
 	struct port *port = &this->out_ports[0];
 	struct spa_v4l2_device *dev = &port->dev;
 	struct v4l2_requestbuffers reqbuf;
-	unsigned int i;
+	unsigned int i, j;
 	bool use_expbuf = false;
 
 	port->memtype = V4L2_MEMORY_MMAP;
@@ -1808,6 +1901,22 @@ again:
 			port->alloc_buffers = false;
 			return -ENOTSUP;
 		}
+
+		/* the other planes are in the same memory, at their own offset */
+		for (j = 1; j < buffers[i]->n_datas; j++) {
+			uint32_t p = SPA_MIN(j, port->n_planes - 1);
+
+			d[j].type = d[0].type;
+			d[j].flags = d[0].flags;
+			d[j].fd = d[0].fd;
+			d[j].mapoffset = d[0].mapoffset;
+			d[j].maxsize = d[0].maxsize;
+			d[j].data = d[0].data;
+			d[j].chunk->offset = port->planes[p].offset;
+			d[j].chunk->size = 0;
+			d[j].chunk->stride = port->planes[p].stride;
+			d[j].chunk->flags = 0;
+		}
 		spa_v4l2_buffer_recycle(this, i);
 	}
 	spa_log_info(this->log, "%s: have %u buffers using %s", dev->path, n_buffers,
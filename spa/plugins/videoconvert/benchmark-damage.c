@@ -0,0 +1,232 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include <libswscale/swscale.h>
+#include <libavutil/pixfmt.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+
+#include <spa/utils/defs.h>
+
+#include "damage.h"
+
+#define MAX_FRAMES	600
+#define MAX_RECTS	64
+#define N_BUFFERS	3
+#define MAX_HISTORY	8
+
+/*
+ * Replays a damage trace and converts the frames like the converter does,
+ * once completely and once only the damaged rows of each output buffer.
+ *
+ * The trace has one damaged rectangle per line:
+ *
+ *   <frame> <x> <y> <width> <height>
+ *
+ * Frames without lines have no damage. Without a trace file, a trace of a
+ * mostly static desktop with typing, cursor movement and some scrolling is
+ * used.
+ */
+struct frame {
+	uint32_t n_rects;
+	struct spa_meta_region rects[MAX_RECTS + 1];
+};
+
+static struct frame frames[MAX_FRAMES];
+static uint32_t n_frames;
+
+static void add_rect(uint32_t frame, int x, int y, int w, int h)
+{
+	struct frame *f;
+
+	if (frame >= MAX_FRAMES)
+		return;
+	f = &frames[frame];
+	if (f->n_rects < MAX_RECTS)
+		f->rects[f->n_rects++].region = SPA_REGION(x, y, w, h);
+	n_frames = SPA_MAX(n_frames, frame + 1);
+}
+
+static int load_trace(const char *path)
+{
+	FILE *f;
+	unsigned int frame;
+	int x, y, w, h;
+
+	if ((f = fopen(path, "r")) == NULL)
+		return -errno;
+	while (fscanf(f, "%u %d %d %d %d", &frame, &x, &y, &w, &h) == 5)
+		add_rect(frame, x, y, w, h);
+	fclose(f);
+	return 0;
+}
+
+static void make_trace(int width, int height)
+{
+	uint32_t i;
+
+	for (i = 0; i < MAX_FRAMES; i++) {
+		/* a character typed on a line of text */
+		if (i % 4 == 0)
+			add_rect(i, 200 + (i * 12) % (width - 400), 300 + (i / 240) * 24, 12, 24);
+		/* the cursor moves */
+		if (i % 60 < 30) {
+			int cx = (i * 17) % (width - 64), cy = (i * 11) % (height - 64);
+			add_rect(i, cx, cy, 48, 48);
+			add_rect(i, cx + 17, cy + 11, 48, 48);
+		}
+		/* a window scrolls */
+		if (i % 120 >= 100)
+			add_rect(i, width / 4, height / 4, width / 2, height / 2);
+		/* everything changes */
+		if (i % 300 == 299)
+			add_rect(i, 0, 0, width, height);
+	}
+	n_frames = MAX_FRAMES;
+}
+
+static struct spa_meta *frame_meta(struct frame *f, struct spa_meta *m)
+{
+	/* terminate the array like a producer would */
+	f->rects[f->n_rects].region = SPA_REGION(0, 0, 0, 0);
+	m->type = SPA_META_VideoDamage;
+	m->size = sizeof(f->rects);
+	m->data = f->rects;
+	return m;
+}
+
+static AVFrame *alloc_frame(enum AVPixelFormat fmt, int width, int height)
+{
+	AVFrame *f = av_frame_alloc();
+	uint32_t i;
+
+	spa_assert_se(f != NULL);
+	f->format = fmt;
+	f->width = width;
+	f->height = height;
+	spa_assert_se(av_frame_get_buffer(f, 0) >= 0);
+	for (i = 0; i < 4 && f->buf[i]; i++)
+		memset(f->buf[i]->data, 0x40 + i, f->buf[i]->size);
+	return f;
+}
+
+static uint64_t now_nsec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void run(int width, int height, enum AVPixelFormat src_fmt,
+		enum AVPixelFormat dst_fmt, int n_threads)
+{
+	struct SwsContext *ctx;
+	AVFrame *src, *dst[N_BUFFERS];
+	struct video_damage history[MAX_HISTORY], d;
+	uint64_t seq[N_BUFFERS] = { 0 }, t1, t2, t3, rows = 0, total = 0;
+	const AVPixFmtDescriptor *in_desc = av_pix_fmt_desc_get(src_fmt);
+	const AVPixFmtDescriptor *out_desc = av_pix_fmt_desc_get(dst_fmt);
+	uint32_t i, j, k, align;
+	struct spa_meta m;
+
+	ctx = sws_alloc_context();
+	spa_assert_se(ctx != NULL);
+	av_opt_set_int(ctx, "srcw", width, 0);
+	av_opt_set_int(ctx, "srch", height, 0);
+	av_opt_set_int(ctx, "src_format", src_fmt, 0);
+	av_opt_set_int(ctx, "dstw", width, 0);
+	av_opt_set_int(ctx, "dsth", height, 0);
+	av_opt_set_int(ctx, "dst_format", dst_fmt, 0);
+	if (n_threads > 1)
+		av_opt_set_int(ctx, "threads", n_threads, 0);
+	spa_assert_se(sws_init_context(ctx, NULL, NULL) >= 0);
+
+	align = SPA_MAX(sws_receive_slice_alignment(ctx),
+			1u << SPA_MAX(in_desc->log2_chroma_h, out_desc->log2_chroma_h));
+
+	src = alloc_frame(src_fmt, width, height);
+	for (i = 0; i < N_BUFFERS; i++)
+		dst[i] = alloc_frame(dst_fmt, width, height);
+
+	t1 = now_nsec();
+	for (i = 0; i < n_frames; i++)
+		spa_assert_se(sws_scale_frame(ctx, dst[i % N_BUFFERS], src) >= 0);
+	t2 = now_nsec();
+
+	for (i = 0; i < n_frames; i++) {
+		uint64_t s = i + 1;
+		uint32_t b = i % N_BUFFERS;
+		struct video_damage *cur = &history[s % MAX_HISTORY];
+
+		video_damage_from_meta(cur, frame_meta(&frames[i], &m), align, width, height);
+
+		if (seq[b] == 0 || s - seq[b] > MAX_HISTORY) {
+			video_damage_reset(&d, true);
+		} else {
+			d = *cur;
+			for (k = seq[b] + 1; k < s && !d.full; k++)
+				video_damage_union(&d, &history[k % MAX_HISTORY], height);
+		}
+		rows += video_damage_rows(&d, height);
+		total += height;
+
+		if (d.full || video_damage_rows(&d, height) * 4 >= (uint32_t)height * 3) {
+			spa_assert_se(sws_scale_frame(ctx, dst[b], src) >= 0);
+		} else if (d.n_bands > 0) {
+			spa_assert_se(sws_frame_start(ctx, dst[b], src) >= 0);
+			spa_assert_se(sws_send_slice(ctx, 0, height) >= 0);
+			for (j = 0; j < d.n_bands; j++)
+				spa_assert_se(sws_receive_slice(ctx, d.bands[j].y,
+							d.bands[j].height) >= 0);
+			sws_frame_end(ctx);
+		}
+		seq[b] = s;
+	}
+	t3 = now_nsec();
+
+	fprintf(stderr, "%-12."PRIu64" \t%dx%d %s->%s full \t threads %d\n",
+			n_frames * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+			width, height, in_desc->name, out_desc->name, n_threads);
+	fprintf(stderr, "%-12."PRIu64" \t%dx%d %s->%s damage \t threads %d rows %.1f%%\n",
+			n_frames * (uint64_t)SPA_NSEC_PER_SEC / (t3 - t2),
+			width, height, in_desc->name, out_desc->name, n_threads,
+			100.0 * rows / total);
+
+	av_frame_free(&src);
+	for (i = 0; i < N_BUFFERS; i++)
+		av_frame_free(&dst[i]);
+	sws_freeContext(ctx);
+}
+
+int main(int argc, char *argv[])
+{
+	int width = 3840, height = 2160, res;
+
+	if (argc > 1) {
+		if ((res = load_trace(argv[1])) < 0) {
+			fprintf(stderr, "can't load trace %s: %s\n", argv[1], strerror(-res));
+			return -1;
+		}
+	} else {
+		make_trace(width, height);
+	}
+
+	fprintf(stderr, "frames/s, %u frames\n", n_frames);
+
+	run(width, height, AV_PIX_FMT_BGRA, AV_PIX_FMT_NV12, 1);
+	run(width, height, AV_PIX_FMT_BGRA, AV_PIX_FMT_NV12, 4);
+	run(width, height, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV420P, 1);
+	run(width, height, AV_PIX_FMT_NV12, AV_PIX_FMT_RGBA, 1);
+
+	return 0;
+}
@@ -0,0 +1,223 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <libswscale/swscale.h>
+#include <libavutil/pixfmt.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/buffer.h>
+#include <libavutil/opt.h>
+
+#include <spa/utils/defs.h>
+
+#define MAX_THREADS	8
+#define MAX_COUNT	50
+#define ALIGN		32
+
+struct size {
+	int width;
+	int height;
+	const char *name;
+};
+
+static const struct size sizes[] = {
+	{ 1920, 1080, "1080p" },
+	{ 3840, 2160, "4K" },
+};
+
+struct pair {
+	enum AVPixelFormat src;
+	enum AVPixelFormat dst;
+};
+
+static const struct pair pairs[] = {
+	{ AV_PIX_FMT_NV12, AV_PIX_FMT_RGBA },
+	{ AV_PIX_FMT_YUV420P, AV_PIX_FMT_RGBA },
+	{ AV_PIX_FMT_YUYV422, AV_PIX_FMT_NV12 },
+	{ AV_PIX_FMT_RGBA, AV_PIX_FMT_NV12 },
+	{ AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV420P },
+};
+
+/* an image in one memory block, like a PipeWire buffer */
+struct image {
+	uint8_t *mem;
+	int size;
+	AVBufferRef *ref;
+	uint8_t *data[4];
+	int linesize[4];
+};
+
+static void free_ref(void *opaque, uint8_t *data)
+{
+}
+
+static int image_alloc(struct image *img, enum AVPixelFormat fmt, int width, int height)
+{
+	int i;
+
+	spa_zero(*img);
+	if ((img->size = av_image_get_buffer_size(fmt, width, height, ALIGN)) < 0)
+		return img->size;
+	if (posix_memalign((void **)&img->mem, ALIGN, img->size) != 0)
+		return -ENOMEM;
+	for (i = 0; i < img->size; i++)
+		img->mem[i] = (uint8_t)(i * 7 + (i >> 12));
+
+	if (av_image_fill_arrays(img->data, img->linesize, img->mem, fmt,
+				width, height, ALIGN) < 0)
+		return -EINVAL;
+	if ((img->ref = av_buffer_create(img->mem, img->size, free_ref, NULL, 0)) == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
+static void image_free(struct image *img)
+{
+	av_buffer_unref(&img->ref);
+	free(img->mem);
+}
+
+static void image_wrap(AVFrame *f, struct image *img, enum AVPixelFormat fmt,
+		int width, int height)
+{
+	int i;
+
+	av_frame_unref(f);
+	f->format = fmt;
+	f->width = width;
+	f->height = height;
+	for (i = 0; i < 4; i++) {
+		f->data[i] = img->data[i];
+		f->linesize[i] = img->linesize[i];
+	}
+	f->buf[0] = av_buffer_ref(img->ref);
+}
+
+static struct SwsContext *create_scaler(const struct size *s, const struct pair *p,
+		int n_threads)
+{
+	struct SwsContext *ctx;
+
+	if ((ctx = sws_alloc_context()) == NULL)
+		return NULL;
+
+	av_opt_set_int(ctx, "srcw", s->width, 0);
+	av_opt_set_int(ctx, "srch", s->height, 0);
+	av_opt_set_int(ctx, "src_format", p->src, 0);
+	av_opt_set_int(ctx, "dstw", s->width, 0);
+	av_opt_set_int(ctx, "dsth", s->height, 0);
+	av_opt_set_int(ctx, "dst_format", p->dst, 0);
+	if (n_threads > 1 && av_opt_set_int(ctx, "threads", n_threads, 0) < 0)
+		fprintf(stderr, "swscale has no slice threads\n");
+
+	if (sws_init_context(ctx, NULL, NULL) < 0) {
+		sws_freeContext(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/* Convert into the destination image. With copy, the scaler output goes to
+ * a frame allocated by swscale and is then copied out. */
+static uint64_t run_convert(struct SwsContext *ctx, const struct size *s,
+		const struct pair *p, struct image *src, struct image *dst, bool copy)
+{
+	AVFrame *in, *out;
+	struct timespec ts;
+	uint64_t count, t1, t2;
+	int i, res;
+
+	in = av_frame_alloc();
+	out = av_frame_alloc();
+	spa_assert_se(in != NULL && out != NULL);
+
+	image_wrap(in, src, p->src, s->width, s->height);
+	if (copy) {
+		out->format = p->dst;
+		out->width = s->width;
+		out->height = s->height;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	for (count = 0; count < MAX_COUNT; count++) {
+		if (!copy)
+			image_wrap(out, dst, p->dst, s->width, s->height);
+		res = sws_scale_frame(ctx, out, in);
+		spa_assert_se(res >= 0);
+
+		if (copy) {
+			size_t plane_size[4];
+			ptrdiff_t linesize[4];
+
+			for (i = 0; i < 4; i++)
+				linesize[i] = out->linesize[i];
+			av_image_fill_plane_sizes(plane_size, p->dst, s->height, linesize);
+			for (i = 0; i < 4 && out->data[i]; i++)
+				memcpy(dst->data[i], out->data[i],
+						SPA_MIN(plane_size[i], (size_t)dst->size));
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	av_frame_free(&in);
+	av_frame_free(&out);
+
+	return count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1);
+}
+
+static void test_convert(const struct size *s, const struct pair *p, int n_threads)
+{
+	struct SwsContext *ctx;
+	struct image src, dst;
+	const char *src_name = av_get_pix_fmt_name(p->src);
+	const char *dst_name = av_get_pix_fmt_name(p->dst);
+
+	spa_assert_se(image_alloc(&src, p->src, s->width, s->height) == 0);
+	spa_assert_se(image_alloc(&dst, p->dst, s->width, s->height) == 0);
+
+	ctx = create_scaler(s, p, n_threads);
+	spa_assert_se(ctx != NULL);
+
+	fprintf(stderr, "%-12."PRIu64" \t%s %s->%s copy \t threads %d\n",
+			run_convert(ctx, s, p, &src, &dst, true),
+			s->name, src_name, dst_name, n_threads);
+	fprintf(stderr, "%-12."PRIu64" \t%s %s->%s direct \t threads %d\n",
+			run_convert(ctx, s, p, &src, &dst, false),
+			s->name, src_name, dst_name, n_threads);
+
+	sws_freeContext(ctx);
+	image_free(&src);
+	image_free(&dst);
+}
+
+int main(int argc, char *argv[])
+{
+	long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int max_threads = SPA_CLAMP((int)n_cpus, 1, MAX_THREADS);
+	size_t i, j;
+	int n;
+
+	fprintf(stderr, "frames/s\n");
+
+	for (i = 0; i < SPA_N_ELEMENTS(sizes); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(pairs); j++) {
+			for (n = 1; n <= max_threads; n *= 2)
+				test_convert(&sizes[i], &pairs[j], n);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,162 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef SPA_VIDEOCONVERT_DAMAGE_H
+#define SPA_VIDEOCONVERT_DAMAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <spa/utils/defs.h>
+#include <spa/buffer/meta.h>
+
+#define VIDEO_DAMAGE_MAX_BANDS	16
+
+/**
+ * The damaged rows of a frame, as sorted and non-overlapping bands.
+ *
+ * The converter works on full rows, so the damage regions are reduced to
+ * their vertical extent. The bands are aligned so that they can be
+ * converted on their own.
+ */
+struct video_damage {
+	bool full;
+	uint32_t n_bands;
+	struct video_band {
+		uint32_t y;
+		uint32_t height;
+	} bands[VIDEO_DAMAGE_MAX_BANDS];
+};
+
+static inline void video_damage_reset(struct video_damage *d, bool full)
+{
+	d->full = full;
+	d->n_bands = 0;
+}
+
+static inline uint32_t video_damage_rows(const struct video_damage *d, uint32_t height)
+{
+	uint32_t i, rows = 0;
+
+	if (d->full)
+		return height;
+	for (i = 0; i < d->n_bands; i++)
+		rows += d->bands[i].height;
+	return rows;
+}
+
+/* merge band i with the bands after it that it touches */
+static inline void video_damage_merge(struct video_damage *d, uint32_t i)
+{
+	struct video_band *b = &d->bands[i];
+
+	while (i + 1 < d->n_bands && d->bands[i + 1].y <= b->y + b->height) {
+		struct video_band *n = &d->bands[i + 1];
+		uint32_t end = SPA_MAX(b->y + b->height, n->y + n->height);
+
+		b->height = end - b->y;
+		memmove(n, n + 1, (d->n_bands - i - 2) * sizeof(*n));
+		d->n_bands--;
+	}
+}
+
+/* join the two bands with the smallest gap to make room */
+static inline void video_damage_shrink(struct video_damage *d)
+{
+	uint32_t i, best = 0, gap, best_gap = UINT32_MAX;
+
+	for (i = 0; i + 1 < d->n_bands; i++) {
+		gap = d->bands[i + 1].y - (d->bands[i].y + d->bands[i].height);
+		if (gap < best_gap) {
+			best_gap = gap;
+			best = i;
+		}
+	}
+	d->bands[best].height += best_gap;
+	video_damage_merge(d, best);
+}
+
+/** Add rows [y, y + height) of a frame with \a frame_height rows. The band
+ * is grown to a multiple of \a align rows. */
+static inline void video_damage_add(struct video_damage *d, uint32_t y, uint32_t height,
+		uint32_t align, uint32_t frame_height)
+{
+	uint32_t i, end;
+
+	if (d->full || height == 0 || y >= frame_height)
+		return;
+
+	end = SPA_MIN(y + height, frame_height);
+	align = SPA_MAX(align, 1u);
+	y = y / align * align;
+	end = SPA_MIN(SPA_ROUND_UP_N(end, align), frame_height);
+
+	if (y == 0 && end == frame_height) {
+		video_damage_reset(d, true);
+		return;
+	}
+
+	for (i = 0; i < d->n_bands && d->bands[i].y + d->bands[i].height < y; i++);
+
+	if (i < d->n_bands && d->bands[i].y <= end) {
+		/* touches band i */
+		struct video_band *b = &d->bands[i];
+		uint32_t b_end = SPA_MAX(b->y + b->height, end);
+
+		b->y = SPA_MIN(b->y, y);
+		b->height = b_end - b->y;
+	} else {
+		if (d->n_bands == VIDEO_DAMAGE_MAX_BANDS) {
+			video_damage_shrink(d);
+			video_damage_add(d, y, end - y, 1, frame_height);
+			return;
+		}
+		memmove(&d->bands[i + 1], &d->bands[i], (d->n_bands - i) * sizeof(d->bands[0]));
+		d->bands[i].y = y;
+		d->bands[i].height = end - y;
+		d->n_bands++;
+	}
+	video_damage_merge(d, i);
+}
+
+static inline void video_damage_union(struct video_damage *d, const struct video_damage *o,
+		uint32_t frame_height)
+{
+	uint32_t i;
+
+	if (o->full)
+		video_damage_reset(d, true);
+	for (i = 0; i < o->n_bands && !d->full; i++)
+		video_damage_add(d, o->bands[i].y, o->bands[i].height, 1, frame_height);
+}
+
+/** Fill the damage from the regions in a SPA_META_VideoDamage meta.
+ * A meta without valid regions means that nothing changed. */
+static inline void video_damage_from_meta(struct video_damage *d, struct spa_meta *m,
+		uint32_t align, uint32_t frame_width, uint32_t frame_height)
+{
+	struct spa_meta_region *r;
+
+	video_damage_reset(d, false);
+
+	spa_meta_for_each(r, m) {
+		int32_t y = r->region.position.y, x = r->region.position.x;
+		int64_t end;
+
+		if (!spa_meta_region_is_valid(r))
+			break;
+		if (x >= (int32_t)frame_width || x + (int64_t)r->region.size.width <= 0)
+			continue;
+
+		end = SPA_MIN((int64_t)y + r->region.size.height, (int64_t)frame_height);
+		y = SPA_MAX(y, 0);
+		if (end > y)
+			video_damage_add(d, y, end - y, align, frame_height);
+		if (d->full)
+			break;
+	}
+}
+
+#endif /* SPA_VIDEOCONVERT_DAMAGE_H */
@@ -0,0 +1,206 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <spa/utils/defs.h>
+
+#include "frame-pool.h"
+
+#undef SPA_LOG_TOPIC_DEFAULT
+#define SPA_LOG_TOPIC_DEFAULT &log_topic
+SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.videoconvert.frame-pool");
+
+#define PAGE_SIZE_MIN	4096u
+/* released memory that is kept for reuse */
+#define MAX_FREE_BYTES	(128u * 1024u * 1024u)
+
+struct frame_pool {
+	pthread_mutex_t lock;
+	int ref;
+	struct spa_log *log;
+	struct spa_list free;		/* most recently released first */
+	struct frame_pool_stats stats;
+};
+
+static struct frame_pool global_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Round up to a multiple of the page size for small blocks and to 1/8th of
+ * the next power of two for larger ones, so that sizes that are close
+ * together share a class. */
+static size_t size_class(size_t size)
+{
+	size_t step = PAGE_SIZE_MIN;
+
+	if (size > 8 * PAGE_SIZE_MIN) {
+		int bits = sizeof(unsigned long) * 8 - __builtin_clzl(size - 1);
+		step = SPA_MAX(step, (size_t)1 << (bits - 3));
+	}
+	return SPA_ROUND_UP_N(size, step);
+}
+
+static void block_free(struct frame_pool *pool, struct frame_block *block)
+{
+	spa_log_debug(pool->log, "%p: free block %p fd:%d size:%zu", pool,
+			block, block->fd, block->size);
+	munmap(block->ptr, block->size);
+	close(block->fd);
+	free(block);
+}
+
+static struct frame_block *block_new(struct frame_pool *pool, size_t size)
+{
+	struct frame_block *block;
+	int res;
+
+	if ((block = calloc(1, sizeof(*block))) == NULL)
+		return NULL;
+
+	block->fd = memfd_create("spa-video-frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (block->fd < 0) {
+		res = -errno;
+		goto error_free;
+	}
+	if (ftruncate(block->fd, size) < 0) {
+		res = -errno;
+		goto error_close;
+	}
+	if (fcntl(block->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+		spa_log_debug(pool->log, "%p: can't seal fd %d: %m", pool, block->fd);
+
+	block->ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, block->fd, 0);
+	if (block->ptr == MAP_FAILED) {
+		res = -errno;
+		goto error_close;
+	}
+	block->size = size;
+
+	spa_log_debug(pool->log, "%p: new block %p fd:%d size:%zu", pool,
+			block, block->fd, block->size);
+	return block;
+
+error_close:
+	close(block->fd);
+error_free:
+	free(block);
+	errno = -res;
+	return NULL;
+}
+
+/* Blocks go from one stream to another, possibly of another client, so
+ * the old frames must not be seen again. Punching out the pages makes
+ * them read back as zeroes and gives the memory back until it is used. */
+static void block_clear(struct frame_pool *pool, struct frame_block *block)
+{
+	if (fallocate(block->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				0, block->size) < 0) {
+		spa_log_debug(pool->log, "%p: can't punch fd %d: %m", pool, block->fd);
+		memset(block->ptr, 0, block->size);
+	}
+}
+
+static void trim_free(struct frame_pool *pool, size_t max_bytes)
+{
+	struct frame_block *block;
+
+	while (pool->stats.free_bytes > max_bytes && !spa_list_is_empty(&pool->free)) {
+		block = spa_list_last(&pool->free, struct frame_block, link);
+		spa_list_remove(&block->link);
+		pool->stats.free_bytes -= block->size;
+		block_free(pool, block);
+	}
+}
+
+struct frame_pool *frame_pool_ref(struct spa_log *log)
+{
+	struct frame_pool *pool = &global_pool;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->ref++ == 0) {
+		pool->log = log;
+		spa_log_topic_init(log, &log_topic);
+		spa_list_init(&pool->free);
+		spa_zero(pool->stats);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return pool;
+}
+
+void frame_pool_unref(struct frame_pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	if (--pool->ref == 0)
+		trim_free(pool, 0);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+struct frame_block *frame_pool_get(struct frame_pool *pool, size_t size)
+{
+	struct frame_block *block, *t, *best = NULL;
+	size_t class = size_class(size);
+	bool reused = false;
+
+	pthread_mutex_lock(&pool->lock);
+
+	/* the smallest free block that fits without wasting more than half */
+	spa_list_for_each(block, &pool->free, link) {
+		if (block->size < class || block->size / 2 > class)
+			continue;
+		if (best == NULL || block->size < best->size)
+			best = block;
+	}
+	if (best != NULL) {
+		spa_list_remove(&best->link);
+		pool->stats.free_bytes -= best->size;
+		pool->stats.n_reused++;
+		reused = true;
+	} else {
+		/* while a stream grows, its old blocks can't be used again, release
+		 * them before the new memory is allocated */
+		spa_list_for_each_safe(block, t, &pool->free, link) {
+			if (block->size >= class)
+				continue;
+			spa_list_remove(&block->link);
+			pool->stats.free_bytes -= block->size;
+			block_free(pool, block);
+		}
+		if ((best = block_new(pool, class)) != NULL)
+			pool->stats.n_created++;
+	}
+	if (best != NULL)
+		pool->stats.used_bytes += best->size;
+
+	pthread_mutex_unlock(&pool->lock);
+
+	if (best != NULL && reused)
+		block_clear(pool, best);
+
+	return best;
+}
+
+void frame_pool_put(struct frame_pool *pool, struct frame_block *block)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->stats.used_bytes -= block->size;
+	pool->stats.free_bytes += block->size;
+	spa_list_prepend(&pool->free, &block->link);
+	trim_free(pool, MAX_FREE_BYTES);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void frame_pool_get_stats(struct frame_pool *pool, struct frame_pool_stats *stats)
+{
+	pthread_mutex_lock(&pool->lock);
+	*stats = pool->stats;
+	pthread_mutex_unlock(&pool->lock);
+}
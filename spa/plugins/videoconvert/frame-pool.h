@@ -0,0 +1,49 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef SPA_VIDEOCONVERT_FRAME_POOL_H
+#define SPA_VIDEOCONVERT_FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <spa/utils/list.h>
+#include <spa/support/log.h>
+
+/**
+ * A pool of memfd backed frame memory, shared by all adapters of the
+ * process.
+ *
+ * Sizes are rounded up to a size class. Released blocks stay mapped and
+ * are handed out again for a request of the same or a slightly smaller
+ * size, so a renegotiation does not need new memory and the pages of the
+ * block are already faulted in.
+ */
+struct frame_block {
+	struct spa_list link;
+	int fd;
+	void *ptr;
+	size_t size;
+};
+
+struct frame_pool_stats {
+	uint64_t n_reused;
+	uint64_t n_created;
+	size_t used_bytes;
+	size_t free_bytes;
+};
+
+struct frame_pool;
+
+struct frame_pool *frame_pool_ref(struct spa_log *log);
+void frame_pool_unref(struct frame_pool *pool);
+
+/** Get a mapped block of at least \a size bytes */
+struct frame_block *frame_pool_get(struct frame_pool *pool, size_t size);
+/** Give a block back to the pool */
+void frame_pool_put(struct frame_pool *pool, struct frame_block *block);
+
+void frame_pool_get_stats(struct frame_pool *pool, struct frame_pool_stats *stats);
+
+#endif /* SPA_VIDEOCONVERT_FRAME_POOL_H */
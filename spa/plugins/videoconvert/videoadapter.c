@@ -29,6 +29,8 @@
 #include <spa/debug/pod.h>
 #include <spa/debug/log.h>
 
+#include "frame-pool.h"
+
 #undef SPA_LOG_TOPIC_DEFAULT
 #define SPA_LOG_TOPIC_DEFAULT &log_topic
 SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.videoadapter");
@@ -68,6 +70,8 @@ struct impl {
 
 	uint32_t n_buffers;
 	struct spa_buffer **buffers;
+	struct frame_pool *frame_pool;
+	struct frame_block **blocks;	/* pool memory of the buffers */
 
 	struct spa_io_buffers io_buffers;
 	struct spa_io_rate_match io_rate_match;
@@ -424,6 +428,49 @@ static int debug_params(struct impl *this, struct spa_node *node,
 	return 0;
 }
 
+static void clear_buffers(struct impl *this)
+{
+	uint32_t i;
+
+	if (this->blocks) {
+		for (i = 0; i < this->n_buffers; i++) {
+			if (this->blocks[i])
+				frame_pool_put(this->frame_pool, this->blocks[i]);
+		}
+		free(this->blocks);
+		this->blocks = NULL;
+	}
+	free(this->buffers);
+	this->buffers = NULL;
+	this->n_buffers = 0;
+}
+
+/* get the size of the damage meta of the follower, 0 when it has none */
+static uint32_t follower_damage_size(struct impl *this)
+{
+	uint8_t buffer[1024];
+	struct spa_pod_builder b;
+	uint32_t state = 0, type, size;
+	struct spa_pod *param;
+
+	while (true) {
+		spa_pod_builder_init(&b, buffer, sizeof(buffer));
+		if (node_port_enum_params_sync(this, this->follower,
+				this->direction, 0, SPA_PARAM_Meta, &state,
+				NULL, &param, &b) != 1)
+			break;
+		spa_pod_fixate(param);
+		if (spa_pod_parse_object(param,
+				SPA_TYPE_OBJECT_ParamMeta, NULL,
+				SPA_PARAM_META_type, SPA_POD_Id(&type),
+				SPA_PARAM_META_size, SPA_POD_Int(&size)) < 0)
+			continue;
+		if (type == SPA_META_VideoDamage)
+			return size;
+	}
+	return 0;
+}
+
 static int negotiate_buffers(struct impl *this)
 {
 	uint8_t buffer[4096];
@@ -432,10 +479,12 @@ static int negotiate_buffers(struct impl *this)
 	struct spa_pod *param;
 	int res;
 	bool follower_alloc, conv_alloc;
-	uint32_t i, size, buffers, blocks, align, flags, stride = 0, types;
+	uint32_t i, j, size, buffers, blocks, align, flags, stride = 0, types;
 	uint32_t *aligns, data_flags;
+	bool use_pool;
 	struct spa_data *datas;
-	struct spa_meta metas[1];
+	struct spa_meta metas[2];
+	uint32_t n_metas;
 	uint64_t follower_flags, conv_flags;
 	struct spa_node *alloc_node;
 	enum spa_direction alloc_direction;
@@ -521,9 +570,20 @@ static int negotiate_buffers(struct impl *this)
 	    SPA_FLAG_IS_SET(conv_flags, SPA_PORT_FLAG_DYNAMIC_DATA))
 		data_flags |= SPA_DATA_FLAG_DYNAMIC;
 
-	/* if we allocate, we allocate MemPtr memory */
-	if (!SPA_FLAG_IS_SET(alloc_flags, SPA_NODE_BUFFERS_FLAG_ALLOC))
-		types = SPA_DATA_MemPtr;
+	/* if we allocate, we allocate MemPtr memory, or memfd from the frame pool
+	 * when the nodes accept it */
+	use_pool = false;
+	if (!SPA_FLAG_IS_SET(alloc_flags, SPA_NODE_BUFFERS_FLAG_ALLOC)) {
+		use_pool = this->frame_pool != NULL;
+		if (use_pool && (types & (1u << SPA_DATA_MemFd))) {
+			types = SPA_DATA_MemFd;
+			data_flags |= SPA_DATA_FLAG_MAPPABLE;
+		} else {
+			types = SPA_DATA_MemPtr;
+		}
+		if (use_pool)
+			flags |= SPA_BUFFER_ALLOC_FLAG_NO_DATA;
+	}
 
 	for (i = 0; i < blocks; i++) {
 		datas[i].type = types;
@@ -531,15 +591,62 @@ static int negotiate_buffers(struct impl *this)
 		datas[i].maxsize = size;
 		aligns[i] = align;
 	}
-	metas[0].type = SPA_META_Header;
-	metas[0].size = sizeof(struct spa_meta_header);
+	n_metas = 0;
+	metas[n_metas].type = SPA_META_Header;
+	metas[n_metas].size = sizeof(struct spa_meta_header);
+	n_metas++;
+	/* let the converter see the damage of the follower */
+	if (this->convert != NULL &&
+	    (metas[n_metas].size = follower_damage_size(this)) > 0) {
+		metas[n_metas].type = SPA_META_VideoDamage;
+		n_metas++;
+	}
 
-	free(this->buffers);
-	this->buffers = spa_buffer_alloc_array(buffers, flags, 1, metas, blocks, datas, aligns);
+	clear_buffers(this);
+	this->buffers = spa_buffer_alloc_array(buffers, flags, n_metas, metas, blocks, datas, aligns);
 	if (this->buffers == NULL)
 		return -errno;
 	this->n_buffers = buffers;
 
+	if (use_pool) {
+		size_t offset, plane_size = SPA_ROUND_UP_N(size, align);
+
+		this->blocks = calloc(buffers, sizeof(struct frame_block *));
+		if (this->blocks == NULL)
+			return -errno;
+
+		/* one block per buffer with all the planes */
+		for (i = 0; i < buffers; i++) {
+			struct spa_buffer *buf = this->buffers[i];
+			struct frame_block *fb;
+
+			fb = frame_pool_get(this->frame_pool, plane_size * blocks);
+			if (fb == NULL) {
+				res = -errno;
+				spa_log_error(this->log, "%p: can't get frame memory: %s",
+						this, spa_strerror(res));
+				return res;
+			}
+			this->blocks[i] = fb;
+
+			for (j = 0, offset = 0; j < blocks; j++, offset += plane_size) {
+				struct spa_data *d = &buf->datas[j];
+
+				d->fd = types == SPA_DATA_MemFd ? fb->fd : -1;
+				d->mapoffset = offset;
+				d->data = SPA_PTROFF(fb->ptr, offset, void);
+			}
+		}
+		if (SPA_UNLIKELY(spa_log_level_topic_enabled(this->log, SPA_LOG_TOPIC_DEFAULT,
+						SPA_LOG_LEVEL_DEBUG))) {
+			struct frame_pool_stats stats;
+			frame_pool_get_stats(this->frame_pool, &stats);
+			spa_log_debug(this->log, "%p: frame pool reused:%"PRIu64" created:%"PRIu64
+					" used:%zu free:%zu", this, stats.n_reused, stats.n_created,
+					stats.used_bytes, stats.free_bytes);
+		}
+	}
+
 	/* prefer to let the follower alloc */
 	if (follower_alloc) {
 		alloc_node = this->follower;
@@ -568,13 +675,6 @@ static int negotiate_buffers(struct impl *this)
 	return 0;
 }
 
-static void clear_buffers(struct impl *this)
-{
-	free(this->buffers);
-	this->buffers = NULL;
-	this->n_buffers = 0;
-}
-
 static int configure_format(struct impl *this, uint32_t flags, const struct spa_pod *format)
 {
 	uint8_t buffer[4096];
@@ -1955,6 +2055,8 @@ static int impl_clear(struct spa_handle *handle)
 	}
 
 	clear_buffers(this);
+	if (this->frame_pool)
+		frame_pool_unref(this->frame_pool);
 	return 0;
 }
 
@@ -2024,6 +2126,11 @@ impl_init(const struct spa_handle_factory *factory,
 	if (ret < 0)
 		return ret;
 
+	/* taken last, impl_clear is not called when init fails */
+	if ((str = spa_dict_lookup(info, "adapter.frame-pool")) == NULL ||
+	    spa_atob(str))
+		this->frame_pool = frame_pool_ref(this->log);
+
 	if (this->convert == NULL) {
 		this->target = this->follower;
 		this->mode = SPA_PARAM_PORT_CONFIG_MODE_passthrough;
@@ -12,6 +12,8 @@
 #include <libswscale/swscale.h>
 #include <libavutil/pixfmt.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/buffer.h>
+#include <libavutil/opt.h>
 
 #include <spa/support/plugin.h>
 #include <spa/support/cpu.h>
@@ -39,6 +41,8 @@
 #include <spa/debug/log.h>
 #include <spa/control/ump-utils.h>
 
+#include "damage.h"
+
 #undef SPA_LOG_TOPIC_DEFAULT
 #define SPA_LOG_TOPIC_DEFAULT &log_topic
 SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.videoconvert.ffmpeg");
@@ -65,7 +69,10 @@ struct buffer {
 	struct spa_list link;
 	struct spa_buffer *buf;
 	void *datas[MAX_DATAS];
+	AVFrame *frame;			/* wraps datas for zero-copy conversion */
 	struct spa_meta_header *h;
+	struct spa_meta *damage;
+	uint64_t seq;			/* converted frame in the buffer */
 };
 
 struct port {
@@ -145,6 +152,7 @@ struct impl {
 	uint32_t cpu_flags;
 	uint32_t max_align;
 	uint32_t quantum_limit;
+	uint32_t n_threads;
 	enum spa_direction direction;
 
 	struct spa_ratelimit rate_limit;
@@ -186,7 +194,17 @@ struct impl {
 	struct {
 		struct SwsContext *context;
 		AVFrame *frame;
+		uint64_t frame_seq;	/* converted frame in frame */
 	} convert;
+
+#define MAX_DAMAGE_HISTORY	8
+	struct {
+		uint64_t seq;		/* last converted frame */
+		uint64_t first;		/* first frame of the current setup */
+		uint32_t align;
+		struct video_damage history[MAX_DAMAGE_HISTORY];
+		struct video_damage pending;
+	} damage;
 	struct {
 		AVCodecContext *context;
 		AVFrame *frame;
@@ -656,7 +674,11 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 
 static int videoconvert_set_param(struct impl *this, const char *k, const char *s)
 {
-	return 0;
+	if (spa_streq(k, "convert.threads"))
+		spa_atou32(s, &this->n_threads, 0);
+	else
+		return 0;
+	return 1;
 }
 
 static int parse_prop_params(struct impl *this, struct spa_pod *params)
@@ -1020,6 +1042,8 @@ static int setup_convert(struct impl *this)
 	av_frame_free(&this->convert.frame);
 	if ((this->convert.frame = av_frame_alloc()) == NULL)
 		return -EIO;
+	this->convert.frame_seq = 0;
+	this->damage.first = this->damage.seq + 1;
 
 	this->setup = true;
 
@@ -1519,6 +1543,15 @@ static int port_param_meta(struct impl *this, struct port *port, uint32_t id,
 				SPA_PARAM_META_type, SPA_POD_Id(SPA_META_Header),
 				SPA_PARAM_META_size, SPA_POD_Int(sizeof(struct spa_meta_header)));
 		return 1;
+	case 1:
+		*param = spa_pod_builder_add_object(b,
+				SPA_TYPE_OBJECT_ParamMeta, id,
+				SPA_PARAM_META_type, SPA_POD_Id(SPA_META_VideoDamage),
+				SPA_PARAM_META_size, SPA_POD_CHOICE_RANGE_Int(
+					sizeof(struct spa_meta_region) * 16,
+					sizeof(struct spa_meta_region) * 1,
+					sizeof(struct spa_meta_region) * 16));
+		return 1;
 	}
 	return 0;
 }
@@ -1651,8 +1684,10 @@ static int clear_buffers(struct impl *this, struct port *port)
 	uint32_t i, j;
 
 	spa_log_debug(this->log, "%p: clear buffers %p %d", this, port, port->n_buffers);
+
 	for (i = 0; i < port->n_buffers; i++) {
 		struct buffer *b = &port->buffers[i];
+		av_frame_free(&b->frame);
 		if (SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_MAPPED)) {
 			for (j = 0; j < b->buf->n_datas; j++) {
 				if (b->datas[j]) {
@@ -2076,6 +2111,11 @@ static inline void dequeue_buffer(struct impl *this, struct port *port, struct b
 	SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_QUEUED);
 }
 
+/* the memory is owned by the buffer, the refs only lend it to ffmpeg */
+static void free_buffer_ref(void *opaque, uint8_t *data)
+{
+}
+
 static int
 impl_node_port_use_buffers(void *object,
 			   enum spa_direction direction,
@@ -2115,8 +2155,12 @@ impl_node_port_use_buffers(void *object,
 		b->id = i;
 		b->flags = 0;
 		b->buf = buffers[i];
+		/* left from a use_buffers that failed halfway */
+		av_frame_free(&b->frame);
 		b->h = spa_buffer_find_meta_data(b->buf,
 				SPA_META_Header, sizeof(struct spa_meta_header));
+		b->damage = spa_buffer_find_meta(b->buf, SPA_META_VideoDamage);
+		b->seq = 0;
 
 		if (n_datas != port->blocks) {
 			spa_log_error(this->log, "%p: invalid blocks %d on buffer %d, expected %d",
@@ -2141,8 +2185,9 @@ impl_node_port_use_buffers(void *object,
 				void *data = d[j].data;
 				if (data == NULL && SPA_FLAG_IS_SET(d[j].flags, SPA_DATA_FLAG_MAPPABLE)) {
 					data = mmap(NULL, d[j].maxsize,
-						PROT_READ, MAP_SHARED, d[j].fd,
-						d[j].mapoffset);
+						direction == SPA_DIRECTION_OUTPUT ?
+							PROT_READ | PROT_WRITE : PROT_READ,
+						MAP_SHARED, d[j].fd, d[j].mapoffset);
 					if (data == MAP_FAILED) {
 						spa_log_error(this->log, "%p: mmap failed %d on buffer %d %d %p: %m",
 								this, j, i, d[j].type, data);
@@ -2157,6 +2202,10 @@ impl_node_port_use_buffers(void *object,
 							this, j, i);
 				}
 				b->datas[j] = data;
+				if (data != NULL && !SPA_FLAG_IS_SET(d[j].flags, SPA_DATA_FLAG_DYNAMIC) &&
+				    j < MAX_DATAS && (b->frame != NULL || (b->frame = av_frame_alloc()) != NULL))
+					b->frame->buf[j] = av_buffer_create(data, d[j].maxsize,
+							free_buffer_ref, NULL, 0);
 				spa_log_debug(this->log, "buffer %d: mem:%d data:%p maxsize:%d",
 						i, j, data, d[j].maxsize);
 				maxsize = SPA_MAX(maxsize, d[j].maxsize);
@@ -2234,6 +2283,173 @@ static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t
 	return 0;
 }
 
+static struct SwsContext *create_scaler(struct impl *this, const AVFrame *f, struct dir *out)
+{
+	struct SwsContext *ctx;
+	int res;
+
+	if ((ctx = sws_alloc_context()) == NULL)
+		return NULL;
+
+	av_opt_set_int(ctx, "srcw", f->width, 0);
+	av_opt_set_int(ctx, "srch", f->height, 0);
+	av_opt_set_int(ctx, "src_format", f->format, 0);
+	av_opt_set_int(ctx, "dstw", out->size.width, 0);
+	av_opt_set_int(ctx, "dsth", out->size.height, 0);
+	av_opt_set_int(ctx, "dst_format", out->pix_fmt, 0);
+
+	/* swscale splits the frame in slices for its worker threads */
+	if (this->n_threads > 1 &&
+	    (res = av_opt_set_int(ctx, "threads", this->n_threads, 0)) < 0)
+		spa_log_warn(this->log, "%p: can't use %d threads: %d", this,
+				this->n_threads, res);
+
+	if (sws_init_context(ctx, NULL, NULL) < 0) {
+		sws_freeContext(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/* Point the planes of a frame at the buffer memory. The frame of the
+ * buffer has the buffer refs made in use_buffers so ffmpeg uses the planes
+ * without copies, buffers without one use @f without refs. Returns the
+ * frame and sets @wrapped when all planes could be wrapped. */
+static AVFrame *wrap_frame(struct impl *this, AVFrame *f, struct buffer *b, struct dir *dir,
+		bool output, bool *wrapped)
+{
+	uint32_t i, n_datas = SPA_MIN(b->buf->n_datas, (uint32_t)MAX_DATAS);
+	int n_planes = av_pix_fmt_count_planes(dir->pix_fmt);
+	bool res = n_planes > 0 && n_datas >= (uint32_t)n_planes;
+
+	if (b->frame != NULL) {
+		f = b->frame;
+	} else {
+		res = false;
+		if (f == NULL)
+			goto done;
+		av_frame_unref(f);
+	}
+	f->format = dir->pix_fmt;
+	f->width = dir->size.width;
+	f->height = dir->size.height;
+
+	for (i = 0; i < n_datas; i++) {
+		struct spa_data *d = &b->buf->datas[i];
+		uint32_t offset = 0;
+
+		/* planes that share memory, like the ones of a DMA-BUF, are at
+		 * the offset of their chunk */
+		if (!output && d->chunk->offset < d->maxsize)
+			offset = d->chunk->offset;
+
+		f->data[i] = b->datas[i] ? SPA_PTROFF(b->datas[i], offset, uint8_t) : NULL;
+		f->linesize[i] = (output || d->chunk->stride == 0) ?
+			dir->linesizes[i] : d->chunk->stride;
+
+		if (f->buf[i] == NULL || offset + dir->plane_size[i] > d->maxsize)
+			res = false;
+	}
+done:
+	*wrapped = res;
+	return f;
+}
+
+/* Get the rows of the destination that need converting, the damage of all
+ * frames since the destination was last written. Returns NULL when the
+ * whole frame needs converting. */
+static const struct video_damage *update_damage(struct impl *this, struct buffer *sbuf,
+		const AVFrame *f, uint64_t dst_seq)
+{
+	uint64_t s, seq = ++this->damage.seq;
+	struct video_damage *cur = &this->damage.history[seq % MAX_DAMAGE_HISTORY];
+	struct video_damage *d = &this->damage.pending;
+
+	if (sbuf->damage == NULL)
+		video_damage_reset(cur, true);
+	else
+		video_damage_from_meta(cur, sbuf->damage, this->damage.align,
+				f->width, f->height);
+
+	if (cur->full || dst_seq < this->damage.first ||
+	    seq - dst_seq > MAX_DAMAGE_HISTORY)
+		return NULL;
+
+	*d = *cur;
+	for (s = dst_seq + 1; s < seq && !d->full; s++)
+		video_damage_union(d, &this->damage.history[s % MAX_DAMAGE_HISTORY], f->height);
+
+	/* converting most of the frame in bands is not worth it */
+	if (video_damage_rows(d, f->height) * 4 >= (uint32_t)f->height * 3)
+		return NULL;
+
+	return d;
+}
+
+static int convert_damage(struct impl *this, AVFrame *dst, const AVFrame *src,
+		const struct video_damage *d)
+{
+	struct SwsContext *ctx = this->convert.context;
+	uint32_t i;
+	int res;
+
+	if ((res = sws_frame_start(ctx, dst, src)) < 0)
+		return res;
+	if ((res = sws_send_slice(ctx, 0, src->height)) >= 0) {
+		for (i = 0; i < d->n_bands; i++) {
+			if ((res = sws_receive_slice(ctx, d->bands[i].y, d->bands[i].height)) < 0)
+				break;
+		}
+	}
+	sws_frame_end(ctx);
+	return res;
+}
+
+/* Pass the damage of the input to the output. After scaling or decoding
+ * the complete frame is damaged. */
+static void copy_damage(struct impl *this, struct buffer *sbuf, struct buffer *dbuf,
+		struct dir *out, bool full)
+{
+	struct spa_meta *sm = sbuf->damage, *dm = dbuf->damage;
+	struct spa_meta_region *s, *d, *first;
+	int64_t x1, y1, x2, y2;
+	bool overflow = false;
+
+	if (dm == NULL || (sm != NULL && sm->data == dm->data))
+		return;
+
+	d = first = spa_meta_first(dm);
+	if (!spa_meta_check(d, dm))
+		return;
+
+	if (sm == NULL || full) {
+		d->region = SPA_REGION(0, 0, out->size.width, out->size.height);
+		d++;
+	} else {
+		x1 = y1 = INT64_MAX;
+		x2 = y2 = INT64_MIN;
+		spa_meta_for_each(s, sm) {
+			if (!spa_meta_region_is_valid(s))
+				break;
+			x1 = SPA_MIN(x1, (int64_t)s->region.position.x);
+			y1 = SPA_MIN(y1, (int64_t)s->region.position.y);
+			x2 = SPA_MAX(x2, s->region.position.x + (int64_t)s->region.size.width);
+			y2 = SPA_MAX(y2, s->region.position.y + (int64_t)s->region.size.height);
+			if (spa_meta_check(d, dm))
+				*d++ = *s;
+			else
+				overflow = true;
+		}
+		/* does not fit, use the bounding box */
+		if (overflow) {
+			first->region = SPA_REGION(x1, y1, x2 - x1, y2 - y1);
+			d = first + 1;
+		}
+	}
+	if (spa_meta_check(d, dm))
+		d->region = SPA_REGION(0, 0, 0, 0);
+}
+
 static int impl_node_process(void *object)
 {
 	struct impl *this = object;
@@ -2244,6 +2460,7 @@ static int impl_node_process(void *object)
 	struct AVFrame *f;
 	void *datas[8];
 	uint32_t sizes[8], strides[8];
+	bool full_damage = this->decoder.context != NULL, wrapped;
 	int res;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
@@ -2319,13 +2536,10 @@ static int impl_node_process(void *object)
 			sizes[i] = out->plane_size[i];
 		}
 	} else {
-		f = this->decoder.frame;
-		f->format = in->pix_fmt;
-		f->width = in->size.width;
-		f->height = in->size.height;
+		f = wrap_frame(this, this->decoder.frame, sbuf, in, false, &wrapped);
 		for (uint32_t i = 0; i < sbuf->buf->n_datas; ++i) {
-			datas[i] = f->data[i] = sbuf->datas[i];
-			strides[i] = f->linesize[i] = sbuf->buf->datas[i].chunk->stride;
+			datas[i] = f->data[i];
+			strides[i] = f->linesize[i];
 			sizes[i] = sbuf->buf->datas[i].chunk->size;
 		}
 	}
@@ -2334,20 +2548,66 @@ static int impl_node_process(void *object)
 	if (f->format != out->pix_fmt ||
 	    f->width != (int)out->size.width ||
 	    f->height != (int)out->size.height) {
+		const struct video_damage *damage = NULL;
+		uint64_t *dst_seq;
+		AVFrame *dst;
+
 		if (this->convert.context == NULL) {
 			const AVPixFmtDescriptor *in_fmt = av_pix_fmt_desc_get(f->format);
 			const AVPixFmtDescriptor *out_fmt = av_pix_fmt_desc_get(out->pix_fmt);
-			this->convert.context = sws_getContext(
-					f->width, f->height, f->format,
-					out->size.width, out->size.height, out->pix_fmt,
-					0, NULL, NULL, NULL);
-			spa_log_info(this->log, "%p: using convert %dx%d:%s -> %dx%d:%s",
+
+			if ((this->convert.context = create_scaler(this, f, out)) == NULL) {
+				spa_log_error(this->log, "%p: failed to create scaler", this);
+				return -EIO;
+			}
+			spa_log_info(this->log, "%p: using convert %dx%d:%s -> %dx%d:%s threads:%d",
 					this, f->width, f->height, in_fmt->name,
-					out->size.width, out->size.height, out_fmt->name);
+					out->size.width, out->size.height, out_fmt->name,
+					this->n_threads);
+
+			/* damaged bands must start on a row that can be converted
+			 * on its own */
+			this->damage.align = SPA_MAX(sws_receive_slice_alignment(this->convert.context),
+					1u << SPA_MAX(in_fmt->log2_chroma_h, out_fmt->log2_chroma_h));
+		}
+		/* scale straight into the output buffer when we can, the
+		 * encoder needs its own frame */
+		if (this->encoder.context == NULL &&
+		    (dst = wrap_frame(this, NULL, dbuf, out, true, &wrapped)) != NULL &&
+		    wrapped) {
+			dst_seq = &dbuf->seq;
+		} else {
+			dst = this->convert.frame;
+			dst_seq = &this->convert.frame_seq;
+		}
+
+		/* without scaling, only the damaged rows of the destination
+		 * need to be converted again */
+		if (f->width != (int)out->size.width || f->height != (int)out->size.height)
+			full_damage = true;
+		if (full_damage)
+			this->damage.seq++;
+		else
+			damage = update_damage(this, sbuf, f, *dst_seq);
+
+		if (damage != NULL) {
+			spa_log_trace(this->log, "convert %s %u bands %u rows",
+					dst != this->convert.frame ? "direct" : "copy",
+					damage->n_bands, video_damage_rows(damage, f->height));
+			res = damage->n_bands > 0 ?
+				convert_damage(this, dst, f, damage) : 0;
+		} else {
+			spa_log_trace(this->log, "convert %s",
+					dst != this->convert.frame ? "direct" : "copy");
+			res = sws_scale_frame(this->convert.context, dst, f);
 		}
-		spa_log_trace(this->log, "convert");
-		sws_scale_frame(this->convert.context, this->convert.frame, f);
-		f = this->convert.frame;
+		if (res < 0) {
+			spa_log_error(this->log, "%p: failed to convert: %d", this, res);
+			*dst_seq = 0;
+			return -EIO;
+		}
+		*dst_seq = dbuf->seq = this->damage.seq;
+		f = dst;
 		for (uint32_t i = 0; i < 4; ++i) {
 			datas[i] = f->data[i];
 			strides[i] = f->linesize[i];
@@ -2389,6 +2649,7 @@ static int impl_node_process(void *object)
 
 	if (sbuf->h && dbuf->h)
 		*dbuf->h = *sbuf->h;
+	copy_damage(this, sbuf, dbuf, out, full_damage);
 
 	output->buffer_id = dbuf->id;
 	output->status = SPA_STATUS_HAVE_DATA;
@@ -2451,6 +2712,7 @@ static int impl_clear(struct spa_handle *handle)
 	free_encoder(this);
 	av_frame_free(&this->decoder.frame);
 	av_frame_free(&this->convert.frame);
+	sws_freeContext(this->convert.context);
 
 	free_dir(&this->dir[SPA_DIRECTION_INPUT]);
 	free_dir(&this->dir[SPA_DIRECTION_OUTPUT]);
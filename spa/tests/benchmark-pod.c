@@ -12,6 +12,7 @@
 #include <spa/pod/pod.h>
 #include <spa/pod/builder.h>
 #include <spa/pod/parser.h>
+#include <spa/pod/filter.h>
 #include <spa/param/video/format-utils.h>
 #include <spa/debug/pod.h>
 
@@ -264,11 +265,180 @@ static void test_parser(void)
 			t2 - t1, count, count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1));
 }
 
+struct format_set {
+	const char *name;
+	uint8_t buffer[65536];
+	struct spa_pod_builder b;
+	struct spa_pod *params[256];
+	uint32_t n_params;
+};
+
+/* what a typical USB webcam exposes through V4L2: one EnumFormat for each
+ * pixel format and discrete frame size with an enum of frame intervals */
+static void make_v4l2_formats(struct format_set *s)
+{
+	static const uint32_t formats[] = {
+		SPA_VIDEO_FORMAT_YUY2, SPA_VIDEO_FORMAT_NV12, 0 /* mjpg */
+	};
+	static const struct spa_rectangle sizes[] = {
+		{ 160, 120 }, { 176, 144 }, { 320, 180 }, { 320, 240 },
+		{ 352, 288 }, { 424, 240 }, { 640, 360 }, { 640, 480 },
+		{ 800, 448 }, { 800, 600 }, { 848, 480 }, { 960, 540 },
+		{ 1024, 576 }, { 1280, 720 }, { 1600, 896 }, { 1920, 1080 },
+		{ 2304, 1296 }, { 2560, 1440 }, { 3840, 2160 },
+	};
+	static const struct spa_fraction rates[] = {
+		{ 60, 1 }, { 30, 1 }, { 24, 1 }, { 20, 1 }, { 15, 1 }, { 10, 1 }, { 5, 1 },
+	};
+	struct spa_pod_frame f[2];
+	uint32_t i, j, k;
+
+	s->name = "v4l2";
+	spa_pod_builder_init(&s->b, s->buffer, sizeof(s->buffer));
+
+	for (i = 0; i < SPA_N_ELEMENTS(formats); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(sizes); j++) {
+			spa_pod_builder_push_object(&s->b, &f[0], SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat);
+			spa_pod_builder_add(&s->b,
+					SPA_FORMAT_mediaType,    SPA_POD_Id(SPA_MEDIA_TYPE_video),
+					SPA_FORMAT_mediaSubtype, SPA_POD_Id(formats[i] ?
+						SPA_MEDIA_SUBTYPE_raw : SPA_MEDIA_SUBTYPE_mjpg),
+					0);
+			if (formats[i]) {
+				spa_pod_builder_prop(&s->b, SPA_FORMAT_VIDEO_format, 0);
+				spa_pod_builder_id(&s->b, formats[i]);
+			}
+			spa_pod_builder_prop(&s->b, SPA_FORMAT_VIDEO_size, 0);
+			spa_pod_builder_rectangle(&s->b, sizes[j].width, sizes[j].height);
+
+			spa_pod_builder_prop(&s->b, SPA_FORMAT_VIDEO_framerate, 0);
+			spa_pod_builder_push_choice(&s->b, &f[1], SPA_CHOICE_Enum, 0);
+			spa_pod_builder_fraction(&s->b, rates[0].num, rates[0].denom);
+			for (k = 0; k < SPA_N_ELEMENTS(rates); k++)
+				spa_pod_builder_fraction(&s->b, rates[k].num, rates[k].denom);
+			spa_pod_builder_pop(&s->b, &f[1]);
+
+			s->params[s->n_params++] = spa_pod_builder_pop(&s->b, &f[0]);
+		}
+	}
+}
+
+/* what libcamera exposes: one EnumFormat for each pixel format with a
+ * stepped size range */
+static void make_libcamera_formats(struct format_set *s)
+{
+	static const uint32_t formats[] = {
+		SPA_VIDEO_FORMAT_NV12, SPA_VIDEO_FORMAT_NV21, SPA_VIDEO_FORMAT_I420,
+		SPA_VIDEO_FORMAT_YV12, SPA_VIDEO_FORMAT_YUY2, SPA_VIDEO_FORMAT_UYVY,
+		SPA_VIDEO_FORMAT_RGB, SPA_VIDEO_FORMAT_BGR, SPA_VIDEO_FORMAT_RGBA,
+		SPA_VIDEO_FORMAT_BGRA, SPA_VIDEO_FORMAT_RGBx, SPA_VIDEO_FORMAT_BGRx,
+	};
+	struct spa_pod_frame f[2];
+	uint32_t i;
+
+	s->name = "libcamera";
+	spa_pod_builder_init(&s->b, s->buffer, sizeof(s->buffer));
+
+	for (i = 0; i < SPA_N_ELEMENTS(formats); i++) {
+		spa_pod_builder_push_object(&s->b, &f[0], SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat);
+		spa_pod_builder_add(&s->b,
+				SPA_FORMAT_mediaType,    SPA_POD_Id(SPA_MEDIA_TYPE_video),
+				SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+				0);
+		spa_pod_builder_prop(&s->b, SPA_FORMAT_VIDEO_format, 0);
+		spa_pod_builder_id(&s->b, formats[i]);
+
+		spa_pod_builder_prop(&s->b, SPA_FORMAT_VIDEO_size, 0);
+		spa_pod_builder_push_choice(&s->b, &f[1], SPA_CHOICE_Step, 0);
+		spa_pod_builder_rectangle(&s->b, 32, 16);
+		spa_pod_builder_rectangle(&s->b, 32, 16);
+		spa_pod_builder_rectangle(&s->b, 4056, 3040);
+		spa_pod_builder_rectangle(&s->b, 2, 2);
+		spa_pod_builder_pop(&s->b, &f[1]);
+
+		s->params[s->n_params++] = spa_pod_builder_pop(&s->b, &f[0]);
+	}
+}
+
+/* a consumer filter like the ones used by browsers and screen recorders,
+ * with the properties in a different order than the producers */
+static struct spa_pod *make_filter(struct spa_pod_builder *b)
+{
+	return spa_pod_builder_add_object(b,
+			SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat,
+			SPA_FORMAT_VIDEO_framerate, SPA_POD_CHOICE_RANGE_Fraction(
+							&SPA_FRACTION(30,1),
+							&SPA_FRACTION(0,1),
+							&SPA_FRACTION(144,1)),
+			SPA_FORMAT_VIDEO_size,      SPA_POD_CHOICE_RANGE_Rectangle(
+							&SPA_RECTANGLE(1280, 720),
+							&SPA_RECTANGLE(1, 1),
+							&SPA_RECTANGLE(8192, 4320)),
+			SPA_FORMAT_VIDEO_format,    SPA_POD_CHOICE_ENUM_Id(9,
+							SPA_VIDEO_FORMAT_I420,
+							SPA_VIDEO_FORMAT_I420,
+							SPA_VIDEO_FORMAT_YV12,
+							SPA_VIDEO_FORMAT_NV12,
+							SPA_VIDEO_FORMAT_YUY2,
+							SPA_VIDEO_FORMAT_UYVY,
+							SPA_VIDEO_FORMAT_BGRx,
+							SPA_VIDEO_FORMAT_RGBx,
+							SPA_VIDEO_FORMAT_BGRA),
+			SPA_FORMAT_mediaSubtype,    SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+			SPA_FORMAT_mediaType,	    SPA_POD_Id(SPA_MEDIA_TYPE_video));
+}
+
+static void test_filter(struct format_set *s)
+{
+	uint8_t fbuffer[1024], buffer[4096];
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod *filter, *result;
+	struct timespec ts;
+	uint64_t t1, t2;
+	uint64_t count = 0;
+	uint32_t i, n_results = 0;
+
+	spa_pod_builder_init(&b, fbuffer, sizeof(fbuffer));
+	filter = make_filter(&b);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	fprintf(stderr, "test_filter(%s, %u formats) : ", s->name, s->n_params);
+	for (count = 0; count < MAX_COUNT; count++) {
+		n_results = 0;
+		for (i = 0; i < s->n_params; i++) {
+			spa_pod_builder_init(&b, buffer, sizeof(buffer));
+			if (spa_pod_filter(&b, &result, s->params[i], filter) >= 0)
+				n_results++;
+		}
+		spa_assert(n_results > 0);
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+		if (t2 - t1 > 1 * SPA_NSEC_PER_SEC)
+			break;
+	}
+	fprintf(stderr, "elapsed %"PRIu64" count %"PRIu64" = %"PRIu64"/sec (%u matches)\n",
+			t2 - t1, count, count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+			n_results);
+}
+
 int main(int argc, char *argv[])
 {
+	static struct format_set set;
+
 	test_builder();
 	test_builder2();
 	test_parse();
 	test_parser();
+
+	spa_zero(set);
+	make_v4l2_formats(&set);
+	test_filter(&set);
+
+	spa_zero(set);
+	make_libcamera_formats(&set);
+	test_filter(&set);
 	return 0;
 }
@@ -29,6 +29,7 @@ PW_LOG_TOPIC_EXTERN(mod_topic);
 /** \cond */
 
 #define MAX_BUFFERS	64
+#define MAX_FREE_MEM	16
 #define MAX_METAS	16u
 #define MAX_DATAS	256u
 #define AREA_SLOT	(sizeof(struct spa_io_async_buffers))
@@ -114,6 +115,10 @@ struct impl {
 	struct pw_map io_map;
 	struct pw_array io_areas;
 
+	struct pw_array free_mem;	/* buffer memory still imported by the client */
+	uint32_t n_mem_reused;
+	uint32_t n_mem_created;
+
 	struct pw_memblock *activation;
 
 	struct spa_hook node_listener;
@@ -266,6 +271,63 @@ static void clear_data(struct impl *impl, struct spa_data *d)
 	}
 }
 
+/* drop the recycled memory that was released by the context */
+static void prune_free_mem(struct impl *impl)
+{
+	struct pw_memblock **m;
+
+	for (m = pw_array_first(&impl->free_mem); pw_array_check(&impl->free_mem, m);) {
+		if ((*m)->fd == -1) {
+			pw_memblock_unref(*m);
+			pw_array_remove(&impl->free_mem, m);
+		} else {
+			m++;
+		}
+	}
+}
+
+/* Keep the buffer memory imported in the client when the buffers are
+ * cleared. The context reuses the memory for the next buffers of the port
+ * when it fits and then the client doesn't need a new fd and mapping. */
+static void recycle_mem(struct impl *impl, struct pw_memblock *mem)
+{
+	struct pw_memblock **m;
+
+	if (mem->fd == -1)
+		goto unref;
+
+	pw_array_for_each(m, &impl->free_mem) {
+		if (*m == mem)
+			goto unref;
+	}
+	if (pw_array_get_len(&impl->free_mem, struct pw_memblock*) >= MAX_FREE_MEM) {
+		m = pw_array_first(&impl->free_mem);
+		pw_memblock_unref(*m);
+		pw_array_remove(&impl->free_mem, m);
+	}
+	if (pw_array_add_ptr(&impl->free_mem, mem) < 0)
+		goto unref;
+	return;
+unref:
+	pw_memblock_unref(mem);
+}
+
+static void take_mem(struct impl *impl, struct pw_memblock *mem)
+{
+	struct pw_memblock **m;
+
+	pw_array_for_each(m, &impl->free_mem) {
+		if (*m == mem) {
+			pw_array_remove(&impl->free_mem, m);
+			pw_memblock_unref(mem);
+			impl->n_mem_reused++;
+			return;
+		}
+	}
+	if (mem->ref == 1)
+		impl->n_mem_created++;
+}
+
 static void clear_buffer(struct impl *impl, struct spa_buffer *b)
 {
 	uint32_t i;
@@ -281,9 +343,10 @@ static int clear_buffers(struct impl *impl, struct mix *mix)
 
 		spa_log_debug(impl->log, "%p: clear buffer %d", impl, i);
 		clear_buffer(impl, &b->buffer);
-		pw_memblock_unref(b->mem);
+		recycle_mem(impl, b->mem);
 	}
 	mix->n_buffers = 0;
+	prune_free_mem(impl);
 	return 0;
 }
 
@@ -842,6 +905,7 @@ do_port_use_buffers(struct impl *impl,
 		if (m == NULL)
 			return -errno;
 
+		take_mem(impl, m);
 		b->mem = m;
 
 		mb[i].buffer = &b->buffer;
@@ -902,6 +966,9 @@ do_port_use_buffers(struct impl *impl,
 	}
 	mix->n_buffers = n_buffers;
 
+	spa_log_debug(impl->log, "%p: buffer memory reused:%u created:%u", impl,
+			impl->n_mem_reused, impl->n_mem_created);
+
 	return pw_client_node_resource_port_use_buffers(impl->resource,
 						 direction, port_id, mix_id, flags,
 						 n_buffers, mb);
@@ -1425,6 +1492,10 @@ static void node_free(void *data)
 	}
 	pw_array_clear(&impl->io_areas);
 
+	pw_array_for_each(area, &impl->free_mem)
+		pw_memblock_unref(*area);
+	pw_array_clear(&impl->free_mem);
+
 	if (impl->resource)
 		pw_resource_destroy(impl->resource);
 
@@ -1777,6 +1848,7 @@ struct pw_impl_client_node *pw_impl_client_node_new(struct pw_resource *resource
 	pw_map_init(&impl->ports[1], 64, 64);
 	pw_map_init(&impl->io_map, 64, 64);
 	pw_array_init(&impl->io_areas, 64 * sizeof(struct pw_memblock*));
+	pw_array_init(&impl->free_mem, MAX_FREE_MEM * sizeof(struct pw_memblock*));
 
 	this->resource = resource;
 	this->node = pw_spa_node_new(context,
@@ -53,6 +53,41 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  * - `filter.graph = []`: a description of the filter graph to run, see below
  * - `capture.props = {}`: properties to be passed to the input stream
  * - `playback.props = {}`: properties to be passed to the output stream
+ * - `filter-graph.fuse`: run linear chains of builtin filters on small blocks of
+ *   samples at a time, default true. The chains can contain the `bq_*`, `copy`,
+ *   `mixer`, `linear`, `mult` and `delay` filters.
+ * - `filter-graph.lanes`: run the `bq_*` filters of up to 16 channels together,
+ *   with one channel in each SIMD lane, default false. On CPUs with AVX and FMA
+ *   the lanes use fused multiply-adds, the output can then differ from the
+ *   default by a small rounding error.
+ * - `filter-graph.threads`: the number of threads, including the data thread, that
+ *   run the independent filters of the graph in parallel, default 1. The helper
+ *   threads get realtime priority. When the data thread is realtime and the
+ *   helpers can't get realtime priority, the graph runs on the data thread only,
+ *   as do small graphs and graphs without independent filters. No helper
+ *   threads are created for those.
+ * - `filter-graph.ramp`: the time in milliseconds it takes a control that is set
+ *   from a control sequence to move to its new value, default 5.0. Use 0 to
+ *   change the value at the offset of the control.
+ * - `filter-graph.ramp-block`: the number of samples between two steps of a
+ *   ramping control, default 32. Use 1 to update the controls on every sample.
+ * - `filter-graph.profile`: measure the time spent in each filter, default false.
+ *   Every second, the `filter-graph.cpu.load` property of the capture node is
+ *   updated with the load of each filter instance, as a JSON object with an
+ *   array of `[ load, max ]` per instance for each node. The load is the
+ *   average and maximum fraction of the cycle time used by the instance.
+ * - `filter-graph.silence-timeout`: the time in milliseconds that the inputs and
+ *   outputs of the graph need to be silent before the graph stops running,
+ *   default 0, which always runs the graph. The outputs are then filled with
+ *   silence until there is signal on the inputs or a control changes. Graphs
+ *   that produce output later than this after their input, such as long delays,
+ *   need a larger value. Graphs without audio outputs and graphs with filters
+ *   that have control outputs, such as `ebur128`, always run.
+ *
+ * The `bq_*` filters interpolate their coefficients over a block, and keep
+ * their state, when their controls are changed with a control sequence. Changes
+ * with the node params, like a new preset, recompute the filters and reset their
+ * state.
  *
  * ## Filter graph description
  *
@@ -101,7 +136,9 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  * - `plugin` is the type specific plugin name.
  *    - For LADSPA plugins it will append `.so` to find the shared object with that
  *       name in the LADSPA plugin path.
- *    - For LV2, this is the plugin URI obtained with lv2ls.
+ *    - For LV2, this is the plugin URI obtained with lv2ls. Plugins that use the
+ *      LV2 worker extension get a worker thread per instance that does the
+ *      non-realtime work.
  *    - For builtin, sofa and ebur128 this is ignored
  * - `label` is the type specific filter inside the plugin.
  *    - For LADSPA this is the label
@@ -365,6 +402,10 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  * - `latency`  The extra latency in seconds to report. When left unspecified (or < 0.0)
  *              the convolver latency will be the length of the IR.
  *
+ * Convolvers that load the same IR with the same config share the transformed
+ * IR, so that the file is only read, resampled and transformed once for all of
+ * them.
+ *
  * ### Delay
  *
  * The delay can be used to delay a signal in time.
@@ -567,6 +608,50 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  * - `Radius`    controls how far away the signal is as a value between 0 and 100.
  *               default is 1.0.
  *
+ * ### Spatializer multi
+ *
+ * The spatializer_multi places up to 32 sources in a 3D space with one node.
+ *
+ * It has input ports "In 1" to "In 32" and a stereo pair of output ports
+ * called "Out L" and "Out R". Unconnected inputs are skipped. Each source has
+ * its own "Azimuth N", "Elevation N" and "Radius N" controls, with the same
+ * meaning as those of the spatializer.
+ *
+ * The responses of all directions in the SOFA file are transformed when the
+ * node is loaded. The response of a source is interpolated between the
+ * closest directions and a new response is faded in over one block, so that
+ * moving sources don't need new convolvers. All sources are summed before
+ * the inverse transforms.
+ *
+ *\code{.unparsed}
+ * filter.graph = {
+ *     nodes = [
+ *         {
+ *             type   = sofa
+ *             name   = ...
+ *             label  = spatializer_multi
+ *             config = {
+ *                 blocksize = ...
+ *                 filename = ...
+ *             }
+ *             control = {
+ *                 "Azimuth 1" = ...
+ *                 "Elevation 1" = ...
+ *                 "Radius 1" = ...
+ *                 ...
+ *             }
+ *             ...
+ *         }
+ *     }
+ *     ...
+ * }
+ *\endcode
+ *
+ * - `blocksize` the size of the blocks to use in the FFT and the length of the
+ *               fade. When not specified, this value is computed
+ *               automatically from the number of samples in the file.
+ * - `filename` The SOFA file to load.
+ *
  * ## EBUR128 filter
  *
  * There is an optional EBU R128 filter available.
@@ -1314,6 +1399,14 @@ static void graph_info(void *object, const struct spa_filter_graph_info *info)
 	for (i = 0; props && i < props->n_items; i++) {
 		const char *k = props->items[i].key;
 		const char *s = props->items[i].value;
+		if (spa_streq(k, "cpu.load")) {
+			/* updated periodically with filter-graph.profile */
+			if (impl->capture != NULL)
+				pw_stream_update_properties(impl->capture,
+						&SPA_DICT_ITEMS(
+							SPA_DICT_ITEM("filter-graph.cpu.load", s)));
+			continue;
+		}
 		pw_log_info("%s %s", k, s);
 		if (spa_streq(k, "latency")) {
 			double latency;
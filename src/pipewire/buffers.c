@@ -36,7 +36,8 @@ static int alloc_buffers(struct pw_mempool *pool,
 			 uint32_t *data_aligns,
 			 uint32_t *data_types,
 			 uint32_t flags,
-			 struct pw_buffers *allocation)
+			 struct pw_buffers *allocation,
+			 struct pw_memblock **recycled)
 {
 	struct spa_buffer **buffers;
 	void *skel, *data;
@@ -79,18 +80,30 @@ static int alloc_buffers(struct pw_mempool *pool,
 	skel = SPA_PTR_ALIGN(skel, info.max_align, void);
 
 	if (SPA_FLAG_IS_SET(flags, PW_BUFFERS_FLAG_SHARED)) {
-		/* pointer to buffer structures */
-		m = pw_mempool_alloc(pool,
-				PW_MEMBLOCK_FLAG_READWRITE |
-				PW_MEMBLOCK_FLAG_SEAL |
-				PW_MEMBLOCK_FLAG_MAP,
-				SPA_DATA_MemFd,
-				n_buffers * info.mem_size);
-		if (m == NULL) {
-			free(buffers);
-			return -errno;
+		size_t size = n_buffers * info.mem_size;
+
+		/* reuse the memory of the previous buffers when it is large enough
+		 * and not too large, peers that still have it imported don't need
+		 * a new fd and mapping */
+		m = recycled ? *recycled : NULL;
+		if (m != NULL && m->map != NULL &&
+		    m->size >= size && m->size / 2 <= size) {
+			pw_log_debug("%p: reuse mem %p size:%u for %zu", allocation,
+					m, m->size, size);
+			*recycled = NULL;
+		} else {
+			/* pointer to buffer structures */
+			m = pw_mempool_alloc(pool,
+					PW_MEMBLOCK_FLAG_READWRITE |
+					PW_MEMBLOCK_FLAG_SEAL |
+					PW_MEMBLOCK_FLAG_MAP,
+					SPA_DATA_MemFd,
+					size);
+			if (m == NULL) {
+				free(buffers);
+				return -errno;
+			}
 		}
-
 		data = m->map->ptr;
 	} else {
 		m = NULL;
@@ -101,6 +114,10 @@ static int alloc_buffers(struct pw_mempool *pool,
 			allocation, skel, data, n_buffers, buffers);
 	spa_buffer_alloc_layout_array(&info, n_buffers, buffers, skel, data);
 
+	if (recycled && *recycled) {
+		pw_memblock_unref(*recycled);
+		*recycled = NULL;
+	}
 	allocation->mem = m;
 	allocation->n_buffers = n_buffers;
 	allocation->buffers = buffers;
@@ -177,11 +194,10 @@ param_filter(struct pw_buffers *this,
 	return num;
 }
 
-SPA_EXPORT
-int pw_buffers_negotiate(struct pw_context *context, uint32_t flags,
+int pw_buffers_negotiate_recycled(struct pw_context *context, uint32_t flags,
 		struct spa_node *outnode, uint32_t out_port_id,
 		struct spa_node *innode, uint32_t in_port_id,
-		struct pw_buffers *result)
+		struct pw_buffers *result, struct pw_memblock **recycled)
 {
 	struct spa_pod **params;
 	uint8_t buffer[4096];
@@ -338,13 +354,23 @@ int pw_buffers_negotiate(struct pw_context *context, uint32_t flags,
 				 data_sizes, data_strides,
 				 data_aligns, data_types,
 				 flags,
-				 result)) < 0) {
+				 result, recycled)) < 0) {
 		pw_log_error("%p: can't alloc buffers: %s", result, spa_strerror(res));
 	}
 
 	return res;
 }
 
+SPA_EXPORT
+int pw_buffers_negotiate(struct pw_context *context, uint32_t flags,
+		struct spa_node *outnode, uint32_t out_port_id,
+		struct spa_node *innode, uint32_t in_port_id,
+		struct pw_buffers *result)
+{
+	return pw_buffers_negotiate_recycled(context, flags, outnode, out_port_id,
+			innode, in_port_id, result, NULL);
+}
+
 SPA_EXPORT
 void pw_buffers_clear(struct pw_buffers *buffers)
 {
@@ -353,6 +353,7 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	spa_list_init(&this->control_list[1]);
 	spa_list_init(&this->export_list);
 	spa_list_init(&this->driver_list);
+	spa_list_init(&this->format_cache);
 	spa_hook_list_init(&this->listener_list);
 	spa_hook_list_init(&this->driver_listener_list);
 
@@ -377,7 +378,7 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	if ((res = pw_conf_load_conf_for_context (properties, conf)) < 0)
 		goto error_free;
 
-	n_support = pw_get_support(this->support, SPA_N_ELEMENTS(this->support) - 6);
+	n_support = pw_get_support(this->support, SPA_N_ELEMENTS(this->support) - 7);
 	cpu = spa_support_find(this->support, n_support, SPA_TYPE_INTERFACE_CPU);
 
 	vm_type = SPA_CPU_VM_NONE;
@@ -569,6 +570,8 @@ void pw_context_destroy(struct pw_context *context)
 	pw_log_debug("%p: free", context);
 	pw_context_emit_free(context);
 
+	pw_impl_link_clear_format_cache(context);
+
 	for (i = 0; i < impl->n_data_loops; i++) {
 		if (impl->data_loops[i].impl)
 			pw_data_loop_destroy(impl->data_loops[i].impl);
@@ -631,6 +634,8 @@ const struct spa_support *context_get_support(struct pw_context *context, uint32
 		context->support[n++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_DataSystem, loop->system);
 		context->support[n++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_DataLoop, loop->loop);
 	}
+	context->support[n++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_ThreadUtils,
+			context->thread_utils ? context->thread_utils : pw_thread_utils_get());
 	*n_support = n;
 	return context->support;
 }
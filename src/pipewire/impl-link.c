@@ -35,6 +35,13 @@ struct port_info {
 	struct pw_impl_port *port;
 	struct pw_impl_node *node;
 	struct pw_impl_port_mix *mix;
+	uint64_t fingerprint;
+};
+
+struct format_cache_entry {
+	struct spa_list link;
+	uint64_t key[2];
+	struct spa_pod *format;
 };
 
 /** \cond */
@@ -221,6 +228,169 @@ static void complete_sync(void *obj, void *data, int res, uint32_t id)
 			port->state, spa_strerror(res));
 }
 
+static uint64_t fingerprint_add(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static int fingerprint_add_params(struct spa_node *node, enum spa_direction direction,
+		uint32_t port_id, uint32_t id, uint64_t *hash)
+{
+	uint32_t idx = 0;
+	uint8_t buffer[4096];
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod *param = NULL;
+	int res, count = 0;
+
+	while (true) {
+		spa_pod_builder_init(&b, buffer, sizeof(buffer));
+		if (port_id == SPA_ID_INVALID)
+			res = spa_node_enum_params_sync(node, id, &idx, NULL, &param, &b);
+		else
+			res = spa_node_port_enum_params_sync(node, direction, port_id,
+					id, &idx, NULL, &param, &b);
+		if (res != 1)
+			break;
+
+		*hash = fingerprint_add(*hash, param, SPA_POD_SIZE(param));
+		count++;
+	}
+	if (res < 0 && res != -ENOENT && res != -ENOTSUP)
+		return res;
+	return count;
+}
+
+/* make a fingerprint of everything the nodes use to filter the formats of
+ * a port: the EnumFormat params of the port, the Props of the node and the
+ * properties of the port, without the ones that only identify the port.
+ * The fingerprint is kept on the port until one of those changes so that a
+ * cache hit does not need to enumerate the formats again. Returns the number
+ * of formats, 1 for a kept fingerprint, or < 0 on error. */
+static int port_format_fingerprint(struct port_info *info, uint64_t *fingerprint)
+{
+	static const char * const ignored[] = {
+		PW_KEY_OBJECT_ID,
+		PW_KEY_OBJECT_SERIAL,
+		PW_KEY_OBJECT_PATH,
+		PW_KEY_NODE_ID,
+		PW_KEY_PORT_ID,
+		PW_KEY_PORT_NAME,
+		PW_KEY_PORT_ALIAS,
+		NULL
+	};
+	struct pw_impl_port *port = info->port;
+	struct spa_node *node = info->node->node;
+	const struct spa_dict_item *it;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	int res, count, i;
+
+	if (port->have_formats_fingerprint) {
+		*fingerprint = port->formats_fingerprint;
+		return 1;
+	}
+
+	if ((count = fingerprint_add_params(node, port->direction, port->port_id,
+					SPA_PARAM_EnumFormat, &hash)) < 0)
+		return count;
+	if ((res = fingerprint_add_params(node, port->direction, SPA_ID_INVALID,
+					SPA_PARAM_Props, &hash)) < 0)
+		return res;
+
+	spa_dict_for_each(it, &port->properties->dict) {
+		for (i = 0; ignored[i] != NULL; i++)
+			if (spa_streq(it->key, ignored[i]))
+				break;
+		if (ignored[i] != NULL)
+			continue;
+		hash = fingerprint_add(hash, it->key, strlen(it->key) + 1);
+		if (it->value)
+			hash = fingerprint_add(hash, it->value, strlen(it->value) + 1);
+	}
+
+	*fingerprint = hash ^ count;
+	if (count > 0) {
+		port->formats_fingerprint = *fingerprint;
+		port->have_formats_fingerprint = true;
+	}
+	return count;
+}
+
+static void format_cache_entry_free(struct pw_context *context,
+		struct format_cache_entry *e)
+{
+	spa_list_remove(&e->link);
+	context->n_format_cache--;
+	free(e->format);
+	free(e);
+}
+
+static struct format_cache_entry *format_cache_find(struct pw_context *context,
+		const uint64_t key[2])
+{
+	struct format_cache_entry *e;
+
+	spa_list_for_each(e, &context->format_cache, link) {
+		if (e->key[0] == key[0] && e->key[1] == key[1]) {
+			/* move to the front, least recently used entries are evicted first */
+			spa_list_remove(&e->link);
+			spa_list_prepend(&context->format_cache, &e->link);
+			return e;
+		}
+	}
+	return NULL;
+}
+
+static void format_cache_add(struct pw_context *context, const uint64_t key[2],
+		const struct spa_pod *format)
+{
+	struct format_cache_entry *e;
+	uint32_t max = context->settings.link_format_cache;
+
+	if (max == 0)
+		return;
+
+	if ((e = calloc(1, sizeof(*e))) == NULL)
+		return;
+	if ((e->format = spa_pod_copy(format)) == NULL) {
+		free(e);
+		return;
+	}
+	e->key[0] = key[0];
+	e->key[1] = key[1];
+	spa_list_prepend(&context->format_cache, &e->link);
+	context->n_format_cache++;
+
+	while (context->n_format_cache > max) {
+		e = spa_list_last(&context->format_cache, struct format_cache_entry, link);
+		format_cache_entry_free(context, e);
+	}
+}
+
+static void format_cache_invalidate(struct pw_context *context, uint64_t fingerprint)
+{
+	struct format_cache_entry *e, *t;
+
+	spa_list_for_each_safe(e, t, &context->format_cache, link) {
+		if (e->key[0] == fingerprint || e->key[1] == fingerprint)
+			format_cache_entry_free(context, e);
+	}
+}
+
+void pw_impl_link_clear_format_cache(struct pw_context *context)
+{
+	struct format_cache_entry *e;
+
+	spa_list_consume(e, &context->format_cache, link)
+		format_cache_entry_free(context, e);
+}
+
 /* find a common format. info[0] has the higher priority.
  * Either the format contains a valid common format or error is set. */
 static int link_find_format(struct pw_impl_link *this,
@@ -337,8 +507,33 @@ static int link_find_format(struct pw_impl_link *this,
 			}
 		}
 	} else if (state[0] == PW_IMPL_PORT_STATE_CONFIGURE && state[1] == PW_IMPL_PORT_STATE_CONFIGURE) {
-		bool do_filter = true;
+		bool do_filter = true, use_cache = false;
 		int count = 0;
+		uint64_t key[2];
+		struct format_cache_entry *e;
+
+		/* ports that advertise the same formats as a previous link will
+		 * negotiate the same format, try to reuse it */
+		if (this->context->settings.link_format_cache > 0 &&
+		    port_format_fingerprint(info[0], &key[0]) > 0 &&
+		    port_format_fingerprint(info[1], &key[1]) > 0) {
+			info[0]->fingerprint = key[0];
+			info[1]->fingerprint = key[1];
+			use_cache = true;
+
+			if ((e = format_cache_find(this->context, key)) != NULL) {
+				uint32_t offset = builder->state.offset;
+				if ((res = spa_pod_builder_raw_padded(builder, e->format,
+								SPA_POD_SIZE(e->format))) < 0) {
+					*error = spa_aprintf("failed to add pod");
+					goto error;
+				}
+				*format = spa_pod_builder_deref(builder, offset);
+				pw_log_debug("%p: using cached format:", this);
+				pw_log_pod(SPA_LOG_LEVEL_DEBUG, *format);
+				return 1;
+			}
+		}
 	      again:
 		/* both ports need a format, we start with a format from port 0 and use that
 		 * as a filter for port 1. Because the filter has higher priority, its
@@ -387,6 +582,9 @@ static int link_find_format(struct pw_impl_link *this,
 
 		pw_log_debug("%p: Got filtered:", this);
 		pw_log_pod(SPA_LOG_LEVEL_DEBUG, *format);
+
+		if (use_cache)
+			format_cache_add(this->context, key, *format);
 	} else {
 		res = -EBADF;
 		*error = spa_aprintf("error bad node state");
@@ -728,10 +926,10 @@ static int do_allocation(struct pw_impl_link *this)
 		out_port = output->port_id;
 #endif
 
-		if ((res = pw_buffers_negotiate(this->context, alloc_flags,
+		if ((res = pw_buffers_negotiate_recycled(this->context, alloc_flags,
 						out_node, out_port,
 						in_node, in_port,
-						&output->buffers)) < 0) {
+						&output->buffers, &output->recycled_mem)) < 0) {
 			error = spa_aprintf("error alloc buffers: %s", spa_strerror(res));
 			goto error;
 		}
@@ -1064,6 +1262,7 @@ static void port_state_changed(struct pw_impl_link *this, struct pw_impl_port *p
 static void port_param_changed(struct pw_impl_link *this, uint32_t id,
 		struct pw_impl_port *outport, struct pw_impl_port *inport)
 {
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
 	enum pw_impl_port_state target;
 
 	pw_log_debug("%p: outport %p input %p param %d (%s)", this,
@@ -1076,6 +1275,14 @@ static void port_param_changed(struct pw_impl_link *this, uint32_t id,
 	default:
 		return;
 	}
+	/* the formats of one of the ports changed, results negotiated with
+	 * the old formats can't be used anymore */
+	if (impl->output.fingerprint != 0)
+		format_cache_invalidate(this->context, impl->output.fingerprint);
+	if (impl->input.fingerprint != 0)
+		format_cache_invalidate(this->context, impl->input.fingerprint);
+	impl->output.fingerprint = impl->input.fingerprint = 0;
+
 	if (outport)
 		pw_impl_port_update_state(outport, target, 0, NULL);
 	if (inport)
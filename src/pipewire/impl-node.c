@@ -13,6 +13,7 @@
 
 #include "config.h"
 
+#include <spa/support/cpu.h>
 #include <spa/support/system.h>
 #include <spa/pod/parser.h>
 #include <spa/pod/filter.h>
@@ -1112,6 +1113,20 @@ static int execute_match(void *data, const char *location, const char *action,
 	return 1;
 }
 
+static int
+do_update_denormals(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_node *node = user_data;
+	const bool *zero_denormals = data;
+
+	node->rt.zero_denormals = zero_denormals[0];
+	node->rt.loop_zero_denormals = zero_denormals[1];
+	node->rt.switch_denormals = node->rt.cpu != NULL &&
+		zero_denormals[0] != zero_denormals[1];
+	return 0;
+}
+
 static void check_properties(struct pw_impl_node *node)
 {
 	struct impl *impl = SPA_CONTAINER_OF(node, struct impl, this);
@@ -1119,7 +1134,7 @@ static void check_properties(struct pw_impl_node *node)
 	const char *str, *recalc_reason = NULL;
 	struct spa_fraction frac;
 	uint32_t value;
-	bool driver, trigger, sync, async;
+	bool driver, trigger, sync, async, zero_denormals[2];
 	struct match match;
 
 	match = MATCH_INIT(node);
@@ -1284,6 +1299,18 @@ static void check_properties(struct pw_impl_node *node)
 	}
 	node->lock_quantum = pw_properties_get_bool(node->properties, PW_KEY_NODE_LOCK_QUANTUM, false);
 
+	/* the data loops flush denormals when cpu.zero.denormals is set, the
+	 * node switches the mode while it processes when it wants otherwise.
+	 * The data loop reads both modes, update them together there. */
+	zero_denormals[1] = pw_properties_get_bool(context->properties,
+			SPA_KEY_CPU_ZERO_DENORMALS, false);
+	zero_denormals[0] = pw_properties_get_bool(node->properties,
+			PW_KEY_NODE_ZERO_DENORMALS, zero_denormals[1]);
+	if (zero_denormals[0] != node->rt.zero_denormals ||
+	    zero_denormals[1] != node->rt.loop_zero_denormals)
+		pw_loop_invoke(node->data_loop, do_update_denormals, SPA_ID_INVALID,
+				zero_denormals, sizeof(zero_denormals), true, node);
+
 	value = pw_properties_get_uint32(node->properties, PW_KEY_NODE_FORCE_QUANTUM, 0);
 	if (node->force_quantum != value) {
 	        node->force_quantum = value;
@@ -1472,7 +1499,7 @@ static inline int process_node(void *data, uint64_t nsec)
 	struct pw_node_activation *a = this->rt.target.activation;
 	struct spa_system *data_system = this->rt.target.system;
 	int status;
-	bool was_awake;
+	bool was_awake, switch_denormals = this->rt.switch_denormals;
 
 	if (!SPA_ATOMIC_CAS(a->status,
 				PW_NODE_ACTIVATION_TRIGGERED,
@@ -1489,6 +1516,9 @@ static inline int process_node(void *data, uint64_t nsec)
 		a->pending_sync = false;
 
 	if (SPA_LIKELY(this->rt.prepared)) {
+		if (SPA_UNLIKELY(switch_denormals))
+			spa_cpu_zero_denormals(this->rt.cpu, this->rt.zero_denormals);
+
 		/* process input mixers */
 		spa_list_for_each(p, &this->rt.input_mix, rt.node_link)
 			spa_node_process_fast(p->mix);
@@ -1501,6 +1531,9 @@ static inline int process_node(void *data, uint64_t nsec)
 			spa_list_for_each(p, &this->rt.output_mix, rt.node_link)
 				spa_node_process_fast(p->mix);
 		}
+
+		if (SPA_UNLIKELY(switch_denormals))
+			spa_cpu_zero_denormals(this->rt.cpu, this->rt.loop_zero_denormals);
 	} else {
 		/* This can happen when we deactivated the node but some links are
 		 * still not shut down. We simply don't schedule the node and make
@@ -1698,6 +1731,8 @@ struct pw_impl_node *pw_context_create_node(struct pw_context *context,
 	this->rt.target.activation = this->activation->map->ptr;
 	this->rt.target.node = this;
 	this->rt.target.system = this->data_loop->system;
+	this->rt.cpu = spa_support_find(context->support, context->n_support,
+			SPA_TYPE_INTERFACE_CPU);
 	this->rt.target.fd = this->source.fd;
 	this->rt.target.trigger = trigger_target_v1;
 
@@ -1842,6 +1877,15 @@ static void node_info(void *data, const struct spa_node_info *info)
 
 			if (info->params[i].flags & SPA_PARAM_INFO_READ)
 				changed_ids[n_changed_ids++] = id;
+
+			if (id == SPA_PARAM_Props) {
+				struct pw_impl_port *p;
+				/* the props are part of the link format cache key */
+				spa_list_for_each(p, &node->input_ports, link)
+					p->have_formats_fingerprint = false;
+				spa_list_for_each(p, &node->output_ports, link)
+					p->have_formats_fingerprint = false;
+			}
 		}
 	}
 	emit_info_changed(node, flags_changed);
@@ -446,6 +446,7 @@ static int update_properties(struct pw_impl_port *port, const struct spa_dict *d
 	if (changed) {
 		pw_log_debug("%p: updated %d properties", port, changed);
 		port->info.change_mask |= PW_PORT_CHANGE_MASK_PROPS;
+		port->have_formats_fingerprint = false;
 	}
 	return changed;
 }
@@ -661,6 +662,9 @@ static void update_info(struct pw_impl_port *port, const struct spa_port_info *i
 				changed_ids[n_changed_ids++] = id;
 
 			switch (id) {
+			case SPA_PARAM_EnumFormat:
+				port->have_formats_fingerprint = false;
+				break;
 			case SPA_PARAM_Latency:
 				port->have_latency_param =
 					SPA_FLAG_IS_SET(info->params[i].flags, SPA_PARAM_INFO_WRITE);
@@ -1412,6 +1416,21 @@ static void pw_impl_port_remove(struct pw_impl_port *port)
 	port->node = NULL;
 }
 
+/* clear the port buffers. With \a recycle, the shared memory of the buffers
+ * is kept and reused by the next negotiation on the port */
+static void clear_buffers(struct pw_impl_port *port, bool recycle)
+{
+	if (port->recycled_mem && (!recycle || port->buffers.mem)) {
+		pw_memblock_unref(port->recycled_mem);
+		port->recycled_mem = NULL;
+	}
+	if (recycle && port->buffers.mem) {
+		port->recycled_mem = port->buffers.mem;
+		port->buffers.mem = NULL;
+	}
+	pw_buffers_clear(&port->buffers);
+}
+
 void pw_impl_port_destroy(struct pw_impl_port *port)
 {
 	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
@@ -1442,7 +1461,7 @@ void pw_impl_port_destroy(struct pw_impl_port *port)
 
 	spa_hook_list_clean(&port->listener_list);
 
-	pw_buffers_clear(&port->buffers);
+	clear_buffers(port, false);
 	pw_buffers_clear(&port->mix_buffers);
 	free((void*)port->error);
 
@@ -1861,7 +1880,10 @@ int pw_impl_port_set_param(struct pw_impl_port *port, uint32_t id, uint32_t flag
 			spa_list_for_each(l, &port->links, output_link)
 				pw_impl_port_use_buffers(l->input, &l->rt.in_mix, 0, NULL, 0);
 		}
-		pw_buffers_clear(&port->buffers);
+		/* when a new format follows, the shared memory is kept for the
+		 * next negotiation */
+		clear_buffers(port, res >= 0 && param != NULL &&
+				spa_pod_is_fixated(param) > 0);
 		pw_buffers_clear(&port->mix_buffers);
 
 		if (param == NULL || res < 0) {
@@ -183,6 +183,9 @@ extern "C" {
 								  *  default node. If the target is removed,
 								  *  the node is destroyed */
 #define PW_KEY_NODE_ALWAYS_PROCESS	"node.always-process"	/**< process even when unlinked */
+#define PW_KEY_NODE_ZERO_DENORMALS	"node.zero-denormals"	/**< flush denormals to zero while the
+								  *  node processes. The default is the
+								  *  cpu.zero.denormals context property */
 #define PW_KEY_NODE_WANT_DRIVER		"node.want-driver"	/**< the node wants to be grouped with a driver
 								  *  node in order to schedule the graph. */
 #define PW_KEY_NODE_PAUSE_ON_IDLE	"node.pause-on-idle"	/**< pause the node when idle */
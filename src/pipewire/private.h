@@ -47,6 +47,7 @@ struct settings {
 	struct spa_rectangle video_size;
 	struct spa_fraction video_rate;
 	uint32_t link_max_buffers;
+	uint32_t link_format_cache;		/* max cached negotiation results */
 	unsigned int mem_warn_mlock:1;
 	unsigned int mem_allow_mlock:1;
 	unsigned int clock_power_of_two_quantum:1;
@@ -413,6 +414,8 @@ struct pw_context {
 	struct spa_list control_list[2];	/**< list of controls, indexed by direction */
 	struct spa_list export_list;		/**< list of export types */
 	struct spa_list driver_list;		/**< list of driver nodes */
+	struct spa_list format_cache;		/**< cache of negotiated link formats */
+	uint32_t n_format_cache;		/**< number of entries in format_cache */
 
 	struct spa_hook_list driver_listener_list;
 	struct spa_hook_list listener_list;
@@ -847,6 +850,12 @@ struct pw_impl_node {
 
 		struct spa_ratelimit rate_limit;
 
+		struct spa_cpu *cpu;			/**< to switch the denormals mode */
+		bool zero_denormals;			/**< denormals are flushed while processing */
+		bool loop_zero_denormals;		/**< the mode of the data loop, restored
+							  *  after processing */
+		bool switch_denormals;			/**< the data loop uses the other mode */
+
 		bool prepared;				/**< the node was added to loop */
 	} rt;
 	struct pw_node_peer *to_driver_peer;		/* node -> driver */
@@ -941,9 +950,14 @@ struct pw_impl_port {
 	struct pw_properties *properties;	/**< properties of the port */
 	struct pw_port_info info;
 	struct spa_param_info params[MAX_PARAMS];
+	uint64_t formats_fingerprint;	/**< hash of the EnumFormat params, the node
+					  *  Props and the port properties, used by
+					  *  the link format cache */
 
 	struct pw_buffers buffers;	/**< buffers managed by this port, only on
 					  *  output ports, shared with all links */
+	struct pw_memblock *recycled_mem;	/**< memory of the buffers of the previous
+						  *  format, reused by the next negotiation */
 
 	struct spa_list links;		/**< list of \ref pw_impl_link */
 
@@ -982,6 +996,8 @@ struct pw_impl_port {
 	unsigned int have_tag_param:1;
 	struct spa_pod *tag[2];			/**< tags */
 
+	unsigned int have_formats_fingerprint:1;
+
 	void *owner_data;		/**< extra owner data */
 	void *user_data;                /**< extra user data */
 };
@@ -1363,6 +1379,16 @@ int pw_impl_link_activate(struct pw_impl_link *link);
 /** Deactivate a link */
 int pw_impl_link_deactivate(struct pw_impl_link *link);
 
+/** Negotiate buffers like pw_buffers_negotiate() and reuse the memory in
+ * \a recycled when it fits. \a recycled is released and cleared on success */
+int pw_buffers_negotiate_recycled(struct pw_context *context, uint32_t flags,
+		struct spa_node *outnode, uint32_t out_port_id,
+		struct spa_node *innode, uint32_t in_port_id,
+		struct pw_buffers *result, struct pw_memblock **recycled);
+
+/** Clear the negotiated format cache of \a context */
+void pw_impl_link_clear_format_cache(struct pw_context *context);
+
 struct pw_control *
 pw_control_new(struct pw_context *context,
 	       struct pw_impl_port *owner,		/**< can be NULL */
@@ -57,6 +57,9 @@ struct node {
 	struct driver info;
 	uint32_t info_base;
 	struct node *driver;
+	int64_t wakeup_start;
+	uint32_t wakeups;
+	uint32_t wakeup_rate;
 	uint32_t generation;
 	char format[MAX_FORMAT+1];
 	struct pw_proxy *proxy;
@@ -367,6 +370,29 @@ static void remove_node(struct data *d, struct node *n)
 	free(n);
 }
 
+/* A cycle is a wakeup when the driver slept since the previous cycle. Drivers
+ * that run a burst of cycles start them faster than the cycle period. */
+static void update_wakeups(struct node *n, struct measurement *m, struct driver *info)
+{
+	int64_t period = 0;
+
+	if (info->clock.rate.denom)
+		period = (int64_t)(info->clock.duration * SPA_NSEC_PER_SEC *
+			info->clock.rate.num / info->clock.rate.denom);
+
+	if (m->prev_signal == 0 || m->signal > m->prev_signal + period / 2)
+		n->wakeups++;
+
+	if (n->wakeup_start == 0 || m->signal < n->wakeup_start) {
+		n->wakeup_start = m->signal;
+		n->wakeups = 0;
+	} else if (m->signal >= n->wakeup_start + SPA_NSEC_PER_SEC) {
+		n->wakeup_rate = n->wakeups * SPA_NSEC_PER_SEC / (m->signal - n->wakeup_start);
+		n->wakeup_start = m->signal;
+		n->wakeups = 0;
+	}
+}
+
 static int process_driver_block(struct data *d, const struct spa_pod *pod, struct point *point)
 {
 	char *name = NULL;
@@ -392,6 +418,8 @@ static int process_driver_block(struct data *d, const struct spa_pod *pod, struc
 	if ((n = find_node(d, id)) == NULL)
 		return -ENOENT;
 
+	update_wakeups(n, &m, &point->info);
+
 	n->driver = n;
 	n->measurement = m;
 	n->info = point->info;
@@ -495,6 +523,7 @@ static void print_node(struct data *d, struct node *dr, struct node *n, int y)
 	char buf2[64];
 	char buf3[64];
 	char buf4[64];
+	char buf5[64];
 	uint64_t waiting, busy;
 	float quantum;
 	struct spa_fraction frac;
@@ -528,7 +557,12 @@ static void print_node(struct data *d, struct node *dr, struct node *n, int y)
 	else
 		busy = -1;
 
-	print_mode_dependent(d, y, 0, "%s %4.1u %6.1u %6.1u %s %s %s %s  %3.1u %16.16s %s%s",
+	if (active && n->driver == n)
+		snprintf(buf5, sizeof(buf5), "%5u", n->wakeup_rate);
+	else
+		snprintf(buf5, sizeof(buf5), "  ---");
+
+	print_mode_dependent(d, y, 0, "%s %4.1u %6.1u %6.1u %s %s %s %s  %3.1u %s %16.16s %s%s",
 			state_as_string(n->state, i->transport_state),
 			n->id,
 			frac.num, frac.denom,
@@ -539,6 +573,7 @@ static void print_node(struct data *d, struct node *dr, struct node *n, int y)
 			n->measurement.xrun_count == XRUN_INVALID ?
 					i->xrun_count - dr->info_base :
 					n->measurement.xrun_count - n->measurement_base,
+			buf5,
 			active ? n->format : "",
 			n->driver == n ? "" : " + ",
 			n->name);
@@ -551,7 +586,7 @@ static void clear_node(struct node *n)
 	spa_zero(n->info);
 }
 
-#define HEADER	"S   ID  QUANT   RATE    WAIT    BUSY   W/Q   B/Q  ERR FORMAT           NAME "
+#define HEADER	"S   ID  QUANT   RATE    WAIT    BUSY   W/Q   B/Q  ERR  WAKE FORMAT           NAME "
 
 static void do_refresh(struct data *d, bool force_refresh)
 {
@@ -0,0 +1,449 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 agent <agent@local> */
+/* SPDX-License-Identifier: MIT */
+
+#include "pwtest.h"
+
+#include <spa/node/node.h>
+#include <spa/node/utils.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/props.h>
+#include <spa/pod/filter.h>
+#include <spa/utils/result.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/impl.h>
+
+#define N_PORT_PARAMS	4
+#define MAX_RATES	4
+
+struct test_node {
+	struct spa_node node;
+	struct spa_hook_list hooks;
+	enum spa_direction direction;
+
+	struct spa_param_info params[1];
+	struct spa_param_info port_params[N_PORT_PARAMS];
+
+	uint32_t rates[MAX_RATES];
+	uint32_t n_rates;
+	float volume;
+
+	uint32_t n_enum_formats;
+	uint32_t n_filtered;
+	uint32_t format_rate;
+};
+
+static void test_node_emit_info(struct test_node *t)
+{
+	struct spa_node_info info = SPA_NODE_INFO_INIT();
+
+	info.max_input_ports = t->direction == SPA_DIRECTION_INPUT ? 1 : 0;
+	info.max_output_ports = t->direction == SPA_DIRECTION_OUTPUT ? 1 : 0;
+	info.change_mask = SPA_NODE_CHANGE_MASK_PARAMS;
+	info.params = t->params;
+	info.n_params = SPA_N_ELEMENTS(t->params);
+	spa_node_emit_info(&t->hooks, &info);
+}
+
+static void test_node_emit_port_info(struct test_node *t)
+{
+	struct spa_port_info info = SPA_PORT_INFO_INIT();
+
+	info.change_mask = SPA_PORT_CHANGE_MASK_PARAMS;
+	info.params = t->port_params;
+	info.n_params = SPA_N_ELEMENTS(t->port_params);
+	spa_node_emit_port_info(&t->hooks, t->direction, 0, &info);
+}
+
+static int test_node_add_listener(void *object, struct spa_hook *listener,
+		const struct spa_node_events *events, void *data)
+{
+	struct test_node *t = object;
+	struct spa_hook_list save;
+
+	spa_hook_list_isolate(&t->hooks, &save, listener, events, data);
+	test_node_emit_info(t);
+	test_node_emit_port_info(t);
+	spa_hook_list_join(&t->hooks, &save);
+	return 0;
+}
+
+static int test_node_set_callbacks(void *object,
+		const struct spa_node_callbacks *callbacks, void *data)
+{
+	return 0;
+}
+
+static int test_node_sync(void *object, int seq)
+{
+	struct test_node *t = object;
+	spa_node_emit_result(&t->hooks, seq, 0, 0, NULL);
+	return 0;
+}
+
+static int emit_param(struct test_node *t, int seq, struct spa_result_node_params *result,
+		struct spa_pod_builder *b, struct spa_pod *param, const struct spa_pod *filter)
+{
+	if (spa_pod_filter(b, &result->param, param, filter) < 0)
+		return 0;
+	spa_node_emit_result(&t->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, result);
+	return 1;
+}
+
+static int test_node_enum_params(void *object, int seq, uint32_t id,
+		uint32_t start, uint32_t num, const struct spa_pod *filter)
+{
+	struct test_node *t = object;
+	struct spa_result_node_params result = { .id = id, .index = 0, .next = 1 };
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+
+	if (id != SPA_PARAM_Props)
+		return -ENOENT;
+	if (start > 0)
+		return 0;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_Props, id,
+			SPA_PROP_volume, SPA_POD_Float(t->volume));
+	emit_param(t, seq, &result, &b, param, filter);
+	return 0;
+}
+
+static int test_node_set_param(void *object, uint32_t id, uint32_t flags,
+		const struct spa_pod *param)
+{
+	return 0;
+}
+
+static int test_node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	return 0;
+}
+
+static int test_node_send_command(void *object, const struct spa_command *command)
+{
+	return 0;
+}
+
+static int test_node_port_enum_params(void *object, int seq,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t id, uint32_t start, uint32_t num,
+		const struct spa_pod *filter)
+{
+	struct test_node *t = object;
+	struct spa_result_node_params result;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	struct spa_pod_frame f;
+	uint32_t i, count = 0;
+
+	result.id = id;
+	result.next = start;
+
+	if (id == SPA_PARAM_EnumFormat) {
+		t->n_enum_formats++;
+		if (filter != NULL)
+			t->n_filtered++;
+	}
+      next:
+	result.index = result.next++;
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_EnumFormat:
+		if (result.index > 0)
+			return 0;
+		spa_pod_builder_push_object(&b, &f, SPA_TYPE_OBJECT_Format, id);
+		spa_pod_builder_add(&b,
+			SPA_FORMAT_mediaType,      SPA_POD_Id(SPA_MEDIA_TYPE_audio),
+			SPA_FORMAT_mediaSubtype,   SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+			SPA_FORMAT_AUDIO_format,   SPA_POD_Id(SPA_AUDIO_FORMAT_F32P),
+			SPA_FORMAT_AUDIO_channels, SPA_POD_Int(1),
+			0);
+		spa_pod_builder_prop(&b, SPA_FORMAT_AUDIO_rate, 0);
+		if (t->n_rates > 1) {
+			struct spa_pod_frame c;
+			spa_pod_builder_push_choice(&b, &c, SPA_CHOICE_Enum, 0);
+			spa_pod_builder_int(&b, t->rates[0]);
+			for (i = 0; i < t->n_rates; i++)
+				spa_pod_builder_int(&b, t->rates[i]);
+			spa_pod_builder_pop(&b, &c);
+		} else {
+			spa_pod_builder_int(&b, t->rates[0]);
+		}
+		param = spa_pod_builder_pop(&b, &f);
+		break;
+	case SPA_PARAM_Format:
+		if (t->format_rate == 0)
+			return -EIO;
+		if (result.index > 0)
+			return 0;
+		param = spa_format_audio_raw_build(&b, id,
+				&SPA_AUDIO_INFO_RAW_INIT(
+					.format = SPA_AUDIO_FORMAT_F32P,
+					.rate = t->format_rate,
+					.channels = 1));
+		break;
+	case SPA_PARAM_Buffers:
+		if (t->format_rate == 0)
+			return -EIO;
+		if (result.index > 0)
+			return 0;
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamBuffers, id,
+			SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(2, 1, 8),
+			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+			SPA_PARAM_BUFFERS_size,    SPA_POD_Int(4096),
+			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(4));
+		break;
+	case SPA_PARAM_IO:
+		if (result.index > 0)
+			return 0;
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamIO, id,
+			SPA_PARAM_IO_id,   SPA_POD_Id(SPA_IO_Buffers),
+			SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_buffers)));
+		break;
+	default:
+		return -ENOENT;
+	}
+
+	count += emit_param(t, seq, &result, &b, param, filter);
+	if (count != num)
+		goto next;
+	return 0;
+}
+
+static int test_node_port_set_param(void *object,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t id, uint32_t flags, const struct spa_pod *param)
+{
+	struct test_node *t = object;
+	struct spa_audio_info_raw info = { 0 };
+
+	if (id != SPA_PARAM_Format)
+		return -ENOENT;
+	if (param == NULL) {
+		t->format_rate = 0;
+		return 0;
+	}
+	if (spa_format_audio_raw_parse(param, &info) < 0)
+		return -EINVAL;
+	t->format_rate = info.rate;
+	return 0;
+}
+
+static int test_node_port_use_buffers(void *object,
+		enum spa_direction direction, uint32_t port_id, uint32_t flags,
+		struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	return 0;
+}
+
+static int test_node_port_set_io(void *object,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t id, void *data, size_t size)
+{
+	return 0;
+}
+
+static int test_node_process(void *object)
+{
+	return SPA_STATUS_OK;
+}
+
+static const struct spa_node_methods test_node_methods = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = test_node_add_listener,
+	.set_callbacks = test_node_set_callbacks,
+	.sync = test_node_sync,
+	.enum_params = test_node_enum_params,
+	.set_param = test_node_set_param,
+	.set_io = test_node_set_io,
+	.send_command = test_node_send_command,
+	.port_enum_params = test_node_port_enum_params,
+	.port_set_param = test_node_port_set_param,
+	.port_use_buffers = test_node_port_use_buffers,
+	.port_set_io = test_node_port_set_io,
+	.process = test_node_process,
+};
+
+static void test_node_init(struct test_node *t, enum spa_direction direction,
+		const uint32_t *rates, uint32_t n_rates)
+{
+	spa_zero(*t);
+	t->node.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_Node,
+			SPA_VERSION_NODE, &test_node_methods, t);
+	spa_hook_list_init(&t->hooks);
+	t->direction = direction;
+	t->params[0] = SPA_PARAM_INFO(SPA_PARAM_Props, SPA_PARAM_INFO_READWRITE);
+	t->port_params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	t->port_params[1] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	t->port_params[2] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	t->port_params[3] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
+	memcpy(t->rates, rates, n_rates * sizeof(uint32_t));
+	t->n_rates = n_rates;
+	t->volume = 1.0f;
+}
+
+static void test_node_set_rates(struct test_node *t, const uint32_t *rates, uint32_t n_rates)
+{
+	memcpy(t->rates, rates, n_rates * sizeof(uint32_t));
+	t->n_rates = n_rates;
+	t->port_params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+	test_node_emit_port_info(t);
+}
+
+static void test_node_set_volume(struct test_node *t, float volume)
+{
+	t->volume = volume;
+	t->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+	test_node_emit_info(t);
+}
+
+static struct pw_impl_node *create_node(struct pw_context *context, struct test_node *t)
+{
+	struct pw_impl_node *node;
+
+	node = pw_context_create_node(context, NULL, 0);
+	pwtest_ptr_notnull(node);
+	pwtest_neg_errno_ok(pw_impl_node_set_implementation(node, &t->node));
+	pwtest_neg_errno_ok(pw_impl_node_register(node, NULL));
+	pwtest_neg_errno_ok(pw_impl_node_set_active(node, true));
+	return node;
+}
+
+static enum pw_link_state wait_link(struct pw_loop *loop, struct pw_impl_link *link)
+{
+	const struct pw_link_info *info = pw_impl_link_get_info(link);
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		if (info->state == PW_LINK_STATE_ERROR ||
+		    info->state >= PW_LINK_STATE_PAUSED)
+			break;
+		pw_loop_iterate(loop, 10);
+	}
+	return info->state;
+}
+
+static struct pw_impl_link *create_link(struct pw_context *context,
+		struct pw_impl_node *out, struct pw_impl_node *in)
+{
+	struct pw_impl_link *link;
+
+	link = pw_context_create_link(context,
+			pw_impl_node_find_port(out, PW_DIRECTION_OUTPUT, 0),
+			pw_impl_node_find_port(in, PW_DIRECTION_INPUT, 0),
+			NULL, NULL, 0);
+	pwtest_ptr_notnull(link);
+	pwtest_neg_errno_ok(pw_impl_link_register(link, NULL));
+	return link;
+}
+
+static void reset_counters(struct test_node *out, struct test_node *in)
+{
+	out->n_enum_formats = out->n_filtered = 0;
+	in->n_enum_formats = in->n_filtered = 0;
+}
+
+PWTEST(link_format_cache)
+{
+	static const uint32_t out_rates[] = { 48000, 44100 };
+	static const uint32_t in_rates[] = { 44100, 48000, 96000 };
+	static const uint32_t new_rates[] = { 96000 };
+	struct pw_main_loop *main_loop;
+	struct pw_loop *loop;
+	struct pw_context *context;
+	struct test_node out, in;
+	struct pw_impl_node *out_node, *in_node;
+	struct pw_impl_link *link;
+
+	pw_init(0, NULL);
+
+	main_loop = pw_main_loop_new(NULL);
+	loop = pw_main_loop_get_loop(main_loop);
+	context = pw_context_new(loop,
+			pw_properties_new(
+				PW_KEY_CONFIG_NAME, "null",
+				"link.format-cache", "8",
+				NULL), 0);
+	pwtest_ptr_notnull(context);
+
+	pw_loop_enter(loop);
+
+	test_node_init(&out, SPA_DIRECTION_OUTPUT, out_rates, SPA_N_ELEMENTS(out_rates));
+	test_node_init(&in, SPA_DIRECTION_INPUT, in_rates, SPA_N_ELEMENTS(in_rates));
+	out_node = create_node(context, &out);
+	in_node = create_node(context, &in);
+
+	/* the first link negotiates with the formats of the output as filter */
+	reset_counters(&out, &in);
+	link = create_link(context, out_node, in_node);
+	pwtest_int_ge(wait_link(loop, link), PW_LINK_STATE_PAUSED);
+	pwtest_int_eq(in.format_rate, 48000u);
+	pwtest_int_gt(in.n_filtered, 0u);
+	pw_impl_link_destroy(link);
+	pwtest_int_eq(in.format_rate, 0u);
+
+	/* linking the same ports again takes the format from the cache without
+	 * enumerating the formats of the ports */
+	reset_counters(&out, &in);
+	link = create_link(context, out_node, in_node);
+	pwtest_int_ge(wait_link(loop, link), PW_LINK_STATE_PAUSED);
+	pwtest_int_eq(out.format_rate, 48000u);
+	pwtest_int_eq(in.format_rate, 48000u);
+	pwtest_int_eq(out.n_enum_formats, 0u);
+	pwtest_int_eq(in.n_enum_formats, 0u);
+
+	/* new formats on the output invalidate the cached result and the link
+	 * negotiates again */
+	reset_counters(&out, &in);
+	test_node_set_rates(&out, new_rates, SPA_N_ELEMENTS(new_rates));
+	pwtest_int_ge(wait_link(loop, link), PW_LINK_STATE_PAUSED);
+	pwtest_int_eq(out.format_rate, 96000u);
+	pwtest_int_eq(in.format_rate, 96000u);
+	pwtest_int_gt(in.n_filtered, 0u);
+	pw_impl_link_destroy(link);
+
+	/* the props of the node are part of the key, a change makes a miss */
+	reset_counters(&out, &in);
+	test_node_set_volume(&out, 0.5f);
+	link = create_link(context, out_node, in_node);
+	pwtest_int_ge(wait_link(loop, link), PW_LINK_STATE_PAUSED);
+	pwtest_int_eq(in.format_rate, 96000u);
+	pwtest_int_gt(in.n_filtered, 0u);
+	pw_impl_link_destroy(link);
+
+	/* and with the same props again, it is a hit */
+	reset_counters(&out, &in);
+	link = create_link(context, out_node, in_node);
+	pwtest_int_ge(wait_link(loop, link), PW_LINK_STATE_PAUSED);
+	pwtest_int_eq(in.format_rate, 96000u);
+	pwtest_int_eq(in.n_enum_formats, 0u);
+	pw_impl_link_destroy(link);
+
+	pw_impl_node_destroy(out_node);
+	pw_impl_node_destroy(in_node);
+
+	pw_loop_leave(loop);
+
+	pw_context_destroy(context);
+	pw_main_loop_destroy(main_loop);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+PWTEST_SUITE(link)
+{
+	pwtest_add(link_format_cache, PWTEST_NOARG);
+
+	return PWTEST_PASS;
+}
@@ -9,9 +9,11 @@
 #include <spa/pod/iter.h>
 #include <spa/pod/parser.h>
 #include <spa/pod/vararg.h>
+#include <spa/pod/filter.h>
 #include <spa/debug/pod.h>
 #include <spa/param/format.h>
 #include <spa/param/video/raw.h>
+#include <spa/param/audio/format-utils.h>
 #include <spa/utils/string.h>
 
 #include "pwtest.h"
@@ -1668,6 +1670,102 @@ PWTEST(pod_overflow2)
 	return PWTEST_PASS;
 }
 
+static struct spa_pod *build_video_format(struct spa_pod_builder *b,
+		uint32_t format1, uint32_t format2)
+{
+	return spa_pod_builder_add_object(b,
+		SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat,
+		SPA_FORMAT_mediaType,		SPA_POD_Id(SPA_MEDIA_TYPE_video),
+		SPA_FORMAT_mediaSubtype,	SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+		SPA_FORMAT_VIDEO_format,	SPA_POD_CHOICE_ENUM_Id(3,
+							format1, format1, format2),
+		SPA_FORMAT_VIDEO_size,		SPA_POD_CHOICE_RANGE_Rectangle(
+							&SPA_RECTANGLE(320, 240),
+							&SPA_RECTANGLE(1, 1),
+							&SPA_RECTANGLE(4096, 4096)),
+		SPA_FORMAT_VIDEO_framerate,	SPA_POD_CHOICE_RANGE_Fraction(
+							&SPA_FRACTION(25, 1),
+							&SPA_FRACTION(0, 1),
+							&SPA_FRACTION(120, 1)));
+}
+
+PWTEST(pod_filter_overflow)
+{
+	uint8_t buf[1024], fbuf[1024], obuf[1024];
+	struct spa_pod_builder b, fb, ob;
+	struct spa_pod *pod, *filter, *result;
+	uint32_t size;
+
+	spa_pod_builder_init(&b, buf, sizeof(buf));
+	pod = build_video_format(&b, SPA_VIDEO_FORMAT_RGB, SPA_VIDEO_FORMAT_YUY2);
+	spa_pod_builder_init(&fb, fbuf, sizeof(fbuf));
+	filter = build_video_format(&fb, SPA_VIDEO_FORMAT_YUY2, SPA_VIDEO_FORMAT_RGB);
+
+	/* find the size of the result */
+	spa_pod_builder_init(&ob, obuf, sizeof(obuf));
+	spa_assert_se(spa_pod_filter(&ob, &result, pod, filter) >= 0);
+	spa_assert_se(result != NULL);
+	size = ob.state.offset;
+	spa_assert_se(size == SPA_ROUND_UP_N(SPA_POD_SIZE(result), 8));
+
+	/* on overflow the builder is advanced with the required size */
+	spa_pod_builder_init(&ob, obuf, size / 2);
+	spa_assert_se(spa_pod_filter(&ob, &result, pod, filter) == -ENOSPC);
+	spa_assert_se(ob.state.offset == size);
+
+	/* on a filter error the builder is unchanged */
+	spa_pod_builder_init(&fb, fbuf, sizeof(fbuf));
+	filter = build_video_format(&fb, SPA_VIDEO_FORMAT_BGRA, SPA_VIDEO_FORMAT_I420);
+	spa_pod_builder_init(&ob, obuf, sizeof(obuf));
+	spa_assert_se(spa_pod_filter(&ob, &result, pod, filter) == -EINVAL);
+	spa_assert_se(ob.state.offset == 0);
+
+	return PWTEST_PASS;
+}
+
+PWTEST(pod_audio_raw_channels)
+{
+	uint8_t buffer[4096];
+	struct spa_pod_builder b;
+	struct spa_pod *pod;
+	struct spa_audio_info_raw info;
+	struct spa_audio_info ainfo;
+	struct {
+		struct spa_audio_info_raw info;
+		uint32_t position[100 - SPA_AUDIO_MAX_CHANNELS];
+	} ext;
+	uint32_t i;
+
+	spa_zero(ext);
+	ext.info.format = SPA_AUDIO_FORMAT_F32P;
+	ext.info.rate = 48000;
+	ext.info.channels = 100;
+	for (i = 0; i < ext.info.channels; i++)
+		ext.info.position[i] = SPA_AUDIO_CHANNEL_AUX0 + i;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	pod = spa_format_audio_raw_ext_build(&b, SPA_PARAM_Format, &ext.info, sizeof(ext));
+	spa_assert_se(pod != NULL);
+
+	/* the ext variant needs room for all positions */
+	spa_assert_se(spa_format_audio_raw_ext_parse(pod, &info, sizeof(info)) == -ECHRNG);
+	spa_zero(ext);
+	spa_assert_se(spa_format_audio_raw_ext_parse(pod, &ext.info, sizeof(ext)) >= 0);
+	spa_assert_se(ext.info.channels == 100);
+	spa_assert_se(!SPA_FLAG_IS_SET(ext.info.flags, SPA_AUDIO_FLAG_UNPOSITIONED));
+	spa_assert_se(ext.info.position[99] == SPA_AUDIO_CHANNEL_AUX0 + 99);
+
+	/* the legacy functions parse it as unpositioned */
+	spa_assert_se(spa_format_audio_raw_parse(pod, &info) >= 0);
+	spa_assert_se(info.channels == 100);
+	spa_assert_se(SPA_FLAG_IS_SET(info.flags, SPA_AUDIO_FLAG_UNPOSITIONED));
+	spa_assert_se(spa_format_audio_parse(pod, &ainfo) >= 0);
+	spa_assert_se(ainfo.info.raw.channels == 100);
+	spa_assert_se(SPA_FLAG_IS_SET(ainfo.info.raw.flags, SPA_AUDIO_FLAG_UNPOSITIONED));
+
+	return PWTEST_PASS;
+}
+
 PWTEST_SUITE(spa_pod)
 {
 	pwtest_add(pod_abi_sizes, PWTEST_NOARG);
@@ -1682,6 +1780,8 @@ PWTEST_SUITE(spa_pod)
 	pwtest_add(pod_static, PWTEST_NOARG);
 	pwtest_add(pod_overflow, PWTEST_NOARG);
 	pwtest_add(pod_overflow2, PWTEST_NOARG);
+	pwtest_add(pod_filter_overflow, PWTEST_NOARG);
+	pwtest_add(pod_audio_raw_channels, PWTEST_NOARG);
 
 	return PWTEST_PASS;
 }